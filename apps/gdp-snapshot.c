@@ -0,0 +1,164 @@
+/* vim: set ai sw=4 sts=4 ts=4 : */
+
+/*
+**  GDP-SNAPSHOT --- make consistent backup copies of logs
+**
+**	----- BEGIN LICENSE BLOCK -----
+**	Applications for the Global Data Plane
+**	From the Ubiquitous Swarm Lab, 490 Cory Hall, U.C. Berkeley.
+**
+**	Copyright (c) 2015, Regents of the University of California.
+**	All rights reserved.
+**
+**	Permission is hereby granted, without written agreement and without
+**	license or royalty fees, to use, copy, modify, and distribute this
+**	software and its documentation for any purpose, provided that the above
+**	copyright notice and the following two paragraphs appear in all copies
+**	of this software.
+**
+**	IN NO EVENT SHALL REGENTS BE LIABLE TO ANY PARTY FOR DIRECT, INDIRECT,
+**	SPECIAL, INCIDENTAL, OR CONSEQUENTIAL DAMAGES, INCLUDING LOST
+**	PROFITS, ARISING OUT OF THE USE OF THIS SOFTWARE AND ITS DOCUMENTATION,
+**	EVEN IF REGENTS HAS BEEN ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+**
+**	REGENTS SPECIFICALLY DISCLAIMS ANY WARRANTIES, INCLUDING, BUT NOT
+**	LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+**	FOR A PARTICULAR PURPOSE. THE SOFTWARE AND ACCOMPANYING DOCUMENTATION,
+**	IF ANY, PROVIDED HEREUNDER IS PROVIDED "AS IS". REGENTS HAS NO
+**	OBLIGATION TO PROVIDE MAINTENANCE, SUPPORT, UPDATES, ENHANCEMENTS,
+**	OR MODIFICATIONS.
+**	----- END LICENSE BLOCK -----
+*/
+
+#include <gdp/gdp.h>
+
+#include <ep/ep_app.h>
+#include <ep/ep_dbg.h>
+
+#include <sysexits.h>
+#include <time.h>
+
+/*
+**  Each log is copied by the server that holds it into a
+**  directory named by the label under that server's snapshot
+**  directory (swarm.gdplogd.snapshot.dir).  Giving several logs
+**  on one command line puts them all under the same label, but
+**  each is cut independently.  If no label is given, one is made
+**  up here from the current time (in the same form the server
+**  would use) so that it is the same for every log.
+*/
+
+void
+usage(void)
+{
+	fprintf(stderr,
+			"Usage: %s [-D dbg_spec] [-G router_addr] [-l label] log_name ...\n"
+			"    -D  set debugging flags\n"
+			"    -G  IP host to contact for gdp_router\n"
+			"    -l  name of snapshot (default: current UTC time)\n",
+			ep_app_getprogname());
+	exit(EX_USAGE);
+}
+
+
+int
+main(int argc, char **argv)
+{
+	int opt;
+	bool show_usage = false;
+	EP_STAT estat;
+	gdp_gcl_t *gcl;
+	char *gdpd_addr = NULL;
+	const char *label = NULL;
+	char lbuf[40];
+	char buf[200];
+	const char *lname;
+	gdp_name_t gcliname;
+	gdp_recno_t recno;
+	const char *phase;
+	int nfail = 0;
+
+	while ((opt = getopt(argc, argv, "D:G:l:")) > 0)
+	{
+		switch (opt)
+		{
+		 case 'D':
+			ep_dbg_set(optarg);
+			break;
+
+		 case 'G':
+			gdpd_addr = optarg;
+			break;
+
+		 case 'l':
+			label = optarg;
+			break;
+
+		 default:
+			show_usage = true;
+			break;
+		}
+	}
+	argc -= optind;
+	argv += optind;
+
+	if (show_usage || argc < 1)
+		usage();
+
+	if (label == NULL)
+	{
+		time_t now = time(NULL);
+		struct tm tm;
+
+		strftime(lbuf, sizeof lbuf, "%Y%m%dT%H%M%SZ", gmtime_r(&now, &tm));
+		label = lbuf;
+	}
+
+	// initialize GDP library
+	estat = gdp_init(gdpd_addr);
+	if (!EP_STAT_ISOK(estat))
+	{
+		ep_app_error("GDP Initialization failed");
+		goto fail0;
+	}
+
+	// allow thread to settle to avoid interspersed debug output
+	ep_time_nanosleep(INT64_C(100000000));
+
+	for (; argc > 0; argc--, argv++)
+	{
+		EP_STAT cstat;
+
+		// open the log (must already exist)
+		lname = argv[0];
+		gdp_parse_name(lname, gcliname);
+		phase = "open";
+		estat = gdp_gcl_open(gcliname, GDP_MODE_RO, NULL, &gcl);
+		EP_STAT_CHECK(estat, goto fail1);
+
+		phase = "snapshot";
+		estat = gdp_gcl_snapshot(gcl, label, &recno);
+		if (EP_STAT_ISOK(estat))
+			printf("%s: snapshot %s through record %" PRIgdp_recno "\n",
+					lname, label, recno);
+
+		cstat = gdp_gcl_close(gcl);
+		if (EP_STAT_ISOK(estat))
+			estat = cstat;
+
+		if (!EP_STAT_ISOK(estat))
+		{
+fail1:
+			ep_app_error("could not %s %s", phase, lname);
+			nfail++;
+		}
+	}
+
+	if (nfail > 0 && EP_STAT_ISOK(estat))
+		estat = EP_STAT_ERROR;
+
+fail0:
+	fprintf(stderr, "exiting with status %s\n",
+			ep_stat_tostr(estat, buf, sizeof buf));
+	return EP_STAT_ISOK(estat) ? EX_OK : EX_UNAVAILABLE;
+}
@@ -29,6 +29,8 @@
 ***********************************************************************/
 
 #include <ep/ep.h>
+#include <ep/ep_compress.h>
+#include <ep/ep_crc32c.h>
 #include <ep/ep_dbg.h>
 #include <ep/ep_hash.h>
 #include <ep/ep_hexdump.h>
@@ -36,6 +38,7 @@
 #include <ep/ep_prflags.h>
 #include <ep/ep_string.h>
 #include <ep/ep_time.h>
+#include <ep/ep_varint.h>
 #include <ep/ep_xlate.h>
 #include <gdp/gdp.h>
 
@@ -53,6 +56,7 @@
 
 // following are actually private definitions
 #include <gdp/gdp_priv.h>
+#include <gdp/gdp_hashchain.h>
 #include <gdplogd/logd_disklog.h>
 
 
@@ -202,23 +206,170 @@ show_metadata(int nmds, FILE *dfp, size_t *foffp, int plev)
 EP_PRFLAGS_DESC	RecordFlags[] =
 {
 	{ REC_HAS_SIGNATURE,	REC_HAS_SIGNATURE,	"HAS_SIGNATURE"		},
+	{ REC_HAS_CHECKSUM,		REC_HAS_CHECKSUM,	"HAS_CHECKSUM"		},
+	{ REC_IS_COMPRESSED,	REC_IS_COMPRESSED,	"IS_COMPRESSED"		},
 	{ 0,					0,					NULL				}
 };
 
 
+// count of bad record checksums (we keep going so all are reported)
+static int	ChecksumErrors = 0;
+
+// state for checking chain hashes
+static gdp_name_t	ChainGname;			// name of log (for anchor)
+static int			ChainAlg;			// alg of ChainLink (0 = none)
+static uint8_t		ChainLink[EP_CRYPTO_MD_MAXSIZE];	// previous link
+static gdp_merkle_t	ExtMerkle;			// summary of current extent
+
+// compression dictionary for the current log (if any)
+static EP_COMPRESS_DICT	*LogDict;
+
+
+static void
+print_hash(const char *tag, const uint8_t *h, size_t hlen)
+{
+	size_t i;
+
+	fprintf(stdout, "\t%s ", tag);
+	for (i = 0; i < hlen; i++)
+		fprintf(stdout, "%02x", h[i]);
+}
+
+/*
+**  Read a record header in either the fixed or compact format.
+**
+**		Returns the header in host order, the raw bytes (for
+**		dumping), and the CRC of the part covered by the checksum.
+**		Compact headers don't have a record number, so we are
+**		given the one we expect.  Returns EOF at the end of the
+**		extent.
+*/
+
 int
-show_record(extent_record_t *rec, FILE *dfp, size_t *foffp, int plev)
+read_record_header(FILE *dfp,
+		extent_header_t *xhdr,
+		gdp_recno_t recno,
+		extent_record_t *rec,
+		uint8_t *raw,
+		size_t *rawlenp,
+		uint32_t *crcp)
 {
-	rec->recno = ep_net_ntoh64(rec->recno);
-	ep_net_ntoh_timespec(&rec->timestamp);
-	rec->sigmeta = ep_net_ntoh16(rec->sigmeta);
-	rec->flags = ep_net_ntoh16(rec->flags);
-	rec->data_length = ep_net_ntoh32(rec->data_length);
+	uint64_t v;
+	size_t n, i, l;
+	long off;
+
+	if (xhdr->version < GCL_LDF_VERS_COMPACT)
+	{
+		if (fread(rec, sizeof *rec, 1, dfp) != 1)
+			return EOF;
+		memcpy(raw, rec, sizeof *rec);
+		*rawlenp = sizeof *rec;
+
+		// checksum covers the on-disk header with the checksum field zeroed
+		memset(&raw[offsetof(extent_record_t, checksum)], 0,
+				sizeof rec->checksum);
+		*crcp = ep_crc32c(0, raw, sizeof *rec);
+		memcpy(raw, rec, sizeof *rec);
+
+		rec->recno = ep_net_ntoh64(rec->recno);
+		ep_net_ntoh_timespec(&rec->timestamp);
+		rec->sigmeta = ep_net_ntoh16(rec->sigmeta);
+		rec->flags = ep_net_ntoh16(rec->flags);
+		rec->checksum = ep_net_ntoh32(rec->checksum);
+		rec->data_length = ep_net_ntoh32(rec->data_length);
+		return 0;
+	}
+
+	off = ftell(dfp);
+	n = fread(raw, 1, REC2_HDR_MAXSIZE, dfp);
+	if (n == 0)
+		return EOF;
+
+	memset(rec, 0, sizeof *rec);
+	rec->recno = recno;
+	i = 1;
+	if ((l = ep_varint_get(&raw[i], n - i, &v)) == 0)
+		goto corrupt;
+	i += l;
+	rec->data_length = (int32_t) v;
+	if (EP_UT_BITSET(REC2_HAS_HASHES, raw[0]))
+	{
+		if (i + 1 > n)
+			goto corrupt;
+		rec->hashalgs = raw[i++];
+	}
+	if (EP_UT_BITSET(REC2_HAS_SIGNATURE, raw[0]))
+	{
+		if (i + 2 > n)
+			goto corrupt;
+		rec->sigmeta = (raw[i] << 8) | raw[i + 1];
+		i += 2;
+	}
+	if (EP_UT_BITSET(REC2_HAS_TIMESTAMP, raw[0]))
+	{
+		if ((l = ep_varint_get(&raw[i], n - i, &v)) == 0)
+			goto corrupt;
+		i += l;
+		rec->timestamp.tv_sec = xhdr->base_time + EP_ZIGZAG_DEC(v);
+		if ((l = ep_varint_get(&raw[i], n - i, &v)) == 0)
+			goto corrupt;
+		i += l;
+		rec->timestamp.tv_nsec = (int32_t) v;
+	}
+	else
+	{
+		EP_TIME_INVALIDATE(&rec->timestamp);
+	}
+	if (EP_UT_BITSET(REC2_HAS_ACCURACY, raw[0]))
+	{
+		uint32_t acc;
+
+		if (i + sizeof acc > n)
+			goto corrupt;
+		memcpy(&acc, &raw[i], sizeof acc);
+		acc = ep_net_ntoh32(acc);
+		memcpy(&rec->timestamp.tv_accuracy, &acc, sizeof acc);
+		i += sizeof acc;
+	}
+	*crcp = ep_crc32c(0, raw, i);
+	if (EP_UT_BITSET(REC2_HAS_CHECKSUM, raw[0]))
+	{
+		if (i + sizeof rec->checksum > n)
+			goto corrupt;
+		memcpy(&rec->checksum, &raw[i], sizeof rec->checksum);
+		rec->checksum = ep_net_ntoh32(rec->checksum);
+		rec->flags |= REC_HAS_CHECKSUM;
+		i += sizeof rec->checksum;
+	}
+	if (EP_UT_BITSET(REC2_IS_COMPRESSED, raw[0]))
+		rec->flags |= REC_IS_COMPRESSED;
+	*rawlenp = i;
+	if (fseek(dfp, off + i, SEEK_SET) < 0)
+		return EOF;
+	return 0;
+
+corrupt:
+	fprintf(stderr, "Corrupt compact record header at offset %ld\n", off);
+	return EX_DATAERR;
+}
+
+
+int
+show_record(extent_record_t *rec,
+		const uint8_t *raw,
+		size_t rawlen,
+		uint32_t crc,
+		FILE *dfp,
+		size_t *foffp,
+		int plev)
+{
+	uint32_t disk_crc = rec->checksum;
 
 	fprintf(stdout, "\n    Recno %" PRIgdp_recno
-			", offset %zd (0x%zx), dlen %" PRIi32
+			", offset %zd (0x%zx), hdrlen %zd, dlen %" PRIi32
 			", sigmeta %x (mdalg %d, len %d)\n",
-			rec->recno, *foffp, *foffp, rec->data_length, rec->sigmeta,
+			rec->recno, *foffp, *foffp, rawlen, rec->data_length,
+			rec->sigmeta,
 			(rec->sigmeta >> 12) & 0x000f, rec->sigmeta & 0x0fff);
 	fprintf(stdout, "\thashalgs %x, flags ", rec->hashalgs);
 	ep_prflags(rec->flags, RecordFlags, stdout);
@@ -228,9 +379,29 @@ show_record(extent_record_t *rec, FILE *dfp, size_t *foffp, int plev)
 
 	if (plev >= 4)
 	{
-		ep_hexdump(&*rec, sizeof *rec, stdout, EP_HEXDUMP_HEX, *foffp);
+		ep_hexdump(raw, rawlen, stdout, EP_HEXDUMP_HEX, *foffp);
 	}
-	*foffp += sizeof *rec;
+	*foffp += rawlen;
+	CHECK_FILE_OFFSET(dfp, *foffp);
+
+	// chain and data hashes
+	uint8_t chash[EP_CRYPTO_MD_MAXSIZE];
+	uint8_t dhash[EP_CRYPTO_MD_MAXSIZE];
+	int calg = REC_CHASH_ALG(rec->hashalgs);
+	int dalg = REC_DHASH_ALG(rec->hashalgs);
+	size_t clen = calg == 0 ? 0 : ep_crypto_md_len(calg);
+	size_t dlen = dalg == 0 ? 0 : ep_crypto_md_len(dalg);
+
+	if ((clen > 0 && fread(chash, clen, 1, dfp) != 1) ||
+		(dlen > 0 && fread(dhash, dlen, 1, dfp) != 1))
+	{
+		fprintf(stderr, "fread() failed while reading hashes (%d)\n",
+				ferror(dfp));
+		return EX_DATAERR;
+	}
+	crc = ep_crc32c(crc, chash, clen);
+	crc = ep_crc32c(crc, dhash, dlen);
+	*foffp += clen + dlen;
 	CHECK_FILE_OFFSET(dfp, *foffp);
 
 	char *data_buffer = malloc(rec->data_length);
@@ -250,8 +421,100 @@ show_record(extent_record_t *rec, FILE *dfp, size_t *foffp, int plev)
 	}
 	*foffp += rec->data_length;
 	CHECK_FILE_OFFSET(dfp, *foffp);
+	crc = ep_crc32c(crc, data_buffer, rec->data_length);
+
+	// hashes cover the uncompressed data
+	size_t data_length = rec->data_length;
+	if (EP_UT_BITSET(REC_IS_COMPRESSED, rec->flags))
+	{
+		uint8_t *zp = (uint8_t *) data_buffer;
+		uint64_t olen = 0;
+		size_t n = 0;
+		size_t outlen;
+		char *out = NULL;
+		EP_STAT estat = EP_STAT_ERROR;
+
+		if (rec->data_length > 1)
+			n = ep_varint_get(&zp[1], rec->data_length - 1, &olen);
+		if (n > 0 && olen <= INT32_MAX)
+		{
+			n++;
+			outlen = olen;
+			out = malloc(outlen + 1);
+			estat = ep_decompress(zp[0], LogDict, &zp[n],
+						rec->data_length - n, out, &outlen);
+		}
+		if (!EP_STAT_ISOK(estat))
+		{
+			char ebuf[100];
+
+			fprintf(stderr, "Recno %" PRIgdp_recno ": cannot decompress: %s\n",
+					rec->recno, ep_stat_tostr(estat, ebuf, sizeof ebuf));
+			free(out);
+			free(data_buffer);
+			return EX_DATAERR;
+		}
+		fprintf(stdout, "\tcompressed %s, %" PRIu64 " => %" PRIi32 " bytes\n",
+				ep_compress_alg_name(zp[0]), olen, rec->data_length);
+		free(data_buffer);
+		data_buffer = out;
+		data_length = outlen;
+	}
+
+	// check the data hash
+	if (dlen > 0)
+	{
+		uint8_t h[EP_CRYPTO_MD_MAXSIZE];
+
+		_gdp_hash_data(dalg, data_buffer, data_length, h);
+		print_hash("dhash", dhash, dlen);
+		if (memcmp(h, dhash, dlen) == 0)
+		{
+			fprintf(stdout, " (OK)\n");
+		}
+		else
+		{
+			fprintf(stdout, " (BAD)\n");
+			fprintf(stderr, "Recno %" PRIgdp_recno ": data hash mismatch\n",
+					rec->recno);
+			ChecksumErrors++;
+		}
+	}
 	free(data_buffer);
 
+	// check the chain hash and extend the chain
+	if (clen > 0 && calg == dalg)
+	{
+		uint8_t expect[EP_CRYPTO_MD_MAXSIZE];
+
+		if (ChainAlg == calg)
+			memcpy(expect, ChainLink, clen);
+		else
+			_gdp_hash_anchor(calg, ChainGname, expect);
+		print_hash("chash", chash, clen);
+		if (memcmp(expect, chash, clen) == 0)
+		{
+			fprintf(stdout, " (OK)\n");
+		}
+		else
+		{
+			fprintf(stdout, " (BROKEN)\n");
+			fprintf(stderr, "Recno %" PRIgdp_recno ": chain hash mismatch\n",
+					rec->recno);
+			ChecksumErrors++;
+		}
+		_gdp_hash_link(calg, chash, rec->recno, dhash, ChainLink);
+		ChainAlg = calg;
+		if (ExtMerkle.mdalg == 0)
+			_gdp_merkle_init(&ExtMerkle, calg);
+		if (ExtMerkle.mdalg == calg)
+			_gdp_merkle_add(&ExtMerkle, ChainLink);
+	}
+	else
+	{
+		ChainAlg = 0;
+	}
+
 	// print the signature
 	if ((rec->sigmeta & 0x0fff) > 0)
 	{
@@ -273,6 +536,20 @@ show_record(extent_record_t *rec, FILE *dfp, size_t *foffp, int plev)
 
 		*foffp += siglen;
 		CHECK_FILE_OFFSET(dfp, *foffp);
+		crc = ep_crc32c(crc, sigbuf, siglen);
+	}
+
+	if (EP_UT_BITSET(REC_HAS_CHECKSUM, rec->flags))
+	{
+		fprintf(stdout, "\tChecksum %08" PRIx32 " (%s)\n", disk_crc,
+				crc == disk_crc ? "OK" : "BAD");
+		if (crc != disk_crc)
+		{
+			fprintf(stderr, "Recno %" PRIgdp_recno
+					": checksum mismatch (computed %08" PRIx32 ")\n",
+					rec->recno, crc);
+			ChecksumErrors++;
+		}
 	}
 
 	return EX_OK;
@@ -300,29 +577,113 @@ open_index(const char *index_filename, struct stat *st, index_header_t *phdr)
 		return NULL;
 	}
 
+	// defaults for old-style headerless index
+	phdr->magic = 0;
+	phdr->version = GCL_LXF_VERS_FLAT;
+	phdr->header_size = 0;
+	phdr->block_entries = 0;
+	phdr->min_recno = 1;
+
 	if (st->st_size < SIZEOF_INDEX_HEADER)
-	{
-		phdr->magic = 0;
 		return index_fp;
-	}
 	if (fread(&index_header, sizeof index_header, 1, index_fp) != 1)
 	{
 		fprintf(stderr, "Could not read hdr for %s (%s)\n",
 				index_filename, strerror(errno));
 	}
-	else
+	else if (index_header.magic != 0)
 	{
 		phdr->magic = ep_net_ntoh32(index_header.magic);
 		phdr->version = ep_net_ntoh32(index_header.version);
 		phdr->header_size = ep_net_ntoh32(index_header.header_size);
-		phdr->reserved1 = ep_net_ntoh32(index_header.reserved1);
+		phdr->block_entries = ep_net_ntoh32(index_header.block_entries);
 		phdr->min_recno = ep_net_ntoh64(index_header.min_recno);
 	}
+	if (phdr->version == GCL_LXF_VERS_BLOCK && phdr->block_entries == 0)
+	{
+		fprintf(stderr, "Bad index block size in %s\n", index_filename);
+		phdr->version = GCL_LXF_VERS_FLAT;
+	}
 
 	return index_fp;
 }
 
 
+/*
+**  Return the number of entries in an index.
+*/
+
+gdp_recno_t
+index_nentries(index_header_t *phdr, off_t fsize)
+{
+	off_t xlen = fsize - phdr->header_size;
+	off_t bsize;
+	gdp_recno_t n;
+
+	if (xlen <= 0)
+		return 0;
+	if (phdr->version != GCL_LXF_VERS_BLOCK)
+		return xlen / SIZEOF_INDEX_RECORD;
+
+	bsize = SIZEOF_INDEX_BLOCK(phdr->block_entries);
+	n = (xlen / bsize) * phdr->block_entries;
+	xlen %= bsize;
+	if (xlen > (off_t) SIZEOF_INDEX_BLOCK_HDR)
+		n += (xlen - SIZEOF_INDEX_BLOCK_HDR) / sizeof (uint32_t);
+	return n;
+}
+
+
+/*
+**  Read the xno'th entry (counting from zero) of an index.
+**
+**		Works for either index format; the result is in host order.
+*/
+
+bool
+read_index_entry(FILE *index_fp,
+		index_header_t *phdr,
+		gdp_recno_t xno,
+		index_entry_t *xent)
+{
+	if (phdr->version == GCL_LXF_VERS_BLOCK)
+	{
+		index_block_t blk;
+		uint32_t ent;
+		off_t boff = (xno / phdr->block_entries) *
+					SIZEOF_INDEX_BLOCK(phdr->block_entries) +
+					phdr->header_size;
+
+		if (fseek(index_fp, boff, SEEK_SET) < 0 ||
+				fread(&blk, sizeof blk, 1, index_fp) != 1 ||
+				fseek(index_fp, boff + SIZEOF_INDEX_BLOCK_HDR +
+						(xno % phdr->block_entries) * sizeof ent,
+					SEEK_SET) < 0 ||
+				fread(&ent, sizeof ent, 1, index_fp) != 1)
+			return false;
+		blk.base_offset = ep_net_ntoh64(blk.base_offset);
+		blk.base_extent = ep_net_ntoh32(blk.base_extent);
+		ent = ep_net_ntoh32(ent);
+		xent->recno = xno + phdr->min_recno;
+		xent->offset = INDEX_ENT_OFFSET(&blk, ent);
+		xent->extent = INDEX_ENT_EXTENT(&blk, ent);
+		xent->reserved = 0;
+	}
+	else
+	{
+		if (fseek(index_fp, xno * SIZEOF_INDEX_RECORD + phdr->header_size,
+					SEEK_SET) < 0 ||
+				fread(xent, SIZEOF_INDEX_RECORD, 1, index_fp) != 1)
+			return false;
+		xent->recno = ep_net_ntoh64(xent->recno);
+		xent->offset = ep_net_ntoh64(xent->offset);
+		xent->extent = ep_net_ntoh32(xent->extent);
+		xent->reserved = ep_net_ntoh32(xent->reserved);
+	}
+	return true;
+}
+
+
 gdp_recno_t
 show_index_header(const char *index_filename,
 		int plev,
@@ -332,6 +693,7 @@ show_index_header(const char *index_filename,
 	struct stat st;
 	index_entry_t xent;
 	index_header_t index_header;
+	gdp_recno_t nents;
 	FILE *index_fp = open_index(index_filename, &st, &index_header);
 
 	*min_extent = 0;
@@ -341,74 +703,67 @@ show_index_header(const char *index_filename,
 		return -1;
 
 	if (index_header.magic == 0)
-		goto no_header;
+	{
+		if (plev > 1)
+			printf("Old-style headerless index\n");
+	}
 	else if (index_header.magic != GCL_LXF_MAGIC)
 	{
 		fprintf(stderr, "Bad index magic %04x\n", index_header.magic);
 	}
 
 	// get info from the first record
-	if (st.st_size <= index_header.header_size)
+	nents = index_nentries(&index_header, st.st_size);
+	if (nents <= 0)
 	{
 		// no records yet
 		if (plev > 1)
 			printf("\tno index records\n");
 		goto done;
 	}
-	else if (fseek(index_fp, index_header.header_size, SEEK_SET) < 0)
+	else if (!read_index_entry(index_fp, &index_header, 0, &xent))
 	{
-		printf("show_index_header: cannot seek (1)\n");
-	}
-	else if (fread(&xent, SIZEOF_INDEX_RECORD, 1, index_fp) != 1)
-	{
-		printf("show_index_header: fread failure (1)\n");
+		printf("show_index_header: cannot read first entry\n");
 	}
 	else
 	{
-		*min_extent = ep_net_ntoh32(xent.extent);
+		*min_extent = xent.extent;
 	}
 
 	// get info from the last record
 	*max_extent = *min_extent;
-	if (fseek(index_fp, st.st_size - SIZEOF_INDEX_RECORD, SEEK_SET) < 0)
-	{
-		printf("show_index_header: cannot seek (2)\n");
-	}
-	else if (fread(&xent, SIZEOF_INDEX_RECORD, 1, index_fp) != 1)
+	if (!read_index_entry(index_fp, &index_header, nents - 1, &xent))
 	{
-		printf("show_index_header: fread failure (2)\n");
+		printf("show_index_header: cannot read last entry\n");
 	}
 	else
 	{
-		*max_extent = ep_net_ntoh32(xent.extent);
+		*max_extent = xent.extent;
 	}
 
 	if (plev > 1)
 	{
 		printf("    Index: magic=%04" PRIx32 ", vers=%" PRId32
-				", header_size=%" PRId32 ", min_recno=%" PRIgdp_recno "\n",
+				", header_size=%" PRId32 ", block_entries=%" PRIu32
+				", min_recno=%" PRIgdp_recno "\n",
 				index_header.magic, index_header.version,
-				index_header.header_size, index_header.min_recno);
+				index_header.header_size, index_header.block_entries,
+				index_header.min_recno);
 
 		printf("\tfirst extent %d, last recno %" PRIgdp_recno
 				" offset %jd extent %d reserved %x\n",
 				*min_extent,
-				ep_net_ntoh64(xent.recno),
-				(intmax_t) ep_net_ntoh64(xent.offset),
-				ep_net_ntoh32(xent.extent),
-				ep_net_ntoh32(xent.reserved));
+				xent.recno,
+				(intmax_t) xent.offset,
+				xent.extent,
+				xent.reserved);
+		printf("\t%jd bytes, %.2f bytes/record\n",
+				(intmax_t) st.st_size,
+				(double) (st.st_size - index_header.header_size) / nents);
 	}
 done:
 	fclose(index_fp);
-	return ((st.st_size - index_header.header_size) / SIZEOF_INDEX_RECORD)
-				+ index_header.min_recno;
-
-no_header:
-	fclose(index_fp);
-	if (plev > 1)
-		printf("Old-style headerless index\n");
-	return st.st_size / SIZEOF_INDEX_RECORD;
-	return -1;
+	return nents + index_header.min_recno;
 }
 
 
@@ -418,6 +773,8 @@ show_index_contents(const char *gcl_dir_name, gdp_name_t gcl_name, int plev)
 	struct stat st;
 	index_header_t index_header;
 	gdp_pname_t gcl_pname;
+	gdp_recno_t xno;
+	gdp_recno_t nents;
 
 	(void) gdp_printable_name(gcl_name, gcl_pname);
 
@@ -440,16 +797,13 @@ show_index_contents(const char *gcl_dir_name, gdp_name_t gcl_name, int plev)
 
 	printf("\n    =============== Index ===============\n");
 
-	while (true)
+	nents = index_nentries(&index_header, st.st_size);
+	for (xno = 0; xno < nents; xno++)
 	{
 		index_entry_t index_entry;
-		if (fread(&index_entry, sizeof index_entry, 1, index_fp) != 1)
-			break;
-		index_entry.recno = ep_net_ntoh64(index_entry.recno);
-		index_entry.offset = ep_net_ntoh64(index_entry.offset);
-		index_entry.extent = ep_net_ntoh32(index_entry.extent);
-		index_entry.reserved = ep_net_ntoh32(index_entry.reserved);
 
+		if (!read_index_entry(index_fp, &index_header, xno, &index_entry))
+			break;
 		printf("\trecno %" PRIgdp_recno ", extent %" PRIu32
 				", offset %" PRIu64 ", reserved %" PRIu32 "\n",
 				index_entry.recno, index_entry.extent,
@@ -460,6 +814,42 @@ show_index_contents(const char *gcl_dir_name, gdp_name_t gcl_name, int plev)
 }
 
 
+/*
+**  Load the compression dictionary for a log (it may not have one).
+*/
+
+void
+load_dict(const char *gcl_dir_name, gdp_name_t gcl_name)
+{
+	gdp_pname_t gcl_pname;
+	char filename[PATH_MAX];
+	struct stat st;
+	FILE *fp;
+
+	ep_compress_dict_free(LogDict);
+	LogDict = NULL;
+
+	(void) gdp_printable_name(gcl_name, gcl_pname);
+	snprintf(filename, sizeof filename, "%s/_%02x/%s%s",
+			gcl_dir_name, gcl_name[0], gcl_pname, GCL_DICT_SUFFIX);
+	if (stat(filename, &st) != 0 || st.st_size <= 0 ||
+			(fp = fopen(filename, "r")) == NULL)
+		return;
+
+	void *dictdata = malloc(st.st_size);
+	if (fread(dictdata, st.st_size, 1, fp) == 1)
+		LogDict = ep_compress_dict_new(EP_COMPRESS_ZSTD, 0,
+						dictdata, st.st_size);
+	if (LogDict == NULL)
+		fprintf(stderr, "Could not load dictionary %s\n", filename);
+	else
+		ep_dbg_cprintf(Dbg, 6, "Dictionary %s (id %" PRIu32 ")\n",
+				filename, ep_compress_dict_id(LogDict));
+	free(dictdata);
+	fclose(fp);
+}
+
+
 int
 show_extent(const char *gcl_dir_name,
 		gdp_name_t gcl_name,
@@ -519,9 +909,17 @@ show_extent(const char *gcl_dir_name,
 	log_header.n_md_entries = ep_net_ntoh16(log_header.n_md_entries);
 	log_header.log_type = ep_net_ntoh16(log_header.log_type);
 	log_header.extent = ep_net_ntoh32(log_header.extent);
-	log_header.reserved2 = ep_net_ntoh64(log_header.reserved2);
+	log_header.base_time = ep_net_ntoh64(log_header.base_time);
 	log_header.recno_offset = ep_net_ntoh64(log_header.recno_offset);
 
+	// a new log starts a new chain; each extent has its own summary
+	memcpy(ChainGname, log_header.gname, sizeof ChainGname);
+	if (log_header.extent == 0)
+		ChainAlg = 0;
+	_gdp_merkle_init(&ExtMerkle, 0);
+	if (extno == 0 || LogDict == NULL)
+		load_dict(gcl_dir_name, gcl_name);
+
 	if (plev >= 1)
 	{
 		gdp_pname_t pname;
@@ -538,6 +936,9 @@ show_extent(const char *gcl_dir_name,
 				", metadata entries %d, recno_offset %" PRIgdp_recno "\n",
 				log_header.header_size, log_header.header_size,
 				log_header.n_md_entries, log_header.recno_offset);
+		if (log_header.version >= GCL_LDF_VERS_COMPACT)
+			printf("\tcompact record headers, base time %" PRIi64 "\n",
+					log_header.base_time);
 		if (plev >= 4)
 		{
 			ep_hexdump(&log_header, sizeof log_header, stdout,
@@ -564,12 +965,37 @@ show_extent(const char *gcl_dir_name,
 
 	fprintf(stdout, "    --------------- Data ---------------\n");
 
-	while (fread(&record, sizeof record, 1, data_fp) == 1)
+	gdp_recno_t recno = log_header.recno_offset;
+	for (;;)
 	{
-		istat = show_record(&record, data_fp, &file_offset, plev);
+		uint8_t raw[REC2_HDR_MAXSIZE > sizeof record ?
+						REC2_HDR_MAXSIZE : sizeof record];
+		size_t rawlen;
+		uint32_t crc;
+
+		istat = read_record_header(data_fp, &log_header, ++recno,
+						&record, raw, &rawlen, &crc);
+		if (istat == EOF)
+			istat = 0;
+		if (istat != 0)
+			break;
+		istat = show_record(&record, raw, rawlen, crc, data_fp,
+						&file_offset, plev);
 		if (istat != 0)
 			break;
 	}
+	if (ExtMerkle.nleaves > 0)
+	{
+		uint8_t root[EP_CRYPTO_MD_MAXSIZE];
+		size_t rootlen = _gdp_merkle_root(&ExtMerkle, root);
+
+		fprintf(stdout, "\n    Extent %d summary over %" PRIu64 " records:\n",
+				extno, ExtMerkle.nleaves);
+		print_hash("Merkle root", root, rootlen);
+		fprintf(stdout, "\n");
+	}
+	if (istat == 0 && ChecksumErrors > 0)
+		istat = EX_DATAERR;
 
 fail0:
 success:
@@ -0,0 +1,457 @@
+/* vim: set ai sw=8 sts=8 ts=8 :*/
+
+/***********************************************************************
+**  ----- BEGIN LICENSE BLOCK -----
+**	LIBEP: Enhanced Portability Library (Reduced Edition)
+**
+**	Copyright (c) 2008-2015, Eric P. Allman.  All rights reserved.
+**	Copyright (c) 2015, Regents of the University of California.
+**	All rights reserved.
+**
+**	Permission is hereby granted, without written agreement and without
+**	license or royalty fees, to use, copy, modify, and distribute this
+**	software and its documentation for any purpose, provided that the above
+**	copyright notice and the following two paragraphs appear in all copies
+**	of this software.
+**
+**	IN NO EVENT SHALL REGENTS BE LIABLE TO ANY PARTY FOR DIRECT, INDIRECT,
+**	SPECIAL, INCIDENTAL, OR CONSEQUENTIAL DAMAGES, INCLUDING LOST
+**	PROFITS, ARISING OUT OF THE USE OF THIS SOFTWARE AND ITS DOCUMENTATION,
+**	EVEN IF REGENTS HAS BEEN ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+**
+**	REGENTS SPECIFICALLY DISCLAIMS ANY WARRANTIES, INCLUDING, BUT NOT
+**	LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+**	FOR A PARTICULAR PURPOSE. THE SOFTWARE AND ACCOMPANYING DOCUMENTATION,
+**	IF ANY, PROVIDED HEREUNDER IS PROVIDED "AS IS". REGENTS HAS NO
+**	OBLIGATION TO PROVIDE MAINTENANCE, SUPPORT, UPDATES, ENHANCEMENTS,
+**	OR MODIFICATIONS.
+**  ----- END LICENSE BLOCK -----
+***********************************************************************/
+
+
+
+/*
+**  EP_COMPRESS.C --- lossless data compression
+*/
+
+#include <ep/ep_compress.h>
+#include <ep/ep_dbg.h>
+#include <ep/ep_mem.h>
+
+#include <limits.h>
+#include <string.h>
+#include <strings.h>
+
+#if EP_OSCF_USE_LZ4
+# include <lz4.h>
+#endif
+#if EP_OSCF_USE_ZSTD
+# include <zstd.h>
+# include <zdict.h>
+# if EP_OSCF_USE_PTHREADS
+#  include <pthread.h>
+# endif
+#endif
+
+#if EP_OSCF_USE_ZSTD
+static EP_DBG	Dbg = EP_DBG_INIT("libep.compress", "data compression");
+#endif
+
+struct ep_compress_dict
+{
+	int		alg;		// algorithm this is for
+	uint32_t	id;		// dictionary id (zero if none)
+#if EP_OSCF_USE_ZSTD
+	ZSTD_CDict	*cdict;		// digested for compression
+	ZSTD_DDict	*ddict;		// digested for decompression
+#endif
+};
+
+
+#if EP_OSCF_USE_ZSTD
+
+/*
+**  zstd contexts
+**
+**	These are expensive to set up, so each thread keeps one
+**	of each around for reuse.  They are freed when the thread
+**	exits.
+*/
+
+#if EP_OSCF_USE_PTHREADS
+
+static pthread_once_t	ZctxOnce = PTHREAD_ONCE_INIT;
+static pthread_key_t	CctxKey;
+static pthread_key_t	DctxKey;
+
+static void
+cctx_free(void *cctx)
+{
+	ZSTD_freeCCtx(cctx);
+}
+
+static void
+dctx_free(void *dctx)
+{
+	ZSTD_freeDCtx(dctx);
+}
+
+static void
+zctx_init(void)
+{
+	(void) pthread_key_create(&CctxKey, cctx_free);
+	(void) pthread_key_create(&DctxKey, dctx_free);
+}
+
+static ZSTD_CCtx *
+zstd_cctx(void)
+{
+	ZSTD_CCtx *cctx;
+
+	(void) pthread_once(&ZctxOnce, zctx_init);
+	if ((cctx = pthread_getspecific(CctxKey)) == NULL &&
+			(cctx = ZSTD_createCCtx()) != NULL)
+		(void) pthread_setspecific(CctxKey, cctx);
+	return cctx;
+}
+
+static ZSTD_DCtx *
+zstd_dctx(void)
+{
+	ZSTD_DCtx *dctx;
+
+	(void) pthread_once(&ZctxOnce, zctx_init);
+	if ((dctx = pthread_getspecific(DctxKey)) == NULL &&
+			(dctx = ZSTD_createDCtx()) != NULL)
+		(void) pthread_setspecific(DctxKey, dctx);
+	return dctx;
+}
+
+#else // !EP_OSCF_USE_PTHREADS
+
+static ZSTD_CCtx	*Cctx;
+static ZSTD_DCtx	*Dctx;
+
+static ZSTD_CCtx *
+zstd_cctx(void)
+{
+	if (Cctx == NULL)
+		Cctx = ZSTD_createCCtx();
+	return Cctx;
+}
+
+static ZSTD_DCtx *
+zstd_dctx(void)
+{
+	if (Dctx == NULL)
+		Dctx = ZSTD_createDCtx();
+	return Dctx;
+}
+
+#endif // EP_OSCF_USE_PTHREADS
+#endif // EP_OSCF_USE_ZSTD
+
+
+/*
+**  Algorithm names
+*/
+
+struct name_to_alg
+{
+	const char	*str;		// string name of algorithm
+	int		alg;		// internal name
+};
+
+static struct name_to_alg	CompressAlgStrings[] =
+{
+	{ "none",		EP_COMPRESS_NONE,		},
+	{ "lz4",		EP_COMPRESS_LZ4,		},
+	{ "zstd",		EP_COMPRESS_ZSTD,		},
+	{ NULL,			-1				}
+};
+
+int
+ep_compress_alg_byname(const char *name)
+{
+	struct name_to_alg *na;
+
+	for (na = CompressAlgStrings; na->str != NULL; na++)
+	{
+		if (strcasecmp(na->str, name) == 0)
+			break;
+	}
+	return na->alg;
+}
+
+const char *
+ep_compress_alg_name(int alg)
+{
+	struct name_to_alg *na;
+
+	for (na = CompressAlgStrings; na->str != NULL; na++)
+	{
+		if (na->alg == alg)
+			return na->str;
+	}
+	return "unknown";
+}
+
+
+/*
+**  Return true if an algorithm was compiled in.
+*/
+
+bool
+ep_compress_available(int alg)
+{
+	switch (alg)
+	{
+	  case EP_COMPRESS_NONE:
+		return true;
+
+#if EP_OSCF_USE_LZ4
+	  case EP_COMPRESS_LZ4:
+		return true;
+#endif
+
+#if EP_OSCF_USE_ZSTD
+	  case EP_COMPRESS_ZSTD:
+		return true;
+#endif
+	}
+	return false;
+}
+
+
+size_t
+ep_compress_bound(int alg, size_t len)
+{
+	switch (alg)
+	{
+#if EP_OSCF_USE_LZ4
+	  case EP_COMPRESS_LZ4:
+		if (len > LZ4_MAX_INPUT_SIZE)
+			return 0;
+		return LZ4_compressBound((int) len);
+#endif
+
+#if EP_OSCF_USE_ZSTD
+	  case EP_COMPRESS_ZSTD:
+		return ZSTD_compressBound(len);
+#endif
+	}
+	return len;
+}
+
+
+/*
+**  Compress and decompress
+**
+**	The output buffer has to be big enough; if compressed output
+**	won't fit in *outlenp bytes this fails, which callers can use
+**	to give up early on incompressible data.
+*/
+
+EP_STAT
+ep_compress(int alg,
+		int level,
+		EP_COMPRESS_DICT *dict,
+		const void *in,
+		size_t inlen,
+		void *out,
+		size_t *outlenp)
+{
+	switch (alg)
+	{
+#if EP_OSCF_USE_LZ4
+	  case EP_COMPRESS_LZ4:
+	  {
+		int n;
+		size_t cap = *outlenp;
+
+		if (inlen > LZ4_MAX_INPUT_SIZE)
+			return EP_STAT_COMPRESS_FAILED;
+		if (cap > INT_MAX)
+			cap = INT_MAX;
+		n = LZ4_compress_default(in, out, (int) inlen, (int) cap);
+		if (n <= 0)
+			return EP_STAT_COMPRESS_FAILED;
+		*outlenp = n;
+		return EP_STAT_OK;
+	  }
+#endif
+
+#if EP_OSCF_USE_ZSTD
+	  case EP_COMPRESS_ZSTD:
+	  {
+		ZSTD_CCtx *cctx = zstd_cctx();
+		size_t n;
+
+		if (cctx == NULL)
+			return EP_STAT_OUT_OF_MEMORY;
+		if (dict != NULL && dict->cdict != NULL)
+			n = ZSTD_compress_usingCDict(cctx, out, *outlenp,
+					in, inlen, dict->cdict);
+		else
+			n = ZSTD_compressCCtx(cctx, out, *outlenp,
+					in, inlen, level);
+		if (ZSTD_isError(n))
+		{
+			ep_dbg_cprintf(Dbg, 40, "ep_compress: %s\n",
+					ZSTD_getErrorName(n));
+			return EP_STAT_COMPRESS_FAILED;
+		}
+		*outlenp = n;
+		return EP_STAT_OK;
+	  }
+#endif
+	}
+	return EP_STAT_COMPRESS_UNAVAIL;
+}
+
+
+EP_STAT
+ep_decompress(int alg,
+		EP_COMPRESS_DICT *dict,
+		const void *in,
+		size_t inlen,
+		void *out,
+		size_t *outlenp)
+{
+	switch (alg)
+	{
+#if EP_OSCF_USE_LZ4
+	  case EP_COMPRESS_LZ4:
+	  {
+		int n;
+		size_t cap = *outlenp;
+
+		if (inlen > INT_MAX)
+			return EP_STAT_DECOMPRESS_FAILED;
+		if (cap > INT_MAX)
+			cap = INT_MAX;
+		n = LZ4_decompress_safe(in, out, (int) inlen, (int) cap);
+		if (n < 0)
+			return EP_STAT_DECOMPRESS_FAILED;
+		*outlenp = n;
+		return EP_STAT_OK;
+	  }
+#endif
+
+#if EP_OSCF_USE_ZSTD
+	  case EP_COMPRESS_ZSTD:
+	  {
+		ZSTD_DCtx *dctx;
+		unsigned int fdict = ZSTD_getDictID_fromFrame(in, inlen);
+		size_t n;
+
+		if (fdict != 0 && (dict == NULL || dict->id != fdict))
+		{
+			ep_dbg_cprintf(Dbg, 1,
+					"ep_decompress: need dictionary %u\n", fdict);
+			return EP_STAT_COMPRESS_DICT;
+		}
+		if ((dctx = zstd_dctx()) == NULL)
+			return EP_STAT_OUT_OF_MEMORY;
+		if (fdict != 0)
+			n = ZSTD_decompress_usingDDict(dctx, out, *outlenp,
+					in, inlen, dict->ddict);
+		else
+			n = ZSTD_decompressDCtx(dctx, out, *outlenp, in, inlen);
+		if (ZSTD_isError(n))
+		{
+			ep_dbg_cprintf(Dbg, 1, "ep_decompress: %s\n",
+					ZSTD_getErrorName(n));
+			return EP_STAT_DECOMPRESS_FAILED;
+		}
+		*outlenp = n;
+		return EP_STAT_OK;
+	  }
+#endif
+	}
+	return EP_STAT_COMPRESS_UNAVAIL;
+}
+
+
+/*
+**  Dictionaries
+**
+**	A dictionary is built from sample data using
+**	ep_compress_dict_train and can then be stored (it's just
+**	bytes).  ep_compress_dict_new digests the bytes into a form
+**	that can be used for compression and decompression.
+*/
+
+EP_COMPRESS_DICT *
+ep_compress_dict_new(int alg,
+		int level,
+		const void *dictdata,
+		size_t dictlen)
+{
+#if EP_OSCF_USE_ZSTD
+	if (alg == EP_COMPRESS_ZSTD)
+	{
+		EP_COMPRESS_DICT *dict = ep_mem_zalloc(sizeof *dict);
+
+		dict->alg = alg;
+		dict->id = ZDICT_getDictID(dictdata, dictlen);
+		dict->cdict = ZSTD_createCDict(dictdata, dictlen, level);
+		dict->ddict = ZSTD_createDDict(dictdata, dictlen);
+		if (dict->cdict == NULL || dict->ddict == NULL)
+		{
+			ep_compress_dict_free(dict);
+			return NULL;
+		}
+		return dict;
+	}
+#endif
+	return NULL;
+}
+
+void
+ep_compress_dict_free(EP_COMPRESS_DICT *dict)
+{
+	if (dict == NULL)
+		return;
+#if EP_OSCF_USE_ZSTD
+	if (dict->cdict != NULL)
+		ZSTD_freeCDict(dict->cdict);
+	if (dict->ddict != NULL)
+		ZSTD_freeDDict(dict->ddict);
+#endif
+	ep_mem_free(dict);
+}
+
+uint32_t
+ep_compress_dict_id(EP_COMPRESS_DICT *dict)
+{
+	return dict == NULL ? 0 : dict->id;
+}
+
+EP_STAT
+ep_compress_dict_train(int alg,
+		const void *samples,
+		const size_t *samplesizes,
+		unsigned int nsamples,
+		void *dictdata,
+		size_t *dictlenp)
+{
+#if EP_OSCF_USE_ZSTD
+	if (alg == EP_COMPRESS_ZSTD)
+	{
+		size_t n;
+
+		n = ZDICT_trainFromBuffer(dictdata, *dictlenp,
+				samples, samplesizes, nsamples);
+		if (ZDICT_isError(n))
+		{
+			ep_dbg_cprintf(Dbg, 1, "ep_compress_dict_train: %s\n",
+					ZDICT_getErrorName(n));
+			return EP_STAT_COMPRESS_DICT;
+		}
+		*dictlenp = n;
+		return EP_STAT_OK;
+	}
+#endif
+	return EP_STAT_COMPRESS_UNAVAIL;
+}
@@ -0,0 +1,112 @@
+/* vim: set ai sw=8 sts=8 ts=8 :*/
+
+/***********************************************************************
+**  ----- BEGIN LICENSE BLOCK -----
+**	LIBEP: Enhanced Portability Library (Reduced Edition)
+**
+**	Copyright (c) 2008-2015, Eric P. Allman.  All rights reserved.
+**	Copyright (c) 2015, Regents of the University of California.
+**	All rights reserved.
+**
+**	Permission is hereby granted, without written agreement and without
+**	license or royalty fees, to use, copy, modify, and distribute this
+**	software and its documentation for any purpose, provided that the above
+**	copyright notice and the following two paragraphs appear in all copies
+**	of this software.
+**
+**	IN NO EVENT SHALL REGENTS BE LIABLE TO ANY PARTY FOR DIRECT, INDIRECT,
+**	SPECIAL, INCIDENTAL, OR CONSEQUENTIAL DAMAGES, INCLUDING LOST
+**	PROFITS, ARISING OUT OF THE USE OF THIS SOFTWARE AND ITS DOCUMENTATION,
+**	EVEN IF REGENTS HAS BEEN ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+**
+**	REGENTS SPECIFICALLY DISCLAIMS ANY WARRANTIES, INCLUDING, BUT NOT
+**	LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+**	FOR A PARTICULAR PURPOSE. THE SOFTWARE AND ACCOMPANYING DOCUMENTATION,
+**	IF ANY, PROVIDED HEREUNDER IS PROVIDED "AS IS". REGENTS HAS NO
+**	OBLIGATION TO PROVIDE MAINTENANCE, SUPPORT, UPDATES, ENHANCEMENTS,
+**	OR MODIFICATIONS.
+**  ----- END LICENSE BLOCK -----
+***********************************************************************/
+
+
+
+/*
+**  EP_COMPRESS.H --- lossless data compression
+**
+**	This is a thin layer over whatever compression libraries were
+**	compiled in (LZ4 if EP_OSCF_USE_LZ4 is set, zstd if
+**	EP_OSCF_USE_ZSTD is set).  LZ4 is very fast with modest
+**	ratios; zstd is slower but compresses much better, especially
+**	with a dictionary trained on typical data.
+**
+**	Compressed data does not record its own length or algorithm;
+**	callers have to store those if they need them.
+*/
+
+#ifndef _EP_COMPRESS_H_
+#define _EP_COMPRESS_H_
+
+#include <ep/ep.h>
+
+// compression algorithms (these values appear on disk and on the wire)
+#define EP_COMPRESS_NONE	0
+#define EP_COMPRESS_LZ4		1
+#define EP_COMPRESS_ZSTD	2
+#define EP_COMPRESS_MAX		2		// highest algorithm number
+
+// an opaque (pre-digested) compression dictionary
+typedef struct ep_compress_dict	EP_COMPRESS_DICT;
+
+// algorithm names and availability
+extern int	ep_compress_alg_byname(
+			const char *name);
+extern const char
+		*ep_compress_alg_name(
+			int alg);
+extern bool	ep_compress_available(
+			int alg);
+
+// maximum size of compressed output for len input bytes
+extern size_t	ep_compress_bound(
+			int alg,
+			size_t len);
+
+// compress; *outlenp is the size of out on entry, the used size on return
+extern EP_STAT	ep_compress(
+			int alg,
+			int level,
+			EP_COMPRESS_DICT *dict,
+			const void *in,
+			size_t inlen,
+			void *out,
+			size_t *outlenp);
+
+// decompress; *outlenp is the size of out on entry, the used size on return
+extern EP_STAT	ep_decompress(
+			int alg,
+			EP_COMPRESS_DICT *dict,
+			const void *in,
+			size_t inlen,
+			void *out,
+			size_t *outlenp);
+
+// dictionaries (currently only for zstd)
+extern EP_COMPRESS_DICT
+		*ep_compress_dict_new(
+			int alg,
+			int level,
+			const void *dictdata,
+			size_t dictlen);
+extern void	ep_compress_dict_free(
+			EP_COMPRESS_DICT *dict);
+extern uint32_t	ep_compress_dict_id(
+			EP_COMPRESS_DICT *dict);
+extern EP_STAT	ep_compress_dict_train(
+			int alg,
+			const void *samples,
+			const size_t *samplesizes,
+			unsigned int nsamples,
+			void *dictdata,
+			size_t *dictlenp);
+
+#endif // _EP_COMPRESS_H_
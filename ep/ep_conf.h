@@ -72,6 +72,13 @@
 **		System memory free routine; defaults to "free"
 **	EP_OSCF_USE_PTHREADS
 **		Compile in pthreads support
+**	EP_OSCF_USE_LZ4
+**		Compile in LZ4 compression (needs -llz4)
+**	EP_OSCF_USE_ZSTD
+**		Compile in zstd compression (needs -lzstd)
+**	EP_OSCF_USE_IO_URING
+**		Use io_uring for gdplogd disk I/O; defaults on for Linux
+**		if <linux/io_uring.h> is installed
 **
 **  Configuration is probably better done using autoconf
 **
@@ -82,6 +89,15 @@
 # ifndef EP_OSCF_USE_PTHREADS
 #  define EP_OSCF_USE_PTHREADS		1
 # endif
+# ifndef EP_OSCF_USE_LZ4
+#  define EP_OSCF_USE_LZ4		0
+# endif
+# ifndef EP_OSCF_USE_ZSTD
+#  define EP_OSCF_USE_ZSTD		0
+# endif
+# ifndef EP_OSCF_USE_IO_URING
+#  define EP_OSCF_USE_IO_URING		0
+# endif
 
 // these should be defined on all POSIX platforms
 # define EP_OSCF_HAS_INTTYPES_H		1	// does <inttypes.h> exist?
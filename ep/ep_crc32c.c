@@ -0,0 +1,185 @@
+/* vim: set ai sw=8 sts=8 ts=8 :*/
+
+/***********************************************************************
+**  ----- BEGIN LICENSE BLOCK -----
+**	LIBEP: Enhanced Portability Library (Reduced Edition)
+**
+**	Copyright (c) 2008-2015, Eric P. Allman.  All rights reserved.
+**	Copyright (c) 2015, Regents of the University of California.
+**	All rights reserved.
+**
+**	Permission is hereby granted, without written agreement and without
+**	license or royalty fees, to use, copy, modify, and distribute this
+**	software and its documentation for any purpose, provided that the above
+**	copyright notice and the following two paragraphs appear in all copies
+**	of this software.
+**
+**	IN NO EVENT SHALL REGENTS BE LIABLE TO ANY PARTY FOR DIRECT, INDIRECT,
+**	SPECIAL, INCIDENTAL, OR CONSEQUENTIAL DAMAGES, INCLUDING LOST
+**	PROFITS, ARISING OUT OF THE USE OF THIS SOFTWARE AND ITS DOCUMENTATION,
+**	EVEN IF REGENTS HAS BEEN ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+**
+**	REGENTS SPECIFICALLY DISCLAIMS ANY WARRANTIES, INCLUDING, BUT NOT
+**	LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+**	FOR A PARTICULAR PURPOSE. THE SOFTWARE AND ACCOMPANYING DOCUMENTATION,
+**	IF ANY, PROVIDED HEREUNDER IS PROVIDED "AS IS". REGENTS HAS NO
+**	OBLIGATION TO PROVIDE MAINTENANCE, SUPPORT, UPDATES, ENHANCEMENTS,
+**	OR MODIFICATIONS.
+**  ----- END LICENSE BLOCK -----
+***********************************************************************/
+
+
+/*
+**  EP_CRC32C.C --- CRC-32C (Castagnoli) checksums
+*/
+
+#include <ep/ep_crc32c.h>
+#include <ep/ep_thr.h>
+
+#include <string.h>
+
+#define CRC32C_POLY	0x82f63b78	// reversed Castagnoli polynomial
+
+static uint32_t		Crc32cTable[8][256];
+static bool		Crc32cHw;
+static EP_THR_MUTEX	Crc32cMutex	EP_THR_MUTEX_INITIALIZER;
+static bool		Crc32cInitialized = false;
+
+/*
+**  Build the tables for the software version (slicing by eight)
+**  and see if we can use the hardware instead.
+*/
+
+static void
+crc32c_init(void)
+{
+	int i, j;
+
+	ep_thr_mutex_lock(&Crc32cMutex);
+	if (Crc32cInitialized)
+		goto done;
+
+	for (i = 0; i < 256; i++)
+	{
+		uint32_t crc = i;
+
+		for (j = 0; j < 8; j++)
+			crc = (crc >> 1) ^ (-(int32_t) (crc & 1) & CRC32C_POLY);
+		Crc32cTable[0][i] = crc;
+	}
+	for (i = 0; i < 256; i++)
+	{
+		for (j = 1; j < 8; j++)
+			Crc32cTable[j][i] = (Crc32cTable[j - 1][i] >> 8) ^
+					Crc32cTable[0][Crc32cTable[j - 1][i] & 0xff];
+	}
+
+#if defined(__x86_64__) && defined(__GNUC__)
+	__builtin_cpu_init();
+	Crc32cHw = __builtin_cpu_supports("sse4.2");
+#endif
+	Crc32cInitialized = true;
+done:
+	ep_thr_mutex_unlock(&Crc32cMutex);
+}
+
+
+/*
+**  Software implementation.
+*/
+
+static uint32_t
+crc32c_sw(uint32_t crc, const uint8_t *p, size_t len)
+{
+	// align to a word boundary
+	while (len > 0 && ((uintptr_t) p & 7) != 0)
+	{
+		crc = (crc >> 8) ^ Crc32cTable[0][(crc ^ *p++) & 0xff];
+		len--;
+	}
+
+	// eight bytes at a time
+	while (len >= 8)
+	{
+		uint32_t lo = crc ^ (p[0] | (p[1] << 8) | (p[2] << 16) |
+					((uint32_t) p[3] << 24));
+		uint32_t hi = p[4] | (p[5] << 8) | (p[6] << 16) |
+					((uint32_t) p[7] << 24);
+
+		crc = Crc32cTable[7][lo & 0xff] ^
+			Crc32cTable[6][(lo >> 8) & 0xff] ^
+			Crc32cTable[5][(lo >> 16) & 0xff] ^
+			Crc32cTable[4][lo >> 24] ^
+			Crc32cTable[3][hi & 0xff] ^
+			Crc32cTable[2][(hi >> 8) & 0xff] ^
+			Crc32cTable[1][(hi >> 16) & 0xff] ^
+			Crc32cTable[0][hi >> 24];
+		p += 8;
+		len -= 8;
+	}
+
+	// and the tail
+	while (len-- > 0)
+		crc = (crc >> 8) ^ Crc32cTable[0][(crc ^ *p++) & 0xff];
+	return crc;
+}
+
+
+/*
+**  Hardware implementation (SSE4.2 crc32 instruction).
+*/
+
+#if defined(__x86_64__) && defined(__GNUC__)
+
+__attribute__((target("sse4.2")))
+static uint32_t
+crc32c_hw(uint32_t crc, const uint8_t *p, size_t len)
+{
+	uint64_t crc64;
+
+	while (len > 0 && ((uintptr_t) p & 7) != 0)
+	{
+		crc = __builtin_ia32_crc32qi(crc, *p++);
+		len--;
+	}
+	crc64 = crc;
+	while (len >= 8)
+	{
+		uint64_t v;
+
+		memcpy(&v, p, sizeof v);
+		crc64 = __builtin_ia32_crc32di(crc64, v);
+		p += 8;
+		len -= 8;
+	}
+	crc = (uint32_t) crc64;
+	while (len-- > 0)
+		crc = __builtin_ia32_crc32qi(crc, *p++);
+	return crc;
+}
+
+#endif
+
+
+/*
+**  EP_CRC32C --- compute (or continue computing) a checksum
+**
+**	To checksum discontiguous data, pass the result of one
+**	call as the crc for the next.  Start with zero.
+*/
+
+uint32_t
+ep_crc32c(uint32_t crc, const void *buf, size_t len)
+{
+	if (!Crc32cInitialized)
+		crc32c_init();
+
+	crc = ~crc;
+#if defined(__x86_64__) && defined(__GNUC__)
+	if (Crc32cHw)
+		crc = crc32c_hw(crc, buf, len);
+	else
+#endif
+		crc = crc32c_sw(crc, buf, len);
+	return ~crc;
+}
@@ -0,0 +1,51 @@
+/* vim: set ai sw=8 sts=8 ts=8 :*/
+
+/***********************************************************************
+**  ----- BEGIN LICENSE BLOCK -----
+**	LIBEP: Enhanced Portability Library (Reduced Edition)
+**
+**	Copyright (c) 2008-2015, Eric P. Allman.  All rights reserved.
+**	Copyright (c) 2015, Regents of the University of California.
+**	All rights reserved.
+**
+**	Permission is hereby granted, without written agreement and without
+**	license or royalty fees, to use, copy, modify, and distribute this
+**	software and its documentation for any purpose, provided that the above
+**	copyright notice and the following two paragraphs appear in all copies
+**	of this software.
+**
+**	IN NO EVENT SHALL REGENTS BE LIABLE TO ANY PARTY FOR DIRECT, INDIRECT,
+**	SPECIAL, INCIDENTAL, OR CONSEQUENTIAL DAMAGES, INCLUDING LOST
+**	PROFITS, ARISING OUT OF THE USE OF THIS SOFTWARE AND ITS DOCUMENTATION,
+**	EVEN IF REGENTS HAS BEEN ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+**
+**	REGENTS SPECIFICALLY DISCLAIMS ANY WARRANTIES, INCLUDING, BUT NOT
+**	LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+**	FOR A PARTICULAR PURPOSE. THE SOFTWARE AND ACCOMPANYING DOCUMENTATION,
+**	IF ANY, PROVIDED HEREUNDER IS PROVIDED "AS IS". REGENTS HAS NO
+**	OBLIGATION TO PROVIDE MAINTENANCE, SUPPORT, UPDATES, ENHANCEMENTS,
+**	OR MODIFICATIONS.
+**  ----- END LICENSE BLOCK -----
+***********************************************************************/
+
+
+/*
+**  EP_CRC32C.H --- CRC-32C (Castagnoli) checksums
+**
+**	This is the polynomial used by iSCSI, ext4, and friends.  It is
+**	intended for detecting accidental corruption, not tampering.
+**	Where the processor supports it (SSE4.2 on x86-64) the hardware
+**	instruction is used; otherwise there is a table-driven fallback.
+*/
+
+#ifndef _EP_CRC32C_H_
+#define _EP_CRC32C_H_
+
+#include <ep/ep.h>
+
+// update a running checksum; start with crc = 0
+extern uint32_t	ep_crc32c(uint32_t crc,
+				const void *buf,
+				size_t len);
+
+#endif // _EP_CRC32C_H_
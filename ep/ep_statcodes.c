@@ -61,6 +61,14 @@ static struct ep_stat_to_string	Stats[] =
     { EP_STAT_CRYPTO_KEYCOMPAT,	"incompatible cryptographic keys",	},
     { EP_STAT_CRYPTO_CIPHER,	"symmetric cipher failure",		},
 
+    // compression status codes
+    { _EP_STAT_INTERNAL(OK, EP_STAT_MOD_COMPRESS, 0), "compress"	},
+
+    { EP_STAT_COMPRESS_UNAVAIL,	"compression algorithm not available",	},
+    { EP_STAT_COMPRESS_FAILED,	"compression failure",			},
+    { EP_STAT_DECOMPRESS_FAILED, "decompression failure",		},
+    { EP_STAT_COMPRESS_DICT,	"compression dictionary problem",	},
+
     { EP_STAT_OK,		NULL,					}
 };
 
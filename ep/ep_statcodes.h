@@ -53,3 +53,9 @@
 #define EP_STAT_CRYPTO_KEYCREATE _EP_STAT_INTERNAL(ERROR, EP_STAT_MOD_CRYPTO, 8)
 #define EP_STAT_CRYPTO_KEYCOMPAT _EP_STAT_INTERNAL(ERROR, EP_STAT_MOD_CRYPTO, 9)
 #define EP_STAT_CRYPTO_CIPHER	_EP_STAT_INTERNAL(ERROR, EP_STAT_MOD_CRYPTO, 10)
+
+// compression module
+#define EP_STAT_COMPRESS_UNAVAIL _EP_STAT_INTERNAL(ERROR, EP_STAT_MOD_COMPRESS, 1)
+#define EP_STAT_COMPRESS_FAILED	_EP_STAT_INTERNAL(ERROR, EP_STAT_MOD_COMPRESS, 2)
+#define EP_STAT_DECOMPRESS_FAILED _EP_STAT_INTERNAL(ERROR, EP_STAT_MOD_COMPRESS, 3)
+#define EP_STAT_COMPRESS_DICT	_EP_STAT_INTERNAL(ERROR, EP_STAT_MOD_COMPRESS, 4)
@@ -0,0 +1,70 @@
+/* vim: set ai sw=8 sts=8 ts=8 :*/
+
+/***********************************************************************
+**  ----- BEGIN LICENSE BLOCK -----
+**	LIBEP: Enhanced Portability Library (Reduced Edition)
+**
+**	Copyright (c) 2008-2015, Eric P. Allman.  All rights reserved.
+**	Copyright (c) 2015, Regents of the University of California.
+**	All rights reserved.
+**
+**	Permission is hereby granted, without written agreement and without
+**	license or royalty fees, to use, copy, modify, and distribute this
+**	software and its documentation for any purpose, provided that the above
+**	copyright notice and the following two paragraphs appear in all copies
+**	of this software.
+**
+**	IN NO EVENT SHALL REGENTS BE LIABLE TO ANY PARTY FOR DIRECT, INDIRECT,
+**	SPECIAL, INCIDENTAL, OR CONSEQUENTIAL DAMAGES, INCLUDING LOST
+**	PROFITS, ARISING OUT OF THE USE OF THIS SOFTWARE AND ITS DOCUMENTATION,
+**	EVEN IF REGENTS HAS BEEN ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+**
+**	REGENTS SPECIFICALLY DISCLAIMS ANY WARRANTIES, INCLUDING, BUT NOT
+**	LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+**	FOR A PARTICULAR PURPOSE. THE SOFTWARE AND ACCOMPANYING DOCUMENTATION,
+**	IF ANY, PROVIDED HEREUNDER IS PROVIDED "AS IS". REGENTS HAS NO
+**	OBLIGATION TO PROVIDE MAINTENANCE, SUPPORT, UPDATES, ENHANCEMENTS,
+**	OR MODIFICATIONS.
+**  ----- END LICENSE BLOCK -----
+***********************************************************************/
+
+
+
+/*
+**  EP_VARINT.C --- variable length integer encoding
+*/
+
+#include <ep/ep_varint.h>
+
+size_t
+ep_varint_put(uint64_t v, uint8_t *buf)
+{
+	size_t n = 0;
+
+	while (v >= 0x80)
+	{
+		buf[n++] = (uint8_t) (v | 0x80);
+		v >>= 7;
+	}
+	buf[n++] = (uint8_t) v;
+	return n;
+}
+
+
+size_t
+ep_varint_get(const uint8_t *buf, size_t buflen, uint64_t *vp)
+{
+	uint64_t v = 0;
+	size_t n;
+
+	for (n = 0; n < buflen && n < EP_VARINT_MAXLEN; n++)
+	{
+		v |= (uint64_t) (buf[n] & 0x7f) << (7 * n);
+		if ((buf[n] & 0x80) == 0)
+		{
+			*vp = v;
+			return n + 1;
+		}
+	}
+	return 0;
+}
@@ -0,0 +1,64 @@
+/* vim: set ai sw=8 sts=8 ts=8 :*/
+
+/***********************************************************************
+**  ----- BEGIN LICENSE BLOCK -----
+**	LIBEP: Enhanced Portability Library (Reduced Edition)
+**
+**	Copyright (c) 2008-2015, Eric P. Allman.  All rights reserved.
+**	Copyright (c) 2015, Regents of the University of California.
+**	All rights reserved.
+**
+**	Permission is hereby granted, without written agreement and without
+**	license or royalty fees, to use, copy, modify, and distribute this
+**	software and its documentation for any purpose, provided that the above
+**	copyright notice and the following two paragraphs appear in all copies
+**	of this software.
+**
+**	IN NO EVENT SHALL REGENTS BE LIABLE TO ANY PARTY FOR DIRECT, INDIRECT,
+**	SPECIAL, INCIDENTAL, OR CONSEQUENTIAL DAMAGES, INCLUDING LOST
+**	PROFITS, ARISING OUT OF THE USE OF THIS SOFTWARE AND ITS DOCUMENTATION,
+**	EVEN IF REGENTS HAS BEEN ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+**
+**	REGENTS SPECIFICALLY DISCLAIMS ANY WARRANTIES, INCLUDING, BUT NOT
+**	LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+**	FOR A PARTICULAR PURPOSE. THE SOFTWARE AND ACCOMPANYING DOCUMENTATION,
+**	IF ANY, PROVIDED HEREUNDER IS PROVIDED "AS IS". REGENTS HAS NO
+**	OBLIGATION TO PROVIDE MAINTENANCE, SUPPORT, UPDATES, ENHANCEMENTS,
+**	OR MODIFICATIONS.
+**  ----- END LICENSE BLOCK -----
+***********************************************************************/
+
+
+
+/*
+**  EP_VARINT.H --- variable length integer encoding
+**
+**	Unsigned integers are stored seven bits per byte, least
+**	significant group first, with the high bit set on all but the
+**	last byte (the same encoding as protocol buffers).  Signed
+**	values should be "zigzag" mapped first so that small negative
+**	numbers are also short.
+*/
+
+#ifndef _EP_VARINT_H_
+#define _EP_VARINT_H_
+
+#include <ep/ep.h>
+
+#define EP_VARINT_MAXLEN	10	// longest encoding of a uint64_t
+
+// encode v into buf (which must have EP_VARINT_MAXLEN bytes); return length
+extern size_t	ep_varint_put(uint64_t v,
+				uint8_t *buf);
+
+// decode from buf; return length consumed or zero if malformed or truncated
+extern size_t	ep_varint_get(const uint8_t *buf,
+				size_t buflen,
+				uint64_t *vp);
+
+// map signed to unsigned so that small magnitudes stay small
+#define EP_ZIGZAG_ENC(v)	((((uint64_t) (v)) << 1) ^ \
+				 ((uint64_t) ((int64_t) (v) >> 63)))
+#define EP_ZIGZAG_DEC(u)	((int64_t) ((u) >> 1) ^ -((int64_t) ((u) & 1)))
+
+#endif // _EP_VARINT_H_
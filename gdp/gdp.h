@@ -112,6 +112,7 @@ typedef enum
 #define GDP_GCLMD_PUBKEY	0x00505542	// PUB (public key)
 #define GDP_GCLMD_CTIME		0x0043544D	// CTM (creation time)
 #define GDP_GCLMD_CID		0x00434944	// CID (creator id)
+#define GDP_GCLMD_STORAGE	0x00535447	// STG (storage: disk, mem[:max], seg)
 
 
 /*
@@ -246,6 +247,17 @@ extern EP_STAT	gdp_gcl_multiread(
 											// callback function for next datum
 					void *cbarg);			// argument passed to callback
 
+// read a sample of records (every stride'th, or last per time bucket)
+extern EP_STAT	gdp_gcl_multiread_sampled(
+					gdp_gcl_t *gcl,			// readable GCL handle
+					gdp_recno_t start,		// first record to consider
+					int32_t numrecs,		// number of records to consider
+					int32_t stride,			// return every stride'th record
+					EP_TIME_SPEC *bucket,	// if set, last record per bucket
+					gdp_event_cbfunc_t cbfunc,
+											// callback function for next datum
+					void *cbarg);			// argument passed to callback
+
 // read metadata
 extern EP_STAT	gdp_gcl_getmetadata(
 					gdp_gcl_t *gcl,			// GCL handle
@@ -255,6 +267,12 @@ extern EP_STAT	gdp_gcl_getmetadata(
 extern EP_STAT	gdp_gcl_newextent(
 					gdp_gcl_t *gcl);		// GCL handle
 
+// make a consistent backup copy of a log on its server
+extern EP_STAT	gdp_gcl_snapshot(
+					gdp_gcl_t *gcl,			// GCL handle
+					const char *label,		// name of snapshot (or NULL)
+					gdp_recno_t *recnop);	// out-param for last recno
+
 // set append filter
 extern void		gdp_gcl_set_append_filter(
 					gdp_gcl_t *gcl,			// GCL handle
@@ -267,6 +285,11 @@ extern void		gdp_gcl_set_read_filter(
 					EP_STAT (*readfilter)(gdp_datum_t *, void *),
 					void *filterdata);
 
+// allow reads from replicas up to maxstale milliseconds out of date
+extern void		gdp_gcl_set_maxstale(
+					gdp_gcl_t *gcl,			// GCL handle
+					int32_t maxstale);		// 0 => read from the log only
+
 // return the name of a GCL
 //		XXX: should this be in a more generic "getstat" function?
 extern const gdp_name_t *gdp_gcl_getname(
@@ -493,6 +493,32 @@ gdp_gcl_multiread(gdp_gcl_t *gcl,
 }
 
 
+/*
+**	GDP_GCL_MULTIREAD_SAMPLED --- read a sample of records from a GCL
+**
+**		Considers the records in [start, start + numrecs) (numrecs
+**		of zero means through the end of the log) but only returns
+**		every stride'th one.  If bucket is non-NULL the range is
+**		split into intervals of that length (measured from the
+**		timestamp of the first record) and only the last record in
+**		each interval is returned.  This is intended for plotting
+**		large logs without transferring every record.
+*/
+
+EP_STAT
+gdp_gcl_multiread_sampled(gdp_gcl_t *gcl,
+		gdp_recno_t start,
+		int32_t numrecs,
+		int32_t stride,
+		EP_TIME_SPEC *bucket,
+		gdp_event_cbfunc_t cbfunc,
+		void *cbarg)
+{
+	return _gdp_gcl_multiread_sampled(gcl, start, numrecs, stride, bucket,
+					cbfunc, cbarg, _GdpChannel, 0);
+}
+
+
 /*
 **  GDP_GCL_GETMETADATA --- return the metadata associated with a GCL
 */
@@ -519,6 +545,24 @@ gdp_gcl_newextent(gdp_gcl_t *gcl)
 }
 
 
+/*
+**  GDP_GCL_SNAPSHOT --- make a backup copy of a GCL
+**
+**		The server copies the log as of some instant into a
+**		directory named by label under its snapshot directory.
+**		The last record in the copy is returned in *recnop.
+**		Like gdp_gcl_newextent, this is an administrative call.
+*/
+
+EP_STAT
+gdp_gcl_snapshot(gdp_gcl_t *gcl,
+		const char *label,
+		gdp_recno_t *recnop)
+{
+	return _gdp_gcl_snapshot(gcl, label, recnop, _GdpChannel, 0);
+}
+
+
 /*
 **  GDP_GCL_SET_APPEND_FILTER --- set the append filter function
 */
@@ -549,6 +593,24 @@ gdp_gcl_set_read_filter(gdp_gcl_t *gcl,
 }
 
 
+/*
+**  GDP_GCL_SET_MAXSTALE --- allow reads from replicas
+**
+**		Reads, multireads, and subscriptions started after this
+**		may be served by a replica of the log that is no more
+**		than maxstale milliseconds out of date, which spreads
+**		read load over the replicas.  Zero (the default) means
+**		that reads always go to the log itself.
+*/
+
+void
+gdp_gcl_set_maxstale(gdp_gcl_t *gcl, int32_t maxstale)
+{
+	GDP_ASSERT_GOOD_GCL(gcl);
+	gcl->maxstale = maxstale < 0 ? 0 : maxstale;
+}
+
+
 /*
 **  GDP GCL Open Information handling
 */
@@ -131,6 +131,60 @@ gdp_buf_getptr(gdp_buf_t *buf, size_t sz)
 	return evbuffer_pullup(buf, sz);
 }
 
+/*
+**  Update a message digest from the contents of a buffer.
+**
+**		This walks the chunks of the buffer rather than pulling
+**		them up into contiguous memory, so large records are hashed
+**		in place instead of being copied first.  The buffer itself
+**		is not modified.
+*/
+
+#define BUF_NIOV	16		// chunks handled without allocation
+
+static EP_STAT
+buf_digest_update(gdp_buf_t *buf,
+		EP_CRYPTO_MD *md,
+		EP_STAT (*updfunc)(EP_CRYPTO_MD *, void *, size_t))
+{
+	EP_STAT estat = EP_STAT_OK;
+	struct evbuffer_iovec iovbuf[BUF_NIOV];
+	struct evbuffer_iovec *iov = iovbuf;
+	int niov;
+	int i;
+
+	niov = evbuffer_peek(buf, -1, NULL, NULL, 0);
+	if (niov > BUF_NIOV)
+		iov = ep_mem_malloc(niov * sizeof *iov);
+	niov = evbuffer_peek(buf, -1, NULL, iov, niov);
+	for (i = 0; i < niov; i++)
+	{
+		estat = (*updfunc)(md, iov[i].iov_base, iov[i].iov_len);
+		EP_STAT_CHECK(estat, break);
+	}
+	if (iov != iovbuf)
+		ep_mem_free(iov);
+	return estat;
+}
+
+EP_STAT
+gdp_buf_md_update(gdp_buf_t *buf, EP_CRYPTO_MD *md)
+{
+	return buf_digest_update(buf, md, &ep_crypto_md_update);
+}
+
+EP_STAT
+gdp_buf_sign_update(gdp_buf_t *buf, EP_CRYPTO_MD *md)
+{
+	return buf_digest_update(buf, md, &ep_crypto_sign_update);
+}
+
+EP_STAT
+gdp_buf_vrfy_update(gdp_buf_t *buf, EP_CRYPTO_MD *md)
+{
+	return buf_digest_update(buf, md, &ep_crypto_vrfy_update);
+}
+
 /*
 **  Write data to a buffer.
 **		Returns 0 on success, -1 on failure.
@@ -170,6 +224,17 @@ gdp_buf_copy(gdp_buf_t *ibuf, gdp_buf_t *obuf)
 	return evbuffer_add_buffer(obuf, ibuf);
 }
 
+/*
+**  Move the first sz bytes of one buffer onto the end of another.
+**		Returns the number of bytes moved, -1 on failure.
+*/
+
+int
+gdp_buf_move(gdp_buf_t *ibuf, gdp_buf_t *obuf, size_t sz)
+{
+	return evbuffer_remove_buffer(ibuf, obuf, sz);
+}
+
 /*
 **  Dump buffer to a file (for debugging).
 */
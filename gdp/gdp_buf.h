@@ -35,6 +35,7 @@
 
 #include <event2/event.h>
 #include <event2/buffer.h>
+#include <ep/ep_crypto.h>
 #include <ep/ep_thr.h>
 
 typedef struct evbuffer	gdp_buf_t;
@@ -73,6 +74,18 @@ extern unsigned char
 						gdp_buf_t *buf,
 						size_t sz);
 
+extern EP_STAT		gdp_buf_md_update(
+						gdp_buf_t *buf,
+						EP_CRYPTO_MD *md);
+
+extern EP_STAT		gdp_buf_sign_update(
+						gdp_buf_t *buf,
+						EP_CRYPTO_MD *md);
+
+extern EP_STAT		gdp_buf_vrfy_update(
+						gdp_buf_t *buf,
+						EP_CRYPTO_MD *md);
+
 extern int			gdp_buf_write(
 						gdp_buf_t *buf,
 						const void *in,
@@ -82,6 +95,11 @@ extern int			gdp_buf_copy(
 						gdp_buf_t *ibuf,
 						gdp_buf_t *obuf);
 
+extern int			gdp_buf_move(
+						gdp_buf_t *ibuf,
+						gdp_buf_t *obuf,
+						size_t sz);
+
 extern int			gdp_buf_printf(
 						gdp_buf_t *buf,
 						const char *fmt, ...);
@@ -71,6 +71,13 @@ gdp_read_cb(struct bufferevent *bev, void *ctx)
 	{
 		pdu = _gdp_pdu_new();
 		estat = _gdp_pdu_in(pdu, chan);
+		if (EP_STAT_IS_SAME(estat, GDP_STAT_PDU_ALIAS_UNKNOWN) ||
+				EP_STAT_IS_SAME(estat, GDP_STAT_PDU_DISCARDED))
+		{
+			// already skipped over; try the next one
+			_gdp_pdu_free(pdu);
+			continue;
+		}
 		if (!EP_STAT_ISOK(estat))
 		{
 			// bad PDU (too short, version mismatch, whatever)
@@ -83,6 +90,22 @@ gdp_read_cb(struct bufferevent *bev, void *ctx)
 				GDP_CMD_IS_COMMAND(pdu->cmd) ? "command" : "ack/nak",
 				pdu->cmd, _gdp_proto_cmd_name(pdu->cmd),
 				bufferevent_getfd(bev));
+		if (_gdp_chan_hello_in(pdu, chan))
+		{
+			// negotiation with the other end of the channel
+			_gdp_pdu_free(pdu);
+			continue;
+		}
+		if (EP_UT_BITSET(GDP_PDU_IS_BATCH, pdu->flags))
+		{
+			// several records in one PDU: process them one at a time
+			gdp_pdu_t *rpdu;
+
+			while ((rpdu = _gdp_pdu_unbatch(pdu)) != NULL)
+				(*chan->process)(rpdu, chan);
+			_gdp_pdu_free(pdu);
+			continue;
+		}
 		(*chan->process)(pdu, chan);
 	}
 }
@@ -394,6 +417,10 @@ fail0:
 	else
 	{
 		ep_dbg_cprintf(Dbg, 1, "Talking to router at %s:%s\n", host, port);
+
+		// new connection: previous header aliases are meaningless
+		_gdp_chan_alias_init(chan);
+		_gdp_chan_hello(chan);
 	}
 
 	{
@@ -428,6 +455,7 @@ _gdp_chan_close(gdp_chan_t **pchan)
 		(*chan->close_cb)(chan);
 	bufferevent_free(chan->bev);
 	chan->bev = NULL;
+	_gdp_chan_alias_free(chan);
 	ep_thr_cond_destroy(&chan->cond);
 	ep_thr_mutex_destroy(&chan->mutex);
 	ep_mem_free(chan);
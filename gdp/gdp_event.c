@@ -273,6 +273,34 @@ _gdp_event_setcb(
 }
 
 
+/*
+**  Create an event for a request and queue it for delivery.
+*/
+
+static EP_STAT
+event_from_req(gdp_req_t *req, int evtype, EP_STAT stat)
+{
+	EP_STAT estat;
+	gdp_event_t *gev;
+
+	estat = _gdp_event_new(&gev);
+	EP_STAT_CHECK(estat, return estat);
+
+	gev->type = evtype;
+	gev->gcl = req->gcl;
+	gev->stat = stat;
+	gev->udata = req->udata;
+	gev->cb = req->sub_cb;
+	gev->datum = req->pdu->datum;
+	req->pdu->datum = NULL;
+
+	// schedule the event for delivery
+	_gdp_event_trigger(gev);
+
+	return estat;
+}
+
+
 /*
 **  Create an event and link it into the queue based on a acknak req.
 */
@@ -336,22 +364,23 @@ _gdp_event_add_from_req(gdp_req_t *req)
 		return estat;
 	}
 
-	gdp_event_t *gev;
-	estat = _gdp_event_new(&gev);
-	EP_STAT_CHECK(estat, return estat);
+	return event_from_req(req, evtype, req->stat);
+}
 
-	gev->type = evtype;
-	gev->gcl = req->gcl;
-	gev->stat = req->stat;
-	gev->udata = req->udata;
-	gev->cb = req->sub_cb;
-	gev->datum = req->pdu->datum;
-	req->pdu->datum = NULL;
 
-	// schedule the event for delivery
-	_gdp_event_trigger(gev);
+/*
+**  Create a failure event for a request that never got a response
+**
+**		Used when something fails locally (e.g., a send), so that
+**		the application sees that status rather than one mapped
+**		from a NAK code.
+*/
 
-	return estat;
+EP_STAT
+_gdp_event_add_failure(gdp_req_t *req, EP_STAT stat)
+{
+	req->stat = stat;
+	return event_from_req(req, GDP_EVENT_FAILURE, stat);
 }
 
 
@@ -59,4 +59,9 @@ extern void				_gdp_event_setcb(
 extern EP_STAT			_gdp_event_add_from_req(
 								gdp_req_t *req);
 
+// create failure event with a local status
+extern EP_STAT			_gdp_event_add_failure(
+								gdp_req_t *req,
+								EP_STAT stat);
+
 #endif // _GDP_EVENT_H_
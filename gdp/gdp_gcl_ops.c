@@ -77,6 +77,7 @@ _gdp_gcl_newhandle(gdp_name_t gcl_name, gdp_gcl_t **pgcl)
 		goto fail1;
 
 	ep_thr_mutex_init(&gcl->mutex, EP_THR_MUTEX_DEFAULT);
+	ep_thr_cond_init(&gcl->apndcond);
 	LIST_INIT(&gcl->reqs);
 	gcl->refcnt = 1;
 
@@ -134,8 +135,11 @@ _gdp_gcl_freehandle(gdp_gcl_t *gcl)
 	if (gcl->digest != NULL)
 		ep_crypto_md_free(gcl->digest);
 	gcl->digest = NULL;
+	_gdp_replset_free(gcl->replset);
+	gcl->replset = NULL;
 
 	// release the locks and cache entry
+	ep_thr_cond_destroy(&gcl->apndcond);
 	ep_thr_mutex_destroy(&gcl->mutex);
 
 	// if there is any "extra" data, drop that
@@ -277,6 +281,50 @@ fail0:
 }
 
 
+/*
+**  GCL_HELLO --- tell the server for a log what we can handle
+**
+**		The answer says what it can handle.  Servers that don't
+**		understand HELLO will NAK it, in which case we just send
+**		plain PDUs.
+*/
+
+static void
+gcl_hello(gdp_gcl_t *gcl, gdp_chan_t *chan, uint32_t reqflags)
+{
+	EP_STAT estat;
+	gdp_req_t *req;
+
+	estat = _gdp_req_new(GDP_CMD_HELLO, gcl, chan, NULL, reqflags, &req);
+	EP_STAT_CHECK(estat, goto fail0);
+	_gdp_hello_put(req->pdu->datum->dbuf);
+
+	estat = _gdp_invoke(req);
+	if (EP_STAT_ISOK(estat))
+	{
+		_gdp_hello_get(gcl->name, req->pdu->datum->dbuf);
+	}
+	else if (EP_STAT_IS_SAME(estat, GDP_STAT_NAK_NOTIMPL))
+	{
+		// server predates HELLO: remember that it supports nothing
+		gdp_buf_t *nbuf = gdp_buf_new();
+
+		_gdp_hello_get(gcl->name, nbuf);
+		gdp_buf_free(nbuf);
+	}
+	_gdp_req_free(&req);
+
+fail0:
+	if (ep_dbg_test(Dbg, 10))
+	{
+		char ebuf[100];
+
+		ep_dbg_printf("gcl_hello(%s) => %s\n", gcl->pname,
+				ep_stat_tostr(estat, ebuf, sizeof ebuf));
+	}
+}
+
+
 /*
 **	_GDP_GCL_OPEN --- open a GCL for reading or further appending
 */
@@ -370,14 +418,15 @@ _gdp_gcl_open(gdp_gcl_t *gcl,
 	// re-serialize the metadata and include it
 	struct evbuffer *evb = evbuffer_new();
 	_gdp_gclmd_serialize(gcl->gclmd, evb);
-	size_t evblen = evbuffer_get_length(evb);
-	ep_crypto_sign_update(gcl->digest, evbuffer_pullup(evb, evblen), evblen);
-	//evbuffer_drain(evb, evblen);
+	gdp_buf_sign_update(evb, gcl->digest);
 	evbuffer_free(evb);
 
 	// the GCL hash structure now has the fixed part of the hash
 
 finis:
+	// negotiate compression and batching (if we want them)
+	if (_gdp_hello_wanted() && !_gdp_peer_known(gcl->name))
+		gcl_hello(gcl, chan, reqflags);
 	estat = EP_STAT_OK;
 
 	if (false)
@@ -472,6 +521,36 @@ fail0:
 }
 
 
+/*
+**  Append send ordering
+**
+**		Signing is done before a PDU is handed to the channel, and
+**		for asynchronous appends it is done in the thread pool so
+**		that several records can be signed at once.  Each append
+**		takes a ticket when its record number is assigned, and must
+**		wait for its turn before it actually goes out on the wire,
+**		so the log server still sees records in order.
+*/
+
+static void
+append_wait_turn(gdp_gcl_t *gcl, uint32_t tkt)
+{
+	ep_thr_mutex_lock(&gcl->mutex);
+	while (gcl->apndturn != tkt)
+		ep_thr_cond_wait(&gcl->apndcond, &gcl->mutex, NULL);
+	ep_thr_mutex_unlock(&gcl->mutex);
+}
+
+static void
+append_end_turn(gdp_gcl_t *gcl)
+{
+	ep_thr_mutex_lock(&gcl->mutex);
+	gcl->apndturn++;
+	ep_thr_cond_broadcast(&gcl->apndcond);
+	ep_thr_mutex_unlock(&gcl->mutex);
+}
+
+
 /*
 **  APPEND_COMMON --- common code for sync and async appends
 */
@@ -510,6 +589,12 @@ append_common(gdp_gcl_t *gcl,
 	// if doing append filtering (e.g., encryption), call it now.
 	if (gcl->apndfilter != NULL)
 		estat = gcl->apndfilter(datum, gcl->apndfpriv);
+	EP_STAT_CHECK(estat, goto fail0);
+
+	// get our place in line for sending
+	ep_thr_mutex_lock(&gcl->mutex);
+	req->apndtkt = gcl->apndtkt++;
+	ep_thr_mutex_unlock(&gcl->mutex);
 
 fail0:
 	return estat;
@@ -534,14 +619,26 @@ _gdp_gcl_append(gdp_gcl_t *gcl,
 	estat = append_common(gcl, datum, chan, reqflags, &req);
 	EP_STAT_CHECK(estat, goto fail0);
 
+	// sign before we have to wait for our turn on the channel
+	if (req->md != NULL)
+	{
+		_gdp_datum_sign(datum, req->md);
+		req->md = NULL;
+	}
+
 	// send the request to the log server
+	append_wait_turn(gcl, req->apndtkt);
 	estat = _gdp_invoke(req);
 	if (EP_STAT_ISOK(estat))
 		gcl->nrecs++;
+	append_end_turn(gcl);
 
-	req->pdu->datum = NULL;			// owned by caller
-	_gdp_req_free(&req);
 fail0:
+	if (req != NULL)
+	{
+		req->pdu->datum = NULL;			// owned by caller
+		_gdp_req_free(&req);
+	}
 	return estat;
 }
 
@@ -554,6 +651,62 @@ fail0:
 # define SIZE_MAX ((size_t) -1)
 #endif
 
+/*
+**  Finish sending an asynchronous append.
+**
+**		Called with the request locked.  If the send fails the
+**		application is told through the usual event mechanism,
+**		since by this time the append call has already returned.
+*/
+
+static EP_STAT
+append_async_send(gdp_req_t *req, bool inpool)
+{
+	EP_STAT estat;
+	gdp_gcl_t *gcl = req->gcl;
+
+	append_wait_turn(gcl, req->apndtkt);
+	estat = _gdp_req_send(req);
+	append_end_turn(gcl);
+
+	if (inpool)
+	{
+		// the datum is our own copy (the caller already has theirs back)
+		if (!EP_STAT_ISOK(estat))
+			_gdp_event_add_failure(req, estat);
+		if (req->pdu->datum != NULL)
+			gdp_datum_free(req->pdu->datum);
+	}
+	req->pdu->datum = NULL;			// owned by caller
+
+	if (!EP_STAT_ISOK(estat))
+	{
+		_gdp_req_free(&req);
+	}
+	else
+	{
+		req->state = GDP_REQ_IDLE;
+		ep_thr_cond_signal(&req->cond);
+		_gdp_req_unlock(req);
+	}
+	return estat;
+}
+
+/*
+**  Sign an asynchronous append (runs in the thread pool).
+*/
+
+static void
+append_async_sign(void *req_)
+{
+	gdp_req_t *req = req_;
+
+	(void) _gdp_req_lock(req);
+	_gdp_datum_sign(req->pdu->datum, req->md);
+	req->md = NULL;
+	(void) append_async_send(req, true);
+}
+
 EP_STAT
 _gdp_gcl_append_async(
 			gdp_gcl_t *gcl,
@@ -574,7 +727,30 @@ _gdp_gcl_append_async(
 	// arrange for responses to appear as events or callbacks
 	_gdp_event_setcb(req, cbfunc, cbarg);
 
-	estat = _gdp_req_send(req);
+	if (req->md != NULL &&
+			ep_adm_getboolparam("swarm.gdp.crypto.sign.async", true))
+	{
+		// sign a private copy in the thread pool; we return right away
+		gdp_datum_t *d = gdp_datum_new();
+
+		d->recno = datum->recno;
+		d->ts = datum->ts;
+		gdp_buf_copy(datum->dbuf, d->dbuf);		// moves the data
+		req->pdu->datum = d;
+		_gdp_req_unlock(req);
+		ep_thr_pool_run(&append_async_sign, req);
+		req = NULL;
+	}
+	else
+	{
+		if (req->md != NULL)
+		{
+			_gdp_datum_sign(datum, req->md);
+			req->md = NULL;
+		}
+		estat = append_async_send(req, false);
+		req = NULL;
+	}
 
 	// Note that this is just a guess: the write may still fail.
 	// If it does, we'll be out of sync and all hell breaks loose.
@@ -582,23 +758,17 @@ _gdp_gcl_append_async(
 		gcl->nrecs++;
 
 	// synchronous calls clear the data in the datum, so be consistent
-	i = gdp_buf_drain(req->pdu->datum->dbuf, SIZE_MAX);
+	i = gdp_buf_drain(datum->dbuf, SIZE_MAX);
 	if (i < 0 && ep_dbg_test(Dbg, 1))
 		ep_dbg_printf("_gdp_gcl_append_async: gdp_buf_drain failure\n");
 
-	// cleanup and return
-	req->pdu->datum = NULL;			// owned by caller
-	if (!EP_STAT_ISOK(estat))
+fail0:
+	if (req != NULL)
 	{
+		// failed before being handed off
+		req->pdu->datum = NULL;			// owned by caller
 		_gdp_req_free(&req);
 	}
-	else
-	{
-		req->state = GDP_REQ_IDLE;
-		ep_thr_cond_signal(&req->cond);
-		_gdp_req_unlock(req);
-	}
-fail0:
 	if (ep_dbg_test(Dbg, 10))
 	{
 		char ebuf[100];
@@ -629,6 +799,8 @@ _gdp_gcl_read(gdp_gcl_t *gcl,
 {
 	EP_STAT estat = GDP_STAT_BAD_IOMODE;
 	gdp_req_t *req;
+	gdp_recno_t recno;
+	gdp_name_t replica;
 
 	errno = 0;				// avoid spurious messages
 
@@ -636,20 +808,38 @@ _gdp_gcl_read(gdp_gcl_t *gcl,
 	EP_ASSERT_POINTER_VALID(datum);
 	if (!EP_UT_BITSET(GDP_MODE_RO, gcl->iomode))
 		goto fail0;
-	estat = _gdp_req_new(GDP_CMD_READ, gcl, chan, NULL, reqflags, &req);
-	EP_STAT_CHECK(estat, goto fail0);
+	recno = datum->recno;
 
-	EP_TIME_INVALIDATE(&datum->ts);
+	// try replicas (if allowed) until one works, then the log itself
+	for (;;)
+	{
+		bool toreplica;
 
-	gdp_datum_free(req->pdu->datum);
-	req->pdu->datum = datum;
-	EP_ASSERT(datum->inuse);
+		estat = _gdp_req_new(GDP_CMD_READ, gcl, chan, NULL, reqflags, &req);
+		EP_STAT_CHECK(estat, goto fail0);
 
-	estat = _gdp_invoke(req);
+		EP_TIME_INVALIDATE(&datum->ts);
 
-	// ok, done!
-	req->pdu->datum = NULL;			// owned by caller
-	_gdp_req_free(&req);
+		gdp_datum_free(req->pdu->datum);
+		req->pdu->datum = datum;
+		EP_ASSERT(datum->inuse);
+
+		toreplica = _gdp_req_replica_redirect(req, NULL);
+		if (toreplica)
+			memcpy(replica, req->pdu->dst, sizeof replica);
+
+		estat = _gdp_invoke(req);
+
+		// ok, done!
+		req->pdu->datum = NULL;			// owned by caller
+		_gdp_req_free(&req);
+		if (!toreplica || !_gdp_replica_failed(gcl, replica, estat))
+			break;
+
+		// start over with the original request
+		datum->recno = recno;
+		gdp_buf_reset(datum->dbuf);
+	}
 fail0:
 	return estat;
 }
@@ -712,10 +902,144 @@ fail0:
 }
 
 
+/*
+**  _GDP_GCL_SNAPSHOT --- ask the server to back up a log
+**
+**		The label (if any) goes in the payload; the reply has the
+**		last record number included in the snapshot.
+*/
+
+EP_STAT
+_gdp_gcl_snapshot(gdp_gcl_t *gcl,
+		const char *label,
+		gdp_recno_t *recnop,
+		gdp_chan_t *chan,
+		uint32_t reqflags)
+{
+	EP_STAT estat;
+	gdp_req_t *req;
+
+	GDP_ASSERT_GOOD_GCL(gcl);
+	estat = _gdp_req_new(GDP_CMD_SNAPSHOT, gcl, chan, NULL, reqflags, &req);
+	EP_STAT_CHECK(estat, goto fail0);
+
+	if (label != NULL)
+		gdp_buf_write(req->pdu->datum->dbuf, label, strlen(label));
+
+	estat = _gdp_invoke(req);
+	EP_STAT_CHECK(estat, goto fail1);
+
+	if (recnop != NULL &&
+			gdp_buf_getlength(req->pdu->datum->dbuf) >= sizeof (uint64_t))
+		*recnop = gdp_buf_get_uint64(req->pdu->datum->dbuf);
+
+fail1:
+	_gdp_req_free(&req);
+
+fail0:
+	return estat;
+}
+
+
 /***********************************************************************
 **  Client side implementations for commands used internally only.
 ***********************************************************************/
 
+/*
+**  _GDP_GCL_REPL_FETCH --- get records from a leader for replication
+**
+**		Like FWD_APPEND, this is sent directly to a gdplogd
+**		instance, with the log names in the payload.  One request
+**		can ask about any number of logs, so a follower needs only
+**		one outstanding request per leader however many logs it
+**		copies.  The caller puts nlogs entries in ibuf, each of
+**
+**			log name[32], first record wanted[8], maxrecs[4],
+**			stalems[4], chain digest algorithm[4], then (unless
+**			the algorithm is zero) the chain link of record
+**			first - 1
+**
+**		If first is zero the log metadata is returned instead of
+**		records.  The leader compares the chain link with its own
+**		and answers GDP_STAT_NAK_CONFLICT for that log if they
+**		differ, i.e., if the follower's copy has diverged.  Stalems says how stale the follower's copy is
+**		(in milliseconds, or UINT32_MAX if it has never been
+**		current); load is how busy the follower is serving reads.
+**		The leader tells clients about both.  If none of the logs
+**		has anything new the leader holds the request for up to
+**		waitms milliseconds.
+**
+**		The reply (moved to obuf) starts with the number of entries,
+**		one per log asked about and in the same order, each of
+**
+**			log name[32], status[4], leader's last recno[8],
+**			length[4], then that many bytes of records (in the
+**			form used by _gdp_pdu_batch_add) or metadata
+**
+**		The reply appears to come from the first log named, so
+**		the handle passed in must have that log's name.
+*/
+
+EP_STAT
+_gdp_gcl_repl_fetch(
+		gdp_gcl_t *gcl,
+		gdp_name_t leader,
+		uint32_t waitms,
+		uint32_t load,
+		uint32_t nlogs,
+		gdp_buf_t *ibuf,
+		gdp_buf_t *obuf,
+		gdp_chan_t *chan,
+		uint32_t reqflags)
+{
+	EP_STAT estat;
+	gdp_req_t *req;
+
+	GDP_ASSERT_GOOD_GCL(gcl);
+	if (memcmp(leader, _GdpMyRoutingName, sizeof _GdpMyRoutingName) == 0)
+	{
+		// replicating from ourselves: bad idea
+		return GDP_STAT_NAK_BADREQ;
+	}
+
+	reqflags |= GDP_REQ_ALLOC_RID;
+	estat = _gdp_req_new(GDP_CMD_REPL_FETCH, gcl, chan, NULL, reqflags, &req);
+	EP_STAT_CHECK(estat, goto fail0);
+
+	// parameters and log entries go in the payload
+	gdp_buf_put_uint32(req->pdu->datum->dbuf, waitms);
+	gdp_buf_put_uint32(req->pdu->datum->dbuf, load);
+	gdp_buf_put_uint32(req->pdu->datum->dbuf, nlogs);
+	gdp_buf_copy(ibuf, req->pdu->datum->dbuf);
+
+	// send to the leader, not the log
+	memcpy(req->pdu->dst, leader, sizeof req->pdu->dst);
+
+	estat = _gdp_invoke(req);
+	EP_STAT_CHECK(estat, goto fail1);
+
+	if (gdp_buf_getlength(req->pdu->datum->dbuf) < sizeof (uint32_t))
+	{
+		estat = GDP_STAT_PDU_CORRUPT;
+		goto fail1;
+	}
+	gdp_buf_copy(req->pdu->datum->dbuf, obuf);
+
+fail1:
+	_gdp_req_free(&req);
+
+fail0:
+	if (ep_dbg_test(Dbg, EP_STAT_ISOK(estat) ? 39 : 10))
+	{
+		char ebuf[100];
+
+		ep_dbg_printf("_gdp_gcl_repl_fetch(%s, %" PRIu32 " logs) => %s\n",
+				gcl->pname, nlogs, ep_stat_tostr(estat, ebuf, sizeof ebuf));
+	}
+	return estat;
+}
+
+
 /*
 **  _GDP_GCL_FWD_APPEND --- forward APPEND command
 **
@@ -0,0 +1,169 @@
+/* vim: set ai sw=4 sts=4 ts=4 :*/
+
+/*
+**  GDP_HASHCHAIN.C --- record chain hashes and Merkle summaries
+**
+**		See gdp_hashchain.h for the definitions.
+**
+**	----- BEGIN LICENSE BLOCK -----
+**	GDP: Global Data Plane Support Library
+**	From the Ubiquitous Swarm Lab, 490 Cory Hall, U.C. Berkeley.
+**
+**	Copyright (c) 2015, Regents of the University of California.
+**	All rights reserved.
+**
+**	Permission is hereby granted, without written agreement and without
+**	license or royalty fees, to use, copy, modify, and distribute this
+**	software and its documentation for any purpose, provided that the above
+**	copyright notice and the following two paragraphs appear in all copies
+**	of this software.
+**
+**	IN NO EVENT SHALL REGENTS BE LIABLE TO ANY PARTY FOR DIRECT, INDIRECT,
+**	SPECIAL, INCIDENTAL, OR CONSEQUENTIAL DAMAGES, INCLUDING LOST
+**	PROFITS, ARISING OUT OF THE USE OF THIS SOFTWARE AND ITS DOCUMENTATION,
+**	EVEN IF REGENTS HAS BEEN ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+**
+**	REGENTS SPECIFICALLY DISCLAIMS ANY WARRANTIES, INCLUDING, BUT NOT
+**	LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+**	FOR A PARTICULAR PURPOSE. THE SOFTWARE AND ACCOMPANYING DOCUMENTATION,
+**	IF ANY, PROVIDED HEREUNDER IS PROVIDED "AS IS". REGENTS HAS NO
+**	OBLIGATION TO PROVIDE MAINTENANCE, SUPPORT, UPDATES, ENHANCEMENTS,
+**	OR MODIFICATIONS.
+**	----- END LICENSE BLOCK -----
+*/
+
+#include "gdp.h"
+#include "gdp_hashchain.h"
+
+#include <string.h>
+
+/*
+**  Hash up to three pieces of data.  Returns the hash length.
+*/
+
+static size_t
+hash3(int mdalg,
+		const void *a, size_t alen,
+		const void *b, size_t blen,
+		const void *c, size_t clen,
+		uint8_t *hash)
+{
+	EP_CRYPTO_MD *md = ep_crypto_md_new(mdalg);
+	size_t hlen = EP_CRYPTO_MD_MAXSIZE;
+
+	if (md == NULL)
+		return 0;
+	if (alen > 0)
+		ep_crypto_md_update(md, (void *) a, alen);
+	if (blen > 0)
+		ep_crypto_md_update(md, (void *) b, blen);
+	if (clen > 0)
+		ep_crypto_md_update(md, (void *) c, clen);
+	if (!EP_STAT_ISOK(ep_crypto_md_final(md, hash, &hlen)))
+		hlen = 0;
+	ep_crypto_md_free(md);
+	return hlen;
+}
+
+
+size_t
+_gdp_hash_data(int mdalg, const void *data, size_t dlen, uint8_t *hash)
+{
+	return hash3(mdalg, data, dlen, NULL, 0, NULL, 0, hash);
+}
+
+
+size_t
+_gdp_hash_anchor(int mdalg, const gdp_name_t gname, uint8_t *hash)
+{
+	return hash3(mdalg, gname, sizeof (gdp_name_t), NULL, 0, NULL, 0, hash);
+}
+
+
+size_t
+_gdp_hash_link(int mdalg,
+		const uint8_t *chash,
+		gdp_recno_t recno,
+		const uint8_t *dhash,
+		uint8_t *hash)
+{
+	size_t hlen = ep_crypto_md_len(mdalg);
+	uint8_t recnobuf[8];
+	int i;
+
+	for (i = 7; i >= 0; i--)
+	{
+		recnobuf[i] = recno & 0xff;
+		recno >>= 8;
+	}
+	return hash3(mdalg, chash, hlen, recnobuf, sizeof recnobuf,
+				dhash, hlen, hash);
+}
+
+
+/*
+**  Merkle summaries
+*/
+
+static const uint8_t	LeafPrefix = 0x00;
+static const uint8_t	NodePrefix = 0x01;
+
+void
+_gdp_merkle_init(gdp_merkle_t *m, int mdalg)
+{
+	memset(m, 0, sizeof *m);
+	m->mdalg = mdalg;
+	m->hashlen = ep_crypto_md_len(mdalg);
+}
+
+
+void
+_gdp_merkle_add(gdp_merkle_t *m, const uint8_t *link)
+{
+	uint8_t h[EP_CRYPTO_MD_MAXSIZE];
+	uint64_t n = m->nleaves;
+	int level = 0;
+
+	hash3(m->mdalg, &LeafPrefix, 1, link, m->hashlen, NULL, 0, h);
+
+	// merge with complete subtrees of the same size
+	while ((n & 1) != 0)
+	{
+		hash3(m->mdalg, &NodePrefix, 1, m->frontier[level], m->hashlen,
+				h, m->hashlen, h);
+		n >>= 1;
+		level++;
+	}
+	memcpy(m->frontier[level], h, m->hashlen);
+	m->nleaves++;
+}
+
+
+size_t
+_gdp_merkle_root(const gdp_merkle_t *m, uint8_t *root)
+{
+	uint8_t h[EP_CRYPTO_MD_MAXSIZE];
+	bool have = false;
+	int level;
+
+	if (m->nleaves == 0)
+	{
+		// by convention the root of an empty tree is H()
+		return hash3(m->mdalg, NULL, 0, NULL, 0, NULL, 0, root);
+	}
+
+	// fold the subtree roots together, smallest first
+	for (level = 0; level < GDP_MERKLE_MAXDEPTH; level++)
+	{
+		if ((m->nleaves & (UINT64_C(1) << level)) == 0)
+			continue;
+		if (!have)
+			memcpy(h, m->frontier[level], m->hashlen);
+		else
+			hash3(m->mdalg, &NodePrefix, 1, m->frontier[level], m->hashlen,
+					h, m->hashlen, h);
+		have = true;
+	}
+	memcpy(root, h, m->hashlen);
+	return m->hashlen;
+}
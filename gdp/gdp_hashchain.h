@@ -0,0 +1,110 @@
+/* vim: set ai sw=4 sts=4 ts=4 :*/
+
+/*
+**  GDP_HASHCHAIN.H --- record chain hashes and Merkle summaries
+**
+**		THESE DEFINITIONS ARE PRIVATE!
+**
+**		Each stored record can carry two hashes:
+**			dhash = H(data)
+**			chash = link(previous record)
+**		where
+**			link(r) = H(chash(r) || recno(r) || dhash(r))
+**		and recno is in network byte order.  The first record of a
+**		log uses the anchor H(log name) as its chash; gdplogd never
+**		starts a chain partway through a log, so the link of record
+**		N covers records 1 through N and replicas compare their
+**		state with the leader's by comparing one link.  Checking that each record's chash
+**		matches the link of its predecessor shows that nothing in a
+**		range has been altered, inserted, or dropped since it was
+**		stored.  The hashes are computed by the server after the
+**		writer has signed the record, and the signature covers
+**		only the record number and data, so the chain says nothing
+**		about who wrote the records: it detects storage damage and
+**		lets two copies be compared cheaply, but each record's
+**		signature must still be checked to authenticate it.
+**
+**		Merkle summaries are built over link values using the
+**		RFC 6962 construction (leaf = H(0x00 || link), interior
+**		node = H(0x01 || left || right)).  They are maintained
+**		incrementally by keeping only the roots of the complete
+**		subtrees seen so far (at most one per level).  Two copies
+**		of a log agree on a set of records if and only if their
+**		roots agree.
+**
+**	----- BEGIN LICENSE BLOCK -----
+**	GDP: Global Data Plane Support Library
+**	From the Ubiquitous Swarm Lab, 490 Cory Hall, U.C. Berkeley.
+**
+**	Copyright (c) 2015, Regents of the University of California.
+**	All rights reserved.
+**
+**	Permission is hereby granted, without written agreement and without
+**	license or royalty fees, to use, copy, modify, and distribute this
+**	software and its documentation for any purpose, provided that the above
+**	copyright notice and the following two paragraphs appear in all copies
+**	of this software.
+**
+**	IN NO EVENT SHALL REGENTS BE LIABLE TO ANY PARTY FOR DIRECT, INDIRECT,
+**	SPECIAL, INCIDENTAL, OR CONSEQUENTIAL DAMAGES, INCLUDING LOST
+**	PROFITS, ARISING OUT OF THE USE OF THIS SOFTWARE AND ITS DOCUMENTATION,
+**	EVEN IF REGENTS HAS BEEN ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+**
+**	REGENTS SPECIFICALLY DISCLAIMS ANY WARRANTIES, INCLUDING, BUT NOT
+**	LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+**	FOR A PARTICULAR PURPOSE. THE SOFTWARE AND ACCOMPANYING DOCUMENTATION,
+**	IF ANY, PROVIDED HEREUNDER IS PROVIDED "AS IS". REGENTS HAS NO
+**	OBLIGATION TO PROVIDE MAINTENANCE, SUPPORT, UPDATES, ENHANCEMENTS,
+**	OR MODIFICATIONS.
+**	----- END LICENSE BLOCK -----
+*/
+
+#ifndef _GDP_HASHCHAIN_H_
+#define _GDP_HASHCHAIN_H_
+
+#include "gdp.h"
+
+#include <ep/ep_crypto.h>
+
+#define GDP_MERKLE_MAXDEPTH		64		// enough for 2^64 leaves
+
+typedef struct gdp_merkle
+{
+	int				mdalg;				// hash algorithm
+	size_t			hashlen;			// length of hashes
+	uint64_t		nleaves;			// number of leaves added
+	uint8_t			frontier[GDP_MERKLE_MAXDEPTH][EP_CRYPTO_MD_MAXSIZE];
+										// subtree roots (one per 1 bit)
+} gdp_merkle_t;
+
+extern size_t	_gdp_hash_data(			// compute dhash
+					int mdalg,
+					const void *data,
+					size_t dlen,
+					uint8_t *hash);
+
+extern size_t	_gdp_hash_anchor(		// compute chain anchor
+					int mdalg,
+					const gdp_name_t gname,
+					uint8_t *hash);
+
+extern size_t	_gdp_hash_link(			// compute link for a record
+					int mdalg,
+					const uint8_t *chash,
+					gdp_recno_t recno,
+					const uint8_t *dhash,
+					uint8_t *hash);
+
+extern void		_gdp_merkle_init(		// initialize empty summary
+					gdp_merkle_t *m,
+					int mdalg);
+
+extern void		_gdp_merkle_add(		// add a link as a leaf
+					gdp_merkle_t *m,
+					const uint8_t *link);
+
+extern size_t	_gdp_merkle_root(		// compute current root
+					const gdp_merkle_t *m,
+					uint8_t *root);
+
+#endif // _GDP_HASHCHAIN_H_
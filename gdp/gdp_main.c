@@ -180,8 +180,9 @@ gdp_pdu_proc_cmd(void *pdu_)
 		memcpy(req->pdu->dst, temp, sizeof req->pdu->dst);
 	}
 
-	// send response PDU if appropriate
-	if (GDP_CMD_NEEDS_ACK(cmd))
+	// send response PDU if appropriate (unless the command will do it later)
+	if (GDP_CMD_NEEDS_ACK(cmd) &&
+		!EP_UT_BITSET(GDP_REQ_DEFER_REPLY, req->flags))
 	{
 		ep_dbg_cprintf(Dbg, 41,
 				"gdp_pdu_proc_cmd: sending %zd bytes\n",
@@ -623,6 +624,9 @@ gdp_lib_init(const char *myname)
 	estat = _gdp_gcl_cache_init();
 	EP_STAT_CHECK(estat, goto fail0);
 
+	// wire compression and batching parameters
+	_gdp_pdu_init();
+
 	// tell the event library that we're using pthreads
 	if (evthread_use_pthreads() < 0)
 		return init_error("cannot use pthreads", "gdp_lib_init");
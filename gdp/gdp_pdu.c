@@ -39,11 +39,14 @@
 */
 
 #include <ep/ep.h>
+#include <ep/ep_compress.h>
 #include <ep/ep_dbg.h>
+#include <ep/ep_hash.h>
 #include <ep/ep_hexdump.h>
 #include <ep/ep_log.h>
 #include <ep/ep_prflags.h>
 #include <ep/ep_stat.h>
+#include <ep/ep_varint.h>
 
 #include "gdp.h"
 #include "gdp_priv.h"
@@ -62,9 +65,263 @@ static EP_PRFLAGS_DESC	PduFlags[] =
 	{	GDP_PDU_HAS_RECNO,	GDP_PDU_HAS_RECNO,	"HAS_RECNO"		},
 	{	GDP_PDU_HAS_SEQNO,	GDP_PDU_HAS_SEQNO,	"HAS_SEQNO"		},
 	{	GDP_PDU_HAS_TS,		GDP_PDU_HAS_TS,		"HAS_TS"		},
+	{	GDP_PDU_COMPRESSED,	GDP_PDU_COMPRESSED,	"COMPRESSED"	},
+	{	GDP_PDU_IS_BATCH,	GDP_PDU_IS_BATCH,	"IS_BATCH"		},
 	{	0,					0,					NULL			}
 };
 
+// wire compression and batching parameters
+static int		WireCompressAlg;		// what we compress with (if peer can)
+static int		WireCompressLevel;		// compression level (zstd)
+static size_t	WireCompressMinSize;	// don't compress smaller payloads
+static size_t	WireDecompressMax;		// largest payload we'll inflate to
+static bool		WireBatch;				// ask for batched responses
+static bool		ChanAlias;				// use header aliases on channels
+static EP_HASH	*PeerCaps;				// what our peers have told us
+
+
+/*
+**  _GDP_PDU_INIT --- read parameters
+*/
+
+void
+_gdp_pdu_init(void)
+{
+	const char *p;
+
+	p = ep_adm_getstrparam("swarm.gdp.compress", "none");
+	WireCompressAlg = ep_compress_alg_byname(p == NULL ? "none" : p);
+	if (WireCompressAlg < 0 || !ep_compress_available(WireCompressAlg))
+	{
+		ep_dbg_cprintf(Dbg, 1, "_gdp_pdu_init: compression %s not available\n",
+				p);
+		WireCompressAlg = EP_COMPRESS_NONE;
+	}
+	WireCompressLevel = ep_adm_getintparam("swarm.gdp.compress.level", 3);
+	WireCompressMinSize = ep_adm_getlongparam("swarm.gdp.compress.minsize",
+							256);
+	WireDecompressMax = ep_adm_getlongparam("swarm.gdp.compress.maxsize",
+							16 * 1024 * 1024);
+	WireBatch = ep_adm_getboolparam("swarm.gdp.batch", false);
+	ChanAlias = ep_adm_getboolparam("swarm.gdp.chan.alias", false);
+
+	if (PeerCaps == NULL)
+		PeerCaps = ep_hash_new("PeerCaps", NULL, 0);
+}
+
+
+/*
+**  Peer capabilities
+**
+**		Either end of a conversation can send a HELLO listing the
+**		algorithms it can decompress and whether it can accept
+**		batched records, plus the algorithm it would like used for
+**		PDUs sent to it.  We remember that per peer name (the log
+**		name on the client side, the client's routing name on the
+**		server side), since PDUs are addressed by name rather than
+**		by the channel to the router.  Peers we haven't heard from
+**		get plain PDUs.
+**
+**		The hash value is the capabilities and preferred algorithm
+**		packed into the pointer itself, so readers never see a
+**		value being freed.
+*/
+
+#define PEER_KNOWN			0x80000000
+#define PEER_PACK(c, a)		((void *) (uintptr_t) \
+								(PEER_KNOWN | ((a) & 0xff) << 16 | \
+								 ((c) & 0xffff)))
+#define PEER_CAPS(v)		((uint32_t) (uintptr_t) (v) & 0xffff)
+#define PEER_PREF(v)		(((uint32_t) (uintptr_t) (v) >> 16) & 0xff)
+
+uint32_t
+_gdp_hello_caps(void)
+{
+	uint32_t caps = 0;
+	int alg;
+
+	for (alg = EP_COMPRESS_NONE + 1; alg <= EP_COMPRESS_MAX; alg++)
+	{
+		if (ep_compress_available(alg))
+			caps |= GDP_CAP_COMPRESS(alg);
+	}
+	if (WireBatch)
+		caps |= GDP_CAP_BATCH;
+	if (ChanAlias)
+		caps |= GDP_CAP_ALIAS;
+	return caps;
+}
+
+bool
+_gdp_hello_wanted(void)
+{
+	return WireCompressAlg != EP_COMPRESS_NONE || WireBatch;
+}
+
+void
+_gdp_hello_put(gdp_buf_t *buf)
+{
+	uint8_t pref = WireCompressAlg;
+
+	gdp_buf_put_uint32(buf, _gdp_hello_caps());
+	gdp_buf_write(buf, &pref, 1);
+}
+
+void
+_gdp_hello_get(gdp_name_t peer, gdp_buf_t *buf)
+{
+	uint32_t caps = 0;
+	uint8_t pref = EP_COMPRESS_NONE;
+
+	if (gdp_buf_getlength(buf) >= sizeof caps)
+		caps = gdp_buf_get_uint32(buf);
+	if (gdp_buf_getlength(buf) >= sizeof pref)
+		gdp_buf_read(buf, &pref, sizeof pref);
+	if (ep_dbg_test(Dbg, 10))
+	{
+		gdp_pname_t pname;
+
+		ep_dbg_printf("_gdp_hello_get(%s): caps 0x%" PRIx32 ", pref %s\n",
+				gdp_printable_name(peer, pname), caps,
+				ep_compress_alg_name(pref));
+	}
+	if (PeerCaps != NULL)
+		(void) ep_hash_insert(PeerCaps, sizeof (gdp_name_t), peer,
+						PEER_PACK(caps, pref));
+}
+
+uint32_t
+_gdp_peer_caps(const gdp_name_t peer)
+{
+	void *v;
+
+	if (PeerCaps == NULL)
+		return 0;
+	v = ep_hash_search(PeerCaps, sizeof (gdp_name_t), peer);
+	return v == NULL ? 0 : PEER_CAPS(v);
+}
+
+// have we had a HELLO from peer (even one with no capabilities)?
+bool
+_gdp_peer_known(const gdp_name_t peer)
+{
+	void *v;
+
+	if (PeerCaps == NULL)
+		return false;
+	v = ep_hash_search(PeerCaps, sizeof (gdp_name_t), peer);
+	return v != NULL && EP_UT_BITSET(PEER_KNOWN, (uintptr_t) v);
+}
+
+// pick a compression algorithm for a PDU to peer (0 => don't)
+static int
+peer_compress_alg(const gdp_name_t peer)
+{
+	void *v;
+	int alg;
+
+	if (PeerCaps == NULL ||
+			(v = ep_hash_search(PeerCaps, sizeof (gdp_name_t), peer)) == NULL)
+		return EP_COMPRESS_NONE;
+	alg = PEER_PREF(v);
+	if (alg != EP_COMPRESS_NONE && ep_compress_available(alg) &&
+			EP_UT_BITSET(GDP_CAP_COMPRESS(alg), PEER_CAPS(v)))
+		return alg;
+	alg = WireCompressAlg;
+	if (alg != EP_COMPRESS_NONE &&
+			EP_UT_BITSET(GDP_CAP_COMPRESS(alg), PEER_CAPS(v)))
+		return alg;
+	return EP_COMPRESS_NONE;
+}
+
+
+/*
+**  Compress a PDU payload.  Returns the length of the compressed
+**  form (in *zbufp, to be freed by the caller) or zero if it
+**  doesn't save anything.
+*/
+
+static size_t
+pdu_compress(int alg, const uint8_t *dp, size_t dlen, uint8_t **zbufp)
+{
+	EP_STAT estat;
+	uint8_t *zbuf;
+	size_t n;
+	size_t zlen;
+
+	zbuf = ep_mem_malloc(1 + EP_VARINT_MAXLEN + dlen);
+	zbuf[0] = alg;
+	n = 1 + ep_varint_put(dlen, &zbuf[1]);
+	if (n + 1 >= dlen)
+		goto fail0;
+	zlen = dlen - n - 1;
+	estat = ep_compress(alg, WireCompressLevel, NULL, dp, dlen,
+					&zbuf[n], &zlen);
+	EP_STAT_CHECK(estat, goto fail0);
+	ep_dbg_cprintf(Dbg, 35, "pdu_compress: %s %zd => %zd\n",
+			ep_compress_alg_name(alg), dlen, n + zlen);
+	*zbufp = zbuf;
+	return n + zlen;
+
+fail0:
+	ep_mem_free(zbuf);
+	return 0;
+}
+
+
+/*
+**  Decompress a PDU payload in place.
+*/
+
+static EP_STAT
+pdu_decompress(const gdp_name_t peer, gdp_buf_t *dbuf)
+{
+	EP_STAT estat;
+	size_t zlen = gdp_buf_getlength(dbuf);
+	uint8_t *zbuf = evbuffer_pullup(dbuf, zlen);
+	uint64_t olen;
+	size_t n;
+	size_t outlen;
+	uint8_t *out;
+
+	if (zlen < 2 || (n = ep_varint_get(&zbuf[1], zlen - 1, &olen)) == 0)
+		return EP_STAT_DECOMPRESS_FAILED;
+
+	// only accept what we offered, and only from peers we offered it to
+	if (!EP_UT_BITSET(GDP_CAP_COMPRESS(zbuf[0]), _gdp_hello_caps()) ||
+			!_gdp_peer_known(peer))
+	{
+		ep_dbg_cprintf(Dbg, 1, "pdu_decompress: unsolicited %s\n",
+				ep_compress_alg_name(zbuf[0]));
+		return EP_STAT_DECOMPRESS_FAILED;
+	}
+
+	// the length is the peer's word; don't let it size our allocation
+	if (olen > WireDecompressMax)
+	{
+		ep_dbg_cprintf(Dbg, 1,
+				"pdu_decompress: %" PRIu64 " bytes exceeds max %zd\n",
+				olen, WireDecompressMax);
+		return EP_STAT_DECOMPRESS_FAILED;
+	}
+	n++;
+	outlen = olen;
+	out = ep_mem_ealloc(outlen + 1);
+	if (out == NULL)
+		return EP_STAT_OUT_OF_MEMORY;
+	estat = ep_decompress(zbuf[0], NULL, &zbuf[n], zlen - n, out, &outlen);
+	if (EP_STAT_ISOK(estat) && outlen != olen)
+		estat = EP_STAT_DECOMPRESS_FAILED;
+	if (EP_STAT_ISOK(estat))
+	{
+		gdp_buf_reset(dbuf);
+		gdp_buf_write(dbuf, out, outlen);
+	}
+	ep_mem_free(out);
+	return estat;
+}
+
+
 void
 _gdp_pdu_dump(gdp_pdu_t *pdu, FILE *fp)
 {
@@ -187,6 +444,134 @@ send_data(struct evbuffer *obuf,
 #define OOFF		74		// offset of olen from beginning of pdu
 #define FOFF		75		// offset of flags from beginning of pdu
 
+
+/*
+**  _GDP_DATUM_SIGN --- compute the signature for a datum
+**
+**		basemd has already been seeded with the GCL name and
+**		metadata; it is cloned, not modified, so several threads
+**		can sign records for the same GCL at once.  The result
+**		is left in datum->sig, where _gdp_pdu_out will find it.
+*/
+
+void
+_gdp_datum_sign(gdp_datum_t *datum, EP_CRYPTO_MD *basemd)
+{
+	uint8_t recnobuf[8];		// 64 bits
+	uint8_t *pbp = recnobuf;
+	uint8_t sigbuf[EP_CRYPTO_MAX_SIG];
+	size_t siglen = sizeof sigbuf;
+	EP_CRYPTO_MD *md = ep_crypto_md_clone(basemd);
+
+	PUT64(datum->recno);
+	ep_crypto_sign_update(md, &recnobuf, sizeof recnobuf);
+	gdp_buf_sign_update(datum->dbuf, md);
+	ep_crypto_sign_final(md, &sigbuf, &siglen);
+	datum->siglen = siglen;
+	datum->sigmdalg = ep_crypto_md_type(md);
+	ep_crypto_sign_free(md);
+
+	if (datum->sig == NULL)
+		datum->sig = gdp_buf_new();
+	else
+		gdp_buf_drain(datum->sig, gdp_buf_getlength(datum->sig));
+	gdp_buf_write(datum->sig, sigbuf, siglen);
+}
+
+
+/*
+**  Channel header aliases
+**
+**		Outgoing aliases are assigned round robin, so when the
+**		table is full the oldest assignment is reused (the peer
+**		sees the new definition before any use of it, since the
+**		assignment is done with the output buffer locked).  The
+**		key for an outgoing alias is the destination and source
+**		address exactly as they appear in the header.
+*/
+
+#define MAX_ALIASES		1024
+#define ALIAS_KEYLEN	(2 * sizeof (gdp_name_t))	// dst + src
+
+struct gdp_chan_alias
+{
+	EP_HASH		*out;					// dst+src => alias + 1
+	uint16_t	nextout;				// next alias to assign
+	uint8_t		outkeys[MAX_ALIASES][ALIAS_KEYLEN];	// for reuse
+	bool		outused[MAX_ALIASES];	// outkeys[i] is in the hash
+	uint8_t		in[MAX_ALIASES][ALIAS_KEYLEN];		// peer's aliases
+	bool		indef[MAX_ALIASES];		// in[i] is defined
+};
+
+void
+_gdp_chan_alias_init(gdp_chan_t *chan)
+{
+	struct evbuffer *obuf = bufferevent_get_output(chan->bev);
+
+	evbuffer_lock(obuf);
+	chan->flags &= ~GDP_CHAN_ALIAS_OK;
+	if (chan->alias != NULL)
+		ep_hash_free(chan->alias->out);
+	else if (ChanAlias)
+		chan->alias = ep_mem_malloc(sizeof *chan->alias);
+	if (chan->alias != NULL)
+	{
+		memset(chan->alias, 0, sizeof *chan->alias);
+		chan->alias->out = ep_hash_new("PduAliases", NULL, 0);
+	}
+	evbuffer_unlock(obuf);
+}
+
+void
+_gdp_chan_alias_free(gdp_chan_t *chan)
+{
+	if (chan->alias == NULL)
+		return;
+	ep_hash_free(chan->alias->out);
+	ep_mem_free(chan->alias);
+	chan->alias = NULL;
+	chan->flags &= ~GDP_CHAN_ALIAS_OK;
+}
+
+// rewrite an outgoing header to use an alias; returns new length
+static size_t
+alias_out(gdp_chan_t *chan, uint8_t *pbuf, size_t hdrlen)
+{
+	struct gdp_chan_alias *a = chan->alias;
+	uint8_t *key = &pbuf[4];				// dst, then src
+	uint8_t *pbp;
+	void *v;
+	uint32_t alias;
+
+	v = ep_hash_search(a->out, ALIAS_KEYLEN, key);
+	if (v != NULL)
+	{
+		// known pair: squeeze out the addresses
+		alias = (uintptr_t) v - 1;
+		pbuf[0] = GDP_PROTO_ALIAS_VERSION;
+		pbuf[4] = (alias >> 8) & 0xff;
+		pbuf[5] = alias & 0xff;
+		memmove(&pbuf[6], &pbuf[4 + ALIAS_KEYLEN], hdrlen - 4 - ALIAS_KEYLEN);
+		return hdrlen - ALIAS_KEYLEN + 2;
+	}
+
+	// new pair: assign an alias and define it in this header
+	alias = a->nextout;
+	a->nextout = (alias + 1) % MAX_ALIASES;
+	if (a->outused[alias])
+		(void) ep_hash_delete(a->out, ALIAS_KEYLEN, a->outkeys[alias]);
+	memcpy(a->outkeys[alias], key, ALIAS_KEYLEN);
+	a->outused[alias] = true;
+	(void) ep_hash_insert(a->out, ALIAS_KEYLEN, key,
+					(void *) (uintptr_t) (alias + 1));
+	pbp = &pbuf[hdrlen];
+	PUT32(alias);
+	pbuf[FOFF] |= GDP_PDU_HAS_ALIAS;
+	pbuf[OOFF] += 1;
+	return hdrlen + 4;
+}
+
+
 EP_STAT
 _gdp_pdu_out(gdp_pdu_t *pdu, gdp_chan_t *chan, EP_CRYPTO_MD *basemd)
 {
@@ -196,9 +581,9 @@ _gdp_pdu_out(gdp_pdu_t *pdu, gdp_chan_t *chan, EP_CRYPTO_MD *basemd)
 	size_t dlen;
 	size_t hdrlen;
 	size_t offset;
+	uint8_t *dp = NULL;
+	uint8_t *zbuf = NULL;
 	struct evbuffer *obuf = bufferevent_get_output(chan->bev);
-	uint8_t sigbuf[EP_CRYPTO_MAX_SIG];
-	bool use_sigbuf = false;
 
 	EP_ASSERT_POINTER_VALID(pdu);
 
@@ -223,28 +608,9 @@ _gdp_pdu_out(gdp_pdu_t *pdu, gdp_chan_t *chan, EP_CRYPTO_MD *basemd)
 		}
 	}
 
+	// normally the signature has already been computed by the caller
 	if (basemd != NULL)
-	{
-		// compute the signature
-		uint8_t recnobuf[8];		// 64 bits
-		uint8_t *pbp = recnobuf;
-		size_t reclen;
-		EP_CRYPTO_MD *md = ep_crypto_md_clone(basemd);
-		gdp_datum_t *datum = pdu->datum;
-		size_t siglen = sizeof sigbuf;
-
-		PUT64(pdu->datum->recno);
-		ep_crypto_sign_update(md, &recnobuf, sizeof recnobuf);
-		reclen = gdp_buf_getlength(datum->dbuf);
-		ep_crypto_sign_update(md, gdp_buf_getptr(datum->dbuf, reclen), reclen);
-		ep_crypto_sign_final(md, &sigbuf, &siglen);
-		datum->siglen = siglen;
-		datum->sigmdalg = ep_crypto_md_type(md);
-		if (datum->sig != NULL)
-			evbuffer_drain(datum->sig, evbuffer_get_length(datum->sig));
-		ep_crypto_sign_free(md);
-		use_sigbuf = true;
-	}
+		_gdp_datum_sign(pdu->datum, basemd);
 
 	if (ep_dbg_test(Dbg, 22))
 	{
@@ -295,13 +661,33 @@ _gdp_pdu_out(gdp_pdu_t *pdu, gdp_chan_t *chan, EP_CRYPTO_MD *basemd)
 	*pbp++ = 0;
 
 	// flags (filled in later)
-	*pbp++ = 0;
+	*pbp++ = pdu->flags & GDP_PDU_IS_BATCH;
 
 	// data length
 	if (pdu->datum != NULL)
 		dlen = evbuffer_get_length(pdu->datum->dbuf);
 	else
 		dlen = 0;
+
+	// compress the data if the peer can take it and it's worth it
+	if (dlen > 0 && dlen >= WireCompressMinSize)
+	{
+		int alg = peer_compress_alg(pdu->dst);
+
+		if (alg != EP_COMPRESS_NONE)
+		{
+			size_t zlen;
+
+			dp = evbuffer_pullup(pdu->datum->dbuf, dlen);
+			zlen = pdu_compress(alg, dp, dlen, &zbuf);
+			if (zlen > 0)
+			{
+				pbuf[FOFF] |= GDP_PDU_COMPRESSED;
+				dp = zbuf;
+				dlen = zlen;
+			}
+		}
+	}
 	PUT32(dlen);
 
 	// end of fixed part of header
@@ -338,20 +724,21 @@ _gdp_pdu_out(gdp_pdu_t *pdu, gdp_chan_t *chan, EP_CRYPTO_MD *basemd)
 
 	ep_dbg_cprintf(Dbg, 32, "_gdp_pdu_out: sending PDU:\n");
 
-	// send header
+	// send header (aliases must be assigned in output order)
 	evbuffer_lock(obuf);
+	if (EP_UT_BITSET(GDP_CHAN_ALIAS_OK, chan->flags) && chan->alias != NULL)
+		hdrlen = alias_out(chan, pbuf, hdrlen);
 	estat = send_data(obuf, pbuf, hdrlen,
 					"header", offset, EP_HEXDUMP_HEX);
-	offset += pbp - pbuf;
+	offset += hdrlen;
 	EP_STAT_CHECK(estat, goto fail0);
 
 	// send data
 	if (dlen > 0)
 	{
-		uint8_t *bp;
-
-		bp = evbuffer_pullup(pdu->datum->dbuf, dlen);
-		estat = send_data(obuf, bp, dlen,
+		if (dp == NULL)
+			dp = evbuffer_pullup(pdu->datum->dbuf, dlen);
+		estat = send_data(obuf, dp, dlen,
 						"data", offset, EP_HEXDUMP_ASCII);
 		offset += dlen;
 		EP_STAT_CHECK(estat, goto fail0);
@@ -362,9 +749,7 @@ _gdp_pdu_out(gdp_pdu_t *pdu, gdp_chan_t *chan, EP_CRYPTO_MD *basemd)
 	{
 		uint8_t *sigp = NULL;
 
-		if (use_sigbuf)
-			sigp = sigbuf;
-		else if (pdu->datum->sig != NULL)
+		if (pdu->datum->sig != NULL)
 			sigp = evbuffer_pullup(pdu->datum->sig, pdu->datum->siglen);
 		else
 			EP_ASSERT_INSIST(pdu->datum->sig != NULL);
@@ -381,6 +766,8 @@ fail0:
 		evbuffer_drain(obuf, evbuffer_get_length(obuf));
 	}
 	evbuffer_unlock(obuf);
+	if (zbuf != NULL)
+		ep_mem_free(zbuf);
 
 	return estat;
 }
@@ -458,11 +845,15 @@ _gdp_pdu_hdr_in(gdp_pdu_t *pdu,
 	uint8_t *pbp;
 	gdp_buf_t *ibuf;
 	size_t needed;
+	size_t fixedsz = _GDP_PDU_FIXEDHDRSZ;
+	int alias = -1;
 
 	ibuf = bufferevent_get_input(chan->bev);
 
 	// see if the fixed part of the header is all in
 	needed = gdp_buf_peek(ibuf, pbuf, _GDP_PDU_FIXEDHDRSZ);
+	if (needed > 0 && pbuf[0] == GDP_PROTO_ALIAS_VERSION)
+		fixedsz = _GDP_PDU_ALIASHDRSZ;
 
 	if (ep_dbg_test(Dbg, 62))
 	{
@@ -470,14 +861,15 @@ _gdp_pdu_hdr_in(gdp_pdu_t *pdu,
 		ep_hexdump(pbuf, needed, ep_dbg_getfile(), EP_HEXDUMP_HEX, 0);
 	}
 
-	if (needed < _GDP_PDU_FIXEDHDRSZ)
+	if (needed < fixedsz)
 	{
 		// try again after we read more in
 		ep_dbg_cprintf(Dbg, 42,
-						"_gdp_pdu_in: keep reading (have %zd, need %d)\n",
-						gdp_buf_getlength(ibuf), _GDP_PDU_FIXEDHDRSZ);
+						"_gdp_pdu_in: keep reading (have %zd, need %zd)\n",
+						gdp_buf_getlength(ibuf), fixedsz);
 		return GDP_STAT_KEEP_READING;
 	}
+	needed = fixedsz;
 
 	// hack: store metadata
 	pdu->chan = chan;
@@ -487,7 +879,8 @@ _gdp_pdu_hdr_in(gdp_pdu_t *pdu,
 	pdu->ver = *pbp++;
 
 	// no point in continuing if we don't recognize the PDU
-	if (pdu->ver < GDP_PROTO_MIN_VERSION || pdu->ver > GDP_PROTO_CUR_VERSION)
+	if ((pdu->ver < GDP_PROTO_MIN_VERSION || pdu->ver > GDP_PROTO_CUR_VERSION) &&
+			pdu->ver != GDP_PROTO_ALIAS_VERSION)
 	{
 		if (ep_dbg_test(Dbg, 1))
 		{
@@ -506,10 +899,19 @@ _gdp_pdu_hdr_in(gdp_pdu_t *pdu,
 	pdu->ttl = *pbp++;
 	pdu->rsvd1 = *pbp++;
 	pdu->cmd = *pbp++;
-	memcpy(pdu->dst, pbp, sizeof pdu->dst);
-	pbp += sizeof pdu->dst;
-	memcpy(pdu->src, pbp, sizeof pdu->src);
-	pbp += sizeof pdu->src;
+	if (pdu->ver == GDP_PROTO_ALIAS_VERSION)
+	{
+		// addresses come from an earlier definition
+		GET16(alias);
+		pdu->ver = GDP_PROTO_CUR_VERSION;
+	}
+	else
+	{
+		memcpy(pdu->dst, pbp, sizeof pdu->dst);
+		pbp += sizeof pdu->dst;
+		memcpy(pdu->src, pbp, sizeof pdu->src);
+		pbp += sizeof pdu->src;
+	}
 	GET32(pdu->rid);
 	uint16_t sigtmp;
 	GET16(sigtmp);
@@ -527,6 +929,8 @@ _gdp_pdu_hdr_in(gdp_pdu_t *pdu,
 		olen += sizeof (gdp_recno_t);
 	if (EP_UT_BITSET(GDP_PDU_HAS_TS, pdu->flags))
 		olen += sizeof (EP_TIME_SPEC);
+	if (EP_UT_BITSET(GDP_PDU_HAS_ALIAS, pdu->flags))
+		olen += sizeof (uint32_t);
 	if (pdu->olen < olen)
 	{
 		// oops!  ten pounds in a five pound sack
@@ -562,6 +966,21 @@ _gdp_pdu_hdr_in(gdp_pdu_t *pdu,
 		return GDP_STAT_KEEP_READING;
 	}
 
+	// look up the addresses for an aliased header
+	if (alias >= 0)
+	{
+		if (chan->alias == NULL || alias >= MAX_ALIASES ||
+				!chan->alias->indef[alias])
+		{
+			ep_log(GDP_STAT_PDU_ALIAS_UNKNOWN,
+					"_gdp_pdu_in: unknown alias %d", alias);
+			return GDP_STAT_PDU_ALIAS_UNKNOWN;
+		}
+		memcpy(pdu->dst, chan->alias->in[alias], sizeof pdu->dst);
+		memcpy(pdu->src, &chan->alias->in[alias][sizeof pdu->dst],
+				sizeof pdu->src);
+	}
+
 	return EP_STAT_OK;
 }
 
@@ -574,6 +993,7 @@ _gdp_pdu_in(gdp_pdu_t *pdu, gdp_chan_t *chan)
 	uint8_t *pbp;
 	gdp_buf_t *ibuf;
 	size_t needed;
+	size_t hdrsz;
 	uint64_t dlen;
 
 	EP_ASSERT_POINTER_VALID(pdu);
@@ -584,22 +1004,28 @@ _gdp_pdu_in(gdp_pdu_t *pdu, gdp_chan_t *chan)
 	ibuf = bufferevent_get_input(chan->bev);
 
 	estat = _gdp_pdu_hdr_in(pdu, chan, &needed, &dlen);
+	if (EP_STAT_IS_SAME(estat, GDP_STAT_PDU_ALIAS_UNKNOWN))
+	{
+		// can't tell where it goes; skip it
+		gdp_buf_drain(ibuf, needed);
+	}
 	EP_STAT_CHECK(estat, return estat);
 
 	// the entire PDU is now in ibuf
 
 	// now drain the data we have processed
-	sz = gdp_buf_read(ibuf, pbuf, _GDP_PDU_FIXEDHDRSZ + pdu->olen);
-	if (sz < _GDP_PDU_FIXEDHDRSZ + pdu->olen)
+	hdrsz = needed - dlen - pdu->datum->siglen;
+	sz = gdp_buf_read(ibuf, pbuf, hdrsz);
+	if (sz < hdrsz)
 	{
 		// shouldn't happen, since it's already in memory
 		estat = GDP_STAT_BUFFER_FAILURE;
 		ep_log(estat,
-				"_gdp_pdu_in: gdp_buf_drain failed, sz = %zu, needed = %u\n",
-				sz, _GDP_PDU_FIXEDHDRSZ + pdu->olen);
+				"_gdp_pdu_in: gdp_buf_drain failed, sz = %zu, needed = %zu\n",
+				sz, hdrsz);
 		// buffer is now out of sync; not clear if we can continue
 	}
-	pbp = &pbuf[_GDP_PDU_FIXEDHDRSZ];
+	pbp = &pbuf[hdrsz - pdu->olen];
 
 	if (ep_dbg_test(Dbg, 32))
 	{
@@ -634,6 +1060,22 @@ _gdp_pdu_in(gdp_pdu_t *pdu, gdp_chan_t *chan)
 		GET32(*((uint32_t *) &pdu->datum->ts.tv_accuracy));
 	}
 
+	// header alias definition
+	if (EP_UT_BITSET(GDP_PDU_HAS_ALIAS, pdu->flags))
+	{
+		uint32_t alias;
+
+		GET32(alias);
+		if (chan->alias != NULL && alias < MAX_ALIASES)
+		{
+			memcpy(chan->alias->in[alias], pdu->dst, sizeof pdu->dst);
+			memcpy(&chan->alias->in[alias][sizeof pdu->dst], pdu->src,
+					sizeof pdu->src);
+			chan->alias->indef[alias] = true;
+		}
+		pdu->flags &= ~GDP_PDU_HAS_ALIAS;
+	}
+
 	//XXX soak up any padding bytes?
 
 	// ibuf now points at the data block, sz is the PDU offset
@@ -659,6 +1101,22 @@ _gdp_pdu_in(gdp_pdu_t *pdu, gdp_chan_t *chan)
 		sz += l;
 	}
 
+	// the rest of the world only sees uncompressed data
+	if (EP_UT_BITSET(GDP_PDU_COMPRESSED, pdu->flags))
+	{
+		EP_STAT zstat = pdu_decompress(pdu->src, pdu->datum->dbuf);
+
+		if (!EP_STAT_ISOK(zstat))
+		{
+			// finish reading the PDU to stay in sync, then drop it
+			ep_log(zstat, "_gdp_pdu_in: cannot decompress %s",
+					_gdp_proto_cmd_name(pdu->cmd));
+			gdp_buf_reset(pdu->datum->dbuf);
+			estat = GDP_STAT_PDU_DISCARDED;
+		}
+		pdu->flags &= ~GDP_PDU_COMPRESSED;
+	}
+
 	// ibuf now points at the signature (if any)
 	if (pdu->datum->siglen > 0)
 	{
@@ -710,6 +1168,101 @@ _gdp_pdu_in(gdp_pdu_t *pdu, gdp_chan_t *chan)
 }
 
 
+/*
+**  _GDP_PDU_BATCH_ADD --- add a record to a batch PDU
+**
+**		The record data is moved, not copied, into the batch.
+*/
+
+#define BATCH_ENT_HDRSZ		(8 + 16 + 2 + 4)
+
+void
+_gdp_pdu_batch_add(gdp_pdu_t *bpdu, gdp_datum_t *datum)
+{
+	gdp_buf_t *b = bpdu->datum->dbuf;
+	uint8_t sigbuf[2];
+	int siglen = datum->sig == NULL ? 0 : datum->siglen;
+	uint16_t sigtmp = (siglen & 0x0fff) | ((datum->sigmdalg & 0x0f) << 12);
+
+	bpdu->flags |= GDP_PDU_IS_BATCH;
+	gdp_buf_put_uint64(b, datum->recno);
+	gdp_buf_put_timespec(b, &datum->ts);
+	sigbuf[0] = (sigtmp >> 8) & 0xff;
+	sigbuf[1] = sigtmp & 0xff;
+	gdp_buf_write(b, sigbuf, sizeof sigbuf);
+	gdp_buf_put_uint32(b, gdp_buf_getlength(datum->dbuf));
+	gdp_buf_copy(datum->dbuf, b);
+	if (siglen > 0)
+		gdp_buf_write(b, evbuffer_pullup(datum->sig, siglen), siglen);
+}
+
+
+/*
+**  _GDP_PDU_UNBATCH --- return the next record in a batch as a PDU
+**
+**		The PDU looks just as though the record had been sent by
+**		itself.  Returns NULL when the batch is exhausted.
+*/
+
+gdp_pdu_t *
+_gdp_pdu_unbatch(gdp_pdu_t *bpdu)
+{
+	gdp_buf_t *b = bpdu->datum->dbuf;
+	gdp_pdu_t *pdu;
+	uint8_t sigbuf[2];
+	uint16_t sigtmp;
+	uint32_t dlen;
+
+	if (gdp_buf_getlength(b) < BATCH_ENT_HDRSZ)
+	{
+		if (gdp_buf_getlength(b) > 0)
+			goto corrupt;
+		return NULL;
+	}
+
+	pdu = _gdp_pdu_new();
+	pdu->chan = bpdu->chan;
+	pdu->ver = bpdu->ver;
+	pdu->ttl = bpdu->ttl;
+	pdu->rsvd1 = bpdu->rsvd1;
+	pdu->cmd = bpdu->cmd;
+	memcpy(pdu->dst, bpdu->dst, sizeof pdu->dst);
+	memcpy(pdu->src, bpdu->src, sizeof pdu->src);
+	pdu->rid = bpdu->rid;
+	pdu->seqno = bpdu->seqno;
+	pdu->flags = GDP_PDU_HAS_RECNO | GDP_PDU_HAS_TS;
+
+	pdu->datum->recno = gdp_buf_get_uint64(b);
+	gdp_buf_get_timespec(b, &pdu->datum->ts);
+	gdp_buf_read(b, sigbuf, sizeof sigbuf);
+	sigtmp = (sigbuf[0] << 8) | sigbuf[1];
+	pdu->datum->sigmdalg = (sigtmp >> 12) & 0x0f;
+	pdu->datum->siglen = sigtmp & 0x0fff;
+	dlen = gdp_buf_get_uint32(b);
+	if (gdp_buf_getlength(b) < dlen + pdu->datum->siglen)
+	{
+		_gdp_pdu_free(pdu);
+		goto corrupt;
+	}
+	evbuffer_remove_buffer(b, pdu->datum->dbuf, dlen);
+	if (pdu->datum->siglen > 0)
+	{
+		pdu->datum->sig = gdp_buf_new();
+		evbuffer_remove_buffer(b, pdu->datum->sig, pdu->datum->siglen);
+	}
+	ep_dbg_cprintf(Dbg, 38, "_gdp_pdu_unbatch: recno %" PRIgdp_recno
+			", %" PRIu32 " bytes\n",
+			pdu->datum->recno, dlen);
+	return pdu;
+
+corrupt:
+	ep_log(GDP_STAT_PDU_CORRUPT, "_gdp_pdu_unbatch: truncated batch (%zd left)",
+			gdp_buf_getlength(b));
+	gdp_buf_reset(b);
+	return NULL;
+}
+
+
 /*
 **  _GDP_PDU_NEW --- allocate a PDU (from free list if possible)
 **  _GDP_PDU_FREE --- return a PDU to the free list
@@ -41,6 +41,7 @@
 
 #define GDP_PROTO_CUR_VERSION	3		// current protocol version
 #define GDP_PROTO_MIN_VERSION	2		// min version we can accept
+#define GDP_PROTO_ALIAS_VERSION	4		// aliased header (see below)
 
 #define GDP_TTL_DEFAULT			15		// hops left
 
@@ -99,6 +100,40 @@
 **			V	__	additional optional data
 **			V	__	data (length indicated above)
 **			V	__	signature (length indicated above)
+**
+**		If GDP_PDU_COMPRESSED is set the data portion is one byte
+**		of compression algorithm (EP_COMPRESS_*), the uncompressed
+**		length as a varint, and the compressed data; the signature
+**		always covers the uncompressed data.  If GDP_PDU_IS_BATCH
+**		is set the (uncompressed) data portion holds several
+**		records, each encoded as:
+**			8	record number
+**			16	commit timestamp
+**			2	signature length & digest algorithm
+**			4	length of data
+**			V	data
+**			V	signature
+**		Senders only use these if the peer has said (in a HELLO)
+**		that it understands them.
+**
+**		Header aliasing is negotiated hop by hop: each end of a
+**		channel sends a HELLO addressed to the routing layer when
+**		the channel is opened, and if both ends can do it they may
+**		replace the addresses with a short alias.  The first PDU
+**		for a (destination, source) pair has a full header with
+**		GDP_PDU_HAS_ALIAS set and the alias as the last option;
+**		later PDUs for that pair use version GDP_PROTO_ALIAS_VERSION
+**		and replace the addresses with the alias:
+**			1	0	GDP_PROTO_ALIAS_VERSION
+**			1	1	time to live (in hops)
+**			1	2	reserved
+**			1	3	command or ack/nak
+**			2	4	alias
+**			4	6	request id
+**			...			(as above from signature length on)
+**		Aliases are per channel and per direction.  An alias may
+**		be redefined at any time by sending a new full header.
+**
 **		The structure shown below is the in-memory version and does
 **		not correspond 1::1 to the on-wire format.
 */
@@ -135,6 +170,14 @@ typedef struct gdp_pdu
 #define GDP_PDU_HAS_RECNO	0x02		// has a recno field
 #define GDP_PDU_HAS_SEQNO	0x04		// has a seqno field
 #define GDP_PDU_HAS_TS		0x08		// has a timestamp field
+#define GDP_PDU_COMPRESSED	0x10		// data portion is compressed
+#define GDP_PDU_IS_BATCH	0x20		// data portion has several records
+#define GDP_PDU_HAS_ALIAS	0x40		// defines a header alias
+
+/***** capabilities exchanged in HELLO *****/
+#define GDP_CAP_COMPRESS(alg)	(1 << (alg))	// can decompress alg
+#define GDP_CAP_BATCH			0x00000100		// can receive batches
+#define GDP_CAP_ALIAS			0x00000200		// can take aliased headers
 
 /***** dummy values for other fields *****/
 #define GDP_PDU_NO_RID		UINT32_C(0)		// no request id
@@ -146,6 +189,10 @@ typedef struct gdp_pdu
 // (ver, ttl, rsvd, cmd, dst, src, rid, sigalg, siglen, olen, flags, dlen)
 #define _GDP_PDU_FIXEDHDRSZ		(1+1+1+1+32+32+4+1+1+1+1+4)
 
+// size of fixed size part of an aliased header
+// (ver, ttl, rsvd, cmd, alias, rid, sigalg, siglen, olen, flags, dlen)
+#define _GDP_PDU_ALIASHDRSZ		(1+1+1+1+2+4+1+1+1+1+4)
+
 //* maximum size of options portion
 #define _GDP_PDU_MAXOPTSZ		(255 * 4)
 
@@ -192,6 +239,10 @@ typedef struct gdp_pdu
 #define GDP_CMD_OPEN_RA			75			// open a GCL for read or append
 #define GDP_CMD_NEWEXTENT		76			// create a new extent for a log
 #define GDP_CMD_FWD_APPEND		77			// forward (replicate) APPEND
+#define GDP_CMD_SNAPSHOT		78			// make a backup copy of a log
+#define GDP_CMD_REPL_FETCH		79			// fetch records for a replica
+#define GDP_CMD_REPL_LIST		80			// list the replicas of a log
+#define GDP_CMD_REPL_READ		81			// read from a replica
 //		128-191			Positive acks
 #define GDP_ACK_MIN			128			// minimum ack code
 #define GDP_ACK_SUCCESS			_GDP_ACK_FROM_CODE(SUCCESS)				// 128
@@ -262,6 +313,47 @@ void		_gdp_pdu_dump(
 				gdp_pdu_t *pdu,
 				FILE *fp);
 
+void		_gdp_pdu_init(void);		// read PDU parameters
+
+gdp_pdu_t	*_gdp_pdu_unbatch(			// get next record from a batch
+				gdp_pdu_t *bpdu);		// the batch PDU
+
+void		_gdp_pdu_batch_add(			// add a record to a batch
+				gdp_pdu_t *bpdu,		// the batch PDU
+				gdp_datum_t *datum);	// the record to add
+
+uint32_t	_gdp_hello_caps(			// our capabilities
+				void);
+
+bool		_gdp_hello_wanted(			// do we have anything to say?
+				void);
+
+void		_gdp_hello_put(				// encode our HELLO info
+				gdp_buf_t *buf);
+
+void		_gdp_hello_get(				// note a peer's HELLO info
+				gdp_name_t peer,		// who sent it
+				gdp_buf_t *buf);		// the HELLO data
+
+uint32_t	_gdp_peer_caps(				// what does a peer support?
+				const gdp_name_t peer);
+
+bool		_gdp_peer_known(			// have we heard peer's HELLO?
+				const gdp_name_t peer);
+
+void		_gdp_chan_alias_init(		// (re)start aliasing on a channel
+				gdp_chan_t *chan);
+
+void		_gdp_chan_alias_free(		// free channel alias state
+				gdp_chan_t *chan);
+
+void		_gdp_chan_hello(			// say HELLO to other end of channel
+				gdp_chan_t *chan);
+
+bool		_gdp_chan_hello_in(			// handle channel HELLO (if it is one)
+				gdp_pdu_t *pdu,
+				gdp_chan_t *chan);
+
 void		_gdp_pdu_process(
 				gdp_pdu_t *pdu,
 				gdp_chan_t *chan);
@@ -101,6 +101,7 @@ struct gdp_chan
 							gdp_pdu_t *pdu,
 							gdp_chan_t *chan);
 	pthread_t			sub_thr_id;		// subscription poker thread id
+	struct gdp_chan_alias	*alias;		// PDU header aliases (if enabled)
 };
 
 /* Channel states */
@@ -112,6 +113,7 @@ struct gdp_chan
 
 /* Channel flags */
 #define GDP_CHAN_HAS_SUB_THR	0x0001	// subscription poker thread is running
+#define GDP_CHAN_ALIAS_OK		0x0002	// peer accepts aliased PDU headers
 
 EP_STAT			_gdp_chan_open(				// open channel to routing layer
 						const char *gdpd_addr,
@@ -142,6 +144,11 @@ struct gdp_datum
 	bool				inuse:1;		// the datum is in use (for debugging)
 };
 
+// compute signature for a datum (result in datum->sig)
+extern void		_gdp_datum_sign(
+					gdp_datum_t *datum,			// datum to sign
+					EP_CRYPTO_MD *basemd);		// pre-seeded digest
+
 // dump data record (for debugging)
 extern void		_gdp_datum_dump(
 					const gdp_datum_t *datum,	// message to print
@@ -169,6 +176,9 @@ struct gdp_gcl
 	gdp_recno_t			nrecs;			// number of records (= last recno)
 	gdp_gclmd_t			*gclmd;			// metadata
 	EP_CRYPTO_MD		*digest;		// base crypto digest
+	uint32_t			apndtkt;		// next append send ticket
+	uint32_t			apndturn;		// ticket allowed to send now
+	EP_THR_COND			apndcond;		// signaled when apndturn advances
 	EP_STAT				(*apndfilter)(	// append filter function
 							gdp_datum_t *,
 							void *);
@@ -177,6 +187,8 @@ struct gdp_gcl
 							gdp_datum_t *,
 							void *);
 	void				*readfpriv;		// private data for readfilter
+	int32_t				maxstale;		// staleness ok from replicas (ms)
+	struct gdp_replset	*replset;		// known replicas (gdp_replica.c)
 	struct gdp_gcl_xtra	*x;				// for use by gdpd, gdp-rest
 };
 
@@ -322,6 +334,17 @@ EP_STAT			_gdp_gcl_subscribe(			// subscribe to data
 						gdp_chan_t *chan,
 						uint32_t reqflags);
 
+EP_STAT			_gdp_gcl_multiread_sampled(	// strided/bucketed multiread
+						gdp_gcl_t *gcl,
+						gdp_recno_t start,
+						int32_t numrecs,
+						int32_t stride,
+						EP_TIME_SPEC *bucket,
+						gdp_event_cbfunc_t cbfunc,
+						void *cbarg,
+						gdp_chan_t *chan,
+						uint32_t reqflags);
+
 EP_STAT			_gdp_gcl_unsubscribe(		// unsubscribe
 						gdp_gcl_t *gcl,			// the GCL with the subscription
 						gdp_name_t dest);		// the name of the subscriber
@@ -337,6 +360,24 @@ EP_STAT			_gdp_gcl_newextent(			// create a new physical extent
 						gdp_chan_t *chan,
 						uint32_t reqflags);
 
+EP_STAT			_gdp_gcl_snapshot(			// back up a log on its server
+						gdp_gcl_t *gcl,
+						const char *label,
+						gdp_recno_t *recnop,
+						gdp_chan_t *chan,
+						uint32_t reqflags);
+
+EP_STAT			_gdp_gcl_repl_fetch(		// get records from a leader
+						gdp_gcl_t *gcl,
+						gdp_name_t leader,
+						uint32_t waitms,
+						uint32_t load,
+						uint32_t nlogs,
+						gdp_buf_t *ibuf,
+						gdp_buf_t *obuf,
+						gdp_chan_t *chan,
+						uint32_t reqflags);
+
 EP_STAT			_gdp_gcl_fwd_append(		// forward APPEND (replication)
 						gdp_gcl_t *gcl,
 						gdp_datum_t *datum,
@@ -346,6 +387,22 @@ EP_STAT			_gdp_gcl_fwd_append(		// forward APPEND (replication)
 						gdp_chan_t *chan,
 						uint32_t reqflags);
 
+/*
+**  Reading from replicas (gdp_replica.c)
+*/
+
+bool			_gdp_req_replica_redirect(	// send read to a replica
+						gdp_req_t *req,
+						const gdp_name_t prefer);
+
+bool			_gdp_replica_failed(		// replica failed; retry?
+						gdp_gcl_t *gcl,
+						const gdp_name_t replica,
+						EP_STAT estat);
+
+void			_gdp_replset_free(			// free list of replicas
+						struct gdp_replset *rs);
+
 /*
 **  GCL Open Information
 */
@@ -445,6 +502,10 @@ struct gdp_req
 	EP_STAT				stat;		// status code from last operation
 	gdp_recno_t			nextrec;	// next record to return (subscriptions)
 	int32_t				numrecs;	// remaining number of records to return
+	int32_t				stride;		// return every stride'th record (multiread)
+	gdp_recno_t			lastrec;	// last record in range (sampled multiread)
+	int64_t				bucket_ns;	// time bucket width in ns (sampled multiread)
+	gdp_name_t			replica;	// replica serving subscription (or zero)
 	uint16_t			state;		// see below
 	uint32_t			flags;		// see below
 	EP_TIME_SPEC		act_ts;		// timestamp of last successful activity
@@ -453,6 +514,7 @@ struct gdp_req
 	gdp_event_cbfunc_t	sub_cb;		// callback function (subscribe & async I/O)
 	void				*udata;		// user-supplied opaque data to cb
 	EP_CRYPTO_MD		*md;		// message digest context
+	uint32_t			apndtkt;	// send order ticket (appends only)
 };
 
 // states
@@ -473,6 +535,7 @@ struct gdp_req
 #define GDP_REQ_ON_CHAN_LIST	0x00000100	// this is on a channel list
 #define GDP_REQ_CORE			0x00000200	// internal to the core code
 #define GDP_REQ_ROUTEFAIL		0x00000400	// fail immediately on route failure
+#define GDP_REQ_DEFER_REPLY		0x00000800	// reply will be sent later
 
 EP_STAT			_gdp_req_new(				// create new request
 						int cmd,
@@ -460,10 +460,10 @@ static dispatch_ent_t	DispatchTable[256] =
 	{ NULL,				"CMD_OPEN_RA"			},			// 75
 	{ NULL,				"CMD_NEWEXTENT"			},			// 76
 	{ NULL,				"CMD_FWD_APPEND"		},			// 77
-	NOENT,				// 78
-	NOENT,				// 79
-	NOENT,				// 80
-	NOENT,				// 81
+	{ NULL,				"CMD_SNAPSHOT"			},			// 78
+	{ NULL,				"CMD_REPL_FETCH"		},			// 79
+	{ NULL,				"CMD_REPL_LIST"			},			// 80
+	{ NULL,				"CMD_REPL_READ"			},			// 81
 	NOENT,				// 82
 	NOENT,				// 83
 	NOENT,				// 84
@@ -803,6 +803,61 @@ fail0:
 }
 
 
+/*
+**  Channel HELLO
+**
+**		Each end of a channel tells the other what it can do as
+**		soon as the channel is opened, by sending a HELLO addressed
+**		to the routing layer.  These are consumed by the channel
+**		code rather than dispatched, and are not acknowledged;
+**		peers that don't know about them will NAK or ignore them.
+**		We only send one if there is something to negotiate.
+*/
+
+void
+_gdp_chan_hello(gdp_chan_t *chan)
+{
+	EP_STAT estat;
+	gdp_pdu_t *pdu;
+
+	if (!EP_UT_BITSET(GDP_CAP_ALIAS, _gdp_hello_caps()))
+		return;
+
+	pdu = _gdp_pdu_new();
+	pdu->cmd = GDP_CMD_HELLO;
+	memcpy(pdu->dst, RoutingLayerAddr, sizeof pdu->dst);
+	_gdp_hello_put(pdu->datum->dbuf);
+	estat = _gdp_pdu_out(pdu, chan, NULL);
+	_gdp_pdu_free(pdu);
+
+	if (ep_dbg_test(Dbg, 10))
+	{
+		char ebuf[100];
+
+		ep_dbg_printf("_gdp_chan_hello => %s\n",
+				ep_stat_tostr(estat, ebuf, sizeof ebuf));
+	}
+}
+
+bool
+_gdp_chan_hello_in(gdp_pdu_t *pdu, gdp_chan_t *chan)
+{
+	uint32_t caps = 0;
+
+	if (pdu->cmd != GDP_CMD_HELLO ||
+			memcmp(pdu->dst, RoutingLayerAddr, sizeof pdu->dst) != 0)
+		return false;
+
+	if (gdp_buf_getlength(pdu->datum->dbuf) >= sizeof caps)
+		caps = gdp_buf_get_uint32(pdu->datum->dbuf);
+	ep_dbg_cprintf(Dbg, 10, "_gdp_chan_hello_in: caps 0x%" PRIx32 "\n", caps);
+	if (EP_UT_BITSET(GDP_CAP_ALIAS, caps) &&
+			EP_UT_BITSET(GDP_CAP_ALIAS, _gdp_hello_caps()))
+		chan->flags |= GDP_CHAN_ALIAS_OK;
+	return true;
+}
+
+
 /*
 **  Advertise me only
 */
@@ -0,0 +1,310 @@
+/* vim: set ai sw=4 sts=4 ts=4 :*/
+
+/*
+**  ----- BEGIN LICENSE BLOCK -----
+**	GDP: Global Data Plane Support Library
+**	From the Ubiquitous Swarm Lab, 490 Cory Hall, U.C. Berkeley.
+**
+**	Copyright (c) 2015, Regents of the University of California.
+**	All rights reserved.
+**
+**	Permission is hereby granted, without written agreement and without
+**	license or royalty fees, to use, copy, modify, and distribute this
+**	software and its documentation for any purpose, provided that the above
+**	copyright notice and the following two paragraphs appear in all copies
+**	of this software.
+**
+**	IN NO EVENT SHALL REGENTS BE LIABLE TO ANY PARTY FOR DIRECT, INDIRECT,
+**	SPECIAL, INCIDENTAL, OR CONSEQUENTIAL DAMAGES, INCLUDING LOST
+**	PROFITS, ARISING OUT OF THE USE OF THIS SOFTWARE AND ITS DOCUMENTATION,
+**	EVEN IF REGENTS HAS BEEN ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+**
+**	REGENTS SPECIFICALLY DISCLAIMS ANY WARRANTIES, INCLUDING, BUT NOT
+**	LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+**	FOR A PARTICULAR PURPOSE. THE SOFTWARE AND ACCOMPANYING DOCUMENTATION,
+**	IF ANY, PROVIDED HEREUNDER IS PROVIDED "AS IS". REGENTS HAS NO
+**	OBLIGATION TO PROVIDE MAINTENANCE, SUPPORT, UPDATES, ENHANCEMENTS,
+**	OR MODIFICATIONS.
+**  ----- END LICENSE BLOCK -----
+*/
+
+#include <ep/ep.h>
+#include <ep/ep_dbg.h>
+#include <ep/ep_log.h>
+
+#include "gdp.h"
+#include "gdp_priv.h"
+
+#include <string.h>
+
+static EP_DBG	Dbg = EP_DBG_INIT("gdp.replica", "GDP reads from log replicas");
+
+
+/*
+**  Reading from replicas
+**
+**		If a log is replicated (see gdplogd/logd_repl.c) and the
+**		application has said how stale the data it reads may be
+**		(gdp_gcl_set_maxstale), reads, multireads, and subscriptions
+**		are sent to a replica instead of the log itself.  The leader
+**		tells us which replicas there are, how far behind each one
+**		is, and how busy each one is; we pick the least loaded of
+**		those that are fresh enough.  The replica checks the bound
+**		again before answering, so the list only needs to be
+**		roughly right.  If the replica refuses or can't be reached
+**		we mark it as failed (until the list is next refreshed)
+**		and go to the leader.
+*/
+
+struct gdp_replica
+{
+	gdp_name_t			name;			// routing name of replica
+	gdp_recno_t			recno;			// last record it has
+	uint32_t			stalems;		// how stale it is (msec)
+	uint32_t			load;			// how busy it is
+	bool				failed;			// didn't work last time
+};
+
+struct gdp_replset
+{
+	EP_TIME_SPEC		fetched;		// when we got this list
+	int					nreplicas;		// number of replicas
+	struct gdp_replica	*replicas;		// the replicas themselves
+};
+
+
+void
+_gdp_replset_free(struct gdp_replset *rs)
+{
+	if (rs == NULL)
+		return;
+	if (rs->replicas != NULL)
+		ep_mem_free(rs->replicas);
+	ep_mem_free(rs);
+}
+
+
+/*
+**  REPL_LIST --- ask the leader for the replicas of a log
+*/
+
+static EP_STAT
+repl_list(gdp_gcl_t *gcl, gdp_chan_t *chan, struct gdp_replset **rsp)
+{
+	EP_STAT estat;
+	gdp_req_t *req;
+	gdp_buf_t *b;
+	struct gdp_replset *rs;
+	uint32_t n;
+	int i;
+
+	estat = _gdp_req_new(GDP_CMD_REPL_LIST, gcl, chan, NULL, 0, &req);
+	EP_STAT_CHECK(estat, goto fail0);
+	estat = _gdp_invoke(req);
+	EP_STAT_CHECK(estat, goto fail1);
+
+	b = req->pdu->datum->dbuf;
+	if (gdp_buf_getlength(b) < sizeof n)
+	{
+		estat = GDP_STAT_PDU_CORRUPT;
+		goto fail1;
+	}
+	n = gdp_buf_get_uint32(b);
+	if (gdp_buf_getlength(b) < n * (sizeof (gdp_name_t) + 16))
+	{
+		estat = GDP_STAT_PDU_CORRUPT;
+		goto fail1;
+	}
+
+	rs = ep_mem_zalloc(sizeof *rs);
+	ep_time_now(&rs->fetched);
+	rs->nreplicas = n;
+	if (n > 0)
+		rs->replicas = ep_mem_zalloc(n * sizeof *rs->replicas);
+	for (i = 0; i < rs->nreplicas; i++)
+	{
+		struct gdp_replica *r = &rs->replicas[i];
+
+		gdp_buf_read(b, r->name, sizeof r->name);
+		r->recno = gdp_buf_get_uint64(b);
+		r->stalems = gdp_buf_get_uint32(b);
+		r->load = gdp_buf_get_uint32(b);
+		if (ep_dbg_test(Dbg, 20))
+		{
+			gdp_pname_t pname;
+
+			ep_dbg_printf("repl_list(%s): %s recno %" PRIgdp_recno
+					" stale %" PRIu32 " ms load %" PRIu32 "\n",
+					gcl->pname, gdp_printable_name(r->name, pname),
+					r->recno, r->stalems, r->load);
+		}
+	}
+	*rsp = rs;
+
+fail1:
+	_gdp_req_free(&req);
+fail0:
+	return estat;
+}
+
+
+/*
+**  Get the current replica list for a GCL, refreshing if needed
+**
+**		The list is refreshed every swarm.gdp.replica.refresh
+**		seconds.  If the leader can't be asked we remember an
+**		empty list so that every read doesn't try again.
+*/
+
+static void
+repl_refresh(gdp_gcl_t *gcl, gdp_chan_t *chan)
+{
+	EP_STAT estat;
+	struct gdp_replset *rs = NULL;
+	struct gdp_replset *oldrs;
+	EP_TIME_SPEC now;
+	long refresh = ep_adm_getlongparam("swarm.gdp.replica.refresh", 30);
+
+	ep_time_now(&now);
+	ep_thr_mutex_lock(&gcl->mutex);
+	oldrs = gcl->replset;
+	if (oldrs != NULL && now.tv_sec - oldrs->fetched.tv_sec < refresh)
+	{
+		ep_thr_mutex_unlock(&gcl->mutex);
+		return;
+	}
+	ep_thr_mutex_unlock(&gcl->mutex);
+
+	// can't hold the GCL lock while waiting for the answer
+	estat = repl_list(gcl, chan, &rs);
+	if (!EP_STAT_ISOK(estat))
+	{
+		char ebuf[100];
+
+		ep_dbg_cprintf(Dbg, 1, "repl_refresh(%s): %s\n", gcl->pname,
+				ep_stat_tostr(estat, ebuf, sizeof ebuf));
+		rs = ep_mem_zalloc(sizeof *rs);
+		rs->fetched = now;
+	}
+
+	ep_thr_mutex_lock(&gcl->mutex);
+	oldrs = gcl->replset;
+	gcl->replset = rs;
+	ep_thr_mutex_unlock(&gcl->mutex);
+	_gdp_replset_free(oldrs);
+}
+
+
+/*
+**  _GDP_REQ_REPLICA_REDIRECT --- send a read request to a replica
+**
+**		If the GCL allows stale reads and there is a replica
+**		that is fresh enough, the request is rewritten into a
+**		REPL_READ addressed to that replica and true is returned.
+**		Otherwise the request is left alone.  If prefer is given
+**		and is still acceptable it is used (so that subscriptions
+**		stay where they are when refreshed).
+*/
+
+bool
+_gdp_req_replica_redirect(gdp_req_t *req, const gdp_name_t prefer)
+{
+	gdp_gcl_t *gcl = req->gcl;
+	struct gdp_replset *rs;
+	struct gdp_replica *best = NULL;
+	gdp_buf_t *nbuf;
+	uint8_t cmd;
+	int i;
+
+	if (gcl == NULL || gcl->maxstale <= 0)
+		return false;
+	repl_refresh(gcl, req->chan);
+
+	ep_thr_mutex_lock(&gcl->mutex);
+	rs = gcl->replset;
+	for (i = 0; rs != NULL && i < rs->nreplicas; i++)
+	{
+		struct gdp_replica *r = &rs->replicas[i];
+
+		if (r->failed || r->stalems > (uint32_t) gcl->maxstale)
+			continue;
+		if (prefer != NULL && GDP_NAME_SAME(r->name, prefer))
+		{
+			best = r;
+			break;
+		}
+		if (best == NULL || r->load < best->load ||
+				(r->load == best->load && r->stalems < best->stalems))
+			best = r;
+	}
+	if (best == NULL)
+	{
+		ep_thr_mutex_unlock(&gcl->mutex);
+		return false;
+	}
+	memcpy(req->pdu->dst, best->name, sizeof req->pdu->dst);
+	ep_thr_mutex_unlock(&gcl->mutex);
+
+	// prepend the log name, staleness bound, and real command
+	cmd = req->pdu->cmd;
+	nbuf = gdp_buf_new();
+	gdp_buf_write(nbuf, gcl->name, sizeof gcl->name);
+	gdp_buf_put_uint32(nbuf, gcl->maxstale);
+	gdp_buf_write(nbuf, &cmd, sizeof cmd);
+	gdp_buf_copy(req->pdu->datum->dbuf, nbuf);
+	gdp_buf_copy(nbuf, req->pdu->datum->dbuf);
+	gdp_buf_free(nbuf);
+	req->pdu->cmd = GDP_CMD_REPL_READ;
+
+	if (ep_dbg_test(Dbg, 20))
+	{
+		gdp_pname_t pname;
+
+		ep_dbg_printf("_gdp_req_replica_redirect(%s): %s to %s\n",
+				gcl->pname, _gdp_proto_cmd_name(cmd),
+				gdp_printable_name(req->pdu->dst, pname));
+	}
+	return true;
+}
+
+
+/*
+**  _GDP_REPLICA_FAILED --- note that a replica couldn't help
+**
+**		Returns true if the request should be retried at the log
+**		itself.  Client errors (e.g., no such record) would be the
+**		same there, except that a replica refuses with "precondition
+**		failed" if it is too stale.
+*/
+
+bool
+_gdp_replica_failed(gdp_gcl_t *gcl, const gdp_name_t replica, EP_STAT estat)
+{
+	struct gdp_replset *rs;
+	int i;
+
+	if (EP_STAT_ISOK(estat) ||
+		(GDP_STAT_IS_C_NAK(estat) &&
+		 !EP_STAT_IS_SAME(estat, GDP_STAT_NAK_PRECONFAILED)))
+		return false;
+
+	if (ep_dbg_test(Dbg, 10))
+	{
+		gdp_pname_t pname;
+		char ebuf[100];
+
+		ep_dbg_printf("_gdp_replica_failed(%s): %s: %s\n",
+				gcl->pname, gdp_printable_name(replica, pname),
+				ep_stat_tostr(estat, ebuf, sizeof ebuf));
+	}
+
+	ep_thr_mutex_lock(&gcl->mutex);
+	rs = gcl->replset;
+	for (i = 0; rs != NULL && i < rs->nreplicas; i++)
+	{
+		if (GDP_NAME_SAME(rs->replicas[i].name, replica))
+			rs->replicas[i].failed = true;
+	}
+	ep_thr_mutex_unlock(&gcl->mutex);
+	return true;
+}
@@ -152,6 +152,10 @@ _gdp_req_new(int cmd,
 	req->stat = EP_STAT_OK;
 	req->flags = flags;
 	req->chan = chan;
+	req->stride = 1;
+	req->lastrec = 0;
+	req->bucket_ns = 0;
+	memset(req->replica, 0, sizeof req->replica);
 
 	// keep track of all outstanding requests on a channel
 	if (chan != NULL)
@@ -457,7 +461,11 @@ _gdp_req_find(gdp_gcl_t *gcl, gdp_rid_t rid)
 				estat = _gdp_req_lock(req);
 				EP_STAT_CHECK(estat, break);
 				nextreq = LIST_NEXT(req, gcllist);
-				if (req->pdu->rid == rid)
+
+				// server-side subscriptions never expect responses
+				// (in gdplogd they share the list with client requests)
+				if (req->pdu->rid == rid &&
+						!EP_UT_BITSET(GDP_REQ_SRV_SUBSCR, req->flags))
 					break;
 				_gdp_req_unlock(req);
 			}
@@ -514,6 +522,7 @@ static EP_PRFLAGS_DESC	ReqFlags[] =
 	{ GDP_REQ_ON_CHAN_LIST,	GDP_REQ_ON_CHAN_LIST,	"ON_CHAN_LIST"	},
 	{ GDP_REQ_CORE,			GDP_REQ_CORE,			"CORE"			},
 	{ GDP_REQ_ROUTEFAIL,	GDP_REQ_ROUTEFAIL,		"ROUTEFAIL"		},
+	{ GDP_REQ_DEFER_REPLY,	GDP_REQ_DEFER_REPLY,	"DEFER_REPLY"	},
 	{ 0,					0,						NULL			}
 };
 
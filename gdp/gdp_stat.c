@@ -79,6 +79,8 @@ static struct ep_stat_to_string Stats[] =
 	{ GDP_STAT_RECORD_EXPIRED,			"record expired",					},
 	{ GDP_STAT_DEAD_REQ,				"request freed while in use",		},
 	{ GDP_STAT_BAD_REFCNT,				"invalid reference count",			},
+	{ GDP_STAT_PDU_ALIAS_UNKNOWN,		"unknown pdu header alias",			},
+	{ GDP_STAT_PDU_DISCARDED,			"pdu discarded",					},
 
 	{ GDP_STAT_NAK_BADREQ,				"400 bad request",					},
 	{ GDP_STAT_NAK_UNAUTH,				"401 unauthorized",					},
@@ -68,6 +68,8 @@ static EP_STAT
 subscr_resub(gdp_req_t *req)
 {
 	EP_STAT estat;
+	gdp_name_t replica;
+	bool toreplica;
 
 	ep_dbg_cprintf(Dbg, 39, "subscr_resub: refreshing req@%p\n", req);
 
@@ -75,15 +77,34 @@ subscr_resub(gdp_req_t *req)
 	EP_ASSERT(req->pdu != NULL);
 	EP_ASSERT(req->pdu->datum == NULL);
 
-	req->state = GDP_REQ_ACTIVE;
-	req->pdu->cmd = GDP_CMD_SUBSCRIBE;
-	memcpy(req->pdu->dst, req->gcl->name, sizeof req->pdu->dst);
-	memcpy(req->pdu->src, _GdpMyRoutingName, sizeof req->pdu->src);
-	req->pdu->datum = gdp_datum_new();
-	req->pdu->datum->recno = req->gcl->nrecs + 1;
-	gdp_buf_put_uint32(req->pdu->datum->dbuf, req->numrecs);
-
-	estat = _gdp_invoke(req);
+	// stay with the same replica if it is still good enough; if it
+	// has gone bad, try other replicas and then the log itself
+	for (;;)
+	{
+		req->state = GDP_REQ_ACTIVE;
+		req->pdu->cmd = GDP_CMD_SUBSCRIBE;
+		memcpy(req->pdu->dst, req->gcl->name, sizeof req->pdu->dst);
+		memcpy(req->pdu->src, _GdpMyRoutingName, sizeof req->pdu->src);
+		req->pdu->datum = gdp_datum_new();
+		req->pdu->datum->recno = req->gcl->nrecs + 1;
+		gdp_buf_put_uint32(req->pdu->datum->dbuf, req->numrecs);
+
+		toreplica = _gdp_req_replica_redirect(req, req->replica);
+		if (toreplica)
+			memcpy(replica, req->pdu->dst, sizeof replica);
+
+		estat = _gdp_invoke(req);
+		if (EP_STAT_ISOK(estat) || !toreplica ||
+				!_gdp_replica_failed(req->gcl, replica, estat))
+			break;
+		if (req->pdu->datum != NULL)
+			gdp_datum_free(req->pdu->datum);
+		req->pdu->datum = NULL;
+	}
+	if (toreplica && EP_STAT_ISOK(estat))
+		memcpy(req->replica, replica, sizeof req->replica);
+	else if (EP_STAT_ISOK(estat))
+		memset(req->replica, 0, sizeof req->replica);
 
 	if (ep_dbg_test(Dbg, EP_STAT_ISOK(estat) ? 20 : 1))
 	{
@@ -190,17 +211,20 @@ subscr_poker_thread(void *chan_)
 
 
 /*
-**	_GDP_GCL_SUBSCRIBE --- subscribe to a GCL
+**	SUBSCR_COMMON --- common code for subscriptions and multireads
 **
-**		This also implements multiread based on the cmd parameter.
+**		The stride and bucket parameters are only sent if they
+**		differ from the defaults, so servers that predate sampled
+**		multireads still see the original PDU format.
 */
 
-EP_STAT
-_gdp_gcl_subscribe(gdp_gcl_t *gcl,
+static EP_STAT
+subscr_common(gdp_gcl_t *gcl,
 		int cmd,
 		gdp_recno_t start,
 		int32_t numrecs,
-		EP_TIME_SPEC *timeout,
+		int32_t stride,
+		EP_TIME_SPEC *bucket,
 		gdp_event_cbfunc_t cbfunc,
 		void *cbarg,
 		gdp_chan_t *chan,
@@ -208,6 +232,7 @@ _gdp_gcl_subscribe(gdp_gcl_t *gcl,
 {
 	EP_STAT estat = EP_STAT_OK;
 	gdp_req_t *req;
+	bool toreplica;
 
 	errno = 0;				// avoid spurious messages
 
@@ -215,20 +240,43 @@ _gdp_gcl_subscribe(gdp_gcl_t *gcl,
 
 	// certain flags are required
 	reqflags |= GDP_REQ_PERSIST | GDP_REQ_CLT_SUBSCR | GDP_REQ_ALLOC_RID;
-	estat = _gdp_req_new(cmd, gcl, chan, NULL, reqflags, &req);
-	EP_STAT_CHECK(estat, goto fail0);
 
-	// arrange for responses to appear as events or callbacks
-	_gdp_event_setcb(req, cbfunc, cbarg);
+	// try replicas (if allowed) until one works, then the log itself
+	for (;;)
+	{
+		estat = _gdp_req_new(cmd, gcl, chan, NULL, reqflags, &req);
+		EP_STAT_CHECK(estat, goto fail0);
+
+		// arrange for responses to appear as events or callbacks
+		_gdp_event_setcb(req, cbfunc, cbarg);
 
-	// add start and stop parameters to PDU
-	req->pdu->datum->recno = start;
-	req->numrecs = numrecs;
-	gdp_buf_put_uint32(req->pdu->datum->dbuf, numrecs);
+		// add start and stop parameters to PDU
+		req->pdu->datum->recno = start;
+		req->numrecs = numrecs;
+		gdp_buf_put_uint32(req->pdu->datum->dbuf, numrecs);
+		if (stride > 1 || bucket != NULL)
+		{
+			EP_TIME_SPEC nobucket = { 0, 0, 0.0 };
+
+			if (bucket == NULL)
+				bucket = &nobucket;
+			gdp_buf_put_uint32(req->pdu->datum->dbuf, stride);
+			gdp_buf_put_timespec(req->pdu->datum->dbuf, bucket);
+		}
+
+		toreplica = _gdp_req_replica_redirect(req, NULL);
+		if (toreplica)
+			memcpy(req->replica, req->pdu->dst, sizeof req->replica);
 
-	// issue the subscription --- no data returned
-	estat = _gdp_invoke(req);
-	EP_ASSERT(req->state == GDP_REQ_ACTIVE);
+		// issue the subscription --- no data returned
+		estat = _gdp_invoke(req);
+		EP_ASSERT(req->state == GDP_REQ_ACTIVE);
+
+		if (EP_STAT_ISOK(estat) || !toreplica ||
+				!_gdp_replica_failed(gcl, req->replica, estat))
+			break;
+		_gdp_req_free(&req);
+	}
 
 	if (!EP_STAT_ISOK(estat))
 	{
@@ -265,6 +313,59 @@ fail0:
 }
 
 
+/*
+**	_GDP_GCL_SUBSCRIBE --- subscribe to a GCL
+**
+**		This also implements multiread based on the cmd parameter.
+*/
+
+EP_STAT
+_gdp_gcl_subscribe(gdp_gcl_t *gcl,
+		int cmd,
+		gdp_recno_t start,
+		int32_t numrecs,
+		EP_TIME_SPEC *timeout,
+		gdp_event_cbfunc_t cbfunc,
+		void *cbarg,
+		gdp_chan_t *chan,
+		uint32_t reqflags)
+{
+	return subscr_common(gcl, cmd, start, numrecs, 1, NULL,
+					cbfunc, cbarg, chan, reqflags);
+}
+
+
+/*
+**	_GDP_GCL_MULTIREAD_SAMPLED --- read a sample of records from a GCL
+**
+**		Returns every stride'th record in the range [start,
+**		start + numrecs).  If bucket is set, the range is instead
+**		divided into time buckets of that width and the last record
+**		in each non-empty bucket is returned.  The sampling is done
+**		by the log server, so only the selected records cross the
+**		network.
+*/
+
+EP_STAT
+_gdp_gcl_multiread_sampled(gdp_gcl_t *gcl,
+		gdp_recno_t start,
+		int32_t numrecs,
+		int32_t stride,
+		EP_TIME_SPEC *bucket,
+		gdp_event_cbfunc_t cbfunc,
+		void *cbarg,
+		gdp_chan_t *chan,
+		uint32_t reqflags)
+{
+	if (stride < 1)
+		return GDP_STAT_NAK_BADOPT;
+	if (bucket != NULL && bucket->tv_sec <= 0 && bucket->tv_nsec <= 0)
+		bucket = NULL;
+	return subscr_common(gcl, GDP_CMD_MULTIREAD, start, numrecs,
+					stride, bucket, cbfunc, cbarg, chan, reqflags);
+}
+
+
 /*
 **  Unsubscribe all requests for a given gcl and destination.
 */
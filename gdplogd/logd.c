@@ -29,6 +29,7 @@
 */
 
 #include "logd.h"
+#include "logd_io.h"
 #include "logd_pubsub.h"
 
 #include <ep/ep_string.h>
@@ -55,9 +56,13 @@ static EP_DBG	Dbg = EP_DBG_INIT("gdplogd.main", "GDP Log Daemon");
 void
 logd_sock_close_cb(gdp_chan_t *chan)
 {
-	// free any requests tied to this channel
-	gdp_req_t *req = LIST_FIRST(&chan->reqs);
+	gdp_req_t *req;
+
+	// parked replica fetches mustn't reply on this channel
+	logd_repl_cancel(chan);
 
+	// free any requests tied to this channel
+	req = LIST_FIRST(&chan->reqs);
 	while (req != NULL)
 	{
 		gdp_req_t *req2 = LIST_NEXT(req, chanlist);
@@ -126,6 +131,8 @@ dump_state(int plev)
 	_gdp_gcl_cache_dump(plev, stderr);
 	fprintf(stderr, "\n<<< Open file descriptors >>>\n");
 	ep_app_dumpfds(stderr);
+	append_stats_dump(stderr);
+	logd_repl_dump(stderr);
 }
 
 #ifndef SIGINFO
@@ -305,16 +312,30 @@ main(int argc, char **argv)
 	estat = gdp_lib_init(myname);
 	EP_STAT_CHECK(estat, goto fail0);
 
-	// initialize physical logs (expand this if multiple log implementations)
+	// initialize physical logs
+	phase = "physical I/O engine";
+	estat = logd_io_init();
+	EP_STAT_CHECK(estat, goto fail0);
 	phase = "gcl physlog";
 	estat = GdpDiskImpl.init();
 	EP_STAT_CHECK(estat, goto fail0);
+	phase = "gcl memlog";
+	estat = GdpMemImpl.init();
+	EP_STAT_CHECK(estat, goto fail0);
+	phase = "gcl seglog";
+	estat = GdpSegImpl.init();
+	EP_STAT_CHECK(estat, goto fail0);
 
 	// initialize the protocol module
 	phase = "gdplogd protocol module";
 	estat = gdpd_proto_init();
 	EP_STAT_CHECK(estat, goto fail0);
 
+	// find out what logs we replicate from elsewhere
+	phase = "replication config";
+	estat = logd_repl_init();
+	EP_STAT_CHECK(estat, goto fail0);
+
 	progname = ep_app_getprogname();
 
 	// print our name as a reminder
@@ -361,6 +382,9 @@ main(int argc, char **argv)
 	// initialize the thread pool
 	ep_thr_pool_init(nworkers, nworkers, 0);
 
+	// start opening the logs we are most likely to need soon
+	gcl_prewarm();
+
 	// add a debugging signal to print out some internal data structures
 	event_add(evsignal_new(GdpIoEventBase, SIGINFO, siginfo, NULL), NULL);
 
@@ -390,7 +414,7 @@ main(int argc, char **argv)
 	estat = _gdp_chan_open(router_addr, _gdp_pdu_process, &_GdpChannel);
 	EP_STAT_CHECK(estat, goto fail0);
 	_GdpChannel->close_cb = &logd_sock_close_cb;
-	_GdpChannel->advertise = &logd_advertise_all;
+	_GdpChannel->advertise = &logd_readvertise;
 
 	// start the event loop
 	phase = "start event loop";
@@ -402,6 +426,11 @@ main(int argc, char **argv)
 	estat = logd_advertise_all(GDP_CMD_ADVERTISE);
 	EP_STAT_CHECK(estat, goto fail0);
 
+	// start following the logs we replicate
+	phase = "start replication";
+	estat = logd_repl_start();
+	EP_STAT_CHECK(estat, goto fail0);
+
 	// arrange for clean shutdown
 	atexit(&logd_shutdown);
 
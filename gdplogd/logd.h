@@ -72,6 +72,18 @@ struct gdp_gcl_xtra
 	uint16_t				n_md_entries;	// number of metadata entries
 	uint16_t				log_type;		// from log header
 
+	// metadata cached at open (immutable after create)
+	uint8_t					*md_wire;		// serialized (wire) form of gclmd
+	size_t					md_wirelen;		// length of md_wire
+	EP_CRYPTO_KEY			*pubkey;		// public key from metadata
+
+	// appends are verified in parallel but committed in recno order
+	EP_THR_MUTEX			append_mutex;	// digest setup and commit
+	EP_THR_COND				append_cond;	// signaled after each commit
+
+	// replica fetches waiting for appends (see logd_repl.c)
+	struct repl_wait		*repl_waits;	// protected by FetchMutex
+
 	// physical implementation declarations
 	struct gcl_phys_impl	*physimpl;		// physical implementation
 	gcl_physinfo_t			*physinfo;		// info needed by physical module
@@ -95,6 +107,9 @@ extern EP_STAT	gcl_open(				// open an existing physical GCL
 extern void		gcl_close(				// close an open GCL
 					gdp_gcl_t *gcl);
 
+extern EP_STAT	gcl_load_metadata(		// cache metadata in memory
+					gdp_gcl_t *gcl);
+
 extern void		gcl_touch(				// make a GCL recently used
 					gdp_gcl_t *gcl);
 
@@ -105,8 +120,23 @@ extern EP_STAT	get_open_handle(		// get open handle (pref from cache)
 					gdp_req_t *req,
 					gdp_iomode_t iomode);
 
+extern EP_STAT	gcl_get_open(			// same, by name (no request)
+					gdp_name_t gcl_name,
+					gdp_iomode_t iomode,
+					gdp_gcl_t **pgcl);
+
 extern void		gcl_reclaim_resources(void);	// reclaim old GCLs
 
+extern void		gcl_prewarm(void);		// open recently used GCLs
+
+extern struct gcl_phys_impl
+				*gcl_physimpl_select(	// choose physimpl for new GCL
+					gdp_gclmd_t *gmd);
+
+extern struct gcl_phys_impl
+				*gcl_physimpl_find(		// find physimpl holding GCL
+					gdp_name_t gcl_name);
+
 
 /*
 **  Definitions for the protocol module
@@ -114,6 +144,9 @@ extern void		gcl_reclaim_resources(void);	// reclaim old GCLs
 
 extern EP_STAT	gdpd_proto_init(void);	// initialize protocol module
 
+extern void		append_stats_dump(		// print append verification stats
+					FILE *fp);
+
 extern EP_STAT	dispatch_cmd(			// dispatch a request
 					gdp_req_t *req);
 
@@ -124,6 +157,8 @@ extern EP_STAT	dispatch_cmd(			// dispatch a request
 
 extern EP_STAT	logd_advertise_all(int cmd);
 
+extern EP_STAT	logd_readvertise(int cmd);
+
 extern void		logd_advertise_one(gdp_name_t name, int cmd);
 
 extern void		sub_send_message_notification(
@@ -131,6 +166,46 @@ extern void		sub_send_message_notification(
 					gdp_datum_t *datum,
 					int cmd);
 
+/*
+**  Replication (see logd_repl.c)
+*/
+
+extern EP_STAT	logd_repl_init(void);	// read replication config
+
+extern EP_STAT	logd_repl_start(void);	// start replicating
+
+extern bool		logd_repl_is_replica(	// do we follow this log?
+					gdp_name_t gcl_name);
+
+extern EP_STAT	logd_repl_staleness(	// how stale is our replica?
+					gdp_name_t gcl_name,
+					uint32_t *stalemsp);
+
+extern void		logd_repl_note_read(void);	// count a replica read
+
+extern void		logd_repl_note_follower(	// leader: record a follower
+					gdp_name_t gcl_name,
+					gdp_name_t follower,
+					gdp_recno_t recno,
+					uint32_t stalems,
+					uint32_t load);
+
+extern void		logd_repl_list_followers(	// leader: list followers
+					gdp_name_t gcl_name,
+					gdp_buf_t *obuf);
+
+extern EP_STAT	logd_repl_fetch(		// leader: answer or park a fetch
+					gdp_req_t *req);
+
+extern void		logd_repl_wake(			// leader: log has new records
+					gdp_gcl_t *gcl);
+
+extern void		logd_repl_cancel(		// leader: forget fetches on chan
+					gdp_chan_t *chan);
+
+extern void		logd_repl_dump(			// print replication status
+					FILE *fp);
+
 /*
 **  Physical Implementation --- these are the routines that implement the
 **			on-disk (or in-memory) structure.
@@ -152,6 +227,11 @@ struct gcl_phys_impl
 	EP_STAT		(*append)(
 						gdp_gcl_t *gcl,
 						gdp_datum_t *datum);
+	EP_STAT		(*appendv)(				// optional: may be NULL
+						gdp_gcl_t *gcl,
+						gdp_datum_t **datums,
+						int ndatums,
+						int *nwrittenp);
 	EP_STAT		(*getmetadata)(
 						gdp_gcl_t *gcl,
 						gdp_gclmd_t **gmdp);
@@ -162,9 +242,27 @@ struct gcl_phys_impl
 							gdp_name_t name,
 							void *ctx),
 						void *ctx);
+	EP_STAT		(*getmtime)(
+						gdp_name_t name,
+						EP_TIME_SPEC *mtime);
+	EP_STAT		(*snapshot)(			// optional: may be NULL
+						gdp_gcl_t *gcl,
+						const char *label,
+						gdp_recno_t *recnop);
+	EP_STAT		(*gettimestamp)(		// optional: may be NULL
+						gdp_gcl_t *gcl,
+						gdp_recno_t recno,
+						EP_TIME_SPEC *tsp);
+	EP_STAT		(*getchain)(			// optional: may be NULL
+						gdp_gcl_t *gcl,
+						gdp_recno_t recno,
+						int *algp,
+						uint8_t *link);
 };
 
 // known implementations
 extern struct gcl_phys_impl		GdpDiskImpl;
+extern struct gcl_phys_impl		GdpMemImpl;
+extern struct gcl_phys_impl		GdpSegImpl;
 
 #endif //_GDPLOG_LOGD_H_
@@ -37,6 +37,10 @@
 #include <gdp/gdp_priv.h>
 
 #include <ep/ep_dbg.h>
+#include <ep/ep_log.h>
+#include <ep/ep_time.h>
+
+#include <pthread.h>
 
 
 static EP_DBG	Dbg = EP_DBG_INIT("gdplogd.advertise",
@@ -45,13 +49,35 @@ static EP_DBG	Dbg = EP_DBG_INIT("gdplogd.advertise",
 
 /*
 **  Advertise all known GCLs
+**
+**		The names are collected first and then sent in PDUs of
+**		at most swarm.gdplogd.advertise.maxnames names each, with
+**		a pause between them so that a daemon holding many logs
+**		doesn't monopolize the channel or swamp the router.
+**
+**		A router forgets our advertisements when the connection
+**		drops, and doesn't acknowledge them, so every new
+**		connection gets the complete list.  Only one list is
+**		sent at a time.
 */
 
+static EP_THR_MUTEX		AdvMutex	EP_THR_MUTEX_INITIALIZER;
+
+struct advnames
+{
+	gdp_name_t	*names;		// the names to advertise
+	size_t		n;			// number in use
+	size_t		alloc;		// number allocated
+};
+
 static void
 adv_addone(gdp_name_t gname, void *ctx)
 {
-	gdp_buf_t *b = ctx;
-	int i;
+	struct advnames *an = ctx;
+
+	// the leader advertises replicated logs, not us
+	if (logd_repl_is_replica(gname))
+		return;
 
 	if (ep_dbg_test(Dbg, 54))
 	{
@@ -60,24 +86,88 @@ adv_addone(gdp_name_t gname, void *ctx)
 		ep_dbg_printf("\tAdvertise %s\n", gdp_printable_name(gname, pname));
 	}
 
-	i = gdp_buf_write(b, gname, sizeof (gdp_name_t));
-	if (i < 0)
-		ep_dbg_cprintf(Dbg, 1, "logd_adv_addone: gdp_buf_write failure\n");
+	if (an->n >= an->alloc)
+	{
+		an->alloc = an->alloc == 0 ? 256 : an->alloc * 2;
+		an->names = ep_mem_realloc(an->names,
+							an->alloc * sizeof an->names[0]);
+	}
+	memcpy(an->names[an->n++], gname, sizeof an->names[0]);
 }
 
 
+struct advchunk
+{
+	gdp_name_t	*names;		// first name in this PDU
+	size_t		n;			// number of names in this PDU
+};
+
 static EP_STAT
-advertise_all(gdp_buf_t *dbuf, void *ctx, int cmd)
+advertise_chunk(gdp_buf_t *dbuf, void *ctx, int cmd)
 {
-	GdpDiskImpl.foreach(adv_addone, dbuf);
+	struct advchunk *ac = ctx;
+
+	if (gdp_buf_write(dbuf, ac->names, ac->n * sizeof ac->names[0]) < 0)
+	{
+		ep_dbg_cprintf(Dbg, 1, "advertise_chunk: gdp_buf_write failure\n");
+		return EP_STAT_OUT_OF_MEMORY;
+	}
 	return EP_STAT_OK;
 }
 
 
+static EP_STAT
+advertise_names(struct advnames *an, int cmd)
+{
+	EP_STAT estat = EP_STAT_OK;
+	struct advchunk ac;
+	size_t maxnames;
+	long pace;
+	size_t i;
+
+	maxnames = ep_adm_getlongparam("swarm.gdplogd.advertise.maxnames", 1024);
+	if (maxnames <= 0)
+		maxnames = 1;
+	pace = ep_adm_getlongparam("swarm.gdplogd.advertise.pace", 10);
+
+	// always send at least one PDU so the router learns about us
+	i = 0;
+	do
+	{
+		ac.names = &an->names[i];
+		ac.n = an->n - i;
+		if (ac.n > maxnames)
+			ac.n = maxnames;
+		if (i > 0 && pace > 0)
+			ep_time_nanosleep(pace * INT64_C(1000000));
+		estat = _gdp_advertise(advertise_chunk, &ac, cmd);
+		EP_STAT_CHECK(estat, break);
+		i += ac.n;
+	} while (i < an->n);
+
+	ep_dbg_cprintf(Dbg, 11, "advertise_names: %zd of %zd names in %zd PDUs\n",
+			i, an->n, (i + maxnames - 1) / maxnames);
+	return estat;
+}
+
+
 EP_STAT
 logd_advertise_all(int cmd)
 {
-	EP_STAT estat = _gdp_advertise(advertise_all, NULL, cmd);
+	EP_STAT estat;
+	struct advnames an;
+
+	memset(&an, 0, sizeof an);
+	GdpDiskImpl.foreach(adv_addone, &an);
+	GdpMemImpl.foreach(adv_addone, &an);
+	GdpSegImpl.foreach(adv_addone, &an);
+
+	ep_thr_mutex_lock(&AdvMutex);
+	estat = advertise_names(&an, cmd);
+	ep_thr_mutex_unlock(&AdvMutex);
+	if (an.names != NULL)
+		ep_mem_free(an.names);
+
 	if (ep_dbg_test(Dbg, 10))
 	{
 		char ebuf[100];
@@ -89,6 +179,43 @@ logd_advertise_all(int cmd)
 }
 
 
+/*
+**  Re-advertise after the router connection is re-established
+**
+**		This is called from the event loop, which has to keep
+**		running while the advertisement PDUs are sent and paced,
+**		so the work is done in a thread of its own.
+*/
+
+static void *
+readvertise_thread(void *arg)
+{
+	(void) logd_advertise_all(GDP_CMD_ADVERTISE);
+	return NULL;
+}
+
+EP_STAT
+logd_readvertise(int cmd)
+{
+	pthread_t thr;
+	int err;
+
+	if (cmd != GDP_CMD_ADVERTISE)
+		return logd_advertise_all(cmd);
+
+	err = pthread_create(&thr, NULL, readvertise_thread, NULL);
+	if (err != 0)
+	{
+		// better to stall the event loop than to stay unreachable
+		ep_log(ep_stat_from_errno(err),
+				"logd_readvertise: cannot start thread");
+		return logd_advertise_all(cmd);
+	}
+	pthread_detach(thr);
+	return EP_STAT_OK;
+}
+
+
 /*
 **  Advertise a new GCL
 */
@@ -0,0 +1,459 @@
+/* vim: set ai sw=4 sts=4 ts=4 : */
+
+/*
+**	----- BEGIN LICENSE BLOCK -----
+**	GDPLOGD: Log Daemon for the Global Data Plane
+**	From the Ubiquitous Swarm Lab, 490 Cory Hall, U.C. Berkeley.
+**
+**	Copyright (c) 2015, Regents of the University of California.
+**	All rights reserved.
+**
+**	Permission is hereby granted, without written agreement and without
+**	license or royalty fees, to use, copy, modify, and distribute this
+**	software and its documentation for any purpose, provided that the above
+**	copyright notice and the following two paragraphs appear in all copies
+**	of this software.
+**
+**	IN NO EVENT SHALL REGENTS BE LIABLE TO ANY PARTY FOR DIRECT, INDIRECT,
+**	SPECIAL, INCIDENTAL, OR CONSEQUENTIAL DAMAGES, INCLUDING LOST
+**	PROFITS, ARISING OUT OF THE USE OF THIS SOFTWARE AND ITS DOCUMENTATION,
+**	EVEN IF REGENTS HAS BEEN ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+**
+**	REGENTS SPECIFICALLY DISCLAIMS ANY WARRANTIES, INCLUDING, BUT NOT
+**	LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+**	FOR A PARTICULAR PURPOSE. THE SOFTWARE AND ACCOMPANYING DOCUMENTATION,
+**	IF ANY, PROVIDED HEREUNDER IS PROVIDED "AS IS". REGENTS HAS NO
+**	OBLIGATION TO PROVIDE MAINTENANCE, SUPPORT, UPDATES, ENHANCEMENTS,
+**	OR MODIFICATIONS.
+**	----- END LICENSE BLOCK -----
+*/
+
+
+
+/*
+**  Block cache for direct I/O (see logd_bcache.h).
+**
+**		Replacement uses the "2Q" algorithm.  Blocks read for
+**		the first time go on a FIFO (A1in).  When they drop off
+**		the end of that their keys (but not their data) are kept
+**		for a while on a ghost list (A1out).  A block that is
+**		wanted again while its key is still there is put on the
+**		main LRU list (Am).  A long sequential scan therefore
+**		only churns A1in and can't push out blocks that are
+**		really being reused, which is the problem with letting
+**		the page cache handle both.
+**
+**		One mutex covers everything.  It is not held during I/O,
+**		so two threads may load the same block at once; the
+**		second one to finish just discards its copy.
+*/
+
+#include "logd.h"
+#include "logd_bcache.h"
+#include "logd_io.h"
+
+#include <ep/ep_hash.h>
+#include <ep/ep_thr.h>
+
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+
+static EP_DBG	Dbg = EP_DBG_INIT("gdplogd.bcache", "GDP Log Daemon Block Cache");
+
+struct bckey
+{
+	uint64_t		fileid;		// from bcache_newfile
+	uint64_t		blkno;		// offset / BCACHE_BLKSIZE
+};
+
+#define BQ_A1IN		1			// seen once, has data
+#define BQ_AM		2			// seen more than once, has data
+#define BQ_A1OUT	3			// ghost (no data)
+
+struct bcblock
+{
+	struct bckey	key;		// must be first
+	TAILQ_ENTRY(bcblock)	list;	// on one of the queues
+	int				queue;		// which one (BQ_*)
+	size_t			valid;		// number of bytes of data
+	uint8_t			*data;		// BCACHE_BLKSIZE (NULL if ghost)
+};
+
+TAILQ_HEAD(bcqueue, bcblock);
+
+static EP_THR_MUTEX		BcMutex		EP_THR_MUTEX_INITIALIZER;
+static EP_HASH			*BcHash;		// struct bckey -> struct bcblock
+static struct bcqueue	A1in = TAILQ_HEAD_INITIALIZER(A1in);
+static struct bcqueue	Am = TAILQ_HEAD_INITIALIZER(Am);
+static struct bcqueue	A1out = TAILQ_HEAD_INITIALIZER(A1out);
+static size_t			NA1in;			// blocks on A1in
+static size_t			NAm;			// blocks on Am
+static size_t			NA1out;			// ghosts on A1out
+static size_t			MaxBlocks;		// budget (0 => no cache)
+static size_t			KIn;			// target size of A1in
+static size_t			KOut;			// max size of A1out
+static uint64_t			NextFileId;		// next bcache_newfile value
+static uint64_t			Hits;			// for debugging
+static uint64_t			Misses;
+
+
+/*
+**  BCACHE_INIT --- set up the cache
+**
+**		The budget is in bytes.  A quarter of it goes to blocks
+**		that have only been seen once; ghosts are kept for half
+**		as many blocks as fit.
+*/
+
+EP_STAT
+bcache_init(size_t budget)
+{
+	MaxBlocks = budget / BCACHE_BLKSIZE;
+	if (MaxBlocks == 0)
+		return EP_STAT_OK;
+	KIn = MaxBlocks / 4;
+	if (KIn == 0)
+		KIn = 1;
+	KOut = MaxBlocks / 2;
+	BcHash = ep_hash_new("block cache", NULL, 0);
+	if (BcHash == NULL)
+	{
+		MaxBlocks = 0;
+		return EP_STAT_OUT_OF_MEMORY;
+	}
+	ep_dbg_cprintf(Dbg, 8, "bcache_init: %zd blocks of %d bytes\n",
+			MaxBlocks, BCACHE_BLKSIZE);
+	return EP_STAT_OK;
+}
+
+
+bool
+bcache_enabled(void)
+{
+	return MaxBlocks > 0;
+}
+
+
+uint64_t
+bcache_newfile(void)
+{
+	uint64_t id;
+
+	ep_thr_mutex_lock(&BcMutex);
+	id = ++NextFileId;
+	ep_thr_mutex_unlock(&BcMutex);
+	return id;
+}
+
+
+/*
+**  Queue manipulation.  The caller must hold BcMutex.
+*/
+
+static struct bcqueue *
+bq_head(int queue)
+{
+	switch (queue)
+	{
+	  case BQ_A1IN:
+		return &A1in;
+	  case BQ_AM:
+		return &Am;
+	  default:
+		return &A1out;
+	}
+}
+
+static size_t *
+bq_count(int queue)
+{
+	switch (queue)
+	{
+	  case BQ_A1IN:
+		return &NA1in;
+	  case BQ_AM:
+		return &NAm;
+	  default:
+		return &NA1out;
+	}
+}
+
+static void
+bq_remove(struct bcblock *b)
+{
+	TAILQ_REMOVE(bq_head(b->queue), b, list);
+	(*bq_count(b->queue))--;
+}
+
+static void
+bq_insert(struct bcblock *b, int queue)
+{
+	b->queue = queue;
+	TAILQ_INSERT_HEAD(bq_head(queue), b, list);
+	(*bq_count(queue))++;
+}
+
+static void
+bc_free(struct bcblock *b)
+{
+	bq_remove(b);
+	(void) ep_hash_delete(BcHash, sizeof b->key, &b->key);
+	if (b->data != NULL)
+		free(b->data);
+	ep_mem_free(b);
+}
+
+
+/*
+**  BC_RECLAIM --- make room for one more block
+*/
+
+static void
+bc_reclaim(void)
+{
+	struct bcblock *b;
+
+	if (NA1in + NAm < MaxBlocks)
+		return;
+
+	if (NA1in > KIn || NAm == 0)
+	{
+		// oldest once-seen block becomes a ghost
+		b = TAILQ_LAST(&A1in, bcqueue);
+		bq_remove(b);
+		free(b->data);
+		b->data = NULL;
+		b->valid = 0;
+		bq_insert(b, BQ_A1OUT);
+		if (NA1out > KOut)
+			bc_free(TAILQ_LAST(&A1out, bcqueue));
+	}
+	else
+	{
+		// least recently used of the rest is just dropped
+		bc_free(TAILQ_LAST(&Am, bcqueue));
+	}
+}
+
+
+/*
+**  BC_INSTALL --- put freshly loaded data into the cache
+**
+**		Takes ownership of data.  Returns the block it ended up in.
+*/
+
+static struct bcblock *
+bc_install(struct bckey *key, uint8_t *data, size_t valid)
+{
+	struct bcblock *b;
+
+	b = ep_hash_search(BcHash, sizeof *key, key);
+	if (b != NULL && b->data != NULL)
+	{
+		// already there (someone else loaded it); keep the longer one
+		if (valid > b->valid)
+		{
+			free(b->data);
+			b->data = data;
+			b->valid = valid;
+		}
+		else
+		{
+			free(data);
+		}
+		return b;
+	}
+
+	if (b != NULL)
+	{
+		// a ghost: it has been wanted before, so it is worth keeping
+		// (take it off A1out first so reclaiming can't free it)
+		bq_remove(b);
+		bc_reclaim();
+		b->data = data;
+		b->valid = valid;
+		bq_insert(b, BQ_AM);
+		return b;
+	}
+
+	bc_reclaim();
+	b = ep_mem_zalloc(sizeof *b);
+	b->key = *key;
+	b->data = data;
+	b->valid = valid;
+	bq_insert(b, BQ_A1IN);
+	(void) ep_hash_insert(BcHash, sizeof b->key, &b->key, b);
+	return b;
+}
+
+
+/*
+**  BCACHE_READ --- read from a file through the cache
+**
+**		fd may be opened with O_DIRECT; reads from it are always
+**		whole, aligned blocks.  Returns the number of bytes read,
+**		which will be short at end of file, or -1 on error.
+*/
+
+ssize_t
+bcache_read(uint64_t fileid, int fd, void *buf, size_t len, off_t off)
+{
+	size_t done = 0;
+
+	EP_ASSERT(MaxBlocks > 0);
+	while (done < len)
+	{
+		struct bckey key;
+		struct bcblock *b;
+		size_t boff;
+		size_t n;
+
+		key.fileid = fileid;
+		key.blkno = (off + done) / BCACHE_BLKSIZE;
+		boff = (off + done) % BCACHE_BLKSIZE;
+		n = len - done;
+		if (n > BCACHE_BLKSIZE - boff)
+			n = BCACHE_BLKSIZE - boff;
+
+		ep_thr_mutex_lock(&BcMutex);
+		b = ep_hash_search(BcHash, sizeof key, &key);
+		if (b == NULL || b->data == NULL || b->valid < boff + n)
+		{
+			uint8_t *data;
+			ssize_t nread;
+
+			// not there (or not all of it): load the block
+			Misses++;
+			ep_thr_mutex_unlock(&BcMutex);
+			if (posix_memalign((void **) &data, BCACHE_ALIGN,
+						BCACHE_BLKSIZE) != 0)
+			{
+				errno = ENOMEM;
+				return -1;
+			}
+			nread = logd_io_pread(fd, data, BCACHE_BLKSIZE,
+						(off_t) key.blkno * BCACHE_BLKSIZE);
+			if (nread < 0)
+			{
+				ep_dbg_cprintf(Dbg, 1, "bcache_read: block %" PRIu64
+						": %s\n", key.blkno, strerror(errno));
+				free(data);
+				return done > 0 ? (ssize_t) done : -1;
+			}
+			ep_thr_mutex_lock(&BcMutex);
+			b = bc_install(&key, data, nread);
+		}
+		else
+		{
+			Hits++;
+			if (b->queue == BQ_AM)
+			{
+				bq_remove(b);
+				bq_insert(b, BQ_AM);
+			}
+		}
+
+		// copy out what we need (might be short at EOF)
+		if (b->valid < boff + n)
+			n = b->valid > boff ? b->valid - boff : 0;
+		memcpy((uint8_t *) buf + done, b->data + boff, n);
+		ep_thr_mutex_unlock(&BcMutex);
+		done += n;
+		if (n == 0)
+			break;
+	}
+
+	ep_dbg_cprintf(Dbg, 44, "bcache_read(%" PRIu64 ", %jd, %zd) => %zd"
+			" (%" PRIu64 " hits, %" PRIu64 " misses)\n",
+			fileid, (intmax_t) off, len, done, Hits, Misses);
+	return done;
+}
+
+
+/*
+**  BCACHE_WRITE --- add newly appended data to the cache
+**
+**		Data is only added where the block's earlier contents
+**		are already known: either the block is in the cache and
+**		this continues it, or this starts a new block.
+*/
+
+void
+bcache_write(uint64_t fileid, const void *buf, size_t len, off_t off)
+{
+	size_t done = 0;
+
+	if (MaxBlocks == 0)
+		return;
+
+	ep_thr_mutex_lock(&BcMutex);
+	while (done < len)
+	{
+		struct bckey key;
+		struct bcblock *b;
+		size_t boff;
+		size_t n;
+
+		key.fileid = fileid;
+		key.blkno = (off + done) / BCACHE_BLKSIZE;
+		boff = (off + done) % BCACHE_BLKSIZE;
+		n = len - done;
+		if (n > BCACHE_BLKSIZE - boff)
+			n = BCACHE_BLKSIZE - boff;
+
+		b = ep_hash_search(BcHash, sizeof key, &key);
+		if (b != NULL && b->data != NULL && b->valid == boff)
+		{
+			memcpy(b->data + boff, (const uint8_t *) buf + done, n);
+			b->valid += n;
+		}
+		else if ((b == NULL || b->data == NULL) && boff == 0)
+		{
+			uint8_t *data;
+
+			if (posix_memalign((void **) &data, BCACHE_ALIGN,
+						BCACHE_BLKSIZE) != 0)
+				break;
+			memcpy(data, (const uint8_t *) buf + done, n);
+			(void) bc_install(&key, data, n);
+		}
+		done += n;
+	}
+	ep_thr_mutex_unlock(&BcMutex);
+}
+
+
+/*
+**  BCACHE_FORGET --- drop everything about a file
+**
+**		Called when a file is closed for good.  This has to look
+**		at every block, but that's rare.
+*/
+
+static void
+bc_forget_queue(struct bcqueue *q, uint64_t fileid)
+{
+	struct bcblock *b;
+	struct bcblock *next;
+
+	for (b = TAILQ_FIRST(q); b != NULL; b = next)
+	{
+		next = TAILQ_NEXT(b, list);
+		if (b->key.fileid == fileid)
+			bc_free(b);
+	}
+}
+
+void
+bcache_forget(uint64_t fileid)
+{
+	if (MaxBlocks == 0)
+		return;
+
+	ep_thr_mutex_lock(&BcMutex);
+	bc_forget_queue(&A1in, fileid);
+	bc_forget_queue(&Am, fileid);
+	bc_forget_queue(&A1out, fileid);
+	ep_thr_mutex_unlock(&BcMutex);
+}
@@ -0,0 +1,83 @@
+/* vim: set ai sw=4 sts=4 ts=4 : */
+
+/*
+**	----- BEGIN LICENSE BLOCK -----
+**	GDPLOGD: Log Daemon for the Global Data Plane
+**	From the Ubiquitous Swarm Lab, 490 Cory Hall, U.C. Berkeley.
+**
+**	Copyright (c) 2015, Regents of the University of California.
+**	All rights reserved.
+**
+**	Permission is hereby granted, without written agreement and without
+**	license or royalty fees, to use, copy, modify, and distribute this
+**	software and its documentation for any purpose, provided that the above
+**	copyright notice and the following two paragraphs appear in all copies
+**	of this software.
+**
+**	IN NO EVENT SHALL REGENTS BE LIABLE TO ANY PARTY FOR DIRECT, INDIRECT,
+**	SPECIAL, INCIDENTAL, OR CONSEQUENTIAL DAMAGES, INCLUDING LOST
+**	PROFITS, ARISING OUT OF THE USE OF THIS SOFTWARE AND ITS DOCUMENTATION,
+**	EVEN IF REGENTS HAS BEEN ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+**
+**	REGENTS SPECIFICALLY DISCLAIMS ANY WARRANTIES, INCLUDING, BUT NOT
+**	LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+**	FOR A PARTICULAR PURPOSE. THE SOFTWARE AND ACCOMPANYING DOCUMENTATION,
+**	IF ANY, PROVIDED HEREUNDER IS PROVIDED "AS IS". REGENTS HAS NO
+**	OBLIGATION TO PROVIDE MAINTENANCE, SUPPORT, UPDATES, ENHANCEMENTS,
+**	OR MODIFICATIONS.
+**	----- END LICENSE BLOCK -----
+*/
+
+
+#ifndef _GDPLOGD_BCACHE_H_
+#define _GDPLOGD_BCACHE_H_		1
+
+#include <ep/ep.h>
+#include <ep/ep_stat.h>
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <sys/types.h>
+
+/*
+**  Block cache for direct I/O.
+**
+**		When extents are read with O_DIRECT the kernel no longer
+**		caches them, so gdplogd keeps its own cache of fixed size
+**		blocks, bounded by a memory budget.  Blocks are keyed by
+**		a file id from bcache_newfile and the block number.
+**		Recently appended data can be put into the cache as well,
+**		since it is the most likely to be read.
+**
+**		Files are assumed to be append-only: the bytes in a block
+**		never change, although a block at the end of a file may
+**		grow.
+*/
+
+#define BCACHE_BLKSIZE		(64 * 1024)		// size of cached blocks
+#define BCACHE_ALIGN		4096			// O_DIRECT buffer alignment
+
+extern EP_STAT	bcache_init(				// set up cache
+					size_t budget);
+
+extern bool		bcache_enabled(void);		// is there a cache?
+
+extern uint64_t	bcache_newfile(void);		// get an id for a file
+
+extern ssize_t	bcache_read(				// read through cache
+					uint64_t fileid,
+					int fd,
+					void *buf,
+					size_t len,
+					off_t off);
+
+extern void		bcache_write(				// note data appended to file
+					uint64_t fileid,
+					const void *buf,
+					size_t len,
+					off_t off);
+
+extern void		bcache_forget(				// drop all blocks for a file
+					uint64_t fileid);
+
+#endif //_GDPLOGD_BCACHE_H_
@@ -34,16 +34,22 @@
 */
 
 #include "logd.h"
+#include "logd_bcache.h"
 #include "logd_disklog.h"
+#include "logd_io.h"
 
 #include <gdp/gdp_buf.h>
 #include <gdp/gdp_gclmd.h>
+#include <gdp/gdp_hashchain.h>
 
+#include <ep/ep_compress.h>
+#include <ep/ep_crc32c.h>
 #include <ep/ep_hash.h>
 #include <ep/ep_log.h>
 #include <ep/ep_mem.h>
 #include <ep/ep_net.h>
 #include <ep/ep_thr.h>
+#include <ep/ep_varint.h>
 
 #include <sys/file.h>
 #include <sys/stat.h>
@@ -65,6 +71,36 @@ static EP_DBG	Dbg = EP_DBG_INIT("gdplogd.physlog", "GDP Log Daemon Physical Log"
 #define GCL_PATH_MAX		200		// max length of pathname
 
 static const char	*GCLDir;		// the gcl data directory
+static const char	*SnapshotDir;	// where snapshots are made
+
+// the open file cache
+static TAILQ_HEAD(fdcache_head, fdcache_ent)
+					FdCacheLru = TAILQ_HEAD_INITIALIZER(FdCacheLru);
+static EP_THR_MUTEX	FdCacheMutex	EP_THR_MUTEX_INITIALIZER;
+static long			FdCacheCount;	// number of files currently open
+static long			FdCacheMax;		// budget for open files
+
+static bool			WriteChecksums;	// add checksums to new records
+static bool			VerifyChecksums;	// check checksums on read
+static int			RecHashAlg;		// chain/data hash alg (0 = none)
+static bool			CompactIndex;	// create indexes in block format
+static bool			ConvertIndex;	// convert old indexes on open
+static bool			CompactRecords;	// new extents use compact headers
+static int			CompressAlg;	// compress new records (0 = no)
+static int			CompressLevel;	// compression level (zstd)
+static size_t		CompressMinSize;	// don't compress smaller records
+static unsigned int	CompressDictSamples;	// records to train dict on
+static size_t		CompressDictSize;	// max size of trained dict
+static bool			UseManifest;	// enumerate logs from manifest
+static bool			RebuildManifest;	// rebuild manifest at startup
+static off_t		PreallocExtent;	// extent preallocation chunk
+static off_t		PreallocIndex;	// index preallocation chunk
+static off_t		PreallocThreshold;	// don't preallocate smaller files
+static off_t		WriteBehind;	// start writeback after this much
+static bool			AdviseSequential;	// extents are mostly read in order
+static bool			DirectIO;		// read extents with O_DIRECT
+static size_t		TailMaxBytes;	// budget for tail cache (0 = none)
+static unsigned int	TailSlots;		// records in each log's tail cache
 
 #define GETPHYS(gcl)	((gcl)->x->physinfo)
 
@@ -72,6 +108,9 @@ static const char	*GCLDir;		// the gcl data directory
 
 /*
 **  FSIZEOF --- return the size of a file
+**
+**		Space preallocated by file_prepare_append does not change
+**		the file size, so this is also the logical end of data.
 */
 
 static off_t
@@ -92,6 +131,116 @@ fsizeof(FILE *fp)
 }
 
 
+/*
+**  FILE_PREPARE_APPEND --- make room for an append
+**
+**		Preallocates space in chunks so that the file doesn't
+**		fragment as it grows a record at a time.  The chunk is
+**		a fraction of the file's size, between PREALLOC_MINCHUNK
+**		and maxchunk, and files smaller than PreallocThreshold
+**		get none at all, so a host with many small logs doesn't
+**		reserve much space it will never use.  The space is
+**		reserved past end of file (see logd_io_prealloc), so the
+**		file size still marks the end of valid data and O_APPEND
+**		writes still go to the right place.  *allocp is where
+**		preallocation ends; file_release_prealloc gives back
+**		what is left.  Failure isn't an error; the write will
+**		just allocate as it goes.
+*/
+
+#define PREALLOC_FRACTION	8			// chunk is 1/8 of the file size
+#define PREALLOC_MINCHUNK	16384		// ... but at least this much
+
+static void
+file_prepare_append(FILE *fp, off_t end, off_t maxchunk, off_t *allocp)
+{
+	off_t chunk;
+	off_t newalloc;
+
+	if (maxchunk <= 0 || end <= *allocp || end < PreallocThreshold)
+		return;
+
+	chunk = end / PREALLOC_FRACTION;
+	if (chunk < PREALLOC_MINCHUNK)
+		chunk = PREALLOC_MINCHUNK;
+	if (chunk > maxchunk)
+		chunk = maxchunk;
+	newalloc = (end + chunk + PREALLOC_MINCHUNK - 1) /
+					PREALLOC_MINCHUNK * PREALLOC_MINCHUNK;
+	if (logd_io_prealloc(fileno(fp), *allocp, newalloc - *allocp) < 0)
+	{
+		ep_dbg_cprintf(Dbg, 10, "file_prepare_append: %s\n",
+				strerror(errno));
+		if (errno == EOPNOTSUPP || errno == ENOSYS)
+		{
+			// file system can't do it; don't keep trying
+			PreallocExtent = PreallocIndex = 0;
+		}
+		return;
+	}
+	*allocp = newalloc;
+}
+
+
+/*
+**  FILE_RELEASE_PREALLOC --- give back space reserved past end of file
+**
+**		Called when a file is closed or stops being appended to.
+**		*allocp is left at the end of file.
+*/
+
+static void
+file_release_prealloc(FILE *fp, off_t *allocp)
+{
+	off_t end;
+
+	if (fp == NULL || allocp == NULL || fflush(fp) != 0)
+		return;
+	end = fsizeof(fp);
+	if (end < 0 || *allocp <= end)
+		return;
+	if (logd_io_unreserve(fileno(fp), end, *allocp - end) < 0)
+		ep_dbg_cprintf(Dbg, 10, "file_release_prealloc: %s\n",
+				strerror(errno));
+	*allocp = end;
+}
+
+
+/*
+**  FILE_WRITE_BEHIND --- start writeback of newly appended data
+**
+**		Once enough data has accumulated in the page cache, start
+**		writing it out without waiting for it.  This spreads the
+**		disk writes out rather than leaving them all to the
+**		kernel's periodic flush.  It doesn't make anything durable.
+**
+**		If drop is set (the file is read with direct I/O, so the
+**		page cache copy will never be used) pages from earlier
+**		rounds, which should be clean by now, are evicted.
+*/
+
+static void
+file_write_behind(FILE *fp, off_t end, off_t *flushp, bool drop)
+{
+	if (WriteBehind <= 0 || end - *flushp < WriteBehind)
+		return;
+
+#ifdef POSIX_FADV_DONTNEED
+	if (drop && *flushp > 0)
+		(void) posix_fadvise(fileno(fp), 0, *flushp, POSIX_FADV_DONTNEED);
+#endif
+
+	if (logd_io_writeback(fileno(fp), *flushp, end - *flushp) < 0)
+	{
+		ep_dbg_cprintf(Dbg, 10, "file_write_behind: %s\n",
+				strerror(errno));
+		if (errno == ENOSYS)
+			WriteBehind = 0;
+	}
+	*flushp = end;
+}
+
+
 /*
 **  POSIX_ERROR --- flag error caused by a Posix (Unix) syscall
 */
@@ -122,6 +271,122 @@ disk_init()
 	// find physical location of GCL directory
 	GCLDir = ep_adm_getstrparam("swarm.gdplogd.gcl.dir", GCL_DIR);
 	ep_dbg_cprintf(Dbg, 8, "disk_init: log dir = %s\n", GCLDir);
+	SnapshotDir = ep_adm_getstrparam("swarm.gdplogd.snapshot.dir", NULL);
+	if (SnapshotDir == NULL)
+	{
+		static char sbuf[GCL_PATH_MAX];
+
+		snprintf(sbuf, sizeof sbuf, "%s/_snapshots", GCLDir);
+		SnapshotDir = sbuf;
+	}
+
+	// how many index and extent files may be open at once
+	FdCacheMax = ep_adm_getlongparam("swarm.gdplogd.disk.maxfds", 0);
+	if (FdCacheMax <= 0)
+	{
+		// default to a quarter of the available descriptors
+		int maxfds;
+
+		(void) ep_app_numfds(&maxfds);
+		FdCacheMax = maxfds / 4;
+		if (FdCacheMax < 16)
+			FdCacheMax = 16;
+	}
+	ep_dbg_cprintf(Dbg, 8, "disk_init: max open files = %ld\n", FdCacheMax);
+
+	// per-record checksums
+	WriteChecksums = ep_adm_getboolparam("swarm.gdplogd.disk.checksum",
+							true);
+	VerifyChecksums = ep_adm_getboolparam("swarm.gdplogd.disk.checksum.verify",
+							true);
+
+	// record compression
+	{
+		const char *p = ep_adm_getstrparam("swarm.gdplogd.disk.compress",
+							"none");
+
+		CompressAlg = ep_compress_alg_byname(p == NULL ? "none" : p);
+		if (CompressAlg < 0 || !ep_compress_available(CompressAlg))
+		{
+			ep_log(EP_STAT_COMPRESS_UNAVAIL,
+					"disk_init: compression %s not available", p);
+			CompressAlg = EP_COMPRESS_NONE;
+		}
+		CompressLevel = ep_adm_getintparam(
+							"swarm.gdplogd.disk.compress.level", 3);
+		CompressMinSize = ep_adm_getlongparam(
+							"swarm.gdplogd.disk.compress.minsize", 16);
+		CompressDictSamples = ep_adm_getlongparam(
+							"swarm.gdplogd.disk.compress.dict.samples", 1000);
+		CompressDictSize = ep_adm_getlongparam(
+							"swarm.gdplogd.disk.compress.dict.size", 16384);
+	}
+
+	// list of hosted logs
+	UseManifest = ep_adm_getboolparam("swarm.gdplogd.disk.manifest", true);
+	RebuildManifest = ep_adm_getboolparam(
+							"swarm.gdplogd.disk.manifest.rebuild", false);
+
+	// on-disk layout and write-behind tuning
+	PreallocExtent = ep_adm_getlongparam("swarm.gdplogd.disk.prealloc.extent",
+							1024 * 1024);
+	PreallocIndex = ep_adm_getlongparam("swarm.gdplogd.disk.prealloc.index",
+							64 * 1024);
+	PreallocThreshold = ep_adm_getlongparam(
+							"swarm.gdplogd.disk.prealloc.threshold",
+							64 * 1024);
+	WriteBehind = ep_adm_getlongparam("swarm.gdplogd.disk.writebehind",
+							1024 * 1024);
+	AdviseSequential = ep_adm_getboolparam("swarm.gdplogd.disk.fadvise",
+							true);
+
+	// in-memory copies of recently appended records
+	TailMaxBytes = ep_adm_getlongparam("swarm.gdplogd.disk.tail.size",
+							16 * 1024 * 1024);
+	TailSlots = ep_adm_getintparam("swarm.gdplogd.disk.tail.records", 1024);
+	if (TailSlots == 0)
+		TailMaxBytes = 0;
+
+	// direct I/O needs our own cache
+	DirectIO = ep_adm_getboolparam("swarm.gdplogd.disk.direct", false);
+	if (DirectIO)
+	{
+		estat = bcache_init(ep_adm_getlongparam(
+							"swarm.gdplogd.disk.direct.cachesize",
+							64 * 1024 * 1024));
+		if (!EP_STAT_ISOK(estat) || !bcache_enabled())
+		{
+			ep_log(estat, "disk_init: no block cache, not using direct I/O");
+			DirectIO = false;
+			estat = EP_STAT_OK;
+		}
+	}
+
+	// record header format for new extents
+	CompactRecords = ep_adm_getboolparam("swarm.gdplogd.disk.record.compact",
+							true);
+
+	// index format
+	CompactIndex = ep_adm_getboolparam("swarm.gdplogd.disk.index.compact",
+							true);
+	ConvertIndex = ep_adm_getboolparam("swarm.gdplogd.disk.index.convert",
+							false);
+
+	// chain and data hashes
+	{
+		const char *p = ep_adm_getstrparam("swarm.gdplogd.disk.hashalg",
+							"none");
+
+		if (p == NULL || strcasecmp(p, "none") == 0)
+			RecHashAlg = 0;
+		else if ((RecHashAlg = ep_crypto_md_alg_byname(p)) <= 0 ||
+				RecHashAlg > 0x0f)
+		{
+			ep_log(GDP_STAT_BAD_IOMODE,		//XXX need better status
+					"disk_init: unknown hash algorithm %s", p);
+			RecHashAlg = 0;
+		}
+	}
 
 	return estat;
 }
@@ -220,6 +485,114 @@ fail0:
 }
 
 
+/*
+**  Open file cache
+**
+**		All index and extent files are on a global LRU list.  When
+**		there are too many, the least recently used ones are closed.
+**		A file can only be closed if we can get a write lock on the
+**		log that owns it, which guarantees that no one is using it;
+**		all file access (including the initial open) must be done
+**		holding the log lock.  Closed files are reopened on demand.
+*/
+
+static void
+fdcache_trim(void)
+{
+	fdcache_ent_t *fdc;
+	fdcache_ent_t *prev;
+
+	// caller must hold FdCacheMutex
+	for (fdc = TAILQ_LAST(&FdCacheLru, fdcache_head);
+			fdc != NULL && FdCacheCount > FdCacheMax;
+			fdc = prev)
+	{
+		prev = TAILQ_PREV(fdc, fdcache_head, lru);
+
+		// skip files in logs that are in use (including our own)
+		if (ep_thr_rwlock_trywrlock(&fdc->phys->lock) != 0)
+			continue;
+
+		ep_dbg_cprintf(Dbg, 41, "fdcache_trim: closing fp @ %p\n", *fdc->fpp);
+		file_release_prealloc(*fdc->fpp, fdc->allocp);
+		if (fclose(*fdc->fpp) != 0)
+			(void) posix_error(errno, "fdcache_trim: cannot fclose");
+		*fdc->fpp = NULL;
+		if (fdc->dfdp != NULL && *fdc->dfdp >= 0)
+		{
+			(void) close(*fdc->dfdp);
+			*fdc->dfdp = -1;
+		}
+		TAILQ_REMOVE(&FdCacheLru, fdc, lru);
+		fdc->inlru = false;
+		FdCacheCount--;
+		ep_thr_rwlock_unlock(&fdc->phys->lock);
+	}
+
+	if (FdCacheCount > FdCacheMax)
+		ep_dbg_cprintf(Dbg, 8, "fdcache_trim: %ld files open, budget %ld\n",
+				FdCacheCount, FdCacheMax);
+}
+
+
+/*
+**  FDCACHE_ADD --- note that a file has been opened
+**
+**		The caller must hold the log lock, which keeps this file from
+**		being chosen for eviction immediately.
+*/
+
+static void
+fdcache_add(gcl_physinfo_t *phys, fdcache_ent_t *fdc, FILE **fpp)
+{
+	ep_thr_mutex_lock(&FdCacheMutex);
+	EP_ASSERT(!fdc->inlru);
+	fdc->fpp = fpp;
+	fdc->phys = phys;
+	TAILQ_INSERT_HEAD(&FdCacheLru, fdc, lru);
+	fdc->inlru = true;
+	FdCacheCount++;
+	if (FdCacheCount > FdCacheMax)
+		fdcache_trim();
+	ep_thr_mutex_unlock(&FdCacheMutex);
+}
+
+
+/*
+**  FDCACHE_TOUCH --- mark a file as recently used
+*/
+
+static void
+fdcache_touch(fdcache_ent_t *fdc)
+{
+	ep_thr_mutex_lock(&FdCacheMutex);
+	if (fdc->inlru && TAILQ_FIRST(&FdCacheLru) != fdc)
+	{
+		TAILQ_REMOVE(&FdCacheLru, fdc, lru);
+		TAILQ_INSERT_HEAD(&FdCacheLru, fdc, lru);
+	}
+	ep_thr_mutex_unlock(&FdCacheMutex);
+}
+
+
+/*
+**  FDCACHE_REMOVE --- remove a file from the cache before closing it
+*/
+
+static void
+fdcache_remove(fdcache_ent_t *fdc)
+{
+	ep_thr_mutex_lock(&FdCacheMutex);
+	if (fdc->inlru)
+	{
+		TAILQ_REMOVE(&FdCacheLru, fdc, lru);
+		fdc->inlru = false;
+		FdCacheCount--;
+	}
+	ep_thr_mutex_unlock(&FdCacheMutex);
+}
+
+
 /*
 **  Allocate and free a new in-memory extent.  Does not touch disk.
 */
@@ -230,6 +603,10 @@ extent_alloc(uint32_t extno)
 	extent_t *ext = ep_mem_zalloc(sizeof *ext);
 
 	ext->extno = extno;
+	ext->dfd = -1;
+	ext->fdc.allocp = &ext->alloc_offset;
+	if (DirectIO)
+		ext->cacheid = bcache_newfile();
 
 	return ext;
 }
@@ -241,10 +618,16 @@ extent_free(extent_t *ext)
 		return;
 	ep_dbg_cprintf(Dbg, 41, "extent_free: closing fp @ %p (extent %d)\n",
 			ext->fp, ext->extno);
+	fdcache_remove(&ext->fdc);
+	file_release_prealloc(ext->fp, &ext->alloc_offset);
 	if (ext->fp != NULL && fclose(ext->fp) < 0)
 		(void) posix_error(errno, "extent_free: fclose (extent %d)",
 						ext->extno);
 	ext->fp = NULL;
+	if (ext->dfd >= 0)
+		(void) close(ext->dfd);
+	if (DirectIO)
+		bcache_forget(ext->cacheid);
 	ep_mem_free(ext);
 }
 
@@ -268,6 +651,9 @@ extent_dump(extent_t *ext, FILE *fp)
 **  EXTENT_OPEN --- physically open an extent
 **
 **		The caller allocates and passes in the new extent.
+**		The extent may have been open before but closed by the
+**		open file cache, in which case it is simply reopened.
+**		The caller must hold the log lock.
 */
 
 static EP_STAT
@@ -276,13 +662,25 @@ extent_open(gdp_gcl_t *gcl, extent_t *ext)
 	EP_STAT estat;
 	FILE *data_fp;
 	char data_pbuf[GCL_PATH_MAX];
+	gcl_physinfo_t *phys = GETPHYS(gcl);
 
 	ep_dbg_cprintf(Dbg, 20, "extent_open(ext %d, fp %p)\n",
 			ext->extno, ext->fp);
 
 	// if already open, this is a no-op
 	if (ext->fp != NULL)
+	{
+		fdcache_touch(&ext->fdc);
+		return EP_STAT_OK;
+	}
+
+	// make sure another reader isn't opening it at the same time
+	ep_thr_mutex_lock(&phys->open_mutex);
+	if (ext->fp != NULL)
+	{
+		ep_thr_mutex_unlock(&phys->open_mutex);
 		return EP_STAT_OK;
+	}
 
 	// figure out where the extent lives on disk
 	//XXX for the moment assume that it's on our local disk
@@ -308,6 +706,16 @@ extent_open(gdp_gcl_t *gcl, extent_t *ext)
 		ep_dbg_cprintf(Dbg, 20, "extent_open(%s) OK\n", data_pbuf);
 	}
 
+	// with direct I/O, records are read through a separate descriptor
+	if (DirectIO && (ext->dfd = logd_io_open_direct(data_pbuf)) < 0)
+	{
+		estat = ep_stat_from_errno(errno);
+		ep_dbg_cprintf(Dbg, 16, "extent_open(%s): direct: %s\n",
+				data_pbuf, strerror(errno));
+		fclose(data_fp);
+		goto fail0;
+	}
+
 	// read in the extent header
 	extent_header_t ext_hdr;
 	rewind(data_fp);
@@ -325,6 +733,7 @@ extent_open(gdp_gcl_t *gcl, extent_t *ext)
 	ext_hdr.n_md_entries = ep_net_ntoh16(ext_hdr.n_md_entries);
 	ext_hdr.log_type = ep_net_ntoh16(ext_hdr.log_type);
 	ext_hdr.recno_offset = ep_net_ntoh64(ext_hdr.recno_offset);
+	ext_hdr.base_time = ep_net_ntoh64(ext_hdr.base_time);
 
 	// validate the extent header
 	if (ext_hdr.magic != GCL_LDF_MAGIC)
@@ -351,9 +760,19 @@ extent_open(gdp_gcl_t *gcl, extent_t *ext)
 	// now we can interpret the data (for the extent)
 	ext->header_size = ext_hdr.header_size;
 	ext->recno_offset = ext_hdr.recno_offset;
+	ext->base_time = ext_hdr.base_time;
 	ext->fp = data_fp;
 	ext->ver = ext_hdr.version;
 	ext->max_offset = fsizeof(data_fp);
+	ext->alloc_offset = ext->flush_offset = ext->max_offset;
+	ext->fdc.dfdp = &ext->dfd;
+	fdcache_add(phys, &ext->fdc, &ext->fp);
+
+#ifdef POSIX_FADV_SEQUENTIAL
+	// replays and subscriptions read forward: read ahead aggressively
+	if (AdviseSequential)
+		(void) posix_fadvise(fileno(data_fp), 0, 0, POSIX_FADV_SEQUENTIAL);
+#endif
 
 	// interpret data (for the entire log)
 	gcl->x->n_md_entries = ext_hdr.n_md_entries;
@@ -401,6 +820,7 @@ extent_open(gdp_gcl_t *gcl, extent_t *ext)
 	}
 
 success:
+	ep_thr_mutex_unlock(&phys->open_mutex);
 	if (ep_dbg_test(Dbg, 20))
 	{
 		ep_dbg_printf("extent_open: ");
@@ -410,8 +830,19 @@ success:
 
 fail1:
 	ep_dbg_cprintf(Dbg, 20, "extent_open: closing fp %p (error)\n", data_fp);
+	if (ext->fp == data_fp)
+	{
+		fdcache_remove(&ext->fdc);
+		ext->fp = NULL;
+	}
 	fclose(data_fp);
+	if (ext->dfd >= 0)
+	{
+		(void) close(ext->dfd);
+		ext->dfd = -1;
+	}
 fail0:
+	ep_thr_mutex_unlock(&phys->open_mutex);
 	EP_ASSERT_ENSURE(!EP_STAT_ISOK(estat));
 	return estat;
 }
@@ -434,10 +865,16 @@ extent_close(gdp_gcl_t *gcl, uint32_t extno)
 	{
 		ep_dbg_cprintf(Dbg, 39, "extent_close: closing extent fp %p\n",
 				ext->fp);
+		fdcache_remove(&ext->fdc);
+		file_release_prealloc(ext->fp, &ext->alloc_offset);
 		if (fclose(ext->fp) != 0)
 			(void) posix_error(errno, "extent_close: cannot fclose");
 		ext->fp = NULL;
 	}
+	if (ext->dfd >= 0)
+		(void) close(ext->dfd);
+	if (DirectIO)
+		bcache_forget(ext->cacheid);
 	ep_mem_free(ext);
 	phys->extents[extno] = NULL;
 }
@@ -562,6 +999,7 @@ extent_create(gdp_gcl_t *gcl,
 
 		if (gmd == NULL)
 		{
+			gcl->x->n_md_entries = 0;
 			ext_hdr.n_md_entries = 0;
 		}
 		else
@@ -579,18 +1017,26 @@ extent_create(gdp_gcl_t *gcl,
 
 		EP_ASSERT_POINTER_VALID(ext);
 
-		ext->ver = GCL_LDF_VERSION;
+		ext->ver = CompactRecords ? GCL_LDF_VERS_COMPACT : GCL_LDF_VERS_FIXED;
 		ext->extno = extno;
 		ext->header_size = ext->max_offset = sizeof ext_hdr + metadata_size;
 		ext->recno_offset = 0;
+		ext->base_time = 0;
+		if (ext->ver >= GCL_LDF_VERS_COMPACT)
+		{
+			EP_TIME_SPEC now;
+
+			if (EP_STAT_ISOK(ep_time_now(&now)))
+				ext->base_time = now.tv_sec;
+		}
 
 		ext_hdr.magic = ep_net_hton32(GCL_LDF_MAGIC);
-		ext_hdr.version = ep_net_hton32(GCL_LDF_VERSION);
+		ext_hdr.version = ep_net_hton32(ext->ver);
 		ext_hdr.header_size = ep_net_ntoh32(ext->max_offset);
 		ext_hdr.reserved1 = 0;
 		ext_hdr.log_type = ep_net_hton16(0);		// unused for now
 		ext_hdr.extent = ep_net_hton32(extno);
-		ext_hdr.reserved2 = 0;
+		ext_hdr.base_time = ep_net_hton64(ext->base_time);
 		memcpy(ext_hdr.gname, gcl->name, sizeof ext_hdr.gname);
 		ext_hdr.recno_offset = ep_net_hton64(recno_offset);
 
@@ -628,6 +1074,7 @@ extent_create(gdp_gcl_t *gcl,
 	// success!
 	fflush(data_fp);
 	ext->fp = data_fp;
+	fdcache_add(GETPHYS(gcl), &ext->fdc, &ext->fp);
 	flock(fileno(data_fp), LOCK_UN);
 	ep_dbg_cprintf(Dbg, 10, "Created GCL Extent %s-%06d\n",
 			gcl->pname, extno);
@@ -661,6 +1108,204 @@ fail1:
 }
 
 
+/*
+**  Tail cache --- copies of recently appended records
+**
+**		Most reads (and all subscription catch-up) are for records
+**		near the end of a log, which disk_append has just had in
+**		memory.  Each log has a ring of pointers to copies of its
+**		last TailSlots records, indexed by recno.  The copies are
+**		also on one global FIFO so that the total memory can be
+**		bounded: when over budget the oldest copies, from whatever
+**		log, are dropped.  Everything is protected by TailMutex.
+*/
+
+struct tailrec
+{
+	TAILQ_ENTRY(tailrec)	fifo;	// global list, oldest first
+	gcl_physinfo_t		*phys;		// log it belongs to
+	size_t				size;		// bytes charged to the budget
+	gdp_recno_t			recno;		// record number
+	EP_TIME_SPEC		ts;			// commit timestamp
+	uint32_t			dlen;		// length of data
+	short				siglen;		// length of signature
+	short				sigmdalg;	// signature digest algorithm
+	uint8_t				data[];		// data, then signature
+};
+
+static TAILQ_HEAD(tailrec_head, tailrec)
+					TailFifo = TAILQ_HEAD_INITIALIZER(TailFifo);
+static EP_THR_MUTEX	TailMutex		EP_THR_MUTEX_INITIALIZER;
+static size_t		TailBytes;		// bytes in all tail caches
+
+static void
+tail_drop(struct tailrec *tr)
+{
+	struct tailrec **slot = &tr->phys->tail[tr->recno % TailSlots];
+
+	// caller must hold TailMutex
+	if (*slot == tr)
+		*slot = NULL;
+	TAILQ_REMOVE(&TailFifo, tr, fifo);
+	TailBytes -= tr->size;
+	ep_mem_free(tr);
+}
+
+
+/*
+**  TAIL_PUT --- remember a record that has just been appended
+**
+**		Records that would take more than a sixteenth of the
+**		budget aren't worth keeping.
+*/
+
+static void
+tail_put(gcl_physinfo_t *phys,
+		gdp_recno_t recno,
+		gdp_datum_t *datum,
+		const uint8_t *dp,
+		size_t dlen,
+		const uint8_t *sp,
+		size_t slen)
+{
+	struct tailrec *tr;
+	struct tailrec **slot;
+	size_t size = sizeof *tr + dlen + slen;
+
+	if (TailMaxBytes == 0 || size > TailMaxBytes / 16)
+		return;
+
+	tr = ep_mem_malloc(size);
+	tr->phys = phys;
+	tr->size = size;
+	tr->recno = recno;
+	tr->ts = datum->ts;
+	tr->dlen = dlen;
+	tr->siglen = slen;
+	tr->sigmdalg = datum->sigmdalg;
+	if (dlen > 0)
+		memcpy(tr->data, dp, dlen);
+	if (slen > 0)
+		memcpy(&tr->data[dlen], sp, slen);
+
+	ep_thr_mutex_lock(&TailMutex);
+	if (phys->tail == NULL)
+		phys->tail = ep_mem_zalloc(TailSlots * sizeof phys->tail[0]);
+	slot = &phys->tail[recno % TailSlots];
+	if (*slot != NULL)
+		tail_drop(*slot);
+	*slot = tr;
+	TAILQ_INSERT_TAIL(&TailFifo, tr, fifo);
+	TailBytes += size;
+	while (TailBytes > TailMaxBytes)
+		tail_drop(TAILQ_FIRST(&TailFifo));
+	ep_thr_mutex_unlock(&TailMutex);
+}
+
+
+/*
+**  TAIL_GET --- try to satisfy a read from the tail cache
+**
+**		The caller must hold the log lock (shared is enough).
+*/
+
+static bool
+tail_get(gcl_physinfo_t *phys, gdp_datum_t *datum)
+{
+	struct tailrec *tr;
+
+	// only appends (which hold the lock exclusively) create the ring
+	if (phys->tail == NULL)
+		return false;
+
+	ep_thr_mutex_lock(&TailMutex);
+	tr = phys->tail[datum->recno % TailSlots];
+	if (tr == NULL || tr->recno != datum->recno)
+	{
+		ep_thr_mutex_unlock(&TailMutex);
+		return false;
+	}
+	datum->ts = tr->ts;
+	datum->sigmdalg = tr->sigmdalg;
+	datum->siglen = tr->siglen;
+	if (tr->dlen > 0)
+		gdp_buf_write(datum->dbuf, tr->data, tr->dlen);
+	if (tr->siglen > 0)
+	{
+		if (datum->sig == NULL)
+			datum->sig = gdp_buf_new();
+		else
+			gdp_buf_reset(datum->sig);
+		gdp_buf_write(datum->sig, &tr->data[tr->dlen], tr->siglen);
+	}
+	ep_thr_mutex_unlock(&TailMutex);
+	return true;
+}
+
+// same, but only the timestamp
+static bool
+tail_get_timestamp(gcl_physinfo_t *phys, gdp_recno_t recno, EP_TIME_SPEC *tsp)
+{
+	struct tailrec *tr;
+
+	if (phys->tail == NULL)
+		return false;
+
+	ep_thr_mutex_lock(&TailMutex);
+	tr = phys->tail[recno % TailSlots];
+	if (tr == NULL || tr->recno != recno)
+	{
+		ep_thr_mutex_unlock(&TailMutex);
+		return false;
+	}
+	*tsp = tr->ts;
+	ep_thr_mutex_unlock(&TailMutex);
+	return true;
+}
+
+
+static void
+tail_free(gcl_physinfo_t *phys)
+{
+	unsigned int i;
+
+	if (phys->tail == NULL)
+		return;
+	ep_thr_mutex_lock(&TailMutex);
+	for (i = 0; i < TailSlots; i++)
+	{
+		if (phys->tail[i] != NULL)
+			tail_drop(phys->tail[i]);
+	}
+	ep_thr_mutex_unlock(&TailMutex);
+	ep_mem_free(phys->tail);
+	phys->tail = NULL;
+}
+
+
+/*
+**  TAIL_FORGET --- drop cached copies of records after a given one
+**
+**		Used when appends are undone.
+*/
+
+static void
+tail_forget(gcl_physinfo_t *phys, gdp_recno_t after)
+{
+	unsigned int i;
+
+	if (phys->tail == NULL)
+		return;
+	ep_thr_mutex_lock(&TailMutex);
+	for (i = 0; i < TailSlots; i++)
+	{
+		if (phys->tail[i] != NULL && phys->tail[i]->recno > after)
+			tail_drop(phys->tail[i]);
+	}
+	ep_thr_mutex_unlock(&TailMutex);
+}
+
+
 /*
 **  Allocate/Free the in-memory version of the physical representation
 **		of a GCL.
@@ -679,13 +1324,18 @@ physinfo_alloc(gdp_gcl_t *gcl)
 
 	if (ep_thr_rwlock_init(&phys->lock) != 0)
 		goto fail1;
+	if (ep_thr_mutex_init(&phys->open_mutex, EP_THR_MUTEX_DEFAULT) != 0)
+		goto fail2;
 
 	//XXX Need to figure out how many extents exist
 	//XXX This is just for transition.
 	phys->nextents = 0;
+	phys->index.fdc.allocp = &phys->index.alloc_offset;
 
 	return phys;
 
+fail2:
+	ep_thr_rwlock_destroy(&phys->lock);
 fail1:
 	ep_mem_free(phys);
 	return NULL;
@@ -700,10 +1350,15 @@ physinfo_free(gcl_physinfo_t *phys)
 	if (phys == NULL)
 		return;
 
+	// keep the open file cache from closing files underneath us
+	ep_thr_rwlock_wrlock(&phys->lock);
+
 	if (phys->index.fp != NULL)
 	{
 		ep_dbg_cprintf(Dbg, 41, "physinfo_free: closing index fp @ %p\n",
 				phys->index.fp);
+		fdcache_remove(&phys->index.fdc);
+		file_release_prealloc(phys->index.fp, &phys->index.alloc_offset);
 		if (fclose(phys->index.fp) != 0)
 			(void) posix_error(errno, "physinfo_free: cannot close index fp");
 		phys->index.fp = NULL;
@@ -718,6 +1373,17 @@ physinfo_free(gcl_physinfo_t *phys)
 	ep_mem_free(phys->extents);
 	phys->extents = NULL;
 
+	tail_free(phys);
+	ep_compress_dict_free(phys->cdict);
+	phys->cdict = NULL;
+	if (phys->dsamples != NULL)
+		ep_mem_free(phys->dsamples);
+	if (phys->dsizes != NULL)
+		ep_mem_free(phys->dsizes);
+
+	ep_thr_rwlock_unlock(&phys->lock);
+	if (ep_thr_mutex_destroy(&phys->open_mutex) != 0)
+		(void) posix_error(errno, "physinfo_free: cannot destroy mutex");
 	if (ep_thr_rwlock_destroy(&phys->lock) != 0)
 		(void) posix_error(errno, "physinfo_free: cannot destroy rwlock");
 
@@ -737,10 +1403,12 @@ physinfo_dump(gcl_physinfo_t *phys, FILE *fp)
 	fprintf(fp, "\tnextents %d, last_extent %d\n",
 			phys->nextents, phys->last_extent);
 	fprintf(fp, "\tindex: fp %p, min_recno %" PRIgdp_recno
-			", max_offset %jd, header_size %zd\n",
+			", max_offset %jd, header_size %zd, version %" PRIu32
+			", block_entries %" PRIu32 "\n",
 			phys->index.fp, phys->index.min_recno,
 			(intmax_t) phys->index.max_offset,
-			phys->index.header_size);
+			phys->index.header_size, phys->index.version,
+			phys->index.block_entries);
 
 	for (extno = 0; extno < phys->nextents; extno++)
 	{
@@ -781,35 +1449,1423 @@ xcache_free(gcl_physinfo_t *phys)
 
 
 /*
-**  GCL_PHYSCREATE --- create a brand new GCL on disk
+**  INDEX_OPEN --- make sure the index file is open
+**
+**		The index is opened when the log is opened, but may be
+**		closed by the open file cache at any time the log is not
+**		locked, so this must be called (with the log lock held)
+**		before each use of phys->index.fp.
 */
 
 static EP_STAT
-disk_create(gdp_gcl_t *gcl, gdp_gclmd_t *gmd)
+index_open(gdp_gcl_t *gcl)
 {
 	EP_STAT estat = EP_STAT_OK;
+	gcl_physinfo_t *phys = GETPHYS(gcl);
+	char index_pbuf[GCL_PATH_MAX];
 	FILE *index_fp;
-	gcl_physinfo_t *phys;
-
-	EP_ASSERT_POINTER_VALID(gcl);
-
-	// allocate space for the physical information
-	phys = physinfo_alloc(gcl);
-	if (phys == NULL)
-		goto fail1;
-	phys->last_extent = 0;
-	gcl->x->physinfo = phys;
+	int fd;
 
-	// allocate a name
-	if (!gdp_name_is_valid(gcl->name))
+	if (phys->index.fp != NULL)
 	{
-		_gdp_gcl_newname(gcl);
+		fdcache_touch(&phys->index.fdc);
+		return EP_STAT_OK;
 	}
 
-	// create an initial extent for the GCL
-	estat = extent_create(gcl, gmd, 0, 0);
+	ep_thr_mutex_lock(&phys->open_mutex);
+	if (phys->index.fp != NULL)
+		goto done;
 
-	// create an offset index for that gcl
+	estat = get_gcl_path(gcl, -1, GCL_LXF_SUFFIX,
+					index_pbuf, sizeof index_pbuf);
+	EP_STAT_CHECK(estat, goto done);
+	ep_dbg_cprintf(Dbg, 39, "index_open: opening %s\n", index_pbuf);
+	fd = open(index_pbuf, O_RDWR | O_APPEND);
+	if (fd < 0 || flock(fd, LOCK_SH) < 0 ||
+			(index_fp = fdopen(fd, "a+")) == NULL)
+	{
+		estat = ep_stat_from_errno(errno);
+		if (EP_STAT_IS_SAME(estat, ep_stat_from_errno(ENOENT)))
+			estat = GDP_STAT_NAK_NOTFOUND;
+		ep_log(estat, "index_open(%s): index open failure", index_pbuf);
+		if (fd >= 0)
+			close(fd);
+		goto done;
+	}
+	phys->index.fp = index_fp;
+	fdcache_add(phys, &phys->index.fdc, &phys->index.fp);
+
+done:
+	ep_thr_mutex_unlock(&phys->open_mutex);
+	return estat;
+}
+
+
+/*
+**  INDEX_WRITE_HEADER --- write the header of a new index
+**
+**		Fills in the header size and current size of xp.
+*/
+
+static EP_STAT
+index_write_header(struct phys_index *xp)
+{
+	index_header_t index_header;
+
+	index_header.magic = ep_net_hton32(GCL_LXF_MAGIC);
+	index_header.version = ep_net_hton32(xp->version);
+	index_header.header_size = ep_net_hton32(SIZEOF_INDEX_HEADER);
+	index_header.block_entries = ep_net_hton32(xp->block_entries);
+	index_header.min_recno = ep_net_hton64(xp->min_recno);
+
+	if (fwrite(&index_header, sizeof index_header, 1, xp->fp) != 1 ||
+			fflush(xp->fp) < 0)
+		return posix_error(errno, "index_write_header: cannot write header");
+	xp->max_offset = xp->header_size = SIZEOF_INDEX_HEADER;
+	xp->alloc_offset = xp->flush_offset = xp->max_offset;
+	return EP_STAT_OK;
+}
+
+
+/*
+**  INDEX_NENTRIES --- return the number of entries in an index
+**
+**		Computed from the size of the index file, so a trailing
+**		block header without any entries counts for nothing.
+*/
+
+static gdp_recno_t
+index_nentries(struct phys_index *xp)
+{
+	int64_t xlen = xp->max_offset - xp->header_size;
+	int64_t bsize;
+	gdp_recno_t n;
+
+	if (xlen <= 0)
+		return 0;
+	if (xp->version != GCL_LXF_VERS_BLOCK)
+		return xlen / SIZEOF_INDEX_RECORD;
+
+	bsize = SIZEOF_INDEX_BLOCK(xp->block_entries);
+	n = (xlen / bsize) * xp->block_entries;
+	xlen %= bsize;
+	if (xlen > (int64_t) SIZEOF_INDEX_BLOCK_HDR)
+		n += (xlen - SIZEOF_INDEX_BLOCK_HDR) / sizeof (uint32_t);
+	return n;
+}
+
+
+/*
+**  INDEX_READ_BLOCK --- read a block header from the index
+**
+**		Returns it in host byte order.  The caller must have the
+**		index file locked.
+*/
+
+static EP_STAT
+index_read_block(struct phys_index *xp, off_t boff, index_block_t *blk)
+{
+	if (fseek(xp->fp, boff, SEEK_SET) < 0 ||
+			fread(blk, sizeof *blk, 1, xp->fp) < 1)
+		return posix_error(errno, "index_read_block: cannot read block");
+	blk->base_offset = ep_net_ntoh64(blk->base_offset);
+	blk->base_extent = ep_net_ntoh32(blk->base_extent);
+	blk->reserved = ep_net_ntoh32(blk->reserved);
+	return EP_STAT_OK;
+}
+
+
+/*
+**  INDEX_BLOCK_WALK --- find an entry in a block
+**
+**		Decodes entries 0 through ent of the block at boff, leaving
+**		the location of the last in *xent and the base in effect for
+**		the entry after it in *blk.  Markers are resolved from the
+**		record before them (see logd_disklog.h), which means reading
+**		the data, but they are rare.  The caller must have the index
+**		file locked.
+*/
+
+static EP_STAT	record_next_offset(gdp_gcl_t *gcl,
+						uint32_t extno,
+						int64_t offset,
+						int64_t *nextp);
+
+static EP_STAT
+index_block_walk(gdp_gcl_t *gcl,
+		off_t boff,
+		uint32_t ent,
+		index_block_t *blk,
+		index_entry_t *xent)
+{
+	EP_STAT estat;
+	struct phys_index *xp = &GETPHYS(gcl)->index;
+	uint32_t i;
+
+	estat = index_read_block(xp, boff, blk);
+	EP_STAT_CHECK(estat, return estat);
+	xent->extent = blk->base_extent;
+	xent->offset = blk->base_offset;
+	for (i = 0; i <= ent; i++)
+	{
+		uint32_t e;
+
+		if (fread(&e, sizeof e, 1, xp->fp) < 1)
+			return posix_error(errno, "index_block_walk: fread failed");
+		e = ep_net_ntoh32(e);
+		if (i == 0)
+			continue;
+		if (!INDEX_ENT_ISMARKER(e))
+		{
+			xent->offset = INDEX_ENT_OFFSET(blk, e);
+			xent->extent = INDEX_ENT_EXTENT(blk, e);
+			continue;
+		}
+
+		// rebase on the record the marker stands for
+		if ((e & INDEX_ENT_MAXDELTA) == 0)
+		{
+			estat = record_next_offset(gcl, xent->extent, xent->offset,
+							&xent->offset);
+			EP_STAT_CHECK(estat, return estat);
+		}
+		else
+		{
+			extent_t *ext;
+
+			ext = extent_get(gcl, xent->extent + (e & INDEX_ENT_MAXDELTA));
+			estat = extent_open(gcl, ext);
+			EP_STAT_CHECK(estat, return estat);
+			xent->extent = ext->extno;
+			xent->offset = ext->header_size;
+		}
+		blk->base_offset = xent->offset;
+		blk->base_extent = xent->extent;
+	}
+	return EP_STAT_OK;
+}
+
+
+/*
+**  INDEX_LOOKUP --- find the index entry for a record
+**
+**		The caller must hold the log lock and have checked that
+**		recno is in range.
+*/
+
+static EP_STAT
+index_lookup(gdp_gcl_t *gcl, gdp_recno_t recno, index_entry_t *xent)
+{
+	EP_STAT estat;
+	gcl_physinfo_t *phys = GETPHYS(gcl);
+	struct phys_index *xp = &phys->index;
+	gdp_recno_t xno = recno - xp->min_recno;
+	off_t boff = 0;
+	off_t xoff;
+	size_t xlen;
+
+	estat = index_open(gcl);
+	EP_STAT_CHECK(estat, return estat);
+	flockfile(xp->fp);
+
+	if (xp->version == GCL_LXF_VERS_BLOCK)
+	{
+		boff = (xno / xp->block_entries) *
+					SIZEOF_INDEX_BLOCK(xp->block_entries) + xp->header_size;
+		xoff = boff + SIZEOF_INDEX_BLOCK_HDR +
+					(xno % xp->block_entries) * sizeof (uint32_t);
+		xlen = sizeof (uint32_t);
+	}
+	else
+	{
+		xoff = xno * SIZEOF_INDEX_RECORD + xp->header_size;
+		xlen = SIZEOF_INDEX_RECORD;
+	}
+	ep_dbg_cprintf(Dbg, 14,
+			"recno=%" PRIgdp_recno ", min_recno=%" PRIgdp_recno
+			", index_hdrsize=%zd, xoff=%jd\n",
+			recno, phys->min_recno,
+			xp->header_size, (intmax_t) xoff);
+	if (xoff + (off_t) xlen > xp->max_offset ||
+			xoff < (off_t) xp->header_size)
+	{
+		// computed offset is out of range
+		estat = GDP_STAT_CORRUPT_INDEX;
+		ep_log(estat, "gcl_diskread(%s): computed offset %jd out of range (%jd max)",
+				gcl->pname,
+				(intmax_t) xoff, (intmax_t) xp->max_offset);
+		goto fail0;
+	}
+
+	if (xp->version == GCL_LXF_VERS_BLOCK)
+	{
+		index_block_t blk;
+
+		estat = index_block_walk(gcl, boff, xno % xp->block_entries,
+						&blk, xent);
+		EP_STAT_CHECK(estat, goto fail0);
+		xent->recno = recno;
+		xent->reserved = 0;
+	}
+	else
+	{
+		if (fseek(xp->fp, xoff, SEEK_SET) < 0)
+		{
+			estat = posix_error(errno, "gcl_diskread: fseek failed");
+			goto fail0;
+		}
+		if (fread(xent, SIZEOF_INDEX_RECORD, 1, xp->fp) < 1)
+		{
+			estat = posix_error(errno, "gcl_diskread: fread failed");
+			goto fail0;
+		}
+		xent->recno = ep_net_ntoh64(xent->recno);
+		xent->offset = ep_net_ntoh64(xent->offset);
+		xent->extent = ep_net_ntoh32(xent->extent);
+		xent->reserved = ep_net_ntoh32(xent->reserved);
+	}
+
+	ep_dbg_cprintf(Dbg, 14,
+			"got index entry: recno %" PRIgdp_recno ", extent %" PRIu32
+			", offset=%jd, rsvd=%" PRIu32 "\n",
+			xent->recno, xent->extent,
+			(intmax_t) xent->offset, xent->reserved);
+
+fail0:
+	funlockfile(xp->fp);
+	return estat;
+}
+
+
+/*
+**  INDEX_PUT --- append an entry to the index
+**
+**		Returns the number of bytes written (which the caller should
+**		add to max_offset once the write is committed) or -1 if the
+**		entry can't be represented in the compact format, in which
+**		case nothing is written.  That only happens if the record is
+**		more than INDEX_ENT_MAXDELTA extents on from the last one.
+**		Markers assume that records are appended in order and that
+**		the first record in an extent starts just after its header.
+**		Write errors are left for the caller to find when it flushes.
+*/
+
+static ssize_t
+index_put(struct phys_index *xp,
+		gdp_recno_t recno,
+		uint32_t extent,
+		int64_t offset)
+{
+	uint32_t ent;
+	size_t xlen = sizeof ent;
+
+	if (xp->version != GCL_LXF_VERS_BLOCK)
+	{
+		index_entry_t xent;
+
+		xent.recno = ep_net_hton64(recno);
+		xent.offset = ep_net_hton64(offset);
+		xent.extent = ep_net_hton32(extent);
+		xent.reserved = 0;
+		fwrite(&xent, sizeof xent, 1, xp->fp);
+		xp->last_extent = extent;
+		return sizeof xent;
+	}
+
+	if (index_nentries(xp) % xp->block_entries == 0)
+	{
+		// start a new block
+		index_block_t blk;
+
+		xp->block.base_offset = offset;
+		xp->block.base_extent = extent;
+		xp->block.reserved = 0;
+		blk.base_offset = ep_net_hton64(offset);
+		blk.base_extent = ep_net_hton32(extent);
+		blk.reserved = 0;
+		fwrite(&blk, sizeof blk, 1, xp->fp);
+		xlen += sizeof blk;
+		ent = 0;
+	}
+	else if (extent == xp->block.base_extent &&
+			offset >= xp->block.base_offset &&
+			offset - xp->block.base_offset < INDEX_ENT_NEXTEXT)
+	{
+		ent = offset - xp->block.base_offset;
+	}
+	else if (extent == xp->block.base_extent + 1 && offset >= 0 &&
+			offset < (INDEX_ENT_MARKER & ~INDEX_ENT_NEXTEXT))
+	{
+		ent = offset | INDEX_ENT_NEXTEXT;
+	}
+	else if (extent >= xp->last_extent &&
+			extent - xp->last_extent <= INDEX_ENT_MAXDELTA)
+	{
+		// rebase the rest of the block on this record
+		ent = INDEX_ENT_MARKER | (extent - xp->last_extent);
+		xp->block.base_offset = offset;
+		xp->block.base_extent = extent;
+	}
+	else
+	{
+		return -1;
+	}
+
+	ent = ep_net_hton32(ent);
+	fwrite(&ent, sizeof ent, 1, xp->fp);
+	xp->last_extent = extent;
+	return xlen;
+}
+
+
+/*
+**  INDEX_CONVERT --- rewrite the index in a different format
+**
+**		The new index is written to a temporary file which is then
+**		renamed over the old one, so a crash part way through leaves
+**		the old index intact.  Most of the copying is done a chunk at
+**		a time under the read lock so that appends can carry on; the
+**		write lock is only taken at the end to copy whatever has been
+**		appended since, rename, and switch over.  If appends were
+**		rolled back in the meantime the copy can't be trusted and is
+**		thrown away.  Called without the log locked.
+*/
+
+#define INDEX_CONVERT_CHUNK		4096		// entries copied per read lock
+
+static EP_STAT
+index_copy(gdp_gcl_t *gcl,
+		struct phys_index *newx,
+		gdp_recno_t *recnop,
+		gdp_recno_t maxrecno)
+{
+	EP_STAT estat = EP_STAT_OK;
+	gdp_recno_t recno;
+
+	for (recno = *recnop; recno <= maxrecno; recno++)
+	{
+		index_entry_t xent;
+		ssize_t xlen;
+
+		estat = index_lookup(gcl, recno, &xent);
+		EP_STAT_CHECK(estat, break);
+		xlen = index_put(newx, recno, xent.extent, xent.offset);
+		if (xlen < 0)
+		{
+			estat = EP_STAT_ARG_OUT_OF_RANGE;
+			ep_log(estat, "index_convert(%s): recno %" PRIgdp_recno
+					" cannot be represented",
+					gcl->pname, recno);
+			break;
+		}
+		newx->max_offset += xlen;
+	}
+	*recnop = recno;
+	return estat;
+}
+
+static EP_STAT
+index_convert(gdp_gcl_t *gcl, uint32_t version)
+{
+	EP_STAT estat;
+	gcl_physinfo_t *phys = GETPHYS(gcl);
+	struct phys_index newx;
+	char old_pbuf[GCL_PATH_MAX];
+	char new_pbuf[GCL_PATH_MAX];
+	gdp_recno_t recno;
+	uint32_t gen;
+	bool done;
+	int fd;
+
+	ep_dbg_cprintf(Dbg, 8, "index_convert(%s): version %" PRIu32
+			" => %" PRIu32 "\n",
+			gcl->pname, phys->index.version, version);
+
+	estat = get_gcl_path(gcl, -1, GCL_LXF_SUFFIX,
+					old_pbuf, sizeof old_pbuf);
+	EP_STAT_CHECK(estat, goto fail0);
+	estat = get_gcl_path(gcl, -1, GCL_LXF_SUFFIX "-new",
+					new_pbuf, sizeof new_pbuf);
+	EP_STAT_CHECK(estat, goto fail0);
+
+	memset(&newx, 0, sizeof newx);
+	fd = open(new_pbuf, O_RDWR | O_CREAT | O_TRUNC | O_APPEND, 0644);
+	if (fd < 0 || (newx.fp = fdopen(fd, "a+")) == NULL)
+	{
+		estat = posix_error(errno, "index_convert: cannot create %s",
+					new_pbuf);
+		if (fd >= 0)
+			(void) close(fd);
+		goto fail0;
+	}
+	newx.version = version;
+	if (version == GCL_LXF_VERS_BLOCK)
+		newx.block_entries = INDEX_BLOCK_ENTRIES;
+
+	// copy the bulk of the index
+	ep_thr_rwlock_rdlock(&phys->lock);
+	newx.min_recno = recno = phys->index.min_recno;
+	gen = phys->index.gen;
+	ep_thr_rwlock_unlock(&phys->lock);
+	estat = index_write_header(&newx);
+	EP_STAT_CHECK(estat, goto fail1);
+	do
+	{
+		ep_thr_rwlock_rdlock(&phys->lock);
+		if (phys->index.gen != gen)
+			estat = EP_STAT_ABORT;
+		else
+			estat = index_copy(gcl, &newx, &recno,
+						phys->max_recno < recno + INDEX_CONVERT_CHUNK ?
+							phys->max_recno : recno + INDEX_CONVERT_CHUNK);
+		done = recno > phys->max_recno;
+		ep_thr_rwlock_unlock(&phys->lock);
+		EP_STAT_CHECK(estat, goto fail1);
+	} while (!done);
+	if (fflush(newx.fp) < 0 || ferror(newx.fp) || fsync(fileno(newx.fp)) < 0)
+	{
+		estat = posix_error(errno, "index_convert: cannot write %s",
+					new_pbuf);
+		goto fail1;
+	}
+
+	// catch up with any appends and switch over
+	ep_thr_rwlock_wrlock(&phys->lock);
+	if (phys->index.gen != gen)
+	{
+		estat = EP_STAT_ABORT;
+		goto fail2;
+	}
+	estat = index_copy(gcl, &newx, &recno, phys->max_recno);
+	EP_STAT_CHECK(estat, goto fail2);
+	if (fflush(newx.fp) < 0 || ferror(newx.fp) || fsync(fileno(newx.fp)) < 0)
+	{
+		estat = posix_error(errno, "index_convert: cannot write %s",
+					new_pbuf);
+		goto fail2;
+	}
+	if (rename(new_pbuf, old_pbuf) < 0)
+	{
+		estat = posix_error(errno, "index_convert: cannot rename %s",
+					new_pbuf);
+		goto fail2;
+	}
+
+	fdcache_remove(&phys->index.fdc);
+	if (phys->index.fp != NULL && fclose(phys->index.fp) != 0)
+		(void) posix_error(errno, "index_convert: cannot close old index");
+	phys->index.fp = newx.fp;
+	phys->index.max_offset = newx.max_offset;
+	phys->index.alloc_offset = phys->index.flush_offset = newx.max_offset;
+	phys->index.header_size = newx.header_size;
+	phys->index.version = newx.version;
+	phys->index.block_entries = newx.block_entries;
+	phys->index.block = newx.block;
+	phys->index.last_extent = newx.last_extent;
+	fdcache_add(phys, &phys->index.fdc, &phys->index.fp);
+	ep_thr_rwlock_unlock(&phys->lock);
+	ep_dbg_cprintf(Dbg, 8, "index_convert(%s): %jd bytes\n",
+			gcl->pname, (intmax_t) newx.max_offset);
+	return EP_STAT_OK;
+
+fail2:
+	ep_thr_rwlock_unlock(&phys->lock);
+fail1:
+	fclose(newx.fp);
+	(void) unlink(new_pbuf);
+fail0:
+	return estat;
+}
+
+static void
+index_convert_thread(void *gcl_)
+{
+	gdp_gcl_t *gcl = gcl_;
+	EP_STAT estat;
+
+	// failure is not fatal; we can keep using the old index
+	estat = index_convert(gcl, CompactIndex ?
+					GCL_LXF_VERS_BLOCK : GCL_LXF_VERS_FLAT);
+	if (!EP_STAT_ISOK(estat) && ep_dbg_test(Dbg, 8))
+	{
+		char ebuf[100];
+
+		ep_dbg_printf("index_convert(%s): not converted: %s\n",
+				gcl->pname, ep_stat_tostr(estat, ebuf, sizeof ebuf));
+	}
+	_gdp_gcl_decref(&gcl);
+}
+
+
+/*
+**  Chain and data hashes
+**
+**		REC_HASHLEN returns the lengths of the chash and dhash
+**		fields implied by a record's hashalgs.
+**
+**		RECORD_GET_LINK reads the record header at the current
+**		position of fp and returns its link value (see
+**		gdp/gdp_hashchain.h), or zero if it doesn't have hashes.
+**		On return fp is positioned at the start of the data.
+*/
+
+static void
+rec_hashlen(uint8_t hashalgs, size_t *clenp, size_t *dlenp)
+{
+	*clenp = REC_CHASH_ALG(hashalgs) == 0 ? 0 :
+				ep_crypto_md_len(REC_CHASH_ALG(hashalgs));
+	*dlenp = REC_DHASH_ALG(hashalgs) == 0 ? 0 :
+				ep_crypto_md_len(REC_DHASH_ALG(hashalgs));
+}
+
+/*
+**  Record header encoding
+**
+**		RECORD_ENCODE puts the on-disk form of a record header (given
+**		in host order) into buf, leaving out the checksum, and returns
+**		its length.  RECORD_SET_CHECKSUM then adds the checksum and
+**		returns the new length.  RECORD_READ_HEADER reads a header at
+**		the current position of fp, leaving fp just after it, and
+**		returns it in host order along with its length and the CRC of
+**		the part covered by the checksum.  Compact headers don't
+**		include the record number, so the caller has to supply it.
+*/
+
+#define REC_HDR_MAXSIZE		(sizeof (extent_record_t) > REC2_HDR_MAXSIZE ? \
+								sizeof (extent_record_t) : REC2_HDR_MAXSIZE)
+
+static size_t
+record_encode(extent_t *ext, const extent_record_t *rec, uint8_t *buf)
+{
+	size_t n;
+	uint8_t flags = 0;
+
+	if (ext->ver < GCL_LDF_VERS_COMPACT)
+	{
+		extent_record_t r = *rec;
+
+		r.recno = ep_net_hton64(r.recno);
+		ep_net_hton_timespec(&r.timestamp);
+		r.sigmeta = ep_net_hton16(r.sigmeta);
+		r.flags = ep_net_hton16(r.flags);
+		r.reserved1 = 0;
+		r.reserved2 = 0;
+		r.checksum = 0;
+		r.data_length = ep_net_hton32(r.data_length);
+		memcpy(buf, &r, sizeof r);
+		return sizeof r;
+	}
+
+	n = 1;						// leave room for flags
+	n += ep_varint_put((uint32_t) rec->data_length, &buf[n]);
+	if (rec->hashalgs != 0)
+	{
+		flags |= REC2_HAS_HASHES;
+		buf[n++] = rec->hashalgs;
+	}
+	if (rec->sigmeta != 0)
+	{
+		flags |= REC2_HAS_SIGNATURE;
+		buf[n++] = (rec->sigmeta >> 8) & 0xff;
+		buf[n++] = rec->sigmeta & 0xff;
+	}
+	if (EP_TIME_ISVALID(&rec->timestamp))
+	{
+		flags |= REC2_HAS_TIMESTAMP;
+		n += ep_varint_put(EP_ZIGZAG_ENC(rec->timestamp.tv_sec - ext->base_time),
+						&buf[n]);
+		n += ep_varint_put((uint32_t) rec->timestamp.tv_nsec, &buf[n]);
+		if (rec->timestamp.tv_accuracy != 0.0)
+		{
+			uint32_t acc;
+
+			flags |= REC2_HAS_ACCURACY;
+			memcpy(&acc, &rec->timestamp.tv_accuracy, sizeof acc);
+			acc = ep_net_hton32(acc);
+			memcpy(&buf[n], &acc, sizeof acc);
+			n += sizeof acc;
+		}
+	}
+	if (EP_UT_BITSET(REC_IS_COMPRESSED, rec->flags))
+		flags |= REC2_IS_COMPRESSED;
+	if (EP_UT_BITSET(REC_HAS_CHECKSUM, rec->flags))
+		flags |= REC2_HAS_CHECKSUM;
+	buf[0] = flags;
+	return n;
+}
+
+static size_t
+record_set_checksum(extent_t *ext, uint8_t *buf, size_t len, uint32_t crc)
+{
+	crc = ep_net_hton32(crc);
+	if (ext->ver < GCL_LDF_VERS_COMPACT)
+	{
+		memcpy(&buf[offsetof(extent_record_t, checksum)], &crc, sizeof crc);
+		return len;
+	}
+	memcpy(&buf[len], &crc, sizeof crc);
+	return len + sizeof crc;
+}
+
+static EP_STAT
+record_read_header(FILE *fp,
+		extent_t *ext,
+		gdp_recno_t recno,
+		extent_record_t *rec,
+		size_t *hlenp,
+		uint32_t *crcp)
+{
+	uint8_t buf[REC_HDR_MAXSIZE];
+	uint8_t flags;
+	uint64_t v;
+	size_t n, i, l;
+	off_t off;
+
+	if (ext->ver < GCL_LDF_VERS_COMPACT)
+	{
+		if (fread(rec, sizeof *rec, 1, fp) != 1)
+			return ep_stat_from_errno(errno);
+
+		// the checksum covers the header as it is on disk
+		rec->checksum = ep_net_ntoh32(rec->checksum);
+		memcpy(buf, rec, sizeof *rec);
+		memset(&buf[offsetof(extent_record_t, checksum)], 0,
+				sizeof rec->checksum);
+		*crcp = ep_crc32c(0, buf, sizeof *rec);
+
+		rec->recno = ep_net_ntoh64(rec->recno);
+		ep_net_ntoh_timespec(&rec->timestamp);
+		rec->sigmeta = ep_net_ntoh16(rec->sigmeta);
+		rec->flags = ep_net_ntoh16(rec->flags);
+		rec->reserved2 = ep_net_ntoh16(rec->reserved2);
+		rec->data_length = ep_net_ntoh32(rec->data_length);
+		*hlenp = sizeof *rec;
+		return EP_STAT_OK;
+	}
+
+	// the header is variable length: read as much as it might be
+	off = ftello(fp);
+	n = fread(buf, 1, sizeof buf, fp);
+	if (n < 1)
+		return ep_stat_from_errno(errno);
+
+	memset(rec, 0, sizeof *rec);
+	rec->recno = recno;
+	flags = buf[0];
+	i = 1;
+	if ((l = ep_varint_get(&buf[i], n - i, &v)) == 0)
+		goto corrupt;
+	i += l;
+	rec->data_length = (int32_t) v;
+	if (EP_UT_BITSET(REC2_HAS_HASHES, flags))
+	{
+		if (i + 1 > n)
+			goto corrupt;
+		rec->hashalgs = buf[i++];
+	}
+	if (EP_UT_BITSET(REC2_HAS_SIGNATURE, flags))
+	{
+		if (i + 2 > n)
+			goto corrupt;
+		rec->sigmeta = (buf[i] << 8) | buf[i + 1];
+		i += 2;
+	}
+	if (EP_UT_BITSET(REC2_HAS_TIMESTAMP, flags))
+	{
+		if ((l = ep_varint_get(&buf[i], n - i, &v)) == 0)
+			goto corrupt;
+		i += l;
+		rec->timestamp.tv_sec = ext->base_time + EP_ZIGZAG_DEC(v);
+		if ((l = ep_varint_get(&buf[i], n - i, &v)) == 0)
+			goto corrupt;
+		i += l;
+		rec->timestamp.tv_nsec = (int32_t) v;
+	}
+	else
+	{
+		EP_TIME_INVALIDATE(&rec->timestamp);
+	}
+	if (EP_UT_BITSET(REC2_HAS_ACCURACY, flags))
+	{
+		uint32_t acc;
+
+		if (i + sizeof acc > n)
+			goto corrupt;
+		memcpy(&acc, &buf[i], sizeof acc);
+		acc = ep_net_ntoh32(acc);
+		memcpy(&rec->timestamp.tv_accuracy, &acc, sizeof acc);
+		i += sizeof acc;
+	}
+	if (EP_UT_BITSET(REC2_IS_COMPRESSED, flags))
+		rec->flags |= REC_IS_COMPRESSED;
+	*crcp = ep_crc32c(0, buf, i);
+	if (EP_UT_BITSET(REC2_HAS_CHECKSUM, flags))
+	{
+		if (i + sizeof rec->checksum > n)
+			goto corrupt;
+		memcpy(&rec->checksum, &buf[i], sizeof rec->checksum);
+		rec->checksum = ep_net_ntoh32(rec->checksum);
+		rec->flags |= REC_HAS_CHECKSUM;
+		i += sizeof rec->checksum;
+	}
+
+	*hlenp = i;
+	if (fseeko(fp, off + i, SEEK_SET) < 0)
+		return ep_stat_from_errno(errno);
+	return EP_STAT_OK;
+
+corrupt:
+	ep_dbg_cprintf(Dbg, 1, "record_read_header: bad header at %jd\n",
+			(intmax_t) off);
+	return GDP_STAT_CORRUPT_GCL;
+}
+
+
+static EP_STAT
+record_get_link(FILE *fp,
+		extent_t *ext,
+		gdp_recno_t recno,
+		extent_record_t *rec,
+		size_t *hlenp,
+		int *algp,
+		uint8_t *link)
+{
+	EP_STAT estat;
+	uint8_t chash[EP_CRYPTO_MD_MAXSIZE];
+	uint8_t dhash[EP_CRYPTO_MD_MAXSIZE];
+	size_t clen, dlen;
+	uint32_t crc;
+
+	*algp = 0;
+	estat = record_read_header(fp, ext, recno, rec, hlenp, &crc);
+	EP_STAT_CHECK(estat, return estat);
+
+	rec_hashlen(rec->hashalgs, &clen, &dlen);
+	if (clen > 0 && fread(chash, clen, 1, fp) != 1)
+		return ep_stat_from_errno(errno);
+	if (dlen > 0 && fread(dhash, dlen, 1, fp) != 1)
+		return ep_stat_from_errno(errno);
+
+	// we only chain when both hashes use the same algorithm
+	if (clen > 0 && REC_CHASH_ALG(rec->hashalgs) ==
+						REC_DHASH_ALG(rec->hashalgs))
+	{
+		*algp = REC_CHASH_ALG(rec->hashalgs);
+		_gdp_hash_link(*algp, chash, rec->recno, dhash, link);
+	}
+	return EP_STAT_OK;
+}
+
+
+/*
+**  RECORD_NEXT_OFFSET --- find where the record after this one starts
+**
+**		Used to resolve index markers.  The caller must hold the
+**		log lock.
+*/
+
+static EP_STAT
+record_next_offset(gdp_gcl_t *gcl,
+		uint32_t extno,
+		int64_t offset,
+		int64_t *nextp)
+{
+	EP_STAT estat;
+	extent_t *ext;
+	extent_record_t rec;
+	size_t hlen, clen, dlen;
+	uint32_t crc;
+	FILE *rfp;
+
+	ext = extent_get(gcl, extno);
+	estat = extent_open(gcl, ext);
+	EP_STAT_CHECK(estat, return estat);
+
+	if (ext->dfd >= 0)
+	{
+		uint8_t hbuf[REC_HDR_MAXSIZE];
+		size_t len = sizeof hbuf;
+		ssize_t n;
+
+		if ((off_t) len > ext->max_offset - offset)
+			len = ext->max_offset - offset;
+		n = bcache_read(ext->cacheid, ext->dfd, hbuf, len, offset);
+		if (n <= 0 || (rfp = fmemopen(hbuf, n, "r")) == NULL)
+			return posix_error(errno, "record_next_offset: cannot read header");
+		estat = record_read_header(rfp, ext, 0, &rec, &hlen, &crc);
+		fclose(rfp);
+	}
+	else
+	{
+		rfp = ext->fp;
+		flockfile(rfp);
+		if (fseeko(rfp, offset, SEEK_SET) < 0)
+			estat = ep_stat_from_errno(errno);
+		else
+			estat = record_read_header(rfp, ext, 0, &rec, &hlen, &crc);
+		funlockfile(rfp);
+	}
+	EP_STAT_CHECK(estat, return estat);
+
+	rec_hashlen(rec.hashalgs, &clen, &dlen);
+	*nextp = offset + hlen + clen + dlen + rec.data_length +
+				(rec.sigmeta & 0x0fff);
+	return EP_STAT_OK;
+}
+
+
+/*
+**  CHAIN_LOAD --- find the link value of the last record
+**
+**		Needed before we can append a record with a chain hash.
+**		Done lazily since it involves reading the last record.
+**		The caller must hold the write lock.
+*/
+
+static EP_STAT
+chain_load(gdp_gcl_t *gcl)
+{
+	EP_STAT estat = EP_STAT_OK;
+	gcl_physinfo_t *phys = GETPHYS(gcl);
+	index_entry_t xent;
+	extent_record_t rec;
+	size_t hlen;
+	extent_t *ext;
+
+	phys->chain_valid = true;
+	phys->chainalg = 0;
+	if (phys->max_recno < phys->min_recno || phys->max_recno == 0)
+		return EP_STAT_OK;
+
+	estat = index_lookup(gcl, phys->max_recno, &xent);
+	EP_STAT_CHECK(estat, goto fail0);
+	ext = extent_get(gcl, xent.extent);
+	estat = extent_open(gcl, ext);
+	EP_STAT_CHECK(estat, goto fail0);
+
+	flockfile(ext->fp);
+	if (fseek(ext->fp, xent.offset, SEEK_SET) < 0)
+		estat = ep_stat_from_errno(errno);
+	else
+		estat = record_get_link(ext->fp, ext, phys->max_recno, &rec, &hlen,
+						&phys->chainalg, phys->chain);
+	funlockfile(ext->fp);
+
+fail0:
+	if (!EP_STAT_ISOK(estat))
+	{
+		// start a new chain rather than refusing to append
+		ep_log(estat, "chain_load(%s): cannot read last record", gcl->pname);
+		phys->chainalg = 0;
+	}
+	return estat;
+}
+
+
+/*
+**  Record compression
+**
+**		DICT_LOAD reads the log's compression dictionary, if it has
+**		one.  DICT_ADD_SAMPLE saves the data of new records until
+**		there are enough to train a dictionary, and then trains one
+**		and writes it out.  Both must be called holding the write
+**		lock.
+**
+**		RECORD_COMPRESS returns the on-disk form of some data if
+**		compressing it saves space (or zero if it doesn't).
+**		RECORD_DECOMPRESS reverses that, appending to a buffer.
+*/
+
+#define MAX_SAMPLE_SIZE		4096		// bigger records don't need a dict
+
+static void
+dict_load(gdp_gcl_t *gcl)
+{
+	gcl_physinfo_t *phys = GETPHYS(gcl);
+	char dict_pbuf[GCL_PATH_MAX];
+	struct stat st;
+	FILE *fp;
+	void *dictdata;
+
+	if (!EP_STAT_ISOK(get_gcl_path(gcl, -1, GCL_DICT_SUFFIX,
+						dict_pbuf, sizeof dict_pbuf)))
+		return;
+	if ((fp = fopen(dict_pbuf, "r")) == NULL)
+		return;					// no dictionary (yet)
+	phys->dict_done = true;
+	if (fstat(fileno(fp), &st) < 0 || st.st_size <= 0)
+	{
+		fclose(fp);
+		return;
+	}
+	dictdata = ep_mem_malloc(st.st_size);
+	if (fread(dictdata, st.st_size, 1, fp) != 1)
+		(void) posix_error(errno, "dict_load: cannot read %s", dict_pbuf);
+	else if ((phys->cdict = ep_compress_dict_new(EP_COMPRESS_ZSTD,
+						CompressLevel, dictdata, st.st_size)) == NULL)
+		ep_log(EP_STAT_COMPRESS_DICT, "dict_load: cannot use %s", dict_pbuf);
+	else
+		ep_dbg_cprintf(Dbg, 10, "dict_load(%s): dictionary %" PRIu32 "\n",
+				gcl->pname, ep_compress_dict_id(phys->cdict));
+	ep_mem_free(dictdata);
+	fclose(fp);
+}
+
+
+static void
+dict_train(gdp_gcl_t *gcl)
+{
+	EP_STAT estat;
+	gcl_physinfo_t *phys = GETPHYS(gcl);
+	char dict_pbuf[GCL_PATH_MAX];
+	char tmp_pbuf[GCL_PATH_MAX];
+	size_t dictlen = CompressDictSize;
+	void *dictdata = ep_mem_malloc(dictlen);
+	FILE *fp;
+
+	// we only try once per open, successful or not
+	phys->dict_done = true;
+
+	estat = ep_compress_dict_train(EP_COMPRESS_ZSTD, phys->dsamples,
+					phys->dsizes, phys->ndsamples, dictdata, &dictlen);
+	EP_STAT_CHECK(estat, goto done);
+
+	// write it out so we can decompress after a restart
+	estat = get_gcl_path(gcl, -1, GCL_DICT_SUFFIX,
+					dict_pbuf, sizeof dict_pbuf);
+	EP_STAT_CHECK(estat, goto done);
+	estat = get_gcl_path(gcl, -1, GCL_DICT_SUFFIX "-new",
+					tmp_pbuf, sizeof tmp_pbuf);
+	EP_STAT_CHECK(estat, goto done);
+	if ((fp = fopen(tmp_pbuf, "w")) == NULL)
+	{
+		estat = posix_error(errno, "dict_train: cannot create %s", tmp_pbuf);
+		goto done;
+	}
+	if (fwrite(dictdata, dictlen, 1, fp) != 1 || fflush(fp) < 0 ||
+			fsync(fileno(fp)) < 0)
+		estat = posix_error(errno, "dict_train: cannot write %s", tmp_pbuf);
+	fclose(fp);
+	if (EP_STAT_ISOK(estat) && link(tmp_pbuf, dict_pbuf) < 0)
+	{
+		// don't replace a dictionary that records may already use
+		estat = posix_error(errno, "dict_train: cannot install %s",
+					dict_pbuf);
+	}
+	(void) unlink(tmp_pbuf);
+	EP_STAT_CHECK(estat, goto done);
+
+	phys->cdict = ep_compress_dict_new(EP_COMPRESS_ZSTD, CompressLevel,
+					dictdata, dictlen);
+	ep_dbg_cprintf(Dbg, 10, "dict_train(%s): %zd byte dictionary %" PRIu32
+			" from %u records\n",
+			gcl->pname, dictlen, ep_compress_dict_id(phys->cdict),
+			phys->ndsamples);
+
+done:
+	if (!EP_STAT_ISOK(estat))
+		ep_log(estat, "dict_train(%s): no dictionary", gcl->pname);
+	ep_mem_free(dictdata);
+	ep_mem_free(phys->dsamples);
+	ep_mem_free(phys->dsizes);
+	phys->dsamples = NULL;
+	phys->dsizes = NULL;
+	phys->dsamplelen = 0;
+	phys->ndsamples = 0;
+}
+
+
+static void
+dict_add_sample(gdp_gcl_t *gcl, const uint8_t *dp, size_t dlen)
+{
+	gcl_physinfo_t *phys = GETPHYS(gcl);
+
+	if (phys->dict_done || dlen == 0 || dlen > MAX_SAMPLE_SIZE)
+		return;
+	if (phys->dsizes == NULL)
+		phys->dsizes = ep_mem_malloc(CompressDictSamples *
+								sizeof *phys->dsizes);
+	phys->dsamples = ep_mem_realloc(phys->dsamples,
+								phys->dsamplelen + dlen);
+	memcpy(phys->dsamples + phys->dsamplelen, dp, dlen);
+	phys->dsamplelen += dlen;
+	phys->dsizes[phys->ndsamples++] = dlen;
+	if (phys->ndsamples >= CompressDictSamples)
+		dict_train(gcl);
+}
+
+
+static size_t
+record_compress(gcl_physinfo_t *phys,
+		const uint8_t *dp,
+		size_t dlen,
+		uint8_t **zbufp)
+{
+	EP_STAT estat;
+	uint8_t *zbuf;
+	size_t n;
+	size_t zlen;
+
+	// algorithm and uncompressed length come first
+	zbuf = ep_mem_malloc(1 + EP_VARINT_MAXLEN + dlen);
+	zbuf[0] = CompressAlg;
+	n = 1 + ep_varint_put(dlen, &zbuf[1]);
+
+	// only worth it if it ends up smaller
+	if (n + 1 >= dlen)
+		goto fail0;
+	zlen = dlen - n - 1;
+	estat = ep_compress(CompressAlg, CompressLevel, phys->cdict,
+					dp, dlen, &zbuf[n], &zlen);
+	EP_STAT_CHECK(estat, goto fail0);
+	*zbufp = zbuf;
+	return n + zlen;
+
+fail0:
+	ep_mem_free(zbuf);
+	return 0;
+}
+
+
+static EP_STAT
+record_decompress(gcl_physinfo_t *phys,
+		const uint8_t *zbuf,
+		size_t zlen,
+		gdp_buf_t *dbuf)
+{
+	EP_STAT estat;
+	uint64_t olen;
+	size_t n;
+	size_t outlen;
+	uint8_t *out;
+
+	if (zlen < 2 || (n = ep_varint_get(&zbuf[1], zlen - 1, &olen)) == 0 ||
+			olen > INT32_MAX)
+		return GDP_STAT_CORRUPT_GCL;
+	n++;
+	outlen = olen;
+	out = ep_mem_malloc(outlen + 1);
+	estat = ep_decompress(zbuf[0], phys->cdict, &zbuf[n], zlen - n,
+					out, &outlen);
+	if (EP_STAT_ISOK(estat) && outlen != olen)
+		estat = GDP_STAT_CORRUPT_GCL;
+	if (EP_STAT_ISOK(estat))
+		gdp_buf_write(dbuf, out, outlen);
+	ep_mem_free(out);
+	return estat;
+}
+
+
+/*
+**  DISK_SCAN --- call function for each GCL in directory
+**
+**		This looks at every index file in every subdirectory, so
+**		it is slow when there are many logs.
+*/
+
+static void
+disk_scan(void (*func)(gdp_name_t, void *), void *ctx)
+{
+	int subdir;
+
+	for (subdir = 0; subdir < 0x100; subdir++)
+	{
+		DIR *dir;
+		char dbuf[400];
+
+		snprintf(dbuf, sizeof dbuf, "%s/_%02x", GCLDir, subdir);
+		dir = opendir(dbuf);
+		if (dir == NULL)
+			continue;
+
+		for (;;)
+		{
+			struct dirent dentbuf;
+			struct dirent *dent;
+
+			// read the next directory entry
+			int i = readdir_r(dir, &dentbuf, &dent);
+			if (i != 0)
+			{
+				ep_log(ep_stat_from_errno(i),
+						"gcl_physforeach: readdir_r(%s) failed", dbuf);
+				break;
+			}
+			if (dent == NULL)
+				break;
+
+			// we're only interested in .gdpndx files
+			char *p = strrchr(dent->d_name, '.');
+			if (p == NULL || strcmp(p, GCL_LXF_SUFFIX) != 0)
+				continue;
+
+			// strip off the file extension
+			*p = '\0';
+
+			// convert the base64-encoded name to internal form
+			gdp_name_t gname;
+			EP_STAT estat = gdp_internal_name(dent->d_name, gname);
+			EP_STAT_CHECK(estat, continue);
+
+			// now call the function
+			(*func)((uint8_t *) gname, ctx);
+		}
+		closedir(dir);
+	}
+}
+
+/*
+**  Manifest of hosted logs (see logd_disklog.h)
+**
+**		The names are kept in memory as well so that enumerating
+**		them is just a walk of the array.  It is loaded the first
+**		time it is needed; ManifestFd >= 0 means it is usable.
+*/
+
+static EP_THR_MUTEX	ManifestMutex	EP_THR_MUTEX_INITIALIZER;
+static gdp_name_t	*ManifestNames;	// all hosted log names
+static size_t		ManifestN;		// number of names in use
+static size_t		ManifestAlloc;	// number of names allocated
+static int			ManifestFd = -1;	// open for appending
+static bool			ManifestTried;	// have we tried loading it?
+
+static void
+manifest_addname(gdp_name_t name, void *unused)
+{
+	if (ManifestN >= ManifestAlloc)
+	{
+		ManifestAlloc = ManifestAlloc == 0 ? 1024 : ManifestAlloc * 2;
+		ManifestNames = ep_mem_realloc(ManifestNames,
+							ManifestAlloc * sizeof ManifestNames[0]);
+	}
+	memcpy(ManifestNames[ManifestN++], name, sizeof ManifestNames[0]);
+}
+
+
+/*
+**  MANIFEST_LOAD --- read an existing manifest
+**
+**		A trailing partial name (from a crash while appending)
+**		is truncated away.
+*/
+
+static EP_STAT
+manifest_load(const char *path)
+{
+	uint8_t hbuf[GCL_MANIFEST_HDRSIZE];
+	uint32_t t32;
+	struct stat st;
+	size_t n;
+	int fd;
+
+	fd = open(path, O_RDWR | O_APPEND);
+	if (fd < 0)
+		return ep_stat_from_errno(errno);
+	if (fstat(fd, &st) < 0 ||
+			read(fd, hbuf, sizeof hbuf) != sizeof hbuf)
+		goto fail1;
+	memcpy(&t32, &hbuf[0], sizeof t32);
+	if (ep_net_ntoh32(t32) != GCL_MANIFEST_MAGIC)
+		goto fail1;
+	memcpy(&t32, &hbuf[4], sizeof t32);
+	if (ep_net_ntoh32(t32) != GCL_MANIFEST_VERSION)
+		goto fail1;
+
+	// now all the names in one go
+	n = (st.st_size - sizeof hbuf) / sizeof ManifestNames[0];
+	ManifestAlloc = n < 1024 ? 1024 : n + n / 4;
+	ManifestNames = ep_mem_malloc(ManifestAlloc * sizeof ManifestNames[0]);
+	{
+		size_t len = n * sizeof ManifestNames[0];
+		size_t off = 0;
+
+		while (off < len)
+		{
+			ssize_t i = read(fd, (uint8_t *) ManifestNames + off, len - off);
+
+			if (i <= 0)
+				goto fail2;
+			off += i;
+		}
+	}
+	ManifestN = n;
+	if ((off_t) (sizeof hbuf + n * sizeof ManifestNames[0]) != st.st_size &&
+			ftruncate(fd, sizeof hbuf + n * sizeof ManifestNames[0]) < 0)
+		goto fail2;
+
+	ManifestFd = fd;
+	ep_dbg_cprintf(Dbg, 8, "manifest_load: %zd logs\n", ManifestN);
+	return EP_STAT_OK;
+
+fail2:
+	ep_mem_free(ManifestNames);
+	ManifestNames = NULL;
+	ManifestN = ManifestAlloc = 0;
+fail1:
+	(void) close(fd);
+	return GDP_STAT_CORRUPT_GCL;
+}
+
+
+/*
+**  MANIFEST_REBUILD --- recreate the manifest from the directory
+**
+**		It is written under a temporary name and renamed into
+**		place so that a crash never leaves a partial manifest.
+*/
+
+static EP_STAT
+manifest_rebuild(const char *path)
+{
+	EP_STAT estat;
+	char tmppath[GCL_PATH_MAX];
+	uint8_t hbuf[GCL_MANIFEST_HDRSIZE];
+	uint32_t t32;
+	size_t len;
+	int fd;
+
+	ep_dbg_cprintf(Dbg, 2, "manifest_rebuild: scanning %s\n", GCLDir);
+	ManifestN = 0;
+	disk_scan(manifest_addname, NULL);
+
+	if (snprintf(tmppath, sizeof tmppath, "%s.%d", path, (int) getpid()) >=
+			(int) sizeof tmppath)
+	{
+		errno = ENAMETOOLONG;
+		goto fail0;
+	}
+	fd = open(tmppath, O_RDWR | O_CREAT | O_TRUNC, 0644);
+	if (fd < 0)
+		goto fail0;
+	memset(hbuf, 0, sizeof hbuf);
+	t32 = ep_net_hton32(GCL_MANIFEST_MAGIC);
+	memcpy(&hbuf[0], &t32, sizeof t32);
+	t32 = ep_net_hton32(GCL_MANIFEST_VERSION);
+	memcpy(&hbuf[4], &t32, sizeof t32);
+	len = ManifestN * sizeof ManifestNames[0];
+	if (write(fd, hbuf, sizeof hbuf) != sizeof hbuf ||
+			(len > 0 && write(fd, ManifestNames, len) != (ssize_t) len) ||
+			fsync(fd) < 0 ||
+			rename(tmppath, path) < 0)
+		goto fail1;
+	(void) close(fd);
+
+	// reopen for appending
+	ManifestFd = open(path, O_RDWR | O_APPEND);
+	if (ManifestFd < 0)
+		goto fail0;
+	ep_log(EP_STAT_OK, "manifest_rebuild: %zd logs in %s", ManifestN, path);
+	return EP_STAT_OK;
+
+fail1:
+	(void) close(fd);
+	(void) unlink(tmppath);
+fail0:
+	estat = ep_stat_from_errno(errno);
+	ep_log(estat, "manifest_rebuild: cannot write %s", path);
+	return estat;
+}
+
+
+/*
+**  MANIFEST_READY --- make sure the manifest is loaded
+**
+**		Returns false if there is no usable manifest, in which
+**		case the directory has to be scanned.
+*/
+
+static bool
+manifest_ready(void)
+{
+	char path[GCL_PATH_MAX];
+
+	if (!UseManifest)
+		return false;
+
+	ep_thr_mutex_lock(&ManifestMutex);
+	if (!ManifestTried)
+	{
+		ManifestTried = true;
+		snprintf(path, sizeof path, "%s/%s", GCLDir, GCL_MANIFEST_FILE);
+		if (RebuildManifest || !EP_STAT_ISOK(manifest_load(path)))
+			(void) manifest_rebuild(path);
+	}
+	ep_thr_mutex_unlock(&ManifestMutex);
+	return ManifestFd >= 0;
+}
+
+
+/*
+**  MANIFEST_ADD --- note that a new log has been created
+**
+**		The name is synced to disk before the create is
+**		acknowledged, since nothing else would ever add it.  If
+**		that fails the manifest is removed, so that it is rebuilt
+**		at the next startup, and the directory is scanned until
+**		then.
+*/
+
+static void
+manifest_add(gdp_name_t name)
+{
+	if (!manifest_ready())
+		return;
+
+	ep_thr_mutex_lock(&ManifestMutex);
+	if (ManifestFd >= 0 &&
+			(write(ManifestFd, name, sizeof (gdp_name_t)) !=
+				sizeof (gdp_name_t) ||
+			 logd_io_fsync(ManifestFd, true) < 0))
+	{
+		char path[GCL_PATH_MAX];
+
+		ep_log(ep_stat_from_errno(errno),
+				"manifest_add: write failed; manifest abandoned");
+		snprintf(path, sizeof path, "%s/%s", GCLDir, GCL_MANIFEST_FILE);
+		(void) unlink(path);
+		(void) close(ManifestFd);
+		ManifestFd = -1;
+	}
+	manifest_addname(name, NULL);
+	ep_thr_mutex_unlock(&ManifestMutex);
+}
+
+
+/*
+**  GCL_PHYSCREATE --- create a brand new GCL on disk
+*/
+
+static EP_STAT
+disk_create(gdp_gcl_t *gcl, gdp_gclmd_t *gmd)
+{
+	EP_STAT estat = EP_STAT_OK;
+	FILE *index_fp;
+	gcl_physinfo_t *phys;
+
+	EP_ASSERT_POINTER_VALID(gcl);
+
+	// allocate space for the physical information
+	phys = physinfo_alloc(gcl);
+	if (phys == NULL)
+		goto fail1;
+	phys->last_extent = 0;
+	gcl->x->physinfo = phys;
+	ep_thr_rwlock_wrlock(&phys->lock);
+
+	// allocate a name
+	if (!gdp_name_is_valid(gcl->name))
+	{
+		_gdp_gcl_newname(gcl);
+	}
+
+	// load (or rebuild) the manifest before our files exist, so a
+	// rebuild can't pick this log up and then have it added again
+	(void) manifest_ready();
+
+	// create an initial extent for the GCL
+	estat = extent_create(gcl, gmd, 0, 0);
+
+	// create an offset index for that gcl
 	{
 		int index_fd;
 		char index_pbuf[GCL_PATH_MAX];
@@ -845,20 +2901,23 @@ disk_create(gdp_gcl_t *gcl, gdp_gclmd_t *gmd)
 	}
 
 	// write the index header
+	phys->index.fp = index_fp;
+	phys->index.min_recno = 1;
+	if (CompactIndex)
 	{
-		index_header_t index_header;
-
-		index_header.magic = ep_net_hton32(GCL_LXF_MAGIC);
-		index_header.version = ep_net_hton32(GCL_LXF_VERSION);
-		index_header.header_size = ep_net_hton32(SIZEOF_INDEX_HEADER);
-		index_header.reserved1 = 0;
-		index_header.min_recno = ep_net_hton64(1);
-
-		if (fwrite(&index_header, sizeof index_header, 1, index_fp) != 1)
-		{
-			estat = posix_error(errno, "disk_create: cannot write header");
-			goto fail3;
-		}
+		phys->index.version = GCL_LXF_VERS_BLOCK;
+		phys->index.block_entries = INDEX_BLOCK_ENTRIES;
+	}
+	else
+	{
+		phys->index.version = GCL_LXF_VERS_FLAT;
+		phys->index.block_entries = 0;
+	}
+	estat = index_write_header(&phys->index);
+	if (!EP_STAT_ISOK(estat))
+	{
+		phys->index.fp = NULL;
+		goto fail3;
 	}
 
 	// create a cache for that index
@@ -866,10 +2925,11 @@ disk_create(gdp_gcl_t *gcl, gdp_gclmd_t *gmd)
 	EP_STAT_CHECK(estat, goto fail2);
 
 	// success!
-	phys->index.fp = index_fp;
-	phys->index.max_offset = phys->index.header_size = SIZEOF_INDEX_HEADER;
-	phys->index.min_recno = phys->min_recno = 1;
+	fdcache_add(phys, &phys->index.fdc, &phys->index.fp);
+	phys->min_recno = 1;
 	phys->max_recno = 0;
+	ep_thr_rwlock_unlock(&phys->lock);
+	manifest_add(gcl->name);
 	ep_dbg_cprintf(Dbg, 10, "Created new GCL %s\n", gcl->pname);
 	return estat;
 
@@ -878,6 +2938,7 @@ fail3:
 			index_fp);
 	fclose(index_fp);
 fail2:
+	ep_thr_rwlock_unlock(&phys->lock);
 fail1:
 	// turn OK into an errno-based code
 	if (EP_STAT_ISOK(estat))
@@ -915,10 +2976,9 @@ static EP_STAT
 disk_open(gdp_gcl_t *gcl)
 {
 	EP_STAT estat = EP_STAT_OK;
-	int fd;
 	FILE *index_fp;
 	gcl_physinfo_t *phys;
-	char index_pbuf[GCL_PATH_MAX];
+	const char *index_pbuf = gcl->pname;
 
 	// allocate space for physical data
 	EP_ASSERT_REQUIRE(gcl->x->physinfo == NULL);
@@ -929,23 +2989,13 @@ disk_open(gdp_gcl_t *gcl)
 		goto fail0;
 	}
 
+	// keep the open file cache away until we are done
+	ep_thr_rwlock_wrlock(&phys->lock);
+
 	// open the index file
-	estat = get_gcl_path(gcl, -1, GCL_LXF_SUFFIX,
-					index_pbuf, sizeof index_pbuf);
-	EP_STAT_CHECK(estat, goto fail0);
-	ep_dbg_cprintf(Dbg, 39, "disk_open: opening %s\n", index_pbuf);
-	fd = open(index_pbuf, O_RDWR | O_APPEND);
-	if (fd < 0 || flock(fd, LOCK_SH) < 0 ||
-			(index_fp = fdopen(fd, "a+")) == NULL)
-	{
-		estat = ep_stat_from_errno(errno);
-		if (EP_STAT_IS_SAME(estat, ep_stat_from_errno(ENOENT)))
-			estat = GDP_STAT_NAK_NOTFOUND;
-		ep_log(estat, "disk_open(%s): index open failure", index_pbuf);
-		if (fd >= 0)
-			close(fd);
-		goto fail0;
-	}
+	estat = index_open(gcl);
+	EP_STAT_CHECK(estat, goto fail1);
+	index_fp = phys->index.fp;
 
 	// check for valid index header (distinguish old and new format)
 	index_header_t index_header;
@@ -960,7 +3010,7 @@ disk_open(gdp_gcl_t *gcl)
 		estat = posix_error(errno,
 					"disk_open(%s): index header read failure",
 					index_pbuf);
-		goto fail0;
+		goto fail1;
 	}
 	else if (index_header.magic == 0)
 	{
@@ -970,56 +3020,87 @@ disk_open(gdp_gcl_t *gcl)
 	{
 		estat = GDP_STAT_CORRUPT_INDEX;
 		ep_log(estat, "disk_open(%s): bad index magic", index_pbuf);
-		goto fail0;
+		goto fail1;
 	}
 	else if (ep_net_ntoh32(index_header.version) < GCL_LXF_MINVERS ||
 			 ep_net_ntoh32(index_header.version) > GCL_LXF_MAXVERS)
 	{
 		estat = GDP_STAT_CORRUPT_INDEX;
 		ep_log(estat, "disk_open(%s): bad index version", index_pbuf);
-		goto fail0;
+		goto fail1;
 	}
 
 	if (index_header.magic == 0)
 	{
 		// old-style index; fake the header
+		index_header.version = GCL_LXF_VERS_FLAT;
 		index_header.min_recno = 1;
 		index_header.header_size = 0;
+		index_header.block_entries = 0;
 	}
 	else
 	{
+		index_header.version = ep_net_ntoh32(index_header.version);
 		index_header.min_recno = ep_net_ntoh64(index_header.min_recno);
 		index_header.header_size = ep_net_ntoh32(index_header.header_size);
+		index_header.block_entries = ep_net_ntoh32(index_header.block_entries);
+		if (index_header.version == GCL_LXF_VERS_BLOCK &&
+				index_header.block_entries == 0)
+		{
+			estat = GDP_STAT_CORRUPT_INDEX;
+			ep_log(estat, "disk_open(%s): bad index block size", index_pbuf);
+			goto fail1;
+		}
 	}
 
 	// create a cache for the index information
 	//XXX should do data too, but that's harder because it's variable size
 	estat = xcache_create(phys);
-	EP_STAT_CHECK(estat, goto fail0);
+	EP_STAT_CHECK(estat, goto fail1);
 
-	phys->index.fp = index_fp;
 	phys->index.max_offset = fsizeof(index_fp);
+	phys->index.alloc_offset = phys->index.flush_offset =
+							phys->index.max_offset;
 	phys->index.header_size = index_header.header_size;
 	phys->index.min_recno = index_header.min_recno;
+	phys->index.version = index_header.version;
+	phys->index.block_entries = index_header.block_entries;
 	phys->min_recno = index_header.min_recno;
-	phys->max_recno = ((phys->index.max_offset - index_header.header_size)
-							/ SIZEOF_INDEX_RECORD) - index_header.min_recno + 1;
+	phys->max_recno = index_nentries(&phys->index) +
+							index_header.min_recno - 1;
 	gcl->nrecs = phys->max_recno;
 
 	/*
 	**  Index header has been read.
-	**  Find the last extent mentioned in that index.
+	**  Find the last extent mentioned in that index (and if the
+	**  last block is partially filled, its header).
 	*/
 
+	phys->last_extent = 0;
+	if (phys->max_recno >= phys->min_recno)
+	{
+		index_entry_t xent;
+
+		estat = index_lookup(gcl, phys->max_recno, &xent);
+		EP_STAT_CHECK(estat, goto fail1);
+		phys->last_extent = phys->index.last_extent = xent.extent;
+	}
+	if (phys->index.version == GCL_LXF_VERS_BLOCK &&
+			index_nentries(&phys->index) % phys->index.block_entries != 0)
 	{
+		gdp_recno_t xno = index_nentries(&phys->index) - 1;
 		index_entry_t xent;
-		if (fseek(phys->index.fp, phys->index.max_offset - SIZEOF_INDEX_RECORD,
-					SEEK_SET) < 0 ||
-				fread(&xent, SIZEOF_INDEX_RECORD, 1, phys->index.fp) != 1)
-		{
-			goto fail0;
-		}
-		phys->last_extent = ep_net_ntoh32(xent.extent);
+
+		// the base may have moved since the block header
+		flockfile(phys->index.fp);
+		estat = index_block_walk(gcl,
+					(xno / phys->index.block_entries) *
+						SIZEOF_INDEX_BLOCK(phys->index.block_entries) +
+						phys->index.header_size,
+					xno % phys->index.block_entries,
+					&phys->index.block, &xent);
+		funlockfile(phys->index.fp);
+		EP_STAT_CHECK(estat, goto fail1);
 	}
 
 #if EXTENT_SUPPORT
@@ -1033,7 +3114,7 @@ disk_open(gdp_gcl_t *gcl)
 
 		estat = get_gcl_path(gcl, phys->last_extent + 1, GCL_LDF_SUFFIX,
 						data_pbuf, sizeof data_pbuf);
-		EP_STAT_CHECK(estat, goto fail0);
+		EP_STAT_CHECK(estat, goto fail1);
 		if (stat(data_pbuf, &stbuf) >= 0)
 			phys->last_extent++;
 	}
@@ -1049,7 +3130,19 @@ disk_open(gdp_gcl_t *gcl)
 	{
 		extent_t *ext = extent_get(gcl, phys->last_extent);
 		estat = extent_open(gcl, ext);
-		EP_STAT_CHECK(estat, goto fail0);
+		EP_STAT_CHECK(estat, goto fail1);
+	}
+
+	// compressed records may need the dictionary
+	dict_load(gcl);
+
+	// switch to the preferred index format in the background
+	if (ConvertIndex &&
+			phys->index.version != (CompactIndex ?
+						GCL_LXF_VERS_BLOCK : GCL_LXF_VERS_FLAT))
+	{
+		_gdp_gcl_incref(gcl);
+		ep_thr_pool_run(&index_convert_thread, gcl);
 	}
 
 	if (ep_dbg_test(Dbg, 20))
@@ -1057,8 +3150,11 @@ disk_open(gdp_gcl_t *gcl)
 		ep_dbg_printf("gcl_physopen => ");
 		physinfo_dump(phys, ep_dbg_getfile());
 	}
+	ep_thr_rwlock_unlock(&phys->lock);
 	return estat;
 
+fail1:
+	ep_thr_rwlock_unlock(&phys->lock);
 fail0:
 	if (EP_STAT_ISOK(estat))
 		estat = ep_stat_from_errno(errno);
@@ -1090,6 +3186,59 @@ disk_close(gdp_gcl_t *gcl)
 }
 
 
+/*
+**  RECORD_FETCH --- get an image of a record through the block cache
+**
+**		Used for direct I/O.  The header is read first to find out
+**		how long the record is, then the whole thing is copied
+**		into a buffer, which is opened as a stream so that it can
+**		be parsed just like the extent file itself.  The caller
+**		must fclose the stream and free the buffer.
+*/
+
+static EP_STAT
+record_fetch(extent_t *ext, off_t offset, uint8_t **bufp, FILE **fpp)
+{
+	uint8_t hbuf[REC_HDR_MAXSIZE];
+	extent_record_t rec;
+	size_t hlen, clen, dlen;
+	size_t reclen;
+	uint32_t crc;
+	ssize_t n;
+	EP_STAT estat;
+	FILE *fp;
+
+	reclen = sizeof hbuf;
+	if ((off_t) reclen > ext->max_offset - offset)
+		reclen = ext->max_offset - offset;
+	n = bcache_read(ext->cacheid, ext->dfd, hbuf, reclen, offset);
+	if (n <= 0 || (fp = fmemopen(hbuf, n, "r")) == NULL)
+		return posix_error(errno, "record_fetch: cannot read header");
+	estat = record_read_header(fp, ext, 0, &rec, &hlen, &crc);
+	fclose(fp);
+	EP_STAT_CHECK(estat, return estat);
+
+	rec_hashlen(rec.hashalgs, &clen, &dlen);
+	reclen = hlen + clen + dlen + rec.data_length + (rec.sigmeta & 0x0fff);
+	if ((off_t) reclen > ext->max_offset - offset)
+	{
+		ep_dbg_cprintf(Dbg, 1, "record_fetch: record at %jd runs off end\n",
+				(intmax_t) offset);
+		return GDP_STAT_CORRUPT_GCL;
+	}
+	*bufp = ep_mem_malloc(reclen);
+	n = bcache_read(ext->cacheid, ext->dfd, *bufp, reclen, offset);
+	if (n != (ssize_t) reclen || (*fpp = fmemopen(*bufp, reclen, "r")) == NULL)
+	{
+		estat = posix_error(errno, "record_fetch: cannot read record");
+		ep_mem_free(*bufp);
+		*bufp = NULL;
+		return estat;
+	}
+	return EP_STAT_OK;
+}
+
+
 /*
 **	GCL_PHYSREAD --- read a message from a gcl
 **
@@ -1127,6 +3276,13 @@ disk_read(gdp_gcl_t *gcl,
 		goto fail0;
 	}
 
+	// recent records can be returned without touching the files
+	if (tail_get(phys, datum))
+	{
+		ep_dbg_cprintf(Dbg, 14, "tail\n");
+		goto fail0;
+	}
+
 	// check if recno offset is in the index cache
 	xent = xcache_get(phys, datum->recno);
 	if (xent != NULL)
@@ -1135,52 +3291,9 @@ disk_read(gdp_gcl_t *gcl,
 	}
 	else
 	{
-		off_t xoff;
-
 		// recno is not in the index cache: read it from disk
-		flockfile(phys->index.fp);
-
-		xoff = (datum->recno - phys->index.min_recno) * SIZEOF_INDEX_RECORD +
-				phys->index.header_size;
-		ep_dbg_cprintf(Dbg, 14,
-				"recno=%" PRIgdp_recno ", min_recno=%" PRIgdp_recno
-				", index_hdrsize=%zd, xoff=%jd\n",
-				datum->recno, phys->min_recno,
-				phys->index.header_size, (intmax_t) xoff);
-		if (xoff >= phys->index.max_offset || xoff < phys->index.header_size)
-		{
-			// computed offset is out of range
-			estat = GDP_STAT_CORRUPT_INDEX;
-			ep_log(estat, "gcl_diskread(%s): computed offset %jd out of range (%jd max)",
-					gcl->pname,
-					(intmax_t) xoff, (intmax_t) phys->index.max_offset);
-			goto fail3;
-		}
 		xent = &index_entry;
-
-		if (fseek(phys->index.fp, xoff, SEEK_SET) < 0)
-		{
-			estat = posix_error(errno, "gcl_diskread: fseek failed");
-			goto fail3;
-		}
-		if (fread(xent, SIZEOF_INDEX_RECORD, 1, phys->index.fp) < 1)
-		{
-			estat = posix_error(errno, "gcl_diskread: fread failed");
-			goto fail3;
-		}
-		xent->recno = ep_net_ntoh64(xent->recno);
-		xent->offset = ep_net_ntoh64(xent->offset);
-		xent->extent = ep_net_ntoh32(xent->extent);
-		xent->reserved = ep_net_ntoh32(xent->reserved);
-
-		ep_dbg_cprintf(Dbg, 14,
-				"got index entry: recno %" PRIgdp_recno ", extent %" PRIu32
-				", offset=%jd, rsvd=%" PRIu32 "\n",
-				xent->recno, xent->extent,
-				(intmax_t) xent->offset, xent->reserved); 
-
-fail3:
-		funlockfile(phys->index.fp);
+		estat = index_lookup(gcl, datum->recno, xent);
 	}
 
 	EP_STAT_CHECK(estat, goto fail0);
@@ -1199,23 +3312,53 @@ fail3:
 		goto fail0;
 	}
 
-	// read record header
+	// position at the record (or get a copy of it)
+	FILE *rfp = ext->fp;
+	uint8_t *rbuf = NULL;
+
+	if (ext->dfd >= 0)
+	{
+		estat = record_fetch(ext, xent->offset, &rbuf, &rfp);
+		EP_STAT_CHECK(estat, goto fail0);
+	}
+	flockfile(rfp);
+	if (rbuf == NULL && fseek(rfp, xent->offset, SEEK_SET) < 0)
+	{
+		estat = ep_stat_from_errno(errno);
+		goto fail1;
+	}
+
+	// read record header (the checksum covers it as it is on disk)
 	extent_record_t log_record;
-	flockfile(ext->fp);
-	if (fseek(ext->fp, xent->offset, SEEK_SET) < 0 ||
-			fread(&log_record, sizeof log_record, 1, ext->fp) < 1)
+	size_t hlen;
+	uint32_t crc;
+
+	estat = record_read_header(rfp, ext, xent->recno, &log_record,
+					&hlen, &crc);
+	if (!EP_STAT_ISOK(estat))
 	{
-		ep_dbg_cprintf(Dbg, 1, "gcl_diskread: header fread failed: %s\n",
+		ep_dbg_cprintf(Dbg, 1, "gcl_diskread: header read failed: %s\n",
 				strerror(errno));
-		estat = ep_stat_from_errno(errno);
 		goto fail1;
 	}
+	uint32_t disk_crc = log_record.checksum;
+
+	bool check_crc = VerifyChecksums &&
+				EP_UT_BITSET(REC_HAS_CHECKSUM, log_record.flags);
+
+	// skip over the chain and data hashes (but checksum them)
+	char *phase = "hashes";
+	char read_buffer[GCL_READ_BUFFER_SIZE];
+	size_t clen, dlen;
 
-	log_record.recno = ep_net_ntoh64(log_record.recno);
-	ep_net_ntoh_timespec(&log_record.timestamp);
-	log_record.sigmeta = ep_net_ntoh16(log_record.sigmeta);
-	log_record.flags = ep_net_ntoh16(log_record.flags);
-	log_record.data_length = ep_net_ntoh32(log_record.data_length);
+	rec_hashlen(log_record.hashalgs, &clen, &dlen);
+	if (clen + dlen > 0)
+	{
+		if (fread(read_buffer, clen + dlen, 1, rfp) < 1)
+			goto fail2;
+		if (check_crc)
+			crc = ep_crc32c(crc, read_buffer, clen + dlen);
+	}
 
 	ep_dbg_cprintf(Dbg, 29, "gcl_diskread: recno %" PRIgdp_recno
 				", sigmeta 0x%x, dlen %" PRId32 ", offset %" PRId64 "\n",
@@ -1229,21 +3372,46 @@ fail3:
 
 
 	// read data in chunks and add it to the evbuffer
-	char read_buffer[GCL_READ_BUFFER_SIZE];
 	int64_t data_length = log_record.data_length;
 
-	char *phase = "data";
+	phase = "data";
+	if (EP_UT_BITSET(REC_IS_COMPRESSED, log_record.flags))
+	{
+		// compressed data has to be read all at once
+		uint8_t *zbuf = ep_mem_malloc(data_length + 1);
+
+		if (data_length > 0 && fread(zbuf, data_length, 1, rfp) < 1)
+		{
+			ep_mem_free(zbuf);
+			goto fail2;
+		}
+		if (check_crc)
+			crc = ep_crc32c(crc, zbuf, data_length);
+		estat = record_decompress(phys, zbuf, data_length, datum->dbuf);
+		ep_mem_free(zbuf);
+		if (!EP_STAT_ISOK(estat))
+		{
+			ep_log(estat, "gcl_diskread: %s: cannot decompress recno %"
+					PRIgdp_recno, gcl->pname, log_record.recno);
+			goto fail1;
+		}
+		data_length = 0;
+	}
 	while (data_length >= sizeof read_buffer)
 	{
-		if (fread(read_buffer, sizeof read_buffer, 1, ext->fp) < 1)
+		if (fread(read_buffer, sizeof read_buffer, 1, rfp) < 1)
 			goto fail2;
+		if (check_crc)
+			crc = ep_crc32c(crc, read_buffer, sizeof read_buffer);
 		gdp_buf_write(datum->dbuf, read_buffer, sizeof read_buffer);
 		data_length -= sizeof read_buffer;
 	}
 	if (data_length > 0)
 	{
-		if (fread(read_buffer, data_length, 1, ext->fp) < 1)
+		if (fread(read_buffer, data_length, 1, rfp) < 1)
 			goto fail2;
+		if (check_crc)
+			crc = ep_crc32c(crc, read_buffer, data_length);
 		gdp_buf_write(datum->dbuf, read_buffer, data_length);
 	}
 
@@ -1261,11 +3429,23 @@ fail3:
 			datum->sig = gdp_buf_new();
 		else
 			gdp_buf_reset(datum->sig);
-		if (fread(read_buffer, datum->siglen, 1, ext->fp) < 1)
+		if (fread(read_buffer, datum->siglen, 1, rfp) < 1)
 			goto fail2;
+		if (check_crc)
+			crc = ep_crc32c(crc, read_buffer, datum->siglen);
 		gdp_buf_write(datum->sig, read_buffer, datum->siglen);
 	}
 
+	if (check_crc && crc != disk_crc)
+	{
+		ep_log(GDP_STAT_CORRUPT_GCL,
+				"gcl_diskread: %s: checksum mismatch on recno %"
+				PRIgdp_recno " (extent %" PRIu32 ", offset %" PRId64 ")",
+				gcl->pname, log_record.recno, xent->extent, xent->offset);
+		gdp_buf_reset(datum->dbuf);
+		estat = GDP_STAT_CORRUPT_GCL;
+	}
+
 	// done
 
 	if (false)
@@ -1276,7 +3456,12 @@ fail2:
 		estat = ep_stat_from_errno(errno);
 	}
 fail1:
-	funlockfile(ext->fp);
+	funlockfile(rfp);
+	if (rbuf != NULL)
+	{
+		fclose(rfp);
+		ep_mem_free(rbuf);
+	}
 fail0:
 	ep_thr_rwlock_unlock(&phys->lock);
 
@@ -1284,19 +3469,218 @@ fail0:
 }
 
 /*
-**	GCL_PHYSAPPEND --- append a message to a writable gcl
+**  DISK_GETTIMESTAMP --- return the timestamp of a record
+**
+**		Like disk_read, but only the index entry and the record
+**		header are read.  Used when searching a log by time.
 */
 
 static EP_STAT
-disk_append(gdp_gcl_t *gcl,
-			gdp_datum_t *datum)
+disk_gettimestamp(gdp_gcl_t *gcl,
+		gdp_recno_t recno,
+		EP_TIME_SPEC *tsp)
 {
+	gcl_physinfo_t *phys = GETPHYS(gcl);
+	EP_STAT estat = EP_STAT_OK;
+	index_entry_t index_entry;
+	index_entry_t *xent;
+	extent_t *ext;
 	extent_record_t log_record;
-	int64_t record_size = sizeof log_record;
+	size_t hlen;
+	uint32_t crc;
+	FILE *rfp;
+
+	ep_thr_rwlock_rdlock(&phys->lock);
+	if (recno > phys->max_recno)
+	{
+		estat = GDP_STAT_NAK_NOTFOUND;
+		goto fail0;
+	}
+	if (recno < phys->min_recno)
+	{
+		estat = GDP_STAT_RECORD_EXPIRED;
+		goto fail0;
+	}
+	if (tail_get_timestamp(phys, recno, tsp))
+		goto fail0;
+
+	xent = xcache_get(phys, recno);
+	if (xent == NULL)
+	{
+		xent = &index_entry;
+		estat = index_lookup(gcl, recno, xent);
+		EP_STAT_CHECK(estat, goto fail0);
+	}
+
+	ext = extent_get(gcl, xent->extent);
+	estat = extent_open(gcl, ext);
+	if (!EP_STAT_ISOK(estat))
+	{
+		if (EP_STAT_IS_SAME(estat, ep_stat_from_errno(ENOENT)) &&
+				recno < phys->max_recno)
+			estat = GDP_STAT_RECORD_EXPIRED;
+		goto fail0;
+	}
+
+	if (ext->dfd >= 0)
+	{
+		// just the header, through the block cache
+		uint8_t hbuf[REC_HDR_MAXSIZE];
+		size_t len = sizeof hbuf;
+		ssize_t n;
+
+		if ((off_t) len > ext->max_offset - xent->offset)
+			len = ext->max_offset - xent->offset;
+		n = bcache_read(ext->cacheid, ext->dfd, hbuf, len, xent->offset);
+		if (n <= 0 || (rfp = fmemopen(hbuf, n, "r")) == NULL)
+		{
+			estat = posix_error(errno, "disk_gettimestamp: cannot read header");
+			goto fail0;
+		}
+		estat = record_read_header(rfp, ext, xent->recno, &log_record,
+						&hlen, &crc);
+		fclose(rfp);
+	}
+	else
+	{
+		rfp = ext->fp;
+		flockfile(rfp);
+		if (fseek(rfp, xent->offset, SEEK_SET) < 0)
+			estat = ep_stat_from_errno(errno);
+		else
+			estat = record_read_header(rfp, ext, xent->recno, &log_record,
+							&hlen, &crc);
+		funlockfile(rfp);
+	}
+	if (EP_STAT_ISOK(estat))
+		memcpy(tsp, &log_record.timestamp, sizeof *tsp);
+
+fail0:
+	ep_thr_rwlock_unlock(&phys->lock);
+	return estat;
+}
+
+
+/*
+**  DISK_GETCHAIN --- return the chain link of a record
+**
+**		Chains start at the first record of a log, so the link of
+**		record N is a digest of every record up to N: two copies
+**		of a log that have the same link for N have the same
+**		records up to there.  Replication uses this to notice a
+**		replica that has diverged from its leader.  *algp is set to
+**		zero if the record isn't chained.
+*/
+
+static EP_STAT
+disk_getchain(gdp_gcl_t *gcl,
+		gdp_recno_t recno,
+		int *algp,
+		uint8_t *link)
+{
+	gcl_physinfo_t *phys = GETPHYS(gcl);
+	EP_STAT estat = EP_STAT_OK;
 	index_entry_t index_entry;
+	index_entry_t *xent;
+	extent_t *ext;
+	extent_record_t log_record;
+	size_t hlen;
+	FILE *rfp;
+
+	*algp = 0;
+	ep_thr_rwlock_rdlock(&phys->lock);
+	if (recno > phys->max_recno)
+	{
+		estat = GDP_STAT_NAK_NOTFOUND;
+		goto fail0;
+	}
+	if (recno < phys->min_recno)
+	{
+		estat = GDP_STAT_RECORD_EXPIRED;
+		goto fail0;
+	}
+
+	// the last record's link is usually at hand
+	if (recno == phys->max_recno && phys->chain_valid)
+	{
+		*algp = phys->chainalg;
+		if (phys->chainalg != 0)
+			memcpy(link, phys->chain, ep_crypto_md_len(phys->chainalg));
+		goto fail0;
+	}
+
+	xent = xcache_get(phys, recno);
+	if (xent == NULL)
+	{
+		xent = &index_entry;
+		estat = index_lookup(gcl, recno, xent);
+		EP_STAT_CHECK(estat, goto fail0);
+	}
+
+	ext = extent_get(gcl, xent->extent);
+	estat = extent_open(gcl, ext);
+	EP_STAT_CHECK(estat, goto fail0);
+
+	if (ext->dfd >= 0)
+	{
+		// the header and hashes, through the block cache
+		uint8_t hbuf[REC_HDR_MAXSIZE + 2 * EP_CRYPTO_MD_MAXSIZE];
+		size_t len = sizeof hbuf;
+		ssize_t n;
+
+		if ((off_t) len > ext->max_offset - xent->offset)
+			len = ext->max_offset - xent->offset;
+		n = bcache_read(ext->cacheid, ext->dfd, hbuf, len, xent->offset);
+		if (n <= 0 || (rfp = fmemopen(hbuf, n, "r")) == NULL)
+		{
+			estat = posix_error(errno, "disk_getchain: cannot read header");
+			goto fail0;
+		}
+		estat = record_get_link(rfp, ext, xent->recno, &log_record,
+						&hlen, algp, link);
+		fclose(rfp);
+	}
+	else
+	{
+		rfp = ext->fp;
+		flockfile(rfp);
+		if (fseek(rfp, xent->offset, SEEK_SET) < 0)
+			estat = ep_stat_from_errno(errno);
+		else
+			estat = record_get_link(rfp, ext, xent->recno, &log_record,
+							&hlen, algp, link);
+		funlockfile(rfp);
+	}
+
+fail0:
+	ep_thr_rwlock_unlock(&phys->lock);
+	return estat;
+}
+
+
+/*
+**	GCL_PHYSAPPEND --- append a message to a writable gcl
+**
+**		APPEND_RECORD does the work with the log locked and the
+**		extent and index open.  Unless flush is set the data
+**		may still be in stdio buffers when it returns, so the
+**		caller must flush both files before unlocking.
+*/
+
+static EP_STAT
+append_record(gdp_gcl_t *gcl,
+			extent_t *ext,
+			gdp_datum_t *datum,
+			bool flush)
+{
+	extent_record_t log_record;
+	uint8_t hdrbuf[REC_HDR_MAXSIZE];
+	size_t hdrlen;
+	int64_t record_size;
+	int64_t record_offset;
+	ssize_t xlen;
 	size_t dlen;
 	gcl_physinfo_t *phys;
-	extent_t *ext;
 	EP_STAT estat = EP_STAT_OK;
 
 	if (ep_dbg_test(Dbg, 14))
@@ -1305,53 +3689,37 @@ disk_append(gdp_gcl_t *gcl,
 		_gdp_datum_dump(datum, ep_dbg_getfile());
 	}
 
-	phys = GETPHYS(gcl);
-	EP_ASSERT_POINTER_VALID(phys);
-	EP_ASSERT_POINTER_VALID(datum);
-	dlen = evbuffer_get_length(datum->dbuf);
-
-	ep_thr_rwlock_wrlock(&phys->lock);
-
-	ext = extent_get(gcl, phys->last_extent);
-	estat = extent_open(gcl, ext);
-	EP_STAT_CHECK(estat, return estat);
-
+	phys = GETPHYS(gcl);
+	EP_ASSERT_POINTER_VALID(phys);
+	EP_ASSERT_POINTER_VALID(datum);
+	dlen = evbuffer_get_length(datum->dbuf);
+
 	memset(&log_record, 0, sizeof log_record);
-	log_record.recno = ep_net_hton64(phys->max_recno + 1);
+	log_record.recno = phys->max_recno + 1;
 	log_record.timestamp = datum->ts;
-	ep_net_hton_timespec(&log_record.timestamp);
-	log_record.data_length = ep_net_hton32(dlen);
+	log_record.data_length = dlen;
 	log_record.sigmeta = (datum->siglen & 0x0fff) |
 				((datum->sigmdalg & 0x000f) << 12);
-	log_record.sigmeta = ep_net_hton16(log_record.sigmeta);
-	log_record.flags = ep_net_hton16(log_record.flags);
+	if (WriteChecksums)
+		log_record.flags |= REC_HAS_CHECKSUM;
 
-	// write log record header
-	fwrite(&log_record, sizeof log_record, 1, ext->fp);
+	// locate data and signature (needed for checksum before writing)
+	unsigned char *dp = NULL;
+	unsigned char *sp = NULL;
+	size_t slen = 0;
 
-	// write log record data
 	if (dlen > 0)
-	{
-		unsigned char *p = evbuffer_pullup(datum->dbuf, dlen);
-		if (p != NULL)
-			fwrite(p, dlen, 1, ext->fp);
-		record_size += dlen;
-	}
-
-	// write signature
+		dp = evbuffer_pullup(datum->dbuf, dlen);
 	if (datum->sig != NULL)
 	{
-		size_t slen = evbuffer_get_length(datum->sig);
-		unsigned char *p = evbuffer_pullup(datum->sig, slen);
+		slen = evbuffer_get_length(datum->sig);
+		sp = evbuffer_pullup(datum->sig, slen);
 
 		if (datum->siglen != slen)
 			ep_dbg_cprintf(Dbg, 1,
 					"disk_append: datum->siglen = %d, slen = %zd\n",
 					datum->siglen, slen);
 		EP_ASSERT_INSIST(datum->siglen == slen);
-		if (slen > 0 && p != NULL)
-			fwrite(p, slen, 1, ext->fp);
-		record_size += slen;
 	}
 	else if (datum->siglen > 0)
 	{
@@ -1360,30 +3728,325 @@ disk_append(gdp_gcl_t *gcl,
 				datum->siglen);
 	}
 
-	index_entry.recno = log_record.recno;	// already in net byte order
-	index_entry.offset = ep_net_hton64(ext->max_offset);
-	index_entry.extent = ep_net_hton32(phys->last_extent);
-	index_entry.reserved = 0;
+	// chain and data hashes
+	uint8_t chash[EP_CRYPTO_MD_MAXSIZE];
+	uint8_t dhash[EP_CRYPTO_MD_MAXSIZE];
+	size_t hlen = 0;
+	int halg = 0;
+
+	if (RecHashAlg != 0)
+	{
+		// a chain is only comparable with other copies of the log if
+		// it covers every record, so it is never started partway
+		// through a log and keeps the algorithm it started with
+		if (!phys->chain_valid)
+			(void) chain_load(gcl);
+		if (phys->chainalg != 0)
+			halg = phys->chainalg;
+		else if (phys->max_recno == 0)
+			halg = RecHashAlg;
+	}
+	if (halg != 0)
+	{
+		hlen = ep_crypto_md_len(halg);
+		if (phys->chainalg == halg)
+			memcpy(chash, phys->chain, hlen);
+		else
+			_gdp_hash_anchor(halg, gcl->name, chash);
+		_gdp_hash_data(halg, dp, dlen, dhash);
+		log_record.hashalgs = REC_HASHALGS(halg, halg);
+	}
+
+	// compress data (hashes and signature cover the original)
+	uint8_t *zbuf = NULL;
+	const uint8_t *odp = dp;
+	size_t odlen = dlen;
+
+	if (CompressAlg != EP_COMPRESS_NONE && dp != NULL &&
+			dlen >= CompressMinSize)
+	{
+		size_t zlen;
+
+		if (CompressAlg == EP_COMPRESS_ZSTD && CompressDictSamples > 0)
+			dict_add_sample(gcl, dp, dlen);
+		zlen = record_compress(phys, dp, dlen, &zbuf);
+		if (zlen > 0)
+		{
+			dp = zbuf;
+			dlen = zlen;
+			log_record.data_length = dlen;
+			log_record.flags |= REC_IS_COMPRESSED;
+		}
+	}
+
+	hdrlen = record_encode(ext, &log_record, hdrbuf);
+	if (WriteChecksums)
+	{
+		// encoded header does not include the checksum yet
+		uint32_t crc = ep_crc32c(0, hdrbuf, hdrlen);
+
+		if (hlen > 0)
+		{
+			crc = ep_crc32c(crc, chash, hlen);
+			crc = ep_crc32c(crc, dhash, hlen);
+		}
+		if (dp != NULL)
+			crc = ep_crc32c(crc, dp, dlen);
+		if (sp != NULL)
+			crc = ep_crc32c(crc, sp, slen);
+		hdrlen = record_set_checksum(ext, hdrbuf, hdrlen, crc);
+	}
+
+	// reserve disk space ahead of the writes
+	file_prepare_append(ext->fp, ext->max_offset + hdrlen + 2 * hlen +
+					dlen + slen, PreallocExtent, &ext->alloc_offset);
+	file_prepare_append(phys->index.fp, phys->index.max_offset +
+					SIZEOF_INDEX_BLOCK_HDR + SIZEOF_INDEX_RECORD,
+					PreallocIndex, &phys->index.alloc_offset);
+
+	// write index record (first, so nothing is written if it can't be)
+	record_offset = ext->max_offset;
+	xlen = index_put(&phys->index, phys->max_recno + 1,
+					phys->last_extent, record_offset);
+	if (xlen < 0)
+	{
+		estat = GDP_STAT_CORRUPT_INDEX;
+		ep_log(estat, "gcl_physappend(%s): extent %d can't be indexed",
+				gcl->pname, phys->last_extent);
+		goto fail0;
+	}
+
+	// write log record header
+	fwrite(hdrbuf, hdrlen, 1, ext->fp);
+	record_size = hdrlen;
+
+	// write chain and data hashes
+	if (hlen > 0)
+	{
+		fwrite(chash, hlen, 1, ext->fp);
+		fwrite(dhash, hlen, 1, ext->fp);
+		record_size += 2 * hlen;
+	}
+
+	// write log record data
+	if (dlen > 0)
+	{
+		if (dp != NULL)
+			fwrite(dp, dlen, 1, ext->fp);
+		record_size += dlen;
+	}
 
-	// write index record
-	fwrite(&index_entry, sizeof index_entry, 1, phys->index.fp);
+	// write signature
+	if (slen > 0 && sp != NULL)
+		fwrite(sp, slen, 1, ext->fp);
+	record_size += slen;
 
 	// commit
-	if (fflush(ext->fp) < 0 || ferror(ext->fp))
+	if ((flush && fflush(ext->fp) < 0) || ferror(ext->fp))
 		estat = posix_error(errno, "gcl_physappend: cannot flush data");
-	else if (fflush(phys->index.fp) < 0 || ferror(ext->fp))
+	else if ((flush && fflush(phys->index.fp) < 0) || ferror(ext->fp))
 		estat = posix_error(errno, "gcl_physappend: cannot flush index");
 	else
 	{
-		xcache_put(phys, index_entry.recno, index_entry.offset);
+		xcache_put(phys, phys->max_recno + 1, record_offset);
 		++phys->max_recno;
-		phys->index.max_offset += sizeof index_entry;
+		if (ext->dfd >= 0)
+		{
+			// new data is likely to be read soon: cache it ourselves
+			off_t off = record_offset;
+
+			bcache_write(ext->cacheid, hdrbuf, hdrlen, off);
+			off += hdrlen;
+			if (hlen > 0)
+			{
+				bcache_write(ext->cacheid, chash, hlen, off);
+				bcache_write(ext->cacheid, dhash, hlen, off + hlen);
+				off += 2 * hlen;
+			}
+			if (dp != NULL)
+				bcache_write(ext->cacheid, dp, dlen, off);
+			off += dlen;
+			if (sp != NULL)
+				bcache_write(ext->cacheid, sp, slen, off);
+		}
+		tail_put(phys, phys->max_recno, datum, odp, odlen, sp, slen);
+		phys->index.max_offset += xlen;
 		ext->max_offset += record_size;
+		file_write_behind(ext->fp, ext->max_offset, &ext->flush_offset,
+					ext->dfd >= 0);
+		file_write_behind(phys->index.fp, phys->index.max_offset,
+					&phys->index.flush_offset, false);
+
+		// extend the chain
+		if (hlen > 0)
+		{
+			_gdp_hash_link(halg, chash, phys->max_recno, dhash,
+					phys->chain);
+			phys->chainalg = halg;
+		}
+		else
+		{
+			phys->chainalg = 0;
+		}
 	}
 
+fail0:
+	if (zbuf != NULL)
+		ep_mem_free(zbuf);
+
+	return estat;
+}
+
+static EP_STAT
+disk_append(gdp_gcl_t *gcl,
+			gdp_datum_t *datum)
+{
+	gcl_physinfo_t *phys = GETPHYS(gcl);
+	extent_t *ext;
+	EP_STAT estat;
+
+	ep_thr_rwlock_wrlock(&phys->lock);
+
+	ext = extent_get(gcl, phys->last_extent);
+	estat = extent_open(gcl, ext);
+	if (EP_STAT_ISOK(estat))
+		estat = index_open(gcl);
+	if (EP_STAT_ISOK(estat))
+		estat = append_record(gcl, ext, datum, true);
+
 	ep_thr_rwlock_unlock(&phys->lock);
+	return estat;
+}
 
-	return EP_STAT_OK;
+
+/*
+**  APPEND_ROLLBACK --- undo appends that may not have reached disk
+**
+**		Both files are closed, throwing away anything still in
+**		the stdio buffers, and cut back to their sizes in *mark.
+**		The in-memory state that append_record updated is reset
+**		to match; the chain link is reloaded from disk when
+**		next needed.  The caller must hold the write lock.
+*/
+
+struct append_mark
+{
+	gdp_recno_t		max_recno;
+	int64_t			ext_offset;
+	struct phys_index index;
+};
+
+static EP_STAT
+append_rollback(gdp_gcl_t *gcl, extent_t *ext, struct append_mark *mark)
+{
+	gcl_physinfo_t *phys = GETPHYS(gcl);
+	struct phys_index *xp = &phys->index;
+	int64_t xoff = mark->index.max_offset;
+	char pbuf[GCL_PATH_MAX];
+	EP_STAT estat;
+
+	ep_dbg_cprintf(Dbg, 1, "append_rollback(%s): %" PRIgdp_recno
+			" => %" PRIgdp_recno "\n",
+			gcl->pname, phys->max_recno, mark->max_recno);
+
+	// close files (errors are expected: that's why we are here)
+	fdcache_remove(&ext->fdc);
+	if (ext->fp != NULL)
+		(void) fclose(ext->fp);
+	ext->fp = NULL;
+	if (ext->dfd >= 0)
+		(void) close(ext->dfd);
+	ext->dfd = -1;
+	if (DirectIO)
+		bcache_forget(ext->cacheid);
+	fdcache_remove(&xp->fdc);
+	if (xp->fp != NULL)
+		(void) fclose(xp->fp);
+	xp->fp = NULL;
+
+	// cut them back to where they were
+	estat = get_gcl_path(gcl, ext->extno, GCL_LDF_SUFFIX, pbuf, sizeof pbuf);
+	if (EP_STAT_ISOK(estat) && truncate(pbuf, mark->ext_offset) < 0)
+		estat = posix_error(errno, "append_rollback(%s): cannot truncate",
+						pbuf);
+	if (EP_STAT_ISOK(estat))
+		estat = get_gcl_path(gcl, -1, GCL_LXF_SUFFIX, pbuf, sizeof pbuf);
+	if (EP_STAT_ISOK(estat) && truncate(pbuf, xoff) < 0)
+		estat = posix_error(errno, "append_rollback(%s): cannot truncate",
+						pbuf);
+	if (!EP_STAT_ISOK(estat))
+		ep_log(estat, "append_rollback(%s): log may be corrupt", gcl->pname);
+
+	// and forget what we thought we had written
+	phys->max_recno = mark->max_recno;
+	ext->max_offset = mark->ext_offset;
+	ext->alloc_offset = ext->flush_offset = ext->max_offset;
+	xp->max_offset = xoff;
+	xp->alloc_offset = xp->flush_offset = xoff;
+	xp->block = mark->index.block;
+	xp->last_extent = mark->index.last_extent;
+	xp->gen++;
+	tail_forget(phys, mark->max_recno);
+	phys->chain_valid = false;
+	return estat;
+}
+
+
+/*
+**  DISK_APPENDV --- append several records at once
+**
+**		Used by replication, where records arrive in batches.
+**		The log is locked once and the data and index files are
+**		flushed only at the end.  The records must already have
+**		the right record numbers and timestamps.  Returns the
+**		number actually written in *nwrittenp.  If the final
+**		flush fails none of the batch can be trusted, so it is
+**		rolled back and reported as zero written.
+*/
+
+static EP_STAT
+disk_appendv(gdp_gcl_t *gcl,
+			gdp_datum_t **datums,
+			int ndatums,
+			int *nwrittenp)
+{
+	gcl_physinfo_t *phys = GETPHYS(gcl);
+	extent_t *ext;
+	struct append_mark mark;
+	EP_STAT estat;
+	int i = 0;
+
+	ep_thr_rwlock_wrlock(&phys->lock);
+
+	ext = extent_get(gcl, phys->last_extent);
+	estat = extent_open(gcl, ext);
+	if (EP_STAT_ISOK(estat))
+		estat = index_open(gcl);
+	EP_STAT_CHECK(estat, goto fail0);
+
+	mark.max_recno = phys->max_recno;
+	mark.ext_offset = ext->max_offset;
+	mark.index = phys->index;
+	for (i = 0; i < ndatums; i++)
+	{
+		estat = append_record(gcl, ext, datums[i], false);
+		EP_STAT_CHECK(estat, break);
+	}
+	if (fflush(ext->fp) < 0 || fflush(phys->index.fp) < 0 ||
+			ferror(ext->fp) || ferror(phys->index.fp))
+	{
+		if (EP_STAT_ISOK(estat))
+			estat = posix_error(errno, "disk_appendv: cannot flush");
+		(void) append_rollback(gcl, ext, &mark);
+		i = 0;
+	}
+
+fail0:
+	ep_thr_rwlock_unlock(&phys->lock);
+	ep_dbg_cprintf(Dbg, 24, "disk_appendv(%s): %d of %d records\n",
+			gcl->pname, i, ndatums);
+	*nwrittenp = i;
+	return estat;
 }
 
 
@@ -1430,6 +4093,16 @@ disk_getmetadata(gdp_gcl_t *gcl,
 	// lock the GCL so that no one else seeks around on us
 	ep_thr_rwlock_rdlock(&phys->lock);
 
+	// the extent may have been closed by the open file cache
+	estat = extent_open(gcl, ext);
+	if (!EP_STAT_ISOK(estat))
+	{
+		ep_thr_rwlock_unlock(&phys->lock);
+		ep_mem_free(gmd->mds);
+		ep_mem_free(gmd);
+		return estat;
+	}
+
 	// seek to the metadata area
 	STDIOCHECK("gcl_physgetmetadata: fseek#0", 0,
 			fseek(ext->fp, sizeof (extent_header_t), SEEK_SET));
@@ -1456,8 +4129,11 @@ disk_getmetadata(gdp_gcl_t *gcl,
 
 	// now the data
 	gmd->databuf = ep_mem_malloc(tlen);
-	STDIOCHECK("gcl_physgetmetadata: fread#2", 1,
-			fread(gmd->databuf, tlen, 1, ext->fp));
+	if (tlen > 0)
+	{
+		STDIOCHECK("gcl_physgetmetadata: fread#2", 1,
+				fread(gmd->databuf, tlen, 1, ext->fp));
+	}
 
 	// now map the pointers to the data
 	void *dbuf = gmd->databuf;
@@ -1505,7 +4181,17 @@ disk_newextent(gdp_gcl_t *gcl)
 	ep_thr_rwlock_wrlock(&phys->lock);
 	estat = extent_create(gcl, gmd, newextno, phys->max_recno);
 	if (EP_STAT_ISOK(estat))
+	{
+		extent_t *oldext = NULL;
+
+		if (phys->last_extent < phys->nextents)
+			oldext = phys->extents[phys->last_extent];
+
+		// the old extent won't grow any more
+		if (oldext != NULL)
+			file_release_prealloc(oldext->fp, &oldext->alloc_offset);
 		phys->last_extent = newextno;
+	}
 	ep_thr_rwlock_unlock(&phys->lock);
 
 	return estat;
@@ -1514,58 +4200,247 @@ disk_newextent(gdp_gcl_t *gcl)
 
 
 /*
-**  GCL_PHYSFOREACH --- call function for each GCL in directory
+**  GCL_PHYSFOREACH --- call function for each GCL we hold
+**
+**		Uses the manifest if there is one, since that is much
+**		faster than scanning the directory.
 */
 
 static void
 disk_foreach(void (*func)(gdp_name_t, void *), void *ctx)
 {
-	int subdir;
+	gdp_name_t *names = NULL;
+	size_t n;
+	size_t i;
 
-	for (subdir = 0; subdir < 0x100; subdir++)
+	if (!manifest_ready())
 	{
-		DIR *dir;
-		char dbuf[400];
+		disk_scan(func, ctx);
+		return;
+	}
 
-		snprintf(dbuf, sizeof dbuf, "%s/_%02x", GCLDir, subdir);
-		dir = opendir(dbuf);
-		if (dir == NULL)
-			continue;
+	// copy the names so func can take its time (or create logs)
+	ep_thr_mutex_lock(&ManifestMutex);
+	n = ManifestN;
+	if (n > 0)
+	{
+		names = ep_mem_malloc(n * sizeof names[0]);
+		memcpy(names, ManifestNames, n * sizeof names[0]);
+	}
+	ep_thr_mutex_unlock(&ManifestMutex);
 
-		for (;;)
-		{
-			struct dirent dentbuf;
-			struct dirent *dent;
+	for (i = 0; i < n; i++)
+		(*func)(names[i], ctx);
+	if (names != NULL)
+		ep_mem_free(names);
+}
 
-			// read the next directory entry
-			int i = readdir_r(dir, &dentbuf, &dent);
-			if (i != 0)
-			{
-				ep_log(ep_stat_from_errno(i),
-						"gcl_physforeach: readdir_r(%s) failed", dbuf);
-				break;
-			}
-			if (dent == NULL)
-				break;
 
-			// we're only interested in .gdpndx files
-			char *p = strrchr(dent->d_name, '.');
-			if (p == NULL || strcmp(p, GCL_LXF_SUFFIX) != 0)
-				continue;
+/*
+**  DISK_GETMTIME --- return last modification time of a GCL
+**
+**		This is the time of the last append (or create), and is
+**		used as a proxy for recent use, e.g., to decide which logs
+**		to open at startup.  It does not require that the GCL
+**		be open.
+*/
 
-			// strip off the file extension
-			*p = '\0';
+static EP_STAT
+disk_getmtime(gdp_name_t gname, EP_TIME_SPEC *mtime)
+{
+	gdp_pname_t pname;
+	char pbuf[400];
+	struct stat st;
+	int i;
 
-			// convert the base64-encoded name to internal form
-			gdp_name_t gname;
-			EP_STAT estat = gdp_internal_name(dent->d_name, gname);
-			EP_STAT_CHECK(estat, continue);
+	gdp_printable_name(gname, pname);
+	i = snprintf(pbuf, sizeof pbuf, "%s/_%02x/%s%s",
+				GCLDir, gname[0], pname, GCL_LXF_SUFFIX);
+	if (i >= sizeof pbuf)
+		return EP_STAT_BUF_OVERFLOW;
+	if (stat(pbuf, &st) < 0)
+		return ep_stat_from_errno(errno);
+	mtime->tv_sec = st.st_mtime;
+	mtime->tv_nsec = 0;
+	mtime->tv_accuracy = 1.0;
+	return EP_STAT_OK;
+}
 
-			// now call the function
-			(*func)((uint8_t *) gname, ctx);
+
+/*
+**  DISK_SNAPSHOT --- make a consistent copy of a log
+**
+**		The copy goes in SnapshotDir/label, laid out exactly like
+**		GCLDir so that it can be used as the log directory of
+**		another gdplogd (or copied back to restore).
+**
+**		The cut (last record number, index length, and length of
+**		the extent being written) is taken with the log locked,
+**		and all the files are opened at the same time, so that a
+**		later index conversion or new extent doesn't affect the
+**		result.  The copying is done unlocked: appends only add
+**		data past the cut, so they are held up only while the
+**		files are opened.  Frozen files (earlier extents and the
+**		compression dictionary) are hard linked when possible;
+**		others have as many whole blocks as possible cloned
+**		(reflinked) and the rest copied.
+*/
+
+struct snapfile
+{
+	char		path[GCL_PATH_MAX];		// source path name
+	int			fd;						// open on source (or -1)
+	off_t		len;					// bytes included in the cut
+	bool		frozen;					// won't change any more
+};
+
+static EP_STAT
+snapshot_file(const char *dir, struct snapfile *sf)
+{
+	EP_STAT estat = EP_STAT_OK;
+	char dpath[GCL_PATH_MAX];
+	char *p;
+	int dfd;
+	off_t done = 0;
+	struct stat st;
+
+	// same name relative to dir as to GCLDir
+	if (snprintf(dpath, sizeof dpath, "%s%s",
+				dir, sf->path + strlen(GCLDir)) >= sizeof dpath)
+		return EP_STAT_BUF_OVERFLOW;
+	p = strrchr(dpath, '/');
+	*p = '\0';
+	if (mkdir(dpath, 0775) < 0 && errno != EEXIST)
+		return posix_error(errno, "snapshot_file: cannot create %s", dpath);
+	*p = '/';
+
+	if (sf->frozen && link(sf->path, dpath) == 0)
+	{
+		ep_dbg_cprintf(Dbg, 20, "snapshot_file: linked %s\n", dpath);
+		return EP_STAT_OK;
+	}
+
+	dfd = open(dpath, O_WRONLY | O_CREAT | O_EXCL, 0644);
+	if (dfd < 0)
+		return posix_error(errno, "snapshot_file: cannot create %s", dpath);
+	if (fstat(sf->fd, &st) == 0 && st.st_blksize > 0)
+	{
+		done = sf->len - sf->len % st.st_blksize;
+		if (done > 0 && logd_io_clone(sf->fd, dfd, 0, done) < 0)
+			done = 0;
+	}
+	ep_dbg_cprintf(Dbg, 20, "snapshot_file: %s: cloned %jd, copying %jd\n",
+			dpath, (intmax_t) done, (intmax_t) (sf->len - done));
+	if (logd_io_copy(sf->fd, dfd, done, sf->len - done) < 0 ||
+			logd_io_fsync(dfd, false) < 0)
+	{
+		estat = posix_error(errno, "snapshot_file: cannot copy %s", dpath);
+		(void) unlink(dpath);
+	}
+	close(dfd);
+	return estat;
+}
+
+static EP_STAT
+disk_snapshot(gdp_gcl_t *gcl,
+		const char *label,
+		gdp_recno_t *recnop)
+{
+	EP_STAT estat = EP_STAT_OK;
+	gcl_physinfo_t *phys = GETPHYS(gcl);
+	char dir[GCL_PATH_MAX];
+	struct snapfile *sf;
+	int nsf = 0;
+	int maxsf;
+	int i;
+
+	if (snprintf(dir, sizeof dir, "%s/%s", SnapshotDir, label) >= sizeof dir)
+		return EP_STAT_BUF_OVERFLOW;
+	if ((mkdir(SnapshotDir, 0775) < 0 && errno != EEXIST) ||
+			(mkdir(dir, 0775) < 0 && errno != EEXIST))
+		return posix_error(errno, "disk_snapshot: cannot create %s", dir);
+
+	ep_thr_rwlock_rdlock(&phys->lock);
+	maxsf = phys->last_extent + 3;
+	sf = ep_mem_zalloc(maxsf * sizeof *sf);
+	for (i = 0; i < maxsf; i++)
+		sf[i].fd = -1;
+
+	// the index, up to the last committed entry
+	estat = get_gcl_path(gcl, -1, GCL_LXF_SUFFIX,
+					sf[nsf].path, sizeof sf[nsf].path);
+	EP_STAT_CHECK(estat, goto fail1);
+	if ((sf[nsf].fd = open(sf[nsf].path, O_RDONLY)) < 0)
+		goto fail0;
+	sf[nsf++].len = phys->index.max_offset;
+
+	// the extents; only the last one is still growing
+	for (i = 0; i <= phys->last_extent; i++)
+	{
+		struct stat st;
+
+		if (i == phys->last_extent)
+		{
+			extent_t *ext = extent_get(gcl, i);
+
+			estat = extent_open(gcl, ext);
+			EP_STAT_CHECK(estat, goto fail1);
+			sf[nsf].len = ext->max_offset;
 		}
-		closedir(dir);
+		estat = get_gcl_path(gcl, i, GCL_LDF_SUFFIX,
+						sf[nsf].path, sizeof sf[nsf].path);
+		EP_STAT_CHECK(estat, goto fail1);
+		if ((sf[nsf].fd = open(sf[nsf].path, O_RDONLY)) < 0)
+		{
+			if (errno == ENOENT && i < phys->last_extent)
+				continue;		// already expired
+			goto fail0;
+		}
+		if (i < phys->last_extent)
+		{
+			if (fstat(sf[nsf].fd, &st) < 0)
+				goto fail0;
+			sf[nsf].len = st.st_size;
+			sf[nsf].frozen = true;
+		}
+		nsf++;
+	}
+
+	// the compression dictionary, if there is one
+	estat = get_gcl_path(gcl, -1, GCL_DICT_SUFFIX,
+					sf[nsf].path, sizeof sf[nsf].path);
+	EP_STAT_CHECK(estat, goto fail1);
+	if ((sf[nsf].fd = open(sf[nsf].path, O_RDONLY)) >= 0)
+	{
+		struct stat st;
+
+		if (fstat(sf[nsf].fd, &st) < 0)
+			goto fail0;
+		sf[nsf].len = st.st_size;
+		sf[nsf++].frozen = true;
 	}
+
+	*recnop = phys->max_recno;
+	ep_thr_rwlock_unlock(&phys->lock);
+
+	ep_dbg_cprintf(Dbg, 10, "disk_snapshot(%s): %s through %" PRIgdp_recno
+			", %d files\n", gcl->pname, dir, *recnop, nsf);
+	for (i = 0; i < nsf && EP_STAT_ISOK(estat); i++)
+		estat = snapshot_file(dir, &sf[i]);
+	goto done;
+
+fail0:
+	estat = posix_error(errno, "disk_snapshot: cannot open %s", sf[nsf].path);
+fail1:
+	ep_thr_rwlock_unlock(&phys->lock);
+	if (nsf < maxsf && sf[nsf].fd >= 0)
+		nsf++;
+
+done:
+	for (i = 0; i < nsf; i++)
+		close(sf[i].fd);
+	ep_mem_free(sf);
+	return estat;
 }
 
 
@@ -1577,9 +4452,14 @@ struct gcl_phys_impl	GdpDiskImpl =
 	.open =			disk_open,
 	.close =		disk_close,
 	.append =		disk_append,
+	.appendv =		disk_appendv,
 	.getmetadata =	disk_getmetadata,
 #if EXTENT_SUPPORT
 	.newextent =	disk_newextent,
 #endif
 	.foreach =		disk_foreach,
+	.getmtime =		disk_getmtime,
+	.snapshot =		disk_snapshot,
+	.gettimestamp =	disk_gettimestamp,
+	.getchain =		disk_getchain,
 };
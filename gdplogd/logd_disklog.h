@@ -46,17 +46,28 @@
 
 // magic numbers and versions for on-disk structures
 #define GCL_LDF_MAGIC		UINT32_C(0x47434C31)	// 'GCL1'
-#define GCL_LDF_VERSION		UINT32_C(20151001)		// on-disk version
+#define GCL_LDF_VERSION		UINT32_C(20161001)		// on-disk version
 #define GCL_LDF_MINVERS		UINT32_C(20151001)		// lowest readable version
-#define GCL_LDF_MAXVERS		UINT32_C(20151001)		// highest readable version
+#define GCL_LDF_MAXVERS		UINT32_C(20161001)		// highest readable version
+#define GCL_LDF_VERS_FIXED	UINT32_C(20151001)		// extent_record_t headers
+#define GCL_LDF_VERS_COMPACT UINT32_C(20161001)		// variable length headers
 #define GCL_LDF_SUFFIX		".gdplog"
 
 #define GCL_LXF_MAGIC		UINT32_C(0x47434C78)	// 'GCLx'
-#define GCL_LXF_VERSION		UINT32_C(20160101)		// on-disk version
+#define GCL_LXF_VERSION		UINT32_C(20161001)		// on-disk version
 #define GCL_LXF_MINVERS		UINT32_C(20160101)		// lowest readable version
-#define GCL_LXF_MAXVERS		UINT32_C(20160101)		// highest readable version
+#define GCL_LXF_MAXVERS		UINT32_C(20161001)		// highest readable version
+#define GCL_LXF_VERS_FLAT	UINT32_C(20160101)		// array of index_entry_t
+#define GCL_LXF_VERS_BLOCK	UINT32_C(20161001)		// compact blocks
 #define GCL_LXF_SUFFIX		".gdpndx"
 
+#define GCL_DICT_SUFFIX		".gdpdict"				// compression dictionary
+
+#define GCL_MANIFEST_MAGIC	UINT32_C(0x47434C6D)	// 'GCLm'
+#define GCL_MANIFEST_VERSION UINT32_C(20170101)		// on-disk version
+#define GCL_MANIFEST_FILE	".gdpmanifest"			// in the GCL directory
+#define GCL_MANIFEST_HDRSIZE 16						// magic, version, rsvd
+
 #define GCL_READ_BUFFER_SIZE 4096			// size of I/O buffers
 
 
@@ -97,10 +108,46 @@
 **			dhash --- the hash of the data
 **			data --- the actual data
 **			sig --- the signature
-**		chash and/or dhash have lengths implied by the hashalgs field.
+**		chash and/or dhash have lengths implied by the hashalgs field:
+**		the top four bits are the chain hash algorithm, the bottom
+**		four the data hash algorithm (EP_CRYPTO_MD_* values, zero
+**		meaning "not present").  How they are computed is described
+**		in gdp/gdp_hashchain.h.  A record whose predecessor has no
+**		chash (or a different algorithm) is anchored on the log name.
 **		The data length is explicit.
 **		The signature length (and hash algorithm) is encoded in sigmeta.
 **
+**		If REC_HAS_CHECKSUM is set, the checksum field holds a
+**		CRC-32C over the record header (as stored on disk, but with
+**		the checksum field itself zero), the data, and the signature.
+**		This is only intended to catch media or software errors
+**		cheaply; the signature is what guards against tampering.
+**		Records written before this existed just don't have the flag.
+**
+**		If REC_IS_COMPRESSED is set, the data field is a one byte
+**		compression algorithm (EP_COMPRESS_*), the length of the
+**		uncompressed data as a varint, and the compressed data; the
+**		data length covers all of that.  The chash, dhash, and
+**		signature are all computed on the uncompressed data, but the
+**		checksum covers what is actually on disk.  zstd compressed
+**		records may need the log's dictionary, which is stored (raw)
+**		in a file with GCL_DICT_SUFFIX.  A log only ever has one
+**		dictionary; records written before it existed don't use it.
+**
+**		In extents of version GCL_LDF_VERS_COMPACT the record header
+**		is not an extent_record_t, but a variable length encoding
+**		of the same information (see below).  The fields following
+**		the header are unchanged.
+**
+**		The GCL directory also has a manifest listing every log
+**		it holds, so that they can be enumerated without scanning
+**		all of the subdirectories.  It is a GCL_MANIFEST_HDRSIZE
+**		byte header (magic and version in network byte order, then
+**		eight reserved bytes) followed by the internal names of
+**		the logs in the order they were created.  Creating a log
+**		appends its name and syncs it.  If the manifest is missing
+**		or damaged it is rebuilt from the directory scan.
+**
 **		The extra reserved fields in the record header aren't
 **		anticipated to be needed anytime soon; they are a relic
 **		of earlier implementations, and are here to keep the
@@ -120,7 +167,7 @@ typedef struct
 	uint16_t	n_md_entries;	// number of metadata entries
 	uint16_t	log_type;		// directory, indirect, data, etc. (unused)
 	uint32_t	extent;			// extent number
-	uint64_t	reserved2;		// reserved for future use
+	int64_t		base_time;		// timestamp base (seconds, compact only)
 	gdp_name_t	gname;			// the name of this log
 	gdp_recno_t	recno_offset;	// first recno stored in this extent - 1
 } extent_header_t;
@@ -135,12 +182,75 @@ typedef struct
 	uint8_t			hashalgs;			// algorithms for chain and data hashes
 	uint8_t			reserved1;			// reserved for future use
 	int16_t			reserved2;			// reserved for future use
-	int32_t			reserved3;			// reserved for future use
+	uint32_t		checksum;			// CRC-32C (if REC_HAS_CHECKSUM)
 	int32_t			data_length;		// in bytes
 } extent_record_t;
 
 // flag bits in record headers
 #define REC_HAS_SIGNATURE		0x0001	// signature is stored on disk
+#define REC_HAS_CHECKSUM		0x0002	// checksum field is valid
+#define REC_IS_COMPRESSED		0x0004	// data is compressed
+
+/*
+**  Compact record headers
+**
+**		The record number is not stored since it is implied by the
+**		index, and fields that are usually empty are left out.  The
+**		header is a flags byte (REC2_*) followed by:
+**			data_length --- varint
+**			hashalgs --- one byte, if REC2_HAS_HASHES
+**			sigmeta --- two bytes, if REC2_HAS_SIGNATURE
+**			tv_sec --- zigzag varint relative to the extent base_time,
+**					if REC2_HAS_TIMESTAMP
+**			tv_nsec --- varint, if REC2_HAS_TIMESTAMP
+**			tv_accuracy --- four byte float, if REC2_HAS_ACCURACY
+**			checksum --- four bytes, if REC2_HAS_CHECKSUM
+**		Varints are as in ep/ep_varint.h; everything else is in
+**		network byte order.  The checksum covers the header up to
+**		(but not including) itself and then the same fields as for
+**		fixed headers.
+**
+**		Timestamps are relative to a fixed time per extent rather
+**		than to the previous record so that any record can be
+**		decoded without reading its predecessors.
+*/
+
+#define REC2_HAS_CHECKSUM		0x01	// checksum is present
+#define REC2_HAS_TIMESTAMP		0x02	// tv_sec and tv_nsec are present
+#define REC2_HAS_ACCURACY		0x04	// tv_accuracy is present
+#define REC2_HAS_HASHES			0x08	// hashalgs is present
+#define REC2_HAS_SIGNATURE		0x10	// sigmeta is present
+#define REC2_IS_COMPRESSED		0x20	// data is compressed
+
+#define REC2_HDR_MAXSIZE		(1 + 5 + 1 + 2 + 10 + 5 + 4 + 4)
+
+// cracking the hashalgs field
+#define REC_CHASH_ALG(h)		(((h) >> 4) & 0x0f)
+#define REC_DHASH_ALG(h)		((h) & 0x0f)
+#define REC_HASHALGS(c, d)		((((c) & 0x0f) << 4) | ((d) & 0x0f))
+
+
+/*
+**  Open file cache entries
+**
+**		Every index and extent file that is open on behalf of a log
+**		is on a global LRU list.  If there are more open files than
+**		the budget allows, the coldest ones are closed (providing
+**		their log is not locked at the time) and are lazily reopened
+**		on the next access.  The in-memory state of the log (and the
+**		GCL handle itself) is unaffected, so logs can stay in the GCL
+**		cache without pinning file descriptors.
+*/
+
+typedef struct fdcache_ent
+{
+	FILE					**fpp;		// the FILE * field being cached
+	int						*dfdp;		// direct I/O fd closed with it
+	off_t					*allocp;	// preallocation released on close
+	struct physinfo			*phys;		// owning log (for locking)
+	TAILQ_ENTRY(fdcache_ent)	lru;	// global LRU list
+	bool					inlru;		// currently on LRU list
+} fdcache_ent_t;
 
 
 /*
@@ -156,11 +266,17 @@ typedef struct
 typedef struct
 {
 	FILE				*fp;				// file pointer to extent
+	fdcache_ent_t		fdc;				// open file cache info for fp
+	int					dfd;				// O_DIRECT read fd (or -1)
+	uint64_t			cacheid;			// block cache file id
 	uint32_t			ver;				// on-disk file version
 	uint32_t			extno;				// extent number
 	size_t				header_size;		// size of extent file hdr
 	gdp_recno_t			recno_offset;		// first recno in extent - 1
+	int64_t				base_time;			// for compact timestamps
 	off_t				max_offset;			// size of extent file
+	off_t				alloc_offset;		// preallocated up to here
+	off_t				flush_offset;		// writeback started to here
 	EP_TIME_SPEC		retain_until;		// retain at least until this date
 	EP_TIME_SPEC		remove_by;			// must be gone by this date
 } extent_t;
@@ -187,6 +303,28 @@ typedef struct
 **
 **		The index is not intended to have unique information.  Given the
 **		set of extent files, it should be possible to rebuild the index.
+**
+**		There are two index formats.  The original ("flat") format
+**		is an array of index_entry_t.  The compact ("block") format
+**		is an array of fixed size blocks, each covering block_entries
+**		records (the record number is implied by position in both
+**		formats).  Each block is an index_block_t giving the extent
+**		and offset of the first record in the block, followed by one
+**		32-bit entry per record.  An entry is normally the offset of
+**		the record relative to the first record in the block.  If
+**		INDEX_ENT_NEXTEXT is set the record is instead in the extent
+**		following the block's base extent, and the rest of the entry
+**		is the absolute offset in that extent.  A record that can't be
+**		described this way (more than 2GB on from the base, or a
+**		second change of extent within the block) gets a marker
+**		entry instead: INDEX_ENT_MARKER plus an extent delta.  With
+**		a delta of zero the record directly follows the one before
+**		it in the same extent; otherwise it is the first record in
+**		the extent that many on from the one before.  Either way it
+**		becomes the base for the rest of the block, so finding a
+**		record after a marker means reading the header of the
+**		record before the marker.  The last block is only as long
+**		as it needs to be.
 */
 
 typedef struct index_entry
@@ -202,13 +340,37 @@ typedef struct index_header
 	uint32_t	magic;			// GCL_LDX_MAGIC
 	uint32_t	version;		// GCL_LDX_VERSION
 	uint32_t	header_size;	// offset to first index entry
-	uint32_t	reserved1;		// must be zero
+	uint32_t	block_entries;	// entries per block (zero if flat)
 	gdp_recno_t	min_recno;		// the first record number in the log
 } index_header_t;
 
 #define SIZEOF_INDEX_HEADER		(sizeof(index_header_t))
 #define SIZEOF_INDEX_RECORD		(sizeof(index_entry_t))
 
+typedef struct index_block
+{
+	int64_t		base_offset;	// offset of first record in block
+	uint32_t	base_extent;	// extent of first record in block
+	uint32_t	reserved;		// make padding explicit
+//	uint32_t	entries[block_entries];
+} index_block_t;
+
+#define INDEX_BLOCK_ENTRIES		64			// default entries per block
+#define INDEX_ENT_NEXTEXT		UINT32_C(0x80000000)	// in base_extent + 1
+#define INDEX_ENT_MARKER		UINT32_C(0xffffff00)	// rebase (low byte delta)
+#define INDEX_ENT_MAXDELTA		UINT32_C(0xff)
+#define INDEX_ENT_ISMARKER(ent)	(((ent) & INDEX_ENT_MARKER) == INDEX_ENT_MARKER)
+
+#define SIZEOF_INDEX_BLOCK_HDR	(sizeof(index_block_t))
+#define SIZEOF_INDEX_BLOCK(n)	(SIZEOF_INDEX_BLOCK_HDR + (n) * sizeof(uint32_t))
+
+// decode a block entry
+#define INDEX_ENT_EXTENT(blk, ent)	((blk)->base_extent +					\
+									(((ent) & INDEX_ENT_NEXTEXT) ? 1 : 0))
+#define INDEX_ENT_OFFSET(blk, ent)	(((ent) & INDEX_ENT_NEXTEXT) ?			\
+									(int64_t) ((ent) & ~INDEX_ENT_NEXTEXT) :	\
+									(blk)->base_offset + (ent))
+
 
 /*
 **  The in-memory cache of the physical index data.
@@ -243,9 +405,17 @@ struct phys_index
 {
 	// information about on-disk format
 	FILE				*fp;					// recno -> offset file handle
+	fdcache_ent_t		fdc;					// open file cache info for fp
 	int64_t				max_offset;				// size of index file
+	off_t				alloc_offset;			// preallocated up to here
+	off_t				flush_offset;			// writeback started to here
 	size_t				header_size;			// size of hdr in index file
 	gdp_recno_t			min_recno;				// lowest recno in index
+	uint32_t			version;				// GCL_LXF_VERS_*
+	uint32_t			block_entries;			// entries per block (if block)
+	index_block_t		block;					// base for next entry (host order)
+	uint32_t			last_extent;			// extent of the last entry
+	uint32_t			gen;					// bumped when entries are undone
 
 	// a cache of the contents
 //	index_cache_t		cache;					// in-memory cache
@@ -265,6 +435,9 @@ struct physinfo
 	// reading and writing to the log requires holding this lock
 	EP_THR_RWLOCK		lock;
 
+	// (re)opening index or extent files requires holding this lock
+	EP_THR_MUTEX		open_mutex;
+
 	// info regarding the entire log (not extent)
 	gdp_recno_t			min_recno;				// first recno in log
 	gdp_recno_t			max_recno;				// last recno in log (dynamic)
@@ -277,6 +450,22 @@ struct physinfo
 
 	// info regarding the index file
 	struct phys_index	index;
+
+	// compression dictionary (zstd only)
+	struct ep_compress_dict	*cdict;				// NULL until trained/loaded
+	bool				dict_done;				// don't try to train (again)
+	uint8_t				*dsamples;				// sample data for training
+	size_t				dsamplelen;				// bytes in dsamples
+	size_t				*dsizes;				// size of each sample
+	unsigned int		ndsamples;				// number of samples
+
+	// link value of the last record (for the chain hash)
+	bool				chain_valid;			// chain/chainalg are loaded
+	int					chainalg;				// zero if last has no chash
+	uint8_t				chain[EP_CRYPTO_MD_MAXSIZE];
+
+	// copies of recently appended records (indexed by recno)
+	struct tailrec		**tail;					// NULL until first append
 };
 
 #endif //_GDPLOGD_DISKLOG_H_
@@ -30,6 +30,8 @@
 
 #include "logd.h"
 
+#include <gdp/gdp_gclmd.h>
+
 static EP_DBG	Dbg = EP_DBG_INIT("gdplogd.gcl", "GDP Log Daemon GCL handling");
 
 
@@ -57,9 +59,13 @@ gcl_alloc(gdp_name_t gcl_name, gdp_iomode_t iomode, gdp_gcl_t **pgcl)
 		goto fail0;
 	}
 	gcl->x->gcl = gcl;
+	ep_thr_mutex_init(&gcl->x->append_mutex, EP_THR_MUTEX_DEFAULT);
+	ep_thr_cond_init(&gcl->x->append_cond);
 
-	//XXX for now, assume all GCLs are on disk
-	gcl->x->physimpl = &GdpDiskImpl;
+	// if we don't know where it is, assume it is on disk
+	gcl->x->physimpl = gcl_physimpl_find(gcl_name);
+	if (gcl->x->physimpl == NULL)
+		gcl->x->physimpl = &GdpDiskImpl;
 
 	// make sure that if this is freed it gets removed from GclsByUse
 	gcl->freefunc = gcl_close;
@@ -72,6 +78,78 @@ fail0:
 }
 
 
+/*
+**  GCL_PHYSIMPL_SELECT --- choose the physical implementation for a new GCL
+**
+**		The GDP_GCLMD_STORAGE metadata entry says where the log
+**		should live; if it isn't given the daemon default is used.
+**		Returns NULL if the storage type is not known.
+*/
+
+struct gcl_phys_impl *
+gcl_physimpl_select(gdp_gclmd_t *gmd)
+{
+	const char *stype = NULL;
+	const void *data;
+	size_t len = 0;
+
+	if (gmd != NULL &&
+			EP_STAT_ISOK(gdp_gclmd_find(gmd, GDP_GCLMD_STORAGE, &len, &data)))
+		stype = data;
+	else if ((stype = ep_adm_getstrparam("swarm.gdplogd.gcl.storage",
+							"disk")) != NULL)
+		len = strlen(stype);
+	if (stype == NULL)
+		return &GdpDiskImpl;
+
+	// ignore any parameters after the type
+	{
+		const char *p = memchr(stype, ':', len);
+
+		if (p != NULL)
+			len = p - stype;
+	}
+
+	if (len == 4 && strncasecmp(stype, "disk", len) == 0)
+		return &GdpDiskImpl;
+	if (len == 3 && strncasecmp(stype, "mem", len) == 0)
+		return &GdpMemImpl;
+	if (len == 3 && strncasecmp(stype, "seg", len) == 0)
+		return &GdpSegImpl;
+	ep_dbg_cprintf(Dbg, 1, "gcl_physimpl_select: unknown storage %.*s\n",
+			(int) len, stype);
+	return NULL;
+}
+
+
+/*
+**  GCL_PHYSIMPL_FIND --- find the physical implementation holding a GCL
+**
+**		Returns NULL if none of them know of it.
+*/
+
+struct gcl_phys_impl *
+gcl_physimpl_find(gdp_name_t gcl_name)
+{
+	static struct gcl_phys_impl *const impls[] =
+	{
+		&GdpMemImpl,
+		&GdpSegImpl,
+		&GdpDiskImpl,
+		NULL
+	};
+	EP_TIME_SPEC mtime;
+	int i;
+
+	for (i = 0; impls[i] != NULL; i++)
+	{
+		if (EP_STAT_ISOK(impls[i]->getmtime(gcl_name, &mtime)))
+			return impls[i];
+	}
+	return NULL;
+}
+
+
 /*
 **  GCL_OPEN --- open an existing GCL
 */
@@ -89,6 +167,10 @@ gcl_open(gdp_name_t gcl_name, gdp_iomode_t iomode, gdp_gcl_t **pgcl)
 	estat = gcl->x->physimpl->open(gcl);
 	EP_STAT_CHECK(estat, goto fail1);
 
+	// metadata never changes, so read it once now
+	estat = gcl_load_metadata(gcl);
+	EP_STAT_CHECK(estat, goto fail1);
+
 	// success!
 	*pgcl = gcl;
 	return estat;
@@ -103,6 +185,45 @@ fail0:
 }
 
 
+/*
+**  GCL_LOAD_METADATA --- read metadata into memory
+**
+**		Metadata is immutable once the GCL is created, so we keep
+**		it with the handle (in gcl->gclmd) along with the serialized
+**		form that is sent over the wire, which is also what the
+**		signature digest is seeded with.  If gcl->gclmd is already
+**		set (e.g., on create) it is used as is.
+*/
+
+EP_STAT
+gcl_load_metadata(gdp_gcl_t *gcl)
+{
+	EP_STAT estat = EP_STAT_OK;
+	struct evbuffer *evb;
+	size_t len;
+
+	if (gcl->gclmd == NULL)
+	{
+		estat = gcl->x->physimpl->getmetadata(gcl, &gcl->gclmd);
+		EP_STAT_CHECK(estat, return estat);
+	}
+
+	evb = evbuffer_new();
+	_gdp_gclmd_serialize(gcl->gclmd, evb);
+	len = evbuffer_get_length(evb);
+	if (gcl->x->md_wire != NULL)
+		ep_mem_free(gcl->x->md_wire);
+	gcl->x->md_wire = ep_mem_malloc(len > 0 ? len : 1);
+	gcl->x->md_wirelen = len;
+	evbuffer_remove(evb, gcl->x->md_wire, len);
+	evbuffer_free(evb);
+
+	ep_dbg_cprintf(Dbg, 20, "gcl_load_metadata(%s): %zd bytes\n",
+			gcl->pname, len);
+	return estat;
+}
+
+
 /*
 **  GCL_CLOSE --- close a GDP version of a GCL handle
 **
@@ -120,11 +241,125 @@ gcl_close(gdp_gcl_t *gcl)
 	if (gcl->x->physimpl->close != NULL)
 		gcl->x->physimpl->close(gcl);
 
+	if (gcl->x->md_wire != NULL)
+		ep_mem_free(gcl->x->md_wire);
+	if (gcl->x->pubkey != NULL)
+		ep_crypto_key_free(gcl->x->pubkey);
+	ep_thr_cond_destroy(&gcl->x->append_cond);
+	ep_thr_mutex_destroy(&gcl->x->append_mutex);
 	ep_mem_free(gcl->x);
 	gcl->x = NULL;
 }
 
 
+/*
+**  Opens in progress
+**
+**		If several requests for the same uncached GCL arrive at once,
+**		only the first actually opens it; the others wait for that
+**		open to complete and then pick the result up from the cache.
+**		Without this each of them does the full physical open and
+**		they all race to add their handle to the cache.
+*/
+
+struct pending_open
+{
+	LIST_ENTRY(pending_open)	list;
+	gdp_name_t				name;			// GCL being opened
+	EP_STAT					estat;			// result of the open
+	bool					done;			// open has completed
+	int						nwaiters;		// threads waiting on result
+	EP_THR_COND				cond;			// signaled when done
+};
+
+static LIST_HEAD(pending_head, pending_open)
+							PendingOpens = LIST_HEAD_INITIALIZER(PendingOpens);
+static EP_THR_MUTEX			PendingOpensMutex	EP_THR_MUTEX_INITIALIZER;
+
+
+/*
+**  OPEN_HANDLE --- return a GCL from the cache, opening it if needed
+**
+**		The returned GCL has its reference count bumped.
+*/
+
+static EP_STAT
+open_handle(gdp_name_t gcl_name, gdp_iomode_t iomode, gdp_gcl_t **pgcl)
+{
+	EP_STAT estat;
+	struct pending_open *po;
+
+	for (;;)
+	{
+		ep_thr_mutex_lock(&PendingOpensMutex);
+
+		// check again now that no open can complete underneath us
+		*pgcl = _gdp_gcl_cache_get(gcl_name, iomode);
+		if (*pgcl != NULL)
+		{
+			ep_thr_mutex_unlock(&PendingOpensMutex);
+			return EP_STAT_OK;
+		}
+
+		LIST_FOREACH(po, &PendingOpens, list)
+		{
+			if (GDP_NAME_SAME(po->name, gcl_name))
+				break;
+		}
+		if (po == NULL)
+			break;
+
+		// someone else is already opening this GCL: wait for them
+		ep_dbg_cprintf(Dbg, 20, "open_handle: waiting for open in progress\n");
+		po->nwaiters++;
+		while (!po->done)
+			ep_thr_cond_wait(&po->cond, &PendingOpensMutex, NULL);
+		estat = po->estat;
+		if (--po->nwaiters == 0)
+		{
+			ep_thr_cond_destroy(&po->cond);
+			ep_mem_free(po);
+		}
+		ep_thr_mutex_unlock(&PendingOpensMutex);
+
+		// if that open failed so do we; otherwise it is now in the cache
+		EP_STAT_CHECK(estat, return estat);
+	}
+
+	// nobody else is opening it: let others know that we are
+	po = ep_mem_zalloc(sizeof *po);
+	memcpy(po->name, gcl_name, sizeof po->name);
+	ep_thr_cond_init(&po->cond);
+	LIST_INSERT_HEAD(&PendingOpens, po, list);
+	ep_thr_mutex_unlock(&PendingOpensMutex);
+
+	estat = gcl_open(gcl_name, iomode, pgcl);
+	if (EP_STAT_ISOK(estat))
+	{
+		(*pgcl)->flags |= GCLF_DEFER_FREE;
+		_gdp_gcl_cache_add(*pgcl, iomode);
+	}
+
+	// wake up anyone who was waiting for us
+	ep_thr_mutex_lock(&PendingOpensMutex);
+	LIST_REMOVE(po, list);
+	po->estat = estat;
+	po->done = true;
+	if (po->nwaiters > 0)
+	{
+		ep_thr_cond_broadcast(&po->cond);
+	}
+	else
+	{
+		ep_thr_cond_destroy(&po->cond);
+		ep_mem_free(po);
+	}
+	ep_thr_mutex_unlock(&PendingOpensMutex);
+
+	return estat;
+}
+
+
 /*
 **  Get an open instance of the GCL in the request.
 **
@@ -164,11 +399,7 @@ get_open_handle(gdp_req_t *req, gdp_iomode_t iomode)
 		ep_dbg_printf("get_open_handle: opening %s\n", pname);
 	}
 
-	estat = gcl_open(req->pdu->dst, iomode, &req->gcl);
-	if (EP_STAT_ISOK(estat))
-		_gdp_gcl_cache_add(req->gcl, iomode);
-	if (req->gcl != NULL)
-		req->gcl->flags |= GCLF_DEFER_FREE;
+	estat = open_handle(req->pdu->dst, iomode, &req->gcl);
 
 	if (ep_dbg_test(Dbg, 40))
 	{
@@ -184,6 +415,123 @@ get_open_handle(gdp_req_t *req, gdp_iomode_t iomode)
 }
 
 
+/*
+**  Get an open instance of a GCL by name.
+**
+**		Like get_open_handle, but for use outside of any request
+**		(e.g., by replication).  The caller must _gdp_gcl_decref
+**		the result.
+*/
+
+EP_STAT
+gcl_get_open(gdp_name_t gcl_name, gdp_iomode_t iomode, gdp_gcl_t **pgcl)
+{
+	*pgcl = _gdp_gcl_cache_get(gcl_name, iomode);
+	if (*pgcl != NULL)
+		return EP_STAT_OK;
+	return open_handle(gcl_name, iomode, pgcl);
+}
+
+
+/*
+**  GCL_PREWARM --- open the most recently used GCLs
+**
+**		Opening a log is relatively expensive, so at startup we
+**		open the ones most likely to be wanted soon and leave them
+**		in the cache.  "Most recently used" is approximated by the
+**		modification time reported by the physical layer.  This
+**		runs in a worker thread; requests that arrive for a GCL
+**		that is still being opened just wait for it.
+*/
+
+struct prewarm_ent
+{
+	gdp_name_t		name;
+	EP_TIME_SPEC	mtime;
+};
+
+struct prewarm_ctx
+{
+	int					nents;			// number of entries in use
+	int					maxents;		// size of ents
+	struct prewarm_ent	*ents;			// newest first
+};
+
+static void
+prewarm_addone(gdp_name_t gname, void *ctx_)
+{
+	struct prewarm_ctx *ctx = ctx_;
+	EP_TIME_SPEC mtime;
+	int i;
+
+	if (!EP_STAT_ISOK(GdpDiskImpl.getmtime(gname, &mtime)))
+		return;
+
+	// find where this belongs in the list; ignore if too old
+	for (i = ctx->nents; i > 0; i--)
+	{
+		if (!ep_time_before(&ctx->ents[i - 1].mtime, &mtime))
+			break;
+	}
+	if (i >= ctx->maxents)
+		return;
+
+	// shift older entries down (dropping the oldest if full) and insert
+	if (ctx->nents < ctx->maxents)
+		ctx->nents++;
+	memmove(&ctx->ents[i + 1], &ctx->ents[i],
+			(ctx->nents - i - 1) * sizeof ctx->ents[0]);
+	memcpy(ctx->ents[i].name, gname, sizeof ctx->ents[i].name);
+	ctx->ents[i].mtime = mtime;
+}
+
+static void
+prewarm_thread(void *ctx_)
+{
+	struct prewarm_ctx *ctx = ctx_;
+	int i;
+
+	GdpDiskImpl.foreach(prewarm_addone, ctx);
+	for (i = 0; i < ctx->nents; i++)
+	{
+		EP_STAT estat;
+		gdp_gcl_t *gcl;
+
+		estat = open_handle(ctx->ents[i].name, GDP_MODE_ANY, &gcl);
+		if (!EP_STAT_ISOK(estat))
+		{
+			gdp_pname_t pname;
+
+			ep_log(estat, "gcl_prewarm: cannot open %s",
+					gdp_printable_name(ctx->ents[i].name, pname));
+			continue;
+		}
+
+		// leave it in the cache for the first real user
+		_gdp_gcl_decref(&gcl);
+	}
+	ep_dbg_cprintf(Dbg, 8, "gcl_prewarm: opened %d GCLs\n", ctx->nents);
+
+	ep_mem_free(ctx->ents);
+	ep_mem_free(ctx);
+}
+
+void
+gcl_prewarm(void)
+{
+	struct prewarm_ctx *ctx;
+	int n = ep_adm_getintparam("swarm.gdplogd.prewarm.count", 32);
+
+	if (n <= 0 || GdpDiskImpl.getmtime == NULL)
+		return;
+
+	ctx = ep_mem_zalloc(sizeof *ctx);
+	ctx->maxents = n;
+	ctx->ents = ep_mem_malloc(n * sizeof ctx->ents[0]);
+	ep_thr_pool_run(&prewarm_thread, ctx);
+}
+
+
 /*
 **  GCL_RECLAIM_RESOURCES --- find unused GCL resources and reclaim them
 **
@@ -0,0 +1,618 @@
+/* vim: set ai sw=4 sts=4 ts=4 : */
+
+/*
+**	----- BEGIN LICENSE BLOCK -----
+**	GDPLOGD: Log Daemon for the Global Data Plane
+**	From the Ubiquitous Swarm Lab, 490 Cory Hall, U.C. Berkeley.
+**
+**	Copyright (c) 2015, Regents of the University of California.
+**	All rights reserved.
+**
+**	Permission is hereby granted, without written agreement and without
+**	license or royalty fees, to use, copy, modify, and distribute this
+**	software and its documentation for any purpose, provided that the above
+**	copyright notice and the following two paragraphs appear in all copies
+**	of this software.
+**
+**	IN NO EVENT SHALL REGENTS BE LIABLE TO ANY PARTY FOR DIRECT, INDIRECT,
+**	SPECIAL, INCIDENTAL, OR CONSEQUENTIAL DAMAGES, INCLUDING LOST
+**	PROFITS, ARISING OUT OF THE USE OF THIS SOFTWARE AND ITS DOCUMENTATION,
+**	EVEN IF REGENTS HAS BEEN ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+**
+**	REGENTS SPECIFICALLY DISCLAIMS ANY WARRANTIES, INCLUDING, BUT NOT
+**	LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+**	FOR A PARTICULAR PURPOSE. THE SOFTWARE AND ACCOMPANYING DOCUMENTATION,
+**	IF ANY, PROVIDED HEREUNDER IS PROVIDED "AS IS". REGENTS HAS NO
+**	OBLIGATION TO PROVIDE MAINTENANCE, SUPPORT, UPDATES, ENHANCEMENTS,
+**	OR MODIFICATIONS.
+**	----- END LICENSE BLOCK -----
+*/
+
+
+
+/*
+**  I/O engine for the physical layer (see logd_io.h).
+**
+**		Any number of threads can submit; the submission queue is
+**		protected by a mutex, and each submitter then sleeps until
+**		the completion thread finds its result.  The number of
+**		requests in flight is limited to the size of the completion
+**		queue so that completions are never dropped.
+**
+**		The ring is driven with the raw system calls to avoid a
+**		dependency on liburing, and only uses operations that
+**		have existed since io_uring first appeared (Linux 5.1).
+*/
+
+#ifdef __linux__
+# define _GNU_SOURCE	1	// required to get fallocate, sync_file_range
+#endif
+
+#include "logd.h"
+#include "logd_io.h"
+
+#include <ep/ep_log.h>
+#include <ep/ep_thr.h>
+
+#include <errno.h>
+#include <fcntl.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/ioctl.h>
+#ifdef __linux__
+# include <linux/fs.h>		// FICLONERANGE
+#endif
+
+static EP_DBG	Dbg = EP_DBG_INIT("gdplogd.io", "GDP Log Daemon I/O Engine");
+
+#define MAX_IOV			8			// largest gather write supported
+
+#if EP_OSCF_USE_IO_URING
+
+#include <linux/io_uring.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <pthread.h>
+
+#ifndef IORING_FEAT_SINGLE_MMAP			// headers older than Linux 5.4
+# define IORING_FEAT_SINGLE_MMAP	(1U << 0)
+#endif
+#ifndef __NR_io_uring_setup
+# define __NR_io_uring_setup	425
+#endif
+#ifndef __NR_io_uring_enter
+# define __NR_io_uring_enter	426
+#endif
+
+static struct
+{
+	int					fd;				// ring file descriptor
+	unsigned			*sq_head;		// mapped SQ ring fields
+	unsigned			*sq_tail;
+	unsigned			*sq_mask;
+	unsigned			*sq_array;
+	struct io_uring_sqe	*sqes;
+	unsigned			*cq_head;		// mapped CQ ring fields
+	unsigned			*cq_tail;
+	unsigned			*cq_mask;
+	struct io_uring_cqe	*cqes;
+	unsigned			maxinflight;	// CQ size
+	unsigned			ninflight;		// requests submitted
+} Ring = { .fd = -1 };
+
+static EP_THR_MUTEX		SqMutex		EP_THR_MUTEX_INITIALIZER;
+static EP_THR_COND		SqCond		EP_THR_COND_INITIALIZER;
+static EP_THR_MUTEX		DoneMutex	EP_THR_MUTEX_INITIALIZER;
+static EP_THR_COND		DoneCond	EP_THR_COND_INITIALIZER;
+
+// one outstanding request
+struct ioreq
+{
+	bool				done;			// set by completion thread
+	int					res;			// cqe->res
+};
+
+
+/*
+**  RING_SETUP --- create and map the ring
+*/
+
+static EP_STAT
+ring_setup(unsigned entries)
+{
+	struct io_uring_params p;
+	size_t sqsize, cqsize;
+	uint8_t *sq, *cq;
+	void *sqes;
+	int fd;
+
+	memset(&p, 0, sizeof p);
+	fd = syscall(__NR_io_uring_setup, entries, &p);
+	if (fd < 0)
+		return ep_stat_from_errno(errno);
+
+	sqsize = p.sq_off.array + p.sq_entries * sizeof (unsigned);
+	cqsize = p.cq_off.cqes + p.cq_entries * sizeof (struct io_uring_cqe);
+	if (EP_UT_BITSET(IORING_FEAT_SINGLE_MMAP, p.features) && cqsize > sqsize)
+		sqsize = cqsize;
+	sq = mmap(NULL, sqsize, PROT_READ | PROT_WRITE,
+				MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_SQ_RING);
+	if (sq == MAP_FAILED)
+		goto fail1;
+	if (EP_UT_BITSET(IORING_FEAT_SINGLE_MMAP, p.features))
+		cq = sq;
+	else
+	{
+		cq = mmap(NULL, cqsize, PROT_READ | PROT_WRITE,
+					MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_CQ_RING);
+		if (cq == MAP_FAILED)
+			goto fail1;
+	}
+	sqes = mmap(NULL, p.sq_entries * sizeof (struct io_uring_sqe),
+				PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+				fd, IORING_OFF_SQES);
+	if (sqes == MAP_FAILED)
+		goto fail1;
+
+	Ring.sq_head = (unsigned *) (sq + p.sq_off.head);
+	Ring.sq_tail = (unsigned *) (sq + p.sq_off.tail);
+	Ring.sq_mask = (unsigned *) (sq + p.sq_off.ring_mask);
+	Ring.sq_array = (unsigned *) (sq + p.sq_off.array);
+	Ring.sqes = sqes;
+	Ring.cq_head = (unsigned *) (cq + p.cq_off.head);
+	Ring.cq_tail = (unsigned *) (cq + p.cq_off.tail);
+	Ring.cq_mask = (unsigned *) (cq + p.cq_off.ring_mask);
+	Ring.cqes = (struct io_uring_cqe *) (cq + p.cq_off.cqes);
+	Ring.maxinflight = p.cq_entries;
+	Ring.fd = fd;
+	return EP_STAT_OK;
+
+fail1:
+	// the mappings go away with the process; this only happens at startup
+	{
+		EP_STAT estat = ep_stat_from_errno(errno);
+
+		(void) close(fd);
+		return estat;
+	}
+}
+
+
+/*
+**  COMPLETION_THREAD --- reap completions and wake up submitters
+*/
+
+static void *
+completion_thread(void *unused)
+{
+	for (;;)
+	{
+		unsigned head, tail;
+		int n = 0;
+
+		if (syscall(__NR_io_uring_enter, Ring.fd, 0, 1,
+					IORING_ENTER_GETEVENTS, NULL, 0) < 0 && errno != EINTR)
+		{
+			ep_log(ep_stat_from_errno(errno),
+					"logd_io: io_uring_enter failed");
+			sleep(1);
+			continue;
+		}
+
+		head = *Ring.cq_head;
+		tail = __atomic_load_n(Ring.cq_tail, __ATOMIC_ACQUIRE);
+		ep_thr_mutex_lock(&DoneMutex);
+		while (head != tail)
+		{
+			struct io_uring_cqe *cqe = &Ring.cqes[head & *Ring.cq_mask];
+			struct ioreq *r = (struct ioreq *) (uintptr_t) cqe->user_data;
+
+			r->res = cqe->res;
+			r->done = true;
+			head++;
+			n++;
+		}
+		__atomic_store_n(Ring.cq_head, head, __ATOMIC_RELEASE);
+		if (n > 0)
+			ep_thr_cond_broadcast(&DoneCond);
+		ep_thr_mutex_unlock(&DoneMutex);
+
+		if (n > 0)
+		{
+			ep_thr_mutex_lock(&SqMutex);
+			Ring.ninflight -= n;
+			ep_thr_cond_broadcast(&SqCond);
+			ep_thr_mutex_unlock(&SqMutex);
+		}
+	}
+	return NULL;
+}
+
+
+/*
+**  RING_DO --- submit one request and wait for it
+**
+**		Returns the result as a system call would (-1 with errno
+**		set on error).
+*/
+
+static int
+ring_do(uint8_t opcode, int fd, const struct iovec *iov, unsigned niov,
+		off_t off, uint32_t fsync_flags)
+{
+	struct ioreq r = { false, 0 };
+	struct io_uring_sqe *sqe;
+	unsigned tail;
+	int i;
+
+	ep_thr_mutex_lock(&SqMutex);
+	while (Ring.ninflight >= Ring.maxinflight)
+		ep_thr_cond_wait(&SqCond, &SqMutex, NULL);
+
+	tail = *Ring.sq_tail;
+	sqe = &Ring.sqes[tail & *Ring.sq_mask];
+	memset(sqe, 0, sizeof *sqe);
+	sqe->opcode = opcode;
+	sqe->fd = fd;
+	sqe->addr = (uintptr_t) iov;
+	sqe->len = niov;
+	sqe->off = off;
+	sqe->fsync_flags = fsync_flags;
+	sqe->user_data = (uintptr_t) &r;
+	Ring.sq_array[tail & *Ring.sq_mask] = tail & *Ring.sq_mask;
+	__atomic_store_n(Ring.sq_tail, tail + 1, __ATOMIC_RELEASE);
+	Ring.ninflight++;
+
+	i = syscall(__NR_io_uring_enter, Ring.fd, 1, 0, 0, NULL, 0);
+	if (i < 1)
+	{
+		// not submitted: take it back
+		int err = i < 0 ? errno : EAGAIN;
+
+		__atomic_store_n(Ring.sq_tail, tail, __ATOMIC_RELEASE);
+		Ring.ninflight--;
+		ep_thr_mutex_unlock(&SqMutex);
+		errno = err;
+		return -1;
+	}
+	ep_thr_mutex_unlock(&SqMutex);
+
+	ep_thr_mutex_lock(&DoneMutex);
+	while (!r.done)
+		ep_thr_cond_wait(&DoneCond, &DoneMutex, NULL);
+	ep_thr_mutex_unlock(&DoneMutex);
+
+	if (r.res < 0)
+	{
+		errno = -r.res;
+		return -1;
+	}
+	return r.res;
+}
+
+#endif // EP_OSCF_USE_IO_URING
+
+
+/*
+**  LOGD_IO_INIT --- set up the engine
+*/
+
+EP_STAT
+logd_io_init(void)
+{
+#if EP_OSCF_USE_IO_URING
+	EP_STAT estat;
+	pthread_t thr;
+	int entries;
+	int err;
+
+	if (!ep_adm_getboolparam("swarm.gdplogd.io.uring", false))
+		return EP_STAT_OK;
+	entries = ep_adm_getintparam("swarm.gdplogd.io.uring.entries", 256);
+	estat = ring_setup(entries);
+	if (!EP_STAT_ISOK(estat))
+	{
+		// probably an old kernel or a container that forbids it
+		ep_log(estat, "logd_io_init: no io_uring; using system calls");
+		return EP_STAT_OK;
+	}
+	err = pthread_create(&thr, NULL, completion_thread, NULL);
+	if (err != 0)
+	{
+		ep_log(ep_stat_from_errno(err),
+				"logd_io_init: cannot start completion thread");
+		(void) close(Ring.fd);
+		Ring.fd = -1;
+		return EP_STAT_OK;
+	}
+	ep_dbg_cprintf(Dbg, 8, "logd_io_init: io_uring with %u completions\n",
+			Ring.maxinflight);
+#else
+	ep_dbg_cprintf(Dbg, 8, "logd_io_init: using system calls\n");
+#endif
+	return EP_STAT_OK;
+}
+
+
+bool
+logd_io_async(void)
+{
+#if EP_OSCF_USE_IO_URING
+	return Ring.fd >= 0;
+#else
+	return false;
+#endif
+}
+
+
+/*
+**  LOGD_IO_PREAD --- read at offset
+*/
+
+ssize_t
+logd_io_pread(int fd, void *buf, size_t len, off_t off)
+{
+	size_t done = 0;
+
+	while (done < len)
+	{
+		ssize_t n;
+
+#if EP_OSCF_USE_IO_URING
+		if (Ring.fd >= 0)
+		{
+			struct iovec iov;
+
+			iov.iov_base = (uint8_t *) buf + done;
+			iov.iov_len = len - done;
+			n = ring_do(IORING_OP_READV, fd, &iov, 1, off + done, 0);
+		}
+		else
+#endif
+		n = pread(fd, (uint8_t *) buf + done, len - done, off + done);
+		if (n < 0 && errno == EINTR)
+			continue;
+		if (n < 0)
+			return done > 0 ? (ssize_t) done : n;
+		if (n == 0)
+			break;
+		done += n;
+	}
+	return done;
+}
+
+
+/*
+**  LOGD_IO_PWRITEV --- gather write at offset
+*/
+
+ssize_t
+logd_io_pwritev(int fd, const struct iovec *iov0, int iovcnt, off_t off)
+{
+	struct iovec iov[MAX_IOV];
+	struct iovec *ip = iov;
+	size_t done = 0;
+
+	EP_ASSERT_REQUIRE(iovcnt <= MAX_IOV);
+	memcpy(iov, iov0, iovcnt * sizeof iov[0]);
+
+	while (iovcnt > 0)
+	{
+		ssize_t n;
+
+		// skip anything already written (or empty)
+		if (ip->iov_len == 0)
+		{
+			ip++;
+			iovcnt--;
+			continue;
+		}
+
+#if EP_OSCF_USE_IO_URING
+		if (Ring.fd >= 0)
+			n = ring_do(IORING_OP_WRITEV, fd, ip, iovcnt, off + done, 0);
+		else
+#endif
+		n = pwritev(fd, ip, iovcnt, off + done);
+		if (n < 0 && errno == EINTR)
+			continue;
+		if (n <= 0)
+			return n < 0 ? n : (ssize_t) done;
+		done += n;
+
+		// advance past what was written
+		while (n > 0 && iovcnt > 0)
+		{
+			if ((size_t) n < ip->iov_len)
+			{
+				ip->iov_base = (uint8_t *) ip->iov_base + n;
+				ip->iov_len -= n;
+				n = 0;
+			}
+			else
+			{
+				n -= ip->iov_len;
+				ip++;
+				iovcnt--;
+			}
+		}
+	}
+	return done;
+}
+
+
+/*
+**  LOGD_IO_FSYNC --- flush a file to stable storage
+*/
+
+int
+logd_io_fsync(int fd, bool datasync)
+{
+#if EP_OSCF_USE_IO_URING
+	if (Ring.fd >= 0)
+		return ring_do(IORING_OP_FSYNC, fd, NULL, 0, 0,
+					datasync ? IORING_FSYNC_DATASYNC : 0);
+#endif
+	return datasync ? fdatasync(fd) : fsync(fd);
+}
+
+
+/*
+**  LOGD_IO_OPEN_DIRECT --- open a file for reading around the page cache
+**
+**		Reads from the result must use buffers, offsets, and
+**		lengths aligned to the device block size.  If the file
+**		system doesn't support O_DIRECT the file is opened
+**		normally, which still works (just with double caching).
+*/
+
+int
+logd_io_open_direct(const char *path)
+{
+	int fd = -1;
+
+#ifdef O_DIRECT
+	fd = open(path, O_RDONLY | O_DIRECT);
+	if (fd >= 0 || errno != EINVAL)
+		return fd;
+	ep_dbg_cprintf(Dbg, 8, "logd_io_open_direct(%s): not supported\n", path);
+#endif
+	fd = open(path, O_RDONLY);
+	return fd;
+}
+
+/*
+**  LOGD_IO_PREALLOC --- reserve disk space beyond end of file
+**
+**		The file size is not changed, so appends and fstat are
+**		unaffected.  Fails with EOPNOTSUPP where this can't be
+**		done without writing zeroes.
+*/
+
+int
+logd_io_prealloc(int fd, off_t off, off_t len)
+{
+#ifdef FALLOC_FL_KEEP_SIZE
+	return fallocate(fd, FALLOC_FL_KEEP_SIZE, off, len);
+#else
+	errno = EOPNOTSUPP;
+	return -1;
+#endif
+}
+
+
+/*
+**  LOGD_IO_UNRESERVE --- give back space reserved beyond end of file
+**
+**		Off must be the end of file.  Where holes can't be punched
+**		the file is truncated to its own size, which releases
+**		blocks past EOF on the common Linux file systems.
+*/
+
+int
+logd_io_unreserve(int fd, off_t off, off_t len)
+{
+#if defined(FALLOC_FL_PUNCH_HOLE) && defined(FALLOC_FL_KEEP_SIZE)
+	if (fallocate(fd, FALLOC_FL_PUNCH_HOLE | FALLOC_FL_KEEP_SIZE,
+				off, len) == 0)
+		return 0;
+	if (errno != EOPNOTSUPP)
+		return -1;
+#endif
+	return ftruncate(fd, off);
+}
+
+
+/*
+**  LOGD_IO_WRITEBACK --- start writing dirty pages without waiting
+**
+**		This is only a hint to smooth out page cache flushing;
+**		it says nothing about durability.
+*/
+
+int
+logd_io_writeback(int fd, off_t off, off_t len)
+{
+#ifdef SYNC_FILE_RANGE_WRITE
+	return sync_file_range(fd, off, len, SYNC_FILE_RANGE_WRITE);
+#else
+	errno = ENOSYS;
+	return -1;
+#endif
+}
+
+
+/*
+**  LOGD_IO_CLONE --- make dfd share sfd's blocks for a range
+**
+**		The copy costs no space or data I/O until one side is
+**		modified.  Offsets and length must be multiples of the
+**		file system block size (except that the range may run
+**		to EOF).  Fails with EOPNOTSUPP or EXDEV if the file
+**		system can't do it; the caller should then use
+**		logd_io_copy.
+*/
+
+int
+logd_io_clone(int sfd, int dfd, off_t off, off_t len)
+{
+#ifdef FICLONERANGE
+	struct file_clone_range fcr;
+
+	fcr.src_fd = sfd;
+	fcr.src_offset = off;
+	fcr.src_length = len;
+	fcr.dest_offset = off;
+	return ioctl(dfd, FICLONERANGE, &fcr);
+#else
+	errno = EOPNOTSUPP;
+	return -1;
+#endif
+}
+
+
+/*
+**  LOGD_IO_COPY --- copy a range of bytes between files
+**
+**		Data goes to the same offset in dfd.  It is copied in
+**		modest chunks through the I/O engine so that a large
+**		file doesn't tie up much memory.  Hitting EOF in sfd
+**		before len bytes counts as an error (EIO).
+*/
+
+#define COPY_CHUNK		(256 * 1024)
+
+int
+logd_io_copy(int sfd, int dfd, off_t off, off_t len)
+{
+	char *buf;
+	int rval = 0;
+
+	buf = ep_mem_malloc(COPY_CHUNK);
+	while (len > 0)
+	{
+		size_t n = len > COPY_CHUNK ? COPY_CHUNK : (size_t) len;
+		ssize_t got;
+		struct iovec iov;
+
+		got = logd_io_pread(sfd, buf, n, off);
+		if (got <= 0)
+		{
+			if (got == 0)
+				errno = EIO;
+			rval = -1;
+			break;
+		}
+		iov.iov_base = buf;
+		iov.iov_len = got;
+		if (logd_io_pwritev(dfd, &iov, 1, off) != got)
+		{
+			rval = -1;
+			break;
+		}
+		off += got;
+		len -= got;
+	}
+	ep_mem_free(buf);
+	return rval;
+}
@@ -0,0 +1,118 @@
+/* vim: set ai sw=4 sts=4 ts=4 : */
+
+/*
+**	----- BEGIN LICENSE BLOCK -----
+**	GDPLOGD: Log Daemon for the Global Data Plane
+**	From the Ubiquitous Swarm Lab, 490 Cory Hall, U.C. Berkeley.
+**
+**	Copyright (c) 2015, Regents of the University of California.
+**	All rights reserved.
+**
+**	Permission is hereby granted, without written agreement and without
+**	license or royalty fees, to use, copy, modify, and distribute this
+**	software and its documentation for any purpose, provided that the above
+**	copyright notice and the following two paragraphs appear in all copies
+**	of this software.
+**
+**	IN NO EVENT SHALL REGENTS BE LIABLE TO ANY PARTY FOR DIRECT, INDIRECT,
+**	SPECIAL, INCIDENTAL, OR CONSEQUENTIAL DAMAGES, INCLUDING LOST
+**	PROFITS, ARISING OUT OF THE USE OF THIS SOFTWARE AND ITS DOCUMENTATION,
+**	EVEN IF REGENTS HAS BEEN ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+**
+**	REGENTS SPECIFICALLY DISCLAIMS ANY WARRANTIES, INCLUDING, BUT NOT
+**	LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+**	FOR A PARTICULAR PURPOSE. THE SOFTWARE AND ACCOMPANYING DOCUMENTATION,
+**	IF ANY, PROVIDED HEREUNDER IS PROVIDED "AS IS". REGENTS HAS NO
+**	OBLIGATION TO PROVIDE MAINTENANCE, SUPPORT, UPDATES, ENHANCEMENTS,
+**	OR MODIFICATIONS.
+**	----- END LICENSE BLOCK -----
+*/
+
+
+#ifndef _GDPLOGD_IO_H_
+#define _GDPLOGD_IO_H_		1
+
+#include <ep/ep.h>
+#include <ep/ep_stat.h>
+
+#include <stdbool.h>
+#include <sys/types.h>
+#include <sys/uio.h>
+
+/*
+**  I/O engine for the physical layer.
+**
+**		On Linux with EP_OSCF_USE_IO_URING, requests are queued to
+**		an io_uring and finished by a completion thread.  Otherwise
+**		(or if the kernel refuses to set one up) they become plain
+**		system calls.  These all wait for the result, but do not
+**		hold any locks while doing so, and are safe to call from
+**		any thread.
+**
+**		The ring is off unless compiled in and asked for.  Since
+**		command handlers reply before they return, every request
+**		still waits for its own I/O, and going through the ring
+**		adds a submission lock and a thread hop to each one; it
+**		is only worth turning on once completions are deferred
+**		to the reply path.  Until then the seg back end, the
+**		only user, gets plain system calls.  The disk back end
+**		parses its files through stdio streams.
+**
+**		Return values are as for the corresponding system call;
+**		reads and writes loop until complete, EOF, or error.  A
+**		read that fails after some data has arrived returns the
+**		count so far (an O_DIRECT read that ends short at EOF
+**		can't be continued at an unaligned offset).
+*/
+
+extern EP_STAT	logd_io_init(void);			// set up engine
+
+extern bool		logd_io_async(void);		// is io_uring in use?
+
+extern ssize_t	logd_io_pread(				// read at offset
+					int fd,
+					void *buf,
+					size_t len,
+					off_t off);
+
+extern ssize_t	logd_io_pwritev(			// gather write at offset
+					int fd,
+					const struct iovec *iov,
+					int iovcnt,
+					off_t off);
+
+extern int		logd_io_fsync(				// flush to stable storage
+					int fd,
+					bool datasync);
+
+extern int		logd_io_open_direct(		// open bypassing page cache
+					const char *path);
+
+extern int		logd_io_prealloc(			// reserve space past EOF
+					int fd,
+					off_t off,
+					off_t len);
+
+extern int		logd_io_unreserve(			// release space past EOF
+					int fd,
+					off_t off,
+					off_t len);
+
+extern int		logd_io_writeback(			// start writeback (hint)
+					int fd,
+					off_t off,
+					off_t len);
+
+extern int		logd_io_clone(				// share blocks (reflink)
+					int sfd,
+					int dfd,
+					off_t off,
+					off_t len);
+
+extern int		logd_io_copy(				// copy a range of bytes
+					int sfd,
+					int dfd,
+					off_t off,
+					off_t len);
+
+#endif //_GDPLOGD_IO_H_
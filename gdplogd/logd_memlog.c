@@ -0,0 +1,586 @@
+/* vim: set ai sw=4 sts=4 ts=4 : */
+
+/*
+**	----- BEGIN LICENSE BLOCK -----
+**	GDPLOGD: Log Daemon for the Global Data Plane
+**	From the Ubiquitous Swarm Lab, 490 Cory Hall, U.C. Berkeley.
+**
+**	Copyright (c) 2015, Regents of the University of California.
+**	All rights reserved.
+**
+**	Permission is hereby granted, without written agreement and without
+**	license or royalty fees, to use, copy, modify, and distribute this
+**	software and its documentation for any purpose, provided that the above
+**	copyright notice and the following two paragraphs appear in all copies
+**	of this software.
+**
+**	IN NO EVENT SHALL REGENTS BE LIABLE TO ANY PARTY FOR DIRECT, INDIRECT,
+**	SPECIAL, INCIDENTAL, OR CONSEQUENTIAL DAMAGES, INCLUDING LOST
+**	PROFITS, ARISING OUT OF THE USE OF THIS SOFTWARE AND ITS DOCUMENTATION,
+**	EVEN IF REGENTS HAS BEEN ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+**
+**	REGENTS SPECIFICALLY DISCLAIMS ANY WARRANTIES, INCLUDING, BUT NOT
+**	LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+**	FOR A PARTICULAR PURPOSE. THE SOFTWARE AND ACCOMPANYING DOCUMENTATION,
+**	IF ANY, PROVIDED HEREUNDER IS PROVIDED "AS IS". REGENTS HAS NO
+**	OBLIGATION TO PROVIDE MAINTENANCE, SUPPORT, UPDATES, ENHANCEMENTS,
+**	OR MODIFICATIONS.
+**	----- END LICENSE BLOCK -----
+*/
+
+
+
+/*
+**  Implement in-memory version of logs.
+**
+**		Records are packed into large chunks ("arenas") as they are
+**		appended, with an array indexed by record number pointing
+**		at each one.  If the log has a size cap, whole chunks are
+**		dropped from the front when it is exceeded, so the log
+**		behaves like a ring buffer; reads of dropped records get
+**		GDP_STAT_RECORD_EXPIRED just as with expired data on disk.
+**
+**		Nothing is ever written to stable storage.  These logs
+**		live until the daemon exits, independent of whether any
+**		GCL handle refers to them.
+*/
+
+#include "logd.h"
+
+#include <gdp/gdp_buf.h>
+#include <gdp/gdp_gclmd.h>
+
+#include <ep/ep_hash.h>
+#include <ep/ep_log.h>
+#include <ep/ep_mem.h>
+#include <ep/ep_thr.h>
+
+#include <inttypes.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/queue.h>
+
+static EP_DBG	Dbg = EP_DBG_INIT("gdplogd.memlog", "GDP Log Daemon In-Memory Log");
+
+static size_t		ChunkSize;		// default arena size
+static size_t		DefaultMaxSize;	// default size cap (0 = none)
+
+static EP_HASH		*MemLogs;		// all in-memory logs by name
+static EP_THR_MUTEX	MemLogsMutex	EP_THR_MUTEX_INITIALIZER;
+
+#define MIN_CHUNK_SIZE		4096
+
+/*
+**  A single record.  The data is followed immediately by the
+**  signature; the whole thing is padded out to keep the next
+**  record aligned.
+*/
+
+struct memrec
+{
+	gdp_recno_t			recno;			// record number
+	EP_TIME_SPEC		ts;				// commit timestamp
+	uint32_t			dlen;			// length of data
+	uint16_t			siglen;			// length of signature
+	uint8_t				sigmdalg;		// signature digest algorithm
+	uint8_t				data[];			// data, then signature
+};
+
+#define MEMREC_SIZE(dlen, slen)	\
+			((offsetof(struct memrec, data) + (dlen) + (slen) + 7) & ~(size_t) 7)
+
+struct memchunk
+{
+	TAILQ_ENTRY(memchunk)	next;
+	size_t				size;			// bytes available in data
+	size_t				used;			// bytes in use
+	gdp_recno_t			nrecs;			// records in this chunk
+	uint8_t				data[];
+};
+
+/*
+**  This is what gcl->x->physinfo points at for in-memory logs
+**  (the disk implementation has its own definition).
+*/
+
+struct physinfo
+{
+	gdp_name_t			name;			// name of this log
+	EP_THR_RWLOCK		lock;			// lock on everything below
+	uint8_t				*md_wire;		// serialized metadata
+	size_t				md_wirelen;		// length of md_wire
+	gdp_recno_t			min_recno;		// first record still present
+	gdp_recno_t			max_recno;		// last record appended
+	EP_TIME_SPEC		mtime;			// time of last append
+	size_t				maxsize;		// size cap (0 = unlimited)
+	size_t				chunksize;		// size of a standard chunk
+	size_t				cursize;		// total of all chunk sizes
+	TAILQ_HEAD(memchunk_head, memchunk)
+						chunks;			// oldest first
+	struct memrec		**xrecs;		// index by recno
+	size_t				xstart;			// slot of min_recno
+	size_t				xalloc;			// slots allocated
+};
+
+#define GETMEM(gcl)		((gcl)->x->physinfo)
+
+
+/*
+**  MEM_INIT --- initialize the in-memory implementation
+*/
+
+static EP_STAT
+mem_init(void)
+{
+	ChunkSize = ep_adm_getlongparam("swarm.gdplogd.mem.chunksize",
+							1024 * 1024);
+	if (ChunkSize < MIN_CHUNK_SIZE)
+		ChunkSize = MIN_CHUNK_SIZE;
+	DefaultMaxSize = ep_adm_getlongparam("swarm.gdplogd.mem.maxsize", 0);
+	ep_dbg_cprintf(Dbg, 8, "mem_init: chunk size %zd, max size %zd\n",
+			ChunkSize, DefaultMaxSize);
+
+	ep_thr_mutex_lock(&MemLogsMutex);
+	if (MemLogs == NULL)
+		MemLogs = ep_hash_new("MemLogs", NULL, 0);
+	ep_thr_mutex_unlock(&MemLogsMutex);
+	return EP_STAT_OK;
+}
+
+
+/*
+**  MEMLOG_FIND --- find an in-memory log by name
+*/
+
+static gcl_physinfo_t *
+memlog_find(const gdp_name_t name)
+{
+	gcl_physinfo_t *ml = NULL;
+
+	ep_thr_mutex_lock(&MemLogsMutex);
+	if (MemLogs != NULL)
+		ml = ep_hash_search(MemLogs, sizeof (gdp_name_t), name);
+	ep_thr_mutex_unlock(&MemLogsMutex);
+	return ml;
+}
+
+
+/*
+**  MEMLOG_EVICT --- drop the oldest chunk
+**
+**		The chunk currently being appended to is never dropped,
+**		so the cap is only honored to within one chunk.
+*/
+
+static bool
+memlog_evict(gcl_physinfo_t *ml)
+{
+	struct memchunk *c = TAILQ_FIRST(&ml->chunks);
+
+	if (c == NULL || TAILQ_NEXT(c, next) == NULL)
+		return false;
+	TAILQ_REMOVE(&ml->chunks, c, next);
+	ml->min_recno += c->nrecs;
+	ml->xstart += c->nrecs;
+	ml->cursize -= c->size;
+	ep_dbg_cprintf(Dbg, 20, "memlog_evict: dropped %" PRIgdp_recno
+			" records, min_recno now %" PRIgdp_recno "\n",
+			c->nrecs, ml->min_recno);
+	ep_mem_free(c);
+	return true;
+}
+
+
+/*
+**  MEMLOG_ALLOC --- allocate space for a new record
+**
+**		Returns a pointer to the space, which is charged to the
+**		last chunk; the caller must fill it in and index it.
+*/
+
+static struct memrec *
+memlog_alloc(gcl_physinfo_t *ml, size_t len)
+{
+	struct memchunk *c = TAILQ_LAST(&ml->chunks, memchunk_head);
+	struct memrec *rec;
+
+	if (c == NULL || c->size - c->used < len)
+	{
+		size_t csize = ml->chunksize;
+
+		// oversized records get a chunk to themselves
+		if (csize < len)
+			csize = len;
+		c = ep_mem_malloc(sizeof *c + csize);
+		c->size = csize;
+		c->used = 0;
+		c->nrecs = 0;
+		TAILQ_INSERT_TAIL(&ml->chunks, c, next);
+		ml->cursize += csize;
+
+		// make room if this took us over the cap
+		while (ml->maxsize > 0 && ml->cursize > ml->maxsize &&
+				memlog_evict(ml))
+			continue;
+	}
+	rec = (struct memrec *) &c->data[c->used];
+	c->used += len;
+	c->nrecs++;
+	return rec;
+}
+
+
+/*
+**  MEMLOG_INDEX --- add a new record to the end of the index
+*/
+
+static void
+memlog_index(gcl_physinfo_t *ml, struct memrec *rec)
+{
+	size_t n = ml->max_recno - ml->min_recno + 1;
+
+	if (ml->xstart + n >= ml->xalloc)
+	{
+		if (ml->xstart > ml->xalloc / 2)
+		{
+			// mostly evicted: slide the live entries down
+			memmove(ml->xrecs, &ml->xrecs[ml->xstart],
+					n * sizeof ml->xrecs[0]);
+			ml->xstart = 0;
+		}
+		else
+		{
+			ml->xalloc = ml->xalloc == 0 ? 1024 : ml->xalloc * 2;
+			ml->xrecs = ep_mem_realloc(ml->xrecs,
+							ml->xalloc * sizeof ml->xrecs[0]);
+		}
+	}
+	ml->xrecs[ml->xstart + n] = rec;
+}
+
+
+/*
+**  MEM_CREATE --- create a new in-memory log
+**
+**		The size cap comes from the GDP_GCLMD_STORAGE metadata
+**		("mem:<bytes>") if given, otherwise from the daemon default.
+*/
+
+static EP_STAT
+mem_create(gdp_gcl_t *gcl, gdp_gclmd_t *gmd)
+{
+	gcl_physinfo_t *ml;
+	size_t maxsize = DefaultMaxSize;
+
+	EP_ASSERT_POINTER_VALID(gcl);
+
+	if (gmd != NULL)
+	{
+		size_t len;
+		const void *data;
+		char sbuf[40];
+
+		if (EP_STAT_ISOK(gdp_gclmd_find(gmd, GDP_GCLMD_STORAGE,
+								&len, &data)) &&
+				len < sizeof sbuf)
+		{
+			char *p;
+
+			memcpy(sbuf, data, len);
+			sbuf[len] = '\0';
+			p = strchr(sbuf, ':');
+			if (p != NULL)
+				maxsize = strtoul(p + 1, NULL, 10);
+		}
+	}
+
+	// allocate a name
+	if (!gdp_name_is_valid(gcl->name))
+	{
+		_gdp_gcl_newname(gcl);
+	}
+
+	ml = ep_mem_zalloc(sizeof *ml);
+	memcpy(ml->name, gcl->name, sizeof ml->name);
+	ep_thr_rwlock_init(&ml->lock);
+	TAILQ_INIT(&ml->chunks);
+	ml->min_recno = 1;
+	ml->max_recno = 0;
+	ml->maxsize = maxsize;
+	ml->chunksize = ChunkSize;
+	if (maxsize > 0 && ml->chunksize > maxsize / 4)
+	{
+		// keep the granularity of eviction reasonable
+		ml->chunksize = maxsize / 4;
+		if (ml->chunksize < MIN_CHUNK_SIZE)
+			ml->chunksize = MIN_CHUNK_SIZE;
+	}
+	ep_time_now(&ml->mtime);
+
+	// save the metadata in wire format
+	{
+		struct evbuffer *evb = evbuffer_new();
+
+		if (gmd != NULL)
+			_gdp_gclmd_serialize(gmd, evb);
+		ml->md_wirelen = evbuffer_get_length(evb);
+		ml->md_wire = ep_mem_malloc(ml->md_wirelen + 1);
+		evbuffer_remove(evb, ml->md_wire, ml->md_wirelen);
+		evbuffer_free(evb);
+	}
+
+	ep_thr_mutex_lock(&MemLogsMutex);
+	if (ep_hash_search(MemLogs, sizeof ml->name, ml->name) != NULL)
+	{
+		ep_thr_mutex_unlock(&MemLogsMutex);
+		ep_thr_rwlock_destroy(&ml->lock);
+		ep_mem_free(ml->md_wire);
+		ep_mem_free(ml);
+		return GDP_STAT_NAK_CONFLICT;
+	}
+	ep_hash_insert(MemLogs, sizeof ml->name, ml->name, ml);
+	ep_thr_mutex_unlock(&MemLogsMutex);
+
+	gcl->x->physinfo = ml;
+	ep_dbg_cprintf(Dbg, 10, "Created new in-memory GCL %s (max %zd)\n",
+			gcl->pname, maxsize);
+	return EP_STAT_OK;
+}
+
+
+/*
+**  MEM_OPEN --- attach a handle to an existing in-memory log
+*/
+
+static EP_STAT
+mem_open(gdp_gcl_t *gcl)
+{
+	gcl_physinfo_t *ml;
+
+	EP_ASSERT_REQUIRE(gcl->x->physinfo == NULL);
+
+	ml = memlog_find(gcl->name);
+	if (ml == NULL)
+		return GDP_STAT_NAK_NOTFOUND;
+	gcl->x->physinfo = ml;
+
+	ep_thr_rwlock_rdlock(&ml->lock);
+	gcl->nrecs = ml->max_recno;
+	ep_thr_rwlock_unlock(&ml->lock);
+	return EP_STAT_OK;
+}
+
+
+/*
+**  MEM_CLOSE --- detach a handle (the log itself stays)
+*/
+
+static EP_STAT
+mem_close(gdp_gcl_t *gcl)
+{
+	EP_ASSERT_POINTER_VALID(gcl);
+	EP_ASSERT_POINTER_VALID(gcl->x);
+
+	gcl->x->physinfo = NULL;
+	return EP_STAT_OK;
+}
+
+
+/*
+**  MEM_READ --- read a record from an in-memory log
+*/
+
+static EP_STAT
+mem_read(gdp_gcl_t *gcl,
+		gdp_datum_t *datum)
+{
+	gcl_physinfo_t *ml = GETMEM(gcl);
+	EP_STAT estat = EP_STAT_OK;
+	struct memrec *rec;
+
+	ep_dbg_cprintf(Dbg, 14, "mem_read(%" PRIgdp_recno ")\n", datum->recno);
+
+	ep_thr_rwlock_rdlock(&ml->lock);
+	if (datum->recno > ml->max_recno)
+	{
+		// record does not yet exist
+		estat = GDP_STAT_NAK_NOTFOUND;
+		goto fail0;
+	}
+	if (datum->recno < ml->min_recno)
+	{
+		// record has been dropped
+		estat = GDP_STAT_RECORD_EXPIRED;
+		goto fail0;
+	}
+
+	rec = ml->xrecs[ml->xstart + (datum->recno - ml->min_recno)];
+	datum->recno = rec->recno;
+	datum->ts = rec->ts;
+	datum->sigmdalg = rec->sigmdalg;
+	datum->siglen = rec->siglen;
+	if (rec->dlen > 0)
+		gdp_buf_write(datum->dbuf, rec->data, rec->dlen);
+	if (rec->siglen > 0)
+	{
+		if (datum->sig == NULL)
+			datum->sig = gdp_buf_new();
+		else
+			gdp_buf_reset(datum->sig);
+		gdp_buf_write(datum->sig, &rec->data[rec->dlen], rec->siglen);
+	}
+
+fail0:
+	ep_thr_rwlock_unlock(&ml->lock);
+	return estat;
+}
+
+
+/*
+**  MEM_GETTIMESTAMP --- return the timestamp of a record
+*/
+
+static EP_STAT
+mem_gettimestamp(gdp_gcl_t *gcl,
+		gdp_recno_t recno,
+		EP_TIME_SPEC *tsp)
+{
+	gcl_physinfo_t *ml = GETMEM(gcl);
+	EP_STAT estat = EP_STAT_OK;
+
+	ep_thr_rwlock_rdlock(&ml->lock);
+	if (recno > ml->max_recno)
+		estat = GDP_STAT_NAK_NOTFOUND;
+	else if (recno < ml->min_recno)
+		estat = GDP_STAT_RECORD_EXPIRED;
+	else
+		*tsp = ml->xrecs[ml->xstart + (recno - ml->min_recno)]->ts;
+	ep_thr_rwlock_unlock(&ml->lock);
+	return estat;
+}
+
+
+/*
+**  MEM_APPEND --- append a record to an in-memory log
+*/
+
+static EP_STAT
+mem_append(gdp_gcl_t *gcl,
+		gdp_datum_t *datum)
+{
+	gcl_physinfo_t *ml = GETMEM(gcl);
+	struct memrec *rec;
+	size_t dlen;
+	size_t slen = 0;
+
+	if (ep_dbg_test(Dbg, 14))
+	{
+		ep_dbg_printf("mem_append ");
+		_gdp_datum_dump(datum, ep_dbg_getfile());
+	}
+
+	dlen = evbuffer_get_length(datum->dbuf);
+	if (datum->sig != NULL)
+		slen = evbuffer_get_length(datum->sig);
+
+	ep_thr_rwlock_wrlock(&ml->lock);
+	rec = memlog_alloc(ml, MEMREC_SIZE(dlen, slen));
+	rec->recno = ml->max_recno + 1;
+	rec->ts = datum->ts;
+	rec->dlen = dlen;
+	rec->siglen = slen;
+	rec->sigmdalg = datum->sigmdalg;
+	if (dlen > 0)
+		evbuffer_copyout(datum->dbuf, rec->data, dlen);
+	if (slen > 0)
+		evbuffer_copyout(datum->sig, &rec->data[dlen], slen);
+
+	memlog_index(ml, rec);
+	++ml->max_recno;
+	ml->mtime = datum->ts;
+	ep_thr_rwlock_unlock(&ml->lock);
+
+	return EP_STAT_OK;
+}
+
+
+/*
+**  MEM_GETMETADATA --- return the metadata saved at create
+*/
+
+static EP_STAT
+mem_getmetadata(gdp_gcl_t *gcl,
+		gdp_gclmd_t **gmdp)
+{
+	gcl_physinfo_t *ml = GETMEM(gcl);
+	struct evbuffer *evb = evbuffer_new();
+
+	evbuffer_add(evb, ml->md_wire, ml->md_wirelen);
+	*gmdp = _gdp_gclmd_deserialize(evb);
+	evbuffer_free(evb);
+	if (*gmdp == NULL)
+		*gmdp = gdp_gclmd_new(0);
+	return EP_STAT_OK;
+}
+
+
+/*
+**  MEM_FOREACH --- call function for each in-memory log
+*/
+
+static void
+foreach_helper(size_t klen, const void *key, void *val, va_list av)
+{
+	void (*func)(gdp_name_t, void *) = va_arg(av, void (*)(gdp_name_t, void *));
+	void *ctx = va_arg(av, void *);
+
+	if (val != NULL)
+		(*func)(((gcl_physinfo_t *) val)->name, ctx);
+}
+
+static void
+mem_foreach(void (*func)(gdp_name_t, void *), void *ctx)
+{
+	ep_thr_mutex_lock(&MemLogsMutex);
+	if (MemLogs != NULL)
+		ep_hash_forall(MemLogs, foreach_helper, func, ctx);
+	ep_thr_mutex_unlock(&MemLogsMutex);
+}
+
+
+/*
+**  MEM_GETMTIME --- return time of last append
+**
+**		Also serves as a cheap test of whether an in-memory log
+**		with this name exists.
+*/
+
+static EP_STAT
+mem_getmtime(gdp_name_t gname, EP_TIME_SPEC *mtime)
+{
+	gcl_physinfo_t *ml = memlog_find(gname);
+
+	if (ml == NULL)
+		return GDP_STAT_NAK_NOTFOUND;
+	ep_thr_rwlock_rdlock(&ml->lock);
+	*mtime = ml->mtime;
+	ep_thr_rwlock_unlock(&ml->lock);
+	return EP_STAT_OK;
+}
+
+
+struct gcl_phys_impl	GdpMemImpl =
+{
+	.init =			mem_init,
+	.read =			mem_read,
+	.create =		mem_create,
+	.open =			mem_open,
+	.close =		mem_close,
+	.append =		mem_append,
+	.getmetadata =	mem_getmetadata,
+	.foreach =		mem_foreach,
+	.getmtime =		mem_getmtime,
+	.gettimestamp =	mem_gettimestamp,
+};
@@ -34,6 +34,9 @@
 #include <gdp/gdp_gclmd.h>
 #include <gdp/gdp_priv.h>
 
+#include <ctype.h>
+#include <time.h>
+
 static EP_DBG	Dbg = EP_DBG_INIT("gdplogd.proto", "GDP Log Daemon protocol");
 
 /*
@@ -155,6 +158,26 @@ done:
 }
 
 
+/*
+**  CMD_HELLO --- exchange capabilities with a client
+**
+**		The client tells us what compression algorithms it can
+**		take and whether it wants batched multiread results; we
+**		answer with the same information about us.  This is
+**		remembered per client, not per log.
+*/
+
+EP_STAT
+cmd_hello(gdp_req_t *req)
+{
+	req->pdu->cmd = GDP_ACK_SUCCESS;
+	_gdp_hello_get(req->pdu->src, req->pdu->datum->dbuf);
+	flush_input_data(req, "cmd_hello");
+	_gdp_hello_put(req->pdu->datum->dbuf);
+	return EP_STAT_OK;
+}
+
+
 /*
 **  CMD_CREATE --- create new GCL.
 **
@@ -217,9 +240,36 @@ cmd_create(gdp_req_t *req)
 	// no further input, so we can reset the buffer just to be safe
 	flush_input_data(req, "cmd_create");
 
+	// decide where it lives; the name must be unused in all of them
+	{
+		struct gcl_phys_impl *physimpl = gcl_physimpl_select(gmd);
+
+		if (physimpl == NULL)
+			estat = GDP_STAT_NAK_BADREQ;
+		else if (gcl_physimpl_find(gclname) != NULL)
+			estat = GDP_STAT_NAK_CONFLICT;
+		else
+			gcl->x->physimpl = physimpl;
+		if (!EP_STAT_ISOK(estat))
+		{
+			gdp_gclmd_free(gmd);
+			goto fail2;
+		}
+	}
+
 	// do the physical create
 	estat = gcl->x->physimpl->create(gcl, gmd);
-	gdp_gclmd_free(gmd);
+	if (!EP_STAT_ISOK(estat))
+	{
+		gdp_gclmd_free(gmd);
+		goto fail1;
+	}
+
+	// keep the metadata with the handle (it can't change)
+	if (gmd == NULL)
+		gmd = gdp_gclmd_new(0);
+	gcl->gclmd = gmd;
+	estat = gcl_load_metadata(gcl);
 	EP_STAT_CHECK(estat, goto fail1);
 
 	// advertise this new GCL
@@ -240,6 +290,7 @@ cmd_create(gdp_req_t *req)
 fail1:
 		req->pdu->cmd = GDP_NAK_S_INTERNAL;
 	}
+fail2:
 	_gdp_gcl_decref(&req->gcl);
 
 fail0:
@@ -276,10 +327,11 @@ cmd_open(gdp_req_t *req)
 	gcl = req->gcl;
 	gcl->flags |= GCLF_DEFER_FREE;
 	gcl->iomode = GDP_MODE_RA;
-	if (gcl->gclmd != NULL)
+	if (gcl->x->md_wirelen > 0)
 	{
 		// send metadata as payload
-		_gdp_gclmd_serialize(gcl->gclmd, req->pdu->datum->dbuf);
+		gdp_buf_write(req->pdu->datum->dbuf, gcl->x->md_wire,
+				gcl->x->md_wirelen);
 	}
 
 	req->pdu->datum->recno = gcl->nrecs;
@@ -383,6 +435,8 @@ cmd_read(gdp_req_t *req)
 **
 **		This needs to be done during the append rather than the open
 **		so if gdplogd is restarted, existing connections will heal.
+**		The public key and the serialized metadata are kept with
+**		the handle, so this only happens once per open.
 */
 
 static EP_STAT
@@ -411,22 +465,25 @@ init_sig_digest(gdp_gcl_t *gcl)
 	//pkbits = (pkbuf[2] << 8) | pkbuf[3];
 	ep_dbg_cprintf(Dbg, 40, "init_sig_data: mdtype=%d, pktype=%d, pklen=%zd\n",
 			mdtype, pktype, pklen);
-	key = ep_crypto_key_read_mem(pkbuf + 4, pklen - 4,
-			EP_CRYPTO_KEYFORM_DER, EP_CRYPTO_F_PUBLIC);
+	key = gcl->x->pubkey;
 	if (key == NULL)
-		goto nopubkey;
+	{
+		key = ep_crypto_key_read_mem(pkbuf + 4, pklen - 4,
+				EP_CRYPTO_KEYFORM_DER, EP_CRYPTO_F_PUBLIC);
+		if (key == NULL)
+			goto nopubkey;
+		gcl->x->pubkey = key;
+	}
 
 	gcl->digest = ep_crypto_vrfy_new(key, mdtype);
+	if (gcl->digest == NULL)
+		goto nopubkey;
 
 	// include the GCL name
 	ep_crypto_vrfy_update(gcl->digest, gcl->name, sizeof gcl->name);
 
-	// and the metadata (re-serialized)
-	struct evbuffer *evb = evbuffer_new();
-	_gdp_gclmd_serialize(gcl->gclmd, evb);
-	size_t evblen = evbuffer_get_length(evb);
-	ep_crypto_vrfy_update(gcl->digest, evbuffer_pullup(evb, evblen), evblen);
-	evbuffer_free(evb);
+	// and the metadata (as serialized at open time)
+	ep_crypto_vrfy_update(gcl->digest, gcl->x->md_wire, gcl->x->md_wirelen);
 
 	if (false)
 	{
@@ -450,12 +507,6 @@ nopubkey:
 
 
 
-/*
-**  CMD_APPEND --- append a datum to a GCL
-**
-**		This will have side effects if there are subscriptions pending.
-*/
-
 #define PUT64(v) \
 		{ \
 			*pbp++ = ((v) >> 56) & 0xff; \
@@ -468,107 +519,274 @@ nopubkey:
 			*pbp++ = ((v) & 0xff); \
 		}
 
-EP_STAT
-cmd_append(gdp_req_t *req)
-{
-	EP_STAT estat;
 
-	req->pdu->cmd = GDP_ACK_CREATED;
+/*
+**  Append statistics
+**
+**		Appends to a single GCL may be running in several worker
+**		threads at once.  Signature verification (the expensive
+**		part) runs unlocked in each of them; only the commit to
+**		disk is serialized, and that is done in record number
+**		order.  These counters show how that is working out.
+*/
 
-	estat = get_open_handle(req, GDP_MODE_AO);
-	if (!EP_STAT_ISOK(estat))
-	{
-		return gdpd_gcl_error(req->pdu->dst, "cmd_append: GCL not open",
-							estat, GDP_STAT_NAK_BADREQ);
-	}
+static EP_THR_MUTEX	AppendStatsMutex	EP_THR_MUTEX_INITIALIZER;
+static struct
+{
+	uint64_t		nverified;		// signatures that checked out
+	uint64_t		nfailed;		// signatures that didn't
+	uint64_t		nunsigned;		// appends with no signature/key
+	int64_t			vrfy_ns;		// total time spent verifying
+	uint64_t		nreordered;		// had to wait for a predecessor
+	uint64_t		ntimedout;		// predecessor never showed up
+	uint64_t		nnowait;		// too many waiters already
+	int				nwaiting;		// currently waiting for predecessor
+} AppendStats;
+
+#define APPEND_STAT_INCR(f)		\
+		{ \
+			ep_thr_mutex_lock(&AppendStatsMutex); \
+			AppendStats.f++; \
+			ep_thr_mutex_unlock(&AppendStatsMutex); \
+		}
 
-	// validate sequence number and signature
-	if (req->pdu->datum->recno != req->gcl->nrecs + 1)
-	{
-		// replay or missing a record
-		ep_dbg_cprintf(Dbg, 1, "cmd_append: record sequence error: got %"
-						PRIgdp_recno ", wanted %" PRIgdp_recno "\n",
-						req->pdu->datum->recno, req->gcl->nrecs + 1);
+void
+append_stats_dump(FILE *fp)
+{
+	ep_thr_mutex_lock(&AppendStatsMutex);
+	fprintf(fp, "\n<<< Append statistics >>>\n"
+			"    verified %" PRIu64 ", failed %" PRIu64
+			", unsigned %" PRIu64 "\n",
+			AppendStats.nverified, AppendStats.nfailed,
+			AppendStats.nunsigned);
+	if (AppendStats.nverified + AppendStats.nfailed > 0)
+		fprintf(fp, "    average verify time %" PRId64 " ns\n",
+				AppendStats.vrfy_ns /
+					(int64_t) (AppendStats.nverified + AppendStats.nfailed));
+	fprintf(fp, "    reordered %" PRIu64 ", reorder timeouts %" PRIu64
+			", no wait slot %" PRIu64 "\n",
+			AppendStats.nreordered, AppendStats.ntimedout,
+			AppendStats.nnowait);
+	ep_thr_mutex_unlock(&AppendStatsMutex);
+}
 
-		// XXX TEMPORARY: if no key, allow any record number XXX
-		// (for compatibility with older clients) [delete if condition]
-		if (GDP_PROTO_MIN_VERSION > 2 || req->pdu->ver > 2)
-			return gdpd_gcl_error(req->pdu->dst,
-						"cmd_append: record sequence error",
-						GDP_STAT_RECNO_SEQ_ERROR, GDP_STAT_NAK_FORBIDDEN);
-	}
 
-	if (req->gcl->digest == NULL)
-	{
-		estat = init_sig_digest(req->gcl);
-		EP_STAT_CHECK(estat, goto fail1);
-	}
+/*
+**  VERIFY_APPEND --- check the signature on an incoming datum
+**
+**		This runs without any locks held on the GCL; the digest
+**		in the handle is pre-seeded with the GCL name and metadata
+**		and is only ever cloned here, never updated.
+**
+**		Returns false if the append must be rejected.
+*/
 
-	// check the signature in the PDU
-	if (req->gcl->digest == NULL)
+static bool
+verify_append(gdp_gcl_t *gcl, gdp_datum_t *datum)
+{
+	EP_STAT estat;
+	uint8_t recnobuf[8];		// 64 bits
+	uint8_t *pbp = recnobuf;
+	size_t len;
+	EP_CRYPTO_MD *md;
+	EP_TIME_SPEC t0, t1;
+
+	if (gcl->digest == NULL)
 	{
 		// error (maybe): no public key
+		APPEND_STAT_INCR(nunsigned);
 		if (EP_UT_BITSET(GDP_SIG_PUBKEYREQ, GdpSignatureStrictness))
 		{
 			ep_dbg_cprintf(Dbg, 1, "cmd_append: no public key (fail)\n");
-			goto fail1;
+			return false;
 		}
 		ep_dbg_cprintf(Dbg, 51, "cmd_append: no public key (warn)\n");
+		return true;
 	}
-	else if (req->pdu->datum->sig == NULL)
+
+	if (datum->sig == NULL)
 	{
 		// error (maybe): signature required
+		APPEND_STAT_INCR(nunsigned);
 		if (EP_UT_BITSET(GDP_SIG_REQUIRED, GdpSignatureStrictness))
 		{
 			ep_dbg_cprintf(Dbg, 1, "cmd_append: missing signature (fail)\n");
-			goto fail1;
+			return false;
 		}
 		ep_dbg_cprintf(Dbg, 1, "cmd_append: missing signature (warn)\n");
+		return true;
 	}
+
+	// check the signature
+	ep_time_now(&t0);
+	md = ep_crypto_md_clone(gcl->digest);
+	PUT64(datum->recno);
+	ep_crypto_vrfy_update(md, &recnobuf, sizeof recnobuf);
+	gdp_buf_vrfy_update(datum->dbuf, md);
+	len = gdp_buf_getlength(datum->sig);
+	estat = ep_crypto_vrfy_final(md, gdp_buf_getptr(datum->sig, len), len);
+	ep_crypto_md_free(md);
+	ep_time_now(&t1);
+
+	ep_thr_mutex_lock(&AppendStatsMutex);
+	if (EP_STAT_ISOK(estat))
+		AppendStats.nverified++;
 	else
+		AppendStats.nfailed++;
+	AppendStats.vrfy_ns += (t1.tv_sec - t0.tv_sec) * INT64_C(1000000000) +
+							(t1.tv_nsec - t0.tv_nsec);
+	ep_thr_mutex_unlock(&AppendStatsMutex);
+
+	if (!EP_STAT_ISOK(estat))
 	{
-		// check the signature
-		uint8_t recnobuf[8];		// 64 bits
-		uint8_t *pbp = recnobuf;
-		size_t len;
-		gdp_datum_t *datum = req->pdu->datum;
-		EP_CRYPTO_MD *md = ep_crypto_md_clone(req->gcl->digest);
-
-		PUT64(datum->recno);
-		ep_crypto_vrfy_update(md, &recnobuf, sizeof recnobuf);
-		len = gdp_buf_getlength(datum->dbuf);
-		ep_crypto_vrfy_update(md, gdp_buf_getptr(datum->dbuf, len), len);
-		len = gdp_buf_getlength(datum->sig);
-		estat = ep_crypto_vrfy_final(md,
-						gdp_buf_getptr(datum->sig, len), len);
-		ep_crypto_md_free(md);
-		if (!EP_STAT_ISOK(estat))
+		// error: signature failure
+		if (EP_UT_BITSET(GDP_SIG_MUSTVERIFY, GdpSignatureStrictness))
 		{
-			// error: signature failure
-			if (EP_UT_BITSET(GDP_SIG_MUSTVERIFY, GdpSignatureStrictness))
+			ep_dbg_cprintf(Dbg, 1, "cmd_append: signature failure (fail)\n");
+			return false;
+		}
+		ep_dbg_cprintf(Dbg, 51, "cmd_append: signature failure (warn)\n");
+	}
+	else
+	{
+		ep_dbg_cprintf(Dbg, 51, "cmd_append: good signature\n");
+	}
+	return true;
+}
+
+
+/*
+**  CMD_APPEND --- append a datum to a GCL
+**
+**		This will have side effects if there are subscriptions pending.
+**
+**		Since commands are handed to the thread pool in arrival
+**		order, several appends to the same GCL may be verified at
+**		once.  Before committing, each waits (for a bounded time)
+**		until its predecessor has been written so the records land
+**		in sequence.
+*/
+
+EP_STAT
+cmd_append(gdp_req_t *req)
+{
+	EP_STAT estat;
+	gdp_gcl_t *gcl;
+	gdp_datum_t *datum = req->pdu->datum;
+	bool strictseq = GDP_PROTO_MIN_VERSION > 2 || req->pdu->ver > 2;
+
+	req->pdu->cmd = GDP_ACK_CREATED;
+
+	estat = get_open_handle(req, GDP_MODE_AO);
+	if (!EP_STAT_ISOK(estat))
+	{
+		return gdpd_gcl_error(req->pdu->dst, "cmd_append: GCL not open",
+							estat, GDP_STAT_NAK_BADREQ);
+	}
+	gcl = req->gcl;
+
+	// replicas only change by replication from their leader
+	if (logd_repl_is_replica(gcl->name))
+	{
+		ep_dbg_cprintf(Dbg, 1, "cmd_append: %s is a replica\n", gcl->pname);
+		goto fail1;
+	}
+
+	// replays can be rejected right away; gaps might be filled in
+	if (datum->recno <= gcl->nrecs && strictseq)
+		goto seqerror;
+
+	// set up the digest once; other appends may be racing us
+	if (gcl->digest == NULL)
+	{
+		ep_thr_mutex_lock(&gcl->x->append_mutex);
+		estat = init_sig_digest(gcl);
+		ep_thr_mutex_unlock(&gcl->x->append_mutex);
+		EP_STAT_CHECK(estat, goto fail1);
+	}
+
+	// check the signature in the PDU (in parallel with other appends)
+	if (!verify_append(gcl, datum))
+		goto fail1;
+
+	// commit stage: wait for our turn
+	ep_thr_mutex_lock(&gcl->x->append_mutex);
+	if (strictseq && datum->recno > gcl->nrecs + 1)
+	{
+		EP_TIME_SPEC delta, abstime;
+		long tmo = ep_adm_getlongparam("swarm.gdplogd.append.reorder.timeout",
+							500);
+		int maxwaiters = ep_adm_getintparam(
+							"swarm.gdplogd.append.reorder.maxwaiters", 4);
+		bool canwait;
+
+		// don't let out-of-order appends tie up the whole worker pool
+		ep_thr_mutex_lock(&AppendStatsMutex);
+		AppendStats.nreordered++;
+		canwait = AppendStats.nwaiting < maxwaiters;
+		if (canwait)
+			AppendStats.nwaiting++;
+		else
+			AppendStats.nnowait++;
+		ep_thr_mutex_unlock(&AppendStatsMutex);
+
+		if (canwait)
+		{
+			ep_time_from_nsec(tmo * INT64_C(1000000), &delta);
+			ep_time_deltanow(&delta, &abstime);
+			while (datum->recno > gcl->nrecs + 1)
 			{
-				ep_dbg_cprintf(Dbg, 1, "cmd_append: signature failure (fail)\n");
-				goto fail1;
+				if (ep_thr_cond_wait(&gcl->x->append_cond,
+							&gcl->x->append_mutex, &abstime) != 0)
+					break;
 			}
-			ep_dbg_cprintf(Dbg, 51, "cmd_append: signature failure (warn)\n");
+
+			ep_thr_mutex_lock(&AppendStatsMutex);
+			AppendStats.nwaiting--;
+			if (datum->recno > gcl->nrecs + 1)
+				AppendStats.ntimedout++;
+			ep_thr_mutex_unlock(&AppendStatsMutex);
 		}
-		else
+	}
+	if (datum->recno != gcl->nrecs + 1)
+	{
+		// replay or missing a record
+		// XXX TEMPORARY: if no key, allow any record number XXX
+		// (for compatibility with older clients) [delete if condition]
+		if (strictseq)
 		{
-			ep_dbg_cprintf(Dbg, 51, "cmd_append: good signature\n");
+			ep_thr_mutex_unlock(&gcl->x->append_mutex);
+			goto seqerror;
 		}
+		ep_dbg_cprintf(Dbg, 1, "cmd_append: record sequence error: got %"
+						PRIgdp_recno ", wanted %" PRIgdp_recno " (ignored)\n",
+						datum->recno, gcl->nrecs + 1);
 	}
 
 	// make sure the timestamp is current
-	estat = ep_time_now(&req->pdu->datum->ts);
+	estat = ep_time_now(&datum->ts);
 
 	// create the message
-	estat = req->gcl->x->physimpl->append(req->gcl, req->pdu->datum);
-	req->gcl->nrecs = req->pdu->datum->recno;
+	estat = gcl->x->physimpl->append(gcl, datum);
+	gcl->nrecs = datum->recno;
+	ep_thr_cond_broadcast(&gcl->x->append_cond);
+	ep_thr_mutex_unlock(&gcl->x->append_mutex);
 
 	// send the new data to any subscribers
 	if (EP_STAT_ISOK(estat))
 		sub_notify_all_subscribers(req, GDP_ACK_CONTENT);
 
+	if (false)
+	{
+seqerror:
+		ep_dbg_cprintf(Dbg, 1, "cmd_append: record sequence error: got %"
+						PRIgdp_recno ", wanted %" PRIgdp_recno "\n",
+						datum->recno, gcl->nrecs + 1);
+		estat = gdpd_gcl_error(req->pdu->dst,
+						"cmd_append: record sequence error",
+						GDP_STAT_RECNO_SEQ_ERROR, GDP_STAT_NAK_FORBIDDEN);
+	}
+
 	if (false)
 	{
 fail1:
@@ -577,8 +795,7 @@ fail1:
 
 //fail0:
 	// we can now let the data in the request go
-	evbuffer_drain(req->pdu->datum->dbuf,
-			evbuffer_get_length(req->pdu->datum->dbuf));
+	evbuffer_drain(datum->dbuf, evbuffer_get_length(datum->dbuf));
 
 	// we're no longer using this handle
 	_gdp_gcl_decref(&req->gcl);
@@ -596,10 +813,38 @@ fail1:
 **		request is satisified, we remove it.
 */
 
+static size_t	MultireadBatchSize;		// max bytes per batched PDU
+
+static gdp_pdu_t *
+batch_new(gdp_req_t *req)
+{
+	gdp_pdu_t *bpdu = _gdp_pdu_new();
+
+	bpdu->cmd = req->pdu->cmd;
+	memcpy(bpdu->dst, req->pdu->dst, sizeof bpdu->dst);
+	memcpy(bpdu->src, req->pdu->src, sizeof bpdu->src);
+	bpdu->rid = req->pdu->rid;
+	bpdu->seqno = req->pdu->seqno;
+	return bpdu;
+}
+
+static EP_STAT
+batch_flush(gdp_req_t *req, gdp_pdu_t **bpdup)
+{
+	EP_STAT estat;
+
+	estat = _gdp_pdu_out(*bpdup, req->chan, NULL);
+	_gdp_pdu_free(*bpdup);
+	*bpdup = NULL;
+	return estat;
+}
+
 void
 post_subscribe(gdp_req_t *req)
 {
 	EP_STAT estat;
+	gdp_pdu_t *bpdu = NULL;
+	size_t batchmax = 0;
 
 	ep_dbg_cprintf(Dbg, 38,
 			"post_subscribe: numrecs = %d, nextrec = %"PRIgdp_recno"\n",
@@ -608,6 +853,10 @@ post_subscribe(gdp_req_t *req)
 	// make sure the request has the right command
 	req->pdu->cmd = GDP_ACK_CONTENT;
 
+	// pack existing records together if the client can take it
+	if (EP_UT_BITSET(GDP_CAP_BATCH, _gdp_peer_caps(req->pdu->dst)))
+		batchmax = MultireadBatchSize;
+
 	while (req->numrecs >= 0)
 	{
 		// see if data pre-exists in the GCL
@@ -623,7 +872,18 @@ post_subscribe(gdp_req_t *req)
 		if (EP_STAT_ISOK(estat))
 		{
 			// OK, the next record exists: send it
-			req->stat = estat = _gdp_pdu_out(req->pdu, req->chan, NULL);
+			if (batchmax == 0)
+			{
+				req->stat = estat = _gdp_pdu_out(req->pdu, req->chan, NULL);
+			}
+			else
+			{
+				if (bpdu == NULL)
+					bpdu = batch_new(req);
+				_gdp_pdu_batch_add(bpdu, req->pdu->datum);
+				if (gdp_buf_getlength(bpdu->datum->dbuf) >= batchmax)
+					req->stat = estat = batch_flush(req, &bpdu);
+			}
 
 			// have to clear the old data
 			evbuffer_drain(req->pdu->datum->dbuf,
@@ -635,7 +895,7 @@ post_subscribe(gdp_req_t *req)
 				// numrecs was positive, now zero, but zero means infinity
 				req->numrecs--;
 			}
-			req->nextrec++;
+			req->nextrec += req->stride;
 		}
 		else if (!EP_STAT_IS_SAME(estat, GDP_STAT_NAK_NOTFOUND))
 		{
@@ -653,6 +913,10 @@ post_subscribe(gdp_req_t *req)
 		EP_STAT_CHECK(estat, break);
 	}
 
+	// anything left in the batch has to go before the end notice
+	if (bpdu != NULL)
+		req->stat = batch_flush(req, &bpdu);
+
 	if (req->numrecs < 0 || !EP_UT_BITSET(GDP_REQ_SUBUPGRADE, req->flags))
 	{
 		// no more to read: do cleanup & send termination notice
@@ -675,6 +939,140 @@ post_subscribe(gdp_req_t *req)
 }
 
 
+/*
+**  POST_MULTIREAD_BUCKETED --- return last record in each time bucket
+**
+**		The range [nextrec, lastrec] is divided into buckets of
+**		bucket_ns nanoseconds starting at the timestamp of the
+**		first record, and the last record of each non-empty bucket
+**		is returned.  Bucket boundaries are found by binary search
+**		on the record timestamps, so each returned record costs
+**		O(log n) timestamp lookups rather than a scan of the whole
+**		range.  Back ends with a gettimestamp method only read the
+**		index and record header for those; others read the whole
+**		record.  This assumes that timestamps are (mostly)
+**		non-decreasing; records that violate that are lumped into
+**		whichever bucket the search happens to land in.  Missing
+**		and expired records are skipped.
+*/
+
+// find the first record at or after *recnop (up to maxrec) that exists
+static EP_STAT
+read_timestamp(gdp_gcl_t *gcl,
+		gdp_datum_t *datum,
+		gdp_recno_t *recnop,
+		gdp_recno_t maxrec,
+		int64_t *tsp)
+{
+	EP_STAT estat;
+	EP_TIME_SPEC ts;
+	gdp_recno_t recno;
+
+	for (recno = *recnop; recno <= maxrec; recno++)
+	{
+		if (gcl->x->physimpl->gettimestamp != NULL)
+		{
+			estat = gcl->x->physimpl->gettimestamp(gcl, recno, &ts);
+		}
+		else
+		{
+			datum->recno = recno;
+			estat = gcl->x->physimpl->read(gcl, datum);
+			gdp_buf_reset(datum->dbuf);
+			ts = datum->ts;
+		}
+		if (EP_STAT_IS_SAME(estat, GDP_STAT_NAK_NOTFOUND) ||
+				EP_STAT_IS_SAME(estat, GDP_STAT_RECORD_EXPIRED))
+			continue;
+		if (EP_STAT_ISOK(estat))
+		{
+			*recnop = recno;
+			*tsp = ts.tv_sec * INT64_C(1000000000) + ts.tv_nsec;
+		}
+		return estat;
+	}
+	return GDP_STAT_NAK_NOTFOUND;
+}
+
+static void
+post_multiread_bucketed(gdp_req_t *req)
+{
+	EP_STAT estat;
+	gdp_datum_t *probe = gdp_datum_new();
+	gdp_recno_t first = req->nextrec;
+	int64_t t0;
+	int64_t ts;
+
+	ep_dbg_cprintf(Dbg, 38,
+			"post_multiread_bucketed: %" PRIgdp_recno " .. %" PRIgdp_recno
+			", bucket = %" PRId64 " ns\n",
+			req->nextrec, req->lastrec, req->bucket_ns);
+
+	// make sure the request has the right command
+	req->pdu->cmd = GDP_ACK_CONTENT;
+
+	estat = read_timestamp(req->gcl, probe, &first, req->lastrec, &t0);
+	while (EP_STAT_ISOK(estat) && req->nextrec <= req->lastrec)
+	{
+		gdp_recno_t lo = req->nextrec;
+		gdp_recno_t hi = req->lastrec;
+		int64_t bucket_end;
+
+		// find the end of the bucket containing nextrec
+		estat = read_timestamp(req->gcl, probe, &lo, hi, &ts);
+		EP_STAT_CHECK(estat, break);
+		if (ts < t0)
+			ts = t0;
+		bucket_end = t0 + ((ts - t0) / req->bucket_ns + 1) * req->bucket_ns;
+
+		// find the last record that falls before the end of the bucket
+		while (lo < hi)
+		{
+			gdp_recno_t mid = lo + (hi - lo + 1) / 2;
+			gdp_recno_t r = mid;
+
+			estat = read_timestamp(req->gcl, probe, &r, hi, &ts);
+			if (EP_STAT_IS_SAME(estat, GDP_STAT_NAK_NOTFOUND))
+			{
+				// nothing left in [mid, hi]
+				estat = EP_STAT_OK;
+				hi = mid - 1;
+				continue;
+			}
+			EP_STAT_CHECK(estat, break);
+			if (ts < bucket_end)
+				lo = r;
+			else
+				hi = mid - 1;
+		}
+		EP_STAT_CHECK(estat, break);
+
+		// read that record and send it (unless it expired meanwhile)
+		req->nextrec = lo + 1;
+		req->pdu->datum->recno = lo;
+		estat = req->gcl->x->physimpl->read(req->gcl, req->pdu->datum);
+		if (EP_STAT_IS_SAME(estat, GDP_STAT_RECORD_EXPIRED))
+		{
+			estat = EP_STAT_OK;
+			continue;
+		}
+		EP_STAT_CHECK(estat, break);
+		req->stat = estat = _gdp_pdu_out(req->pdu, req->chan, NULL);
+		evbuffer_drain(req->pdu->datum->dbuf,
+				evbuffer_get_length(req->pdu->datum->dbuf));
+	}
+
+	// running out of records is just the end of the range
+	if (!EP_STAT_ISOK(estat) && !EP_STAT_IS_SAME(estat, GDP_STAT_NAK_NOTFOUND))
+		ep_log(estat, "post_multiread_bucketed: bad read");
+	gdp_datum_free(probe);
+
+	// never converts to a subscription
+	req->numrecs = -1;
+	sub_end_subscription(req);
+}
+
+
 /*
 **  CMD_SUBSCRIBE --- subscribe command
 **
@@ -836,10 +1234,25 @@ cmd_multiread(gdp_req_t *req)
 	// get the additional parameters: number of records and timeout
 	req->numrecs = (int) gdp_buf_get_uint32(req->pdu->datum->dbuf);
 
+	// optional sampling parameters: stride and time bucket width
+	if (gdp_buf_getlength(req->pdu->datum->dbuf) >= sizeof (uint32_t))
+		req->stride = (int32_t) gdp_buf_get_uint32(req->pdu->datum->dbuf);
+	if (gdp_buf_getlength(req->pdu->datum->dbuf) >= 16)
+	{
+		EP_TIME_SPEC bucket;
+
+		gdp_buf_get_timespec(req->pdu->datum->dbuf, &bucket);
+		if (bucket.tv_sec >= 0 && bucket.tv_nsec >= 0)
+			req->bucket_ns = bucket.tv_sec * INT64_C(1000000000) +
+					bucket.tv_nsec;
+	}
+
 	if (ep_dbg_test(Dbg, 14))
 	{
-		ep_dbg_printf("cmd_multiread: first = %" PRIgdp_recno ", numrecs = %d\n  ",
-				req->pdu->datum->recno, req->numrecs);
+		ep_dbg_printf("cmd_multiread: first = %" PRIgdp_recno ", numrecs = %d"
+				", stride = %d, bucket = %" PRId64 " ns\n  ",
+				req->pdu->datum->recno, req->numrecs,
+				req->stride, req->bucket_ns);
 		_gdp_gcl_dump(req->gcl, ep_dbg_getfile(), GDP_PR_BASIC, 0);
 	}
 
@@ -858,7 +1271,7 @@ cmd_multiread(gdp_req_t *req)
 		}
 	}
 
-	if (req->numrecs < 0)
+	if (req->numrecs < 0 || req->stride < 1 || req->bucket_ns < 0)
 	{
 		return GDP_STAT_NAK_BADOPT;
 	}
@@ -888,6 +1301,18 @@ cmd_multiread(gdp_req_t *req)
 		int32_t nrec = req->gcl->nrecs - req->nextrec;
 		if (nrec < req->numrecs || req->numrecs == 0)
 			req->numrecs = nrec + 1;
+		req->lastrec = req->nextrec + req->numrecs - 1;
+
+		if (req->bucket_ns > 0)
+		{
+			// last record per time bucket
+			req->postproc = &post_multiread_bucketed;
+		}
+		else
+		{
+			// every stride'th record
+			req->numrecs = (req->numrecs + req->stride - 1) / req->stride;
+		}
 
 		// keep the request around until the post-processing is done
 		req->flags |= GDP_REQ_PERSIST;
@@ -916,7 +1341,6 @@ cmd_multiread(gdp_req_t *req)
 EP_STAT
 cmd_getmetadata(gdp_req_t *req)
 {
-	gdp_gclmd_t *gmd;
 	EP_STAT estat;
 
 	req->pdu->cmd = GDP_ACK_CONTENT;
@@ -931,14 +1355,13 @@ cmd_getmetadata(gdp_req_t *req)
 							estat, GDP_STAT_NAK_INTERNAL);
 	}
 
-	// get the metadata into memory
-	estat = req->gcl->x->physimpl->getmetadata(req->gcl, &gmd);
-	EP_STAT_CHECK(estat, goto fail0);
-
-	// serialize it to the client
-	_gdp_gclmd_serialize(gmd, req->pdu->datum->dbuf);
+	// the metadata was read and serialized when the GCL was opened
+	if (req->gcl->x->md_wire == NULL)
+		estat = gcl_load_metadata(req->gcl);
+	if (EP_STAT_ISOK(estat))
+		gdp_buf_write(req->pdu->datum->dbuf, req->gcl->x->md_wire,
+				req->gcl->x->md_wirelen);
 
-fail0:
 	_gdp_gcl_decref(&req->gcl);
 	return estat;
 }
@@ -971,6 +1394,84 @@ fail0:
 }
 
 
+/*
+**  CMD_SNAPSHOT --- make a consistent backup copy of a log
+**
+**		The payload is an optional label naming the snapshot; if
+**		none is given, the current time (UTC) is used.  Several
+**		logs can be snapshotted under the same label.  The reply
+**		contains the number of the last record in the copy.
+*/
+
+#define MAX_SNAPSHOT_LABEL		64
+
+EP_STAT
+cmd_snapshot(gdp_req_t *req)
+{
+	EP_STAT estat;
+	char label[MAX_SNAPSHOT_LABEL];
+	gdp_recno_t recno = 0;
+	size_t len;
+	size_t i;
+
+	req->pdu->cmd = GDP_ACK_CREATED;
+
+	// get the label; it becomes a directory name, so be careful
+	len = gdp_buf_getlength(req->pdu->datum->dbuf);
+	if (len >= sizeof label)
+	{
+		flush_input_data(req, "cmd_snapshot");
+		return gdpd_gcl_error(req->pdu->dst, "cmd_snapshot: label too long",
+				GDP_STAT_NAK_BADREQ, GDP_STAT_NAK_BADREQ);
+	}
+	gdp_buf_read(req->pdu->datum->dbuf, label, len);
+	label[len] = '\0';
+	for (i = 0; i < len; i++)
+	{
+		if (!isalnum((unsigned char) label[i]) &&
+				strchr("._-", label[i]) == NULL)
+			break;
+	}
+	if (i < len || label[0] == '.')
+		return gdpd_gcl_error(req->pdu->dst, "cmd_snapshot: invalid label",
+				GDP_STAT_NAK_BADREQ, GDP_STAT_NAK_BADREQ);
+	if (len == 0)
+	{
+		time_t now = time(NULL);
+		struct tm tm;
+
+		strftime(label, sizeof label, "%Y%m%dT%H%M%SZ", gmtime_r(&now, &tm));
+	}
+
+	estat = get_open_handle(req, GDP_MODE_RO);
+	EP_STAT_CHECK(estat, goto fail0);
+
+	if (req->gcl->x->physimpl->snapshot == NULL)
+	{
+		_gdp_gcl_decref(&req->gcl);
+		return gdpd_gcl_error(req->pdu->dst,
+				"cmd_snapshot: snapshots not supported for this type",
+				GDP_STAT_NAK_METHNOTALLOWED, GDP_STAT_NAK_METHNOTALLOWED);
+	}
+	estat = req->gcl->x->physimpl->snapshot(req->gcl, label, &recno);
+	_gdp_gcl_decref(&req->gcl);
+	EP_STAT_CHECK(estat, goto fail1);
+
+	ep_dbg_cprintf(Dbg, 10, "cmd_snapshot: %s through %" PRIgdp_recno "\n",
+			label, recno);
+	gdp_buf_put_uint64(req->pdu->datum->dbuf, recno);
+	return estat;
+
+fail0:
+	return gdpd_gcl_error(req->pdu->dst, "cmd_snapshot: GCL not open",
+			estat, GDP_STAT_NAK_BADREQ);
+
+fail1:
+	return gdpd_gcl_error(req->pdu->dst, "cmd_snapshot: cannot snapshot",
+			estat, GDP_STAT_NAK_INTERNAL);
+}
+
+
 /*
 **  CMD_FWD_APPEND --- forwarded APPEND command
 **
@@ -1024,6 +1525,145 @@ cmd_fwd_append(gdp_req_t *req)
 }
 
 
+/*
+**  CMD_REPL_FETCH --- send records to a replica
+**
+**		Like FWD_APPEND this is addressed to the daemon, with the
+**		log names in the payload.  A follower asks about all the
+**		logs it copies from us in one request; see logd_repl_fetch
+**		for how it is answered.  If nothing new has been written
+**		the request is parked without holding a worker thread, and
+**		the reply is sent later (by the append that makes it
+**		interesting, or when the follower has waited long enough).
+*/
+
+EP_STAT
+cmd_repl_fetch(gdp_req_t *req)
+{
+	// must be addressed to me
+	if (memcmp(req->pdu->dst, _GdpMyRoutingName, sizeof _GdpMyRoutingName) != 0)
+	{
+		// this is directed to a GCL, not to the daemon
+		return gdpd_gcl_error(req->pdu->dst,
+							"cmd_repl_fetch: log name required",
+							GDP_STAT_NAK_CONFLICT,
+							GDP_STAT_NAK_BADREQ);
+	}
+	return logd_repl_fetch(req);
+}
+
+
+/*
+**  CMD_REPL_LIST --- list the replicas of a log
+**
+**		Sent to the log (and hence to its leader).  The reply
+**		is built by logd_repl_list_followers.
+*/
+
+EP_STAT
+cmd_repl_list(gdp_req_t *req)
+{
+	req->pdu->cmd = GDP_ACK_CONTENT;
+
+	// should have no input data; ignore anything there
+	flush_input_data(req, "cmd_repl_list");
+
+	logd_repl_list_followers(req->pdu->dst, req->pdu->datum->dbuf);
+
+	// we don't need the log itself
+	if (req->gcl != NULL)
+		_gdp_gcl_decref(&req->gcl);
+	return EP_STAT_OK;
+}
+
+
+/*
+**  CMD_REPL_READ --- read, multiread, or subscribe from a replica
+**
+**		Like FWD_APPEND this is addressed to the daemon, since the
+**		router sends the log's own traffic to the leader.  The
+**		payload starts with the log name, the maximum staleness
+**		(in milliseconds) the client will accept, and the command
+**		to run; the rest is that command's usual payload.  If our
+**		copy is too stale the request is refused and the client
+**		goes to the leader instead.  Otherwise the command runs
+**		just as though it had been sent to the log, and the reply
+**		(including subscription data) seems to come from the log.
+*/
+
+EP_STAT
+cmd_repl_read(gdp_req_t *req)
+{
+	EP_STAT estat;
+	gdp_buf_t *dbuf = req->pdu->datum->dbuf;
+	gdp_name_t gclname;
+	gdp_pname_t pbuf;
+	uint32_t maxstale;
+	uint32_t stalems;
+	uint8_t cmd;
+
+	// must be addressed to me
+	if (memcmp(req->pdu->dst, _GdpMyRoutingName, sizeof _GdpMyRoutingName) != 0)
+	{
+		// this is directed to a GCL, not to the daemon
+		return gdpd_gcl_error(req->pdu->dst,
+							"cmd_repl_read: log name required",
+							GDP_STAT_NAK_CONFLICT,
+							GDP_STAT_NAK_BADREQ);
+	}
+	if (gdp_buf_getlength(dbuf) < sizeof gclname + 5)
+	{
+		flush_input_data(req, "cmd_repl_read");
+		return gdpd_gcl_error(req->pdu->dst,
+							"cmd_repl_read: short request",
+							GDP_STAT_NAK_BADREQ,
+							GDP_STAT_NAK_BADREQ);
+	}
+
+	gdp_buf_read(dbuf, gclname, sizeof gclname);
+	maxstale = gdp_buf_get_uint32(dbuf);
+	gdp_buf_read(dbuf, &cmd, sizeof cmd);
+	memcpy(req->pdu->dst, gclname, sizeof req->pdu->dst);
+
+	// if our copy isn't good enough, send the client to the leader
+	estat = logd_repl_staleness(gclname, &stalems);
+	if (!EP_STAT_ISOK(estat))
+	{
+		ep_dbg_cprintf(Dbg, 10, "cmd_repl_read: %s: not a replica\n",
+				gdp_printable_name(gclname, pbuf));
+		flush_input_data(req, "cmd_repl_read");
+		return GDP_STAT_NAK_PRECONFAILED;
+	}
+	if (stalems > maxstale)
+	{
+		ep_dbg_cprintf(Dbg, 10,
+				"cmd_repl_read: %s: %" PRIu32 " ms stale, limit %" PRIu32 "\n",
+				gdp_printable_name(gclname, pbuf), stalems, maxstale);
+		flush_input_data(req, "cmd_repl_read");
+		return GDP_STAT_NAK_PRECONFAILED;
+	}
+
+	ep_dbg_cprintf(Dbg, 14, "cmd_repl_read: %s %s\n",
+			_gdp_proto_cmd_name(cmd), gdp_printable_name(gclname, pbuf));
+	logd_repl_note_read();
+	req->pdu->cmd = cmd;
+	switch (cmd)
+	{
+	case GDP_CMD_READ:
+		return cmd_read(req);
+
+	case GDP_CMD_MULTIREAD:
+		return cmd_multiread(req);
+
+	case GDP_CMD_SUBSCRIBE:
+		return cmd_subscribe(req);
+	}
+
+	flush_input_data(req, "cmd_repl_read");
+	return GDP_STAT_NAK_BADREQ;
+}
+
+
 /**************** END OF COMMAND IMPLEMENTATIONS ****************/
 
 
@@ -1108,6 +1748,7 @@ dispatch_cmd(gdp_req_t *req)
 static struct cmdfuncs	CmdFuncs[] =
 {
 	{ GDP_CMD_PING,			cmd_ping		},
+	{ GDP_CMD_HELLO,		cmd_hello		},
 	{ GDP_CMD_CREATE,		cmd_create		},
 	{ GDP_CMD_OPEN_AO,		cmd_open		},
 	{ GDP_CMD_OPEN_RO,		cmd_open		},
@@ -1120,6 +1761,10 @@ static struct cmdfuncs	CmdFuncs[] =
 	{ GDP_CMD_OPEN_RA,		cmd_open		},
 	{ GDP_CMD_NEWEXTENT,	cmd_newextent	},
 	{ GDP_CMD_FWD_APPEND,	cmd_fwd_append	},
+	{ GDP_CMD_SNAPSHOT,		cmd_snapshot	},
+	{ GDP_CMD_REPL_FETCH,	cmd_repl_fetch	},
+	{ GDP_CMD_REPL_LIST,	cmd_repl_list	},
+	{ GDP_CMD_REPL_READ,	cmd_repl_read	},
 	{ 0,					NULL			}
 };
 
@@ -1128,5 +1773,8 @@ gdpd_proto_init(void)
 {
 	// register the commands we implement
 	_gdp_register_cmdfuncs(CmdFuncs);
+
+	MultireadBatchSize = ep_adm_getlongparam(
+							"swarm.gdplogd.multiread.batchsize", 65536);
 	return EP_STAT_OK;
 }
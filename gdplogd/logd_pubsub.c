@@ -75,22 +75,18 @@ sub_send_message_notification(gdp_req_t *req, gdp_datum_t *datum, int cmd)
 
 /*
 **  SUB_NOTIFY_ALL_SUBSCRIBERS --- send something to all interested parties
+**
+**		SUB_NOTIFY_DATUM does the same for data that didn't arrive
+**		in a request (e.g., records written by replication).
 */
 
-void
-sub_notify_all_subscribers(gdp_req_t *pubreq, int cmd)
+static void
+notify_common(gdp_gcl_t *gcl, gdp_datum_t *datum, gdp_req_t *pubreq, int cmd)
 {
 	gdp_req_t *req;
 	gdp_req_t *nextreq;
 	EP_TIME_SPEC sub_timeout;
 
-	if (ep_dbg_test(Dbg, 32))
-	{
-		ep_dbg_printf("sub_notify_all_subscribers(%s) of ",
-				_gdp_proto_cmd_name(cmd));
-		_gdp_req_dump(pubreq, ep_dbg_getfile(), GDP_PR_BASIC, 0);
-	}
-
 	{
 		EP_TIME_SPEC sub_delta;
 		long timeout = ep_adm_getlongparam("swarm.gdplogd.subscr.timeout", 600);
@@ -99,7 +95,11 @@ sub_notify_all_subscribers(gdp_req_t *pubreq, int cmd)
 		ep_time_deltanow(&sub_delta, &sub_timeout);
 	}
 
-	for (req = LIST_FIRST(&pubreq->gcl->reqs); req != NULL; req = nextreq)
+	// replicas waiting for new records are answered first
+	if (cmd == GDP_ACK_CONTENT)
+		logd_repl_wake(gcl);
+
+	for (req = LIST_FIRST(&gcl->reqs); req != NULL; req = nextreq)
 	{
 		nextreq = LIST_NEXT(req, gcllist);
 
@@ -120,7 +120,7 @@ sub_notify_all_subscribers(gdp_req_t *pubreq, int cmd)
 		}
 		else if (!ep_time_before(&req->act_ts, &sub_timeout))
 		{
-			sub_send_message_notification(req, pubreq->pdu->datum, cmd);
+			sub_send_message_notification(req, datum, cmd);
 		}
 		else
 		{
@@ -132,9 +132,9 @@ sub_notify_all_subscribers(gdp_req_t *pubreq, int cmd)
 			}
 
 			// actually remove the subscription
-			ep_thr_mutex_lock(&pubreq->gcl->mutex);
+			ep_thr_mutex_lock(&gcl->mutex);
 			LIST_REMOVE(req, gcllist);
-			ep_thr_mutex_unlock(&pubreq->gcl->mutex);
+			ep_thr_mutex_unlock(&gcl->mutex);
 
 			// _gdp_req_free assumes the request is locked
 			(void) _gdp_req_lock(req);
@@ -143,6 +143,29 @@ sub_notify_all_subscribers(gdp_req_t *pubreq, int cmd)
 	}
 }
 
+void
+sub_notify_all_subscribers(gdp_req_t *pubreq, int cmd)
+{
+	if (ep_dbg_test(Dbg, 32))
+	{
+		ep_dbg_printf("sub_notify_all_subscribers(%s) of ",
+				_gdp_proto_cmd_name(cmd));
+		_gdp_req_dump(pubreq, ep_dbg_getfile(), GDP_PR_BASIC, 0);
+	}
+
+	notify_common(pubreq->gcl, pubreq->pdu->datum, pubreq, cmd);
+}
+
+void
+sub_notify_datum(gdp_gcl_t *gcl, gdp_datum_t *datum, int cmd)
+{
+	ep_dbg_cprintf(Dbg, 32, "sub_notify_datum(%s) of %s recno %"
+			PRIgdp_recno "\n",
+			_gdp_proto_cmd_name(cmd), gcl->pname, datum->recno);
+
+	notify_common(gcl, datum, NULL, cmd);
+}
+
 
 /*
 **  SUB_END_SUBSCRIPTION --- terminate a subscription
@@ -36,6 +36,9 @@
 // notify all subscribers that new data is available (or shutdown required)
 extern void	sub_notify_all_subscribers(gdp_req_t *pubreq, int cmd);
 
+// the same, for data not received in a request
+extern void	sub_notify_datum(gdp_gcl_t *gcl, gdp_datum_t *datum, int cmd);
+
 // terminate a subscription
 extern void	sub_end_subscription(gdp_req_t *req);
 
@@ -0,0 +1,1521 @@
+/* vim: set ai sw=4 sts=4 ts=4 : */
+
+/*
+**  Log Replication
+**
+**	----- BEGIN LICENSE BLOCK -----
+**	GDPLOGD: Log Daemon for the Global Data Plane
+**	From the Ubiquitous Swarm Lab, 490 Cory Hall, U.C. Berkeley.
+**
+**	Copyright (c) 2015, Regents of the University of California.
+**	All rights reserved.
+**
+**	Permission is hereby granted, without written agreement and without
+**	license or royalty fees, to use, copy, modify, and distribute this
+**	software and its documentation for any purpose, provided that the above
+**	copyright notice and the following two paragraphs appear in all copies
+**	of this software.
+**
+**	IN NO EVENT SHALL REGENTS BE LIABLE TO ANY PARTY FOR DIRECT, INDIRECT,
+**	SPECIAL, INCIDENTAL, OR CONSEQUENTIAL DAMAGES, INCLUDING LOST
+**	PROFITS, ARISING OUT OF THE USE OF THIS SOFTWARE AND ITS DOCUMENTATION,
+**	EVEN IF REGENTS HAS BEEN ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+**
+**	REGENTS SPECIFICALLY DISCLAIMS ANY WARRANTIES, INCLUDING, BUT NOT
+**	LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+**	FOR A PARTICULAR PURPOSE. THE SOFTWARE AND ACCOMPANYING DOCUMENTATION,
+**	IF ANY, PROVIDED HEREUNDER IS PROVIDED "AS IS". REGENTS HAS NO
+**	OBLIGATION TO PROVIDE MAINTENANCE, SUPPORT, UPDATES, ENHANCEMENTS,
+**	OR MODIFICATIONS.
+**	----- END LICENSE BLOCK -----
+*/
+
+
+
+#include "logd.h"
+#include "logd_pubsub.h"
+
+#include <gdp/gdp.h>
+#include <gdp/gdp_gclmd.h>
+#include <gdp/gdp_priv.h>
+
+#include <ep/ep_dbg.h>
+#include <ep/ep_hash.h>
+#include <ep/ep_log.h>
+#include <ep/ep_time.h>
+
+#include <ctype.h>
+#include <errno.h>
+#include <pthread.h>
+#include <string.h>
+
+
+static EP_DBG	Dbg = EP_DBG_INIT("gdplogd.replicate",
+							"GDP log replication");
+
+
+/*
+**  Replication
+**
+**		A gdplogd instance can keep read-only copies of logs owned
+**		by another gdplogd (the "leader").  The logs to follow are
+**		listed in the file named by swarm.gdplogd.replicate.file,
+**		one per line as
+**
+**			<log-name>	<leader-name>
+**
+**		where the leader name is the routing name of the leader's
+**		gdplogd.  Blank lines and anything after a '#' are ignored.
+**
+**		Each leader gets a thread that repeatedly asks it, in a
+**		single request, for the records after the last one we have
+**		of every log we copy from it (see logd_repl_fetch).  If
+**		there is nothing new the leader parks the request until
+**		something is appended or a timer runs out, so in steady
+**		state new records show up on the replica within one round
+**		trip of being appended, without polling and without tying
+**		up a thread on either side per log.  Records are written
+**		with their original record numbers, timestamps, and
+**		signatures, and local subscribers are notified just as
+**		though the records had been appended here.
+**
+**		Replicas are not advertised (the leader remains the only
+**		place the router sends a log's traffic) and refuse appends
+**		from anyone but the replication thread.  Clients that can
+**		live with slightly old data send reads to a replica by
+**		addressing this daemon directly (see cmd_repl_read) with
+**		a bound on how stale the data may be.  Each fetch tells
+**		the leader how stale we are and how many such reads we
+**		are serving, and the leader passes that on to clients
+**		choosing a replica (see cmd_repl_list).
+*/
+
+struct repl_log
+{
+	gdp_name_t			name;			// name of the log
+	gdp_pname_t			pname;			// printable name of the log
+	EP_THR_MUTEX		mutex;			// protects the following
+	gdp_recno_t			local_recno;	// last record we have
+	gdp_recno_t			leader_recno;	// last record leader has
+	EP_TIME_SPEC		caughtup;		// when we last had everything
+	EP_TIME_SPEC		retry;			// don't ask again before this
+	bool				diverged;		// leader says our copy differs
+	EP_STAT				laststat;		// status of last fetch
+	struct repl_log		*next;			// next in ReplLogs list
+};
+
+struct repl_leader
+{
+	gdp_name_t			name;			// gdplogd we replicate from
+	gdp_pname_t			pname;			// printable name of same
+	struct repl_log		**logs;			// logs we copy from it
+	gdp_gcl_t			**gcls;			// their handles during a fetch
+	int					nlogs;			// number of entries in logs
+	struct repl_leader	*next;			// next in ReplLeaders list
+};
+
+static EP_HASH			*ReplHash;		// name => struct repl_log
+static struct repl_log	*ReplLogs;		// all replicated logs
+static struct repl_leader	*ReplLeaders;	// everyone we replicate from
+static uint32_t			ReplMaxRecs;	// max records per fetch
+static uint32_t			ReplWait;		// ms leader may hold a fetch
+static long				ReplRetry;		// ms to wait after an error
+static long				ReplExpire;		// ms until silent follower dropped
+
+// load reporting: replica reads per second
+static EP_THR_MUTEX		LoadMutex		EP_THR_MUTEX_INITIALIZER;
+static uint32_t			LoadReads;		// reads since LoadStart
+static EP_TIME_SPEC		LoadStart;		// start of current interval
+static uint32_t			Load;			// rate over last interval
+
+// leader side: who is replicating our logs
+struct repl_follower
+{
+	gdp_name_t			name;			// routing name of follower
+	gdp_recno_t			recno;			// last record it has
+	uint32_t			stalems;		// staleness it reported
+	uint32_t			load;			// load it reported
+	EP_TIME_SPEC		seen;			// when it reported
+	struct repl_follower	*next;		// next follower of this log
+};
+
+static EP_THR_MUTEX		LeaderMutex		EP_THR_MUTEX_INITIALIZER;
+static EP_HASH			*LeaderHash;	// log name => struct repl_follower *
+static gdp_name_t		*Followers;		// replicas we will tell clients about
+static int				NFollowers;		// number of entries in Followers
+
+// leader side: fetches from followers (see logd_repl_fetch)
+struct repl_fetch;
+
+struct repl_wait
+{
+	gdp_name_t			name;			// name of the log
+	gdp_gcl_t			*gcl;			// the log (NULL if not open)
+	EP_STAT				estat;			// why gcl is NULL
+	gdp_recno_t			first;			// first record wanted
+	uint32_t			maxrecs;		// max records to send
+	struct repl_fetch	*rf;			// fetch this is part of
+	struct repl_wait	*next;			// next waiter on gcl
+};
+
+#define RF_PARKED		1				// waiting for an append or timeout
+#define RF_REPLYING		2				// reply being built
+#define RF_CANCELLED	3				// channel closed: don't reply
+
+struct repl_fetch
+{
+	gdp_req_t			*req;			// the request
+	int					state;			// RF_* (see above)
+	struct event		*timer;			// ends the wait
+	uint32_t			nlogs;			// number of entries in logs
+	struct repl_wait	*logs;			// one per log asked about
+	struct repl_fetch	*next;			// next in ReplFetches
+};
+
+static EP_THR_MUTEX		FetchMutex		EP_THR_MUTEX_INITIALIZER;
+static struct repl_fetch	*ReplFetches;	// parked (or replying) fetches
+static size_t			ReplBatchSize;	// max bytes of records per reply
+static long				ReplMaxWait;	// max time to park a fetch (ms)
+
+#define REPL_FETCH_ENTLEN	(sizeof (gdp_name_t) + 20)	// min bytes per log
+
+
+/*
+**  Read the replication configuration
+*/
+
+static EP_STAT
+repl_addone(const char *lname, const char *leadername, int lineno)
+{
+	EP_STAT estat;
+	struct repl_log *rl;
+	struct repl_leader *ld;
+	gdp_name_t leader;
+
+	rl = ep_mem_zalloc(sizeof *rl);
+	estat = gdp_parse_name(lname, rl->name);
+	if (EP_STAT_ISOK(estat))
+		estat = gdp_parse_name(leadername, leader);
+	if (!EP_STAT_ISOK(estat))
+	{
+		ep_log(estat, "logd_repl_init: line %d: bad name", lineno);
+		ep_mem_free(rl);
+		return estat;
+	}
+	if (ep_hash_search(ReplHash, sizeof rl->name, rl->name) != NULL)
+	{
+		ep_log(GDP_STAT_NAK_CONFLICT,
+				"logd_repl_init: line %d: %s listed twice", lineno, lname);
+		ep_mem_free(rl);
+		return GDP_STAT_NAK_CONFLICT;
+	}
+
+	gdp_printable_name(rl->name, rl->pname);
+	ep_thr_mutex_init(&rl->mutex, EP_THR_MUTEX_DEFAULT);
+	rl->laststat = EP_STAT_OK;
+	EP_TIME_INVALIDATE(&rl->caughtup);
+	EP_TIME_INVALIDATE(&rl->retry);
+	(void) ep_hash_insert(ReplHash, sizeof rl->name, rl->name, rl);
+	rl->next = ReplLogs;
+	ReplLogs = rl;
+
+	// logs with the same leader are fetched together
+	for (ld = ReplLeaders; ld != NULL; ld = ld->next)
+	{
+		if (GDP_NAME_SAME(ld->name, leader))
+			break;
+	}
+	if (ld == NULL)
+	{
+		ld = ep_mem_zalloc(sizeof *ld);
+		memcpy(ld->name, leader, sizeof ld->name);
+		gdp_printable_name(ld->name, ld->pname);
+		ld->next = ReplLeaders;
+		ReplLeaders = ld;
+	}
+	ld->logs = ep_mem_realloc(ld->logs, (ld->nlogs + 1) * sizeof *ld->logs);
+	ld->logs[ld->nlogs++] = rl;
+
+	ep_dbg_cprintf(Dbg, 8, "logd_repl_init: replicating %s from %s\n",
+			rl->pname, leadername);
+	return EP_STAT_OK;
+}
+
+EP_STAT
+logd_repl_init(void)
+{
+	const char *fname;
+	FILE *fp;
+	char lbuf[512];
+	int lineno = 0;
+	int nbad = 0;
+
+	ReplMaxRecs = ep_adm_getintparam("swarm.gdplogd.replicate.maxrecs", 1024);
+	ReplWait = ep_adm_getintparam("swarm.gdplogd.replicate.wait", 1000);
+	ReplRetry = ep_adm_getlongparam("swarm.gdplogd.replicate.retry", 5000);
+	ReplExpire = ep_adm_getlongparam("swarm.gdplogd.replicate.expire", 30000);
+	ReplBatchSize = ep_adm_getlongparam("swarm.gdplogd.replicate.batchsize",
+							262144);
+	ReplMaxWait = ep_adm_getlongparam("swarm.gdplogd.replicate.maxwait", 1000);
+	if (ReplMaxRecs == 0)
+		ReplMaxRecs = 1;
+
+	ReplHash = ep_hash_new("replicated logs", NULL, 0);
+	LeaderHash = ep_hash_new("replicas of our logs", NULL, 0);
+	ep_time_now(&LoadStart);
+
+	// replicas that may be offered to clients for reads
+	fname = ep_adm_getstrparam("swarm.gdplogd.replicate.followers", NULL);
+	if (fname != NULL)
+	{
+		char *list = ep_mem_strdup(fname);
+		char *p = list;
+		char *fn;
+
+		while ((fn = strsep(&p, " \t,")) != NULL)
+		{
+			if (*fn == '\0')
+				continue;
+			Followers = ep_mem_realloc(Followers,
+							(NFollowers + 1) * sizeof *Followers);
+			if (!EP_STAT_ISOK(gdp_parse_name(fn, Followers[NFollowers])))
+			{
+				ep_log(GDP_STAT_NAK_BADREQ,
+						"logd_repl_init: bad follower name %s", fn);
+				nbad++;
+				continue;
+			}
+			NFollowers++;
+		}
+		ep_mem_free(list);
+	}
+
+	fname = ep_adm_getstrparam("swarm.gdplogd.replicate.file", NULL);
+	if (fname == NULL)
+		return nbad > 0 ? GDP_STAT_NAK_BADREQ : EP_STAT_OK;
+	if ((fp = fopen(fname, "r")) == NULL)
+	{
+		EP_STAT estat = ep_stat_from_errno(errno);
+
+		ep_log(estat, "logd_repl_init: cannot open %s", fname);
+		return estat;
+	}
+
+	while (fgets(lbuf, sizeof lbuf, fp) != NULL)
+	{
+		char *p;
+		char *lname;
+		char *leadername;
+
+		lineno++;
+		if ((p = strchr(lbuf, '#')) != NULL)
+			*p = '\0';
+		p = lbuf;
+		lname = strsep(&p, " \t\n");
+		while (p != NULL && isspace(*p))
+			p++;
+		leadername = strsep(&p, " \t\n");
+		if (lname == NULL || *lname == '\0')
+			continue;
+		if (leadername == NULL || *leadername == '\0')
+		{
+			ep_log(GDP_STAT_NAK_BADREQ,
+					"logd_repl_init: %s line %d: no leader for %s",
+					fname, lineno, lname);
+			nbad++;
+			continue;
+		}
+		if (!EP_STAT_ISOK(repl_addone(lname, leadername, lineno)))
+			nbad++;
+	}
+	fclose(fp);
+
+	// bad lines are logged but don't keep the daemon from running
+	if (nbad > 0)
+		return GDP_STAT_NAK_BADREQ;
+	return EP_STAT_OK;
+}
+
+
+/*
+**  Is this log a replica?
+*/
+
+bool
+logd_repl_is_replica(gdp_name_t gcl_name)
+{
+	if (ReplLogs == NULL)
+		return false;
+	return ep_hash_search(ReplHash, sizeof (gdp_name_t), gcl_name) != NULL;
+}
+
+
+/*
+**  How stale is a replica?
+**
+**		Returns the number of milliseconds since we last knew we
+**		had every record the leader had, or UINT32_MAX if we never
+**		have.  Since that is measured from when we asked, it can
+**		overstate the staleness by up to one fetch wait, but it
+**		never understates it.
+*/
+
+static uint32_t
+repl_stalems(struct repl_log *rl, EP_TIME_SPEC *now)
+{
+	int64_t ms;
+
+	if (!EP_TIME_ISVALID(&rl->caughtup))
+		return UINT32_MAX;
+	ms = (now->tv_sec - rl->caughtup.tv_sec) * INT64_C(1000) +
+			(now->tv_nsec - rl->caughtup.tv_nsec) / 1000000;
+	if (ms < 0)
+		return 0;
+	if (ms >= UINT32_MAX)
+		return UINT32_MAX;
+	return ms;
+}
+
+EP_STAT
+logd_repl_staleness(gdp_name_t gcl_name, uint32_t *stalemsp)
+{
+	struct repl_log *rl;
+	EP_TIME_SPEC now;
+
+	if (ReplLogs == NULL ||
+		(rl = ep_hash_search(ReplHash, sizeof (gdp_name_t), gcl_name)) == NULL)
+		return GDP_STAT_NAK_NOTFOUND;
+	ep_time_now(&now);
+	ep_thr_mutex_lock(&rl->mutex);
+	*stalemsp = repl_stalems(rl, &now);
+	ep_thr_mutex_unlock(&rl->mutex);
+	return EP_STAT_OK;
+}
+
+
+/*
+**  Keep track of how busy we are serving reads from replicas
+**
+**		The load is the rate of replica reads over the last
+**		interval of at least a second.
+*/
+
+void
+logd_repl_note_read(void)
+{
+	ep_thr_mutex_lock(&LoadMutex);
+	LoadReads++;
+	ep_thr_mutex_unlock(&LoadMutex);
+}
+
+static uint32_t
+repl_load(void)
+{
+	EP_TIME_SPEC now;
+	int64_t ms;
+	uint32_t load;
+
+	ep_time_now(&now);
+	ep_thr_mutex_lock(&LoadMutex);
+	ms = (now.tv_sec - LoadStart.tv_sec) * INT64_C(1000) +
+			(now.tv_nsec - LoadStart.tv_nsec) / 1000000;
+	if (ms >= 1000)
+	{
+		Load = LoadReads * INT64_C(1000) / ms;
+		LoadReads = 0;
+		LoadStart = now;
+	}
+	load = Load;
+	ep_thr_mutex_unlock(&LoadMutex);
+	return load;
+}
+
+
+/*
+**  Get one log's entry out of a fetch reply
+**
+**		The records (or metadata) are moved to obuf.  Returns the
+**		status the leader gave for the log, or GDP_STAT_PDU_CORRUPT
+**		if the rest of the reply can't be trusted.
+*/
+
+static EP_STAT
+repl_get_entry(gdp_buf_t *rbuf, struct repl_log *rl,
+		gdp_recno_t *lastp, gdp_buf_t *obuf)
+{
+	gdp_name_t name;
+	EP_STAT estat;
+	uint32_t len;
+
+	if (gdp_buf_getlength(rbuf) < sizeof name + 16)
+		return GDP_STAT_PDU_CORRUPT;
+	gdp_buf_read(rbuf, name, sizeof name);
+	estat = EP_STAT_FROM_INT(gdp_buf_get_uint32(rbuf));
+	*lastp = gdp_buf_get_uint64(rbuf);
+	len = gdp_buf_get_uint32(rbuf);
+	if (!GDP_NAME_SAME(name, rl->name) || gdp_buf_getlength(rbuf) < len)
+		return GDP_STAT_PDU_CORRUPT;
+	gdp_buf_move(rbuf, obuf, len);
+	return estat;
+}
+
+
+/*
+**  REPL_CREATE --- create the local copy of a log
+**
+**		The metadata is fetched from the leader so that the copy
+**		has the same owner key (and hence signatures still verify)
+**		and, if the leader says so, the same storage type.
+*/
+
+static EP_STAT
+repl_create(struct repl_log *rl, struct repl_leader *ld, gdp_gcl_t **pgcl)
+{
+	EP_STAT estat;
+	gdp_gcl_t *gcl;
+	gdp_gclmd_t *gmd;
+	gdp_buf_t *ibuf;
+	gdp_buf_t *rbuf;
+	gdp_buf_t *mbuf;
+	gdp_recno_t last;
+	struct gcl_phys_impl *physimpl;
+
+	estat = gcl_alloc(rl->name, GDP_MODE_AO, &gcl);
+	EP_STAT_CHECK(estat, goto fail0);
+	gcl->iomode = GDP_MODE_RA;
+
+	// a fetch of just this log, starting at zero, gets the metadata
+	ibuf = gdp_buf_new();
+	rbuf = gdp_buf_new();
+	mbuf = gdp_buf_new();
+	gdp_buf_write(ibuf, rl->name, sizeof rl->name);
+	gdp_buf_put_uint64(ibuf, 0);
+	gdp_buf_put_uint32(ibuf, 0);
+	gdp_buf_put_uint32(ibuf, UINT32_MAX);
+	gdp_buf_put_uint32(ibuf, 0);
+	estat = _gdp_gcl_repl_fetch(gcl, ld->name, 0, 0, 1, ibuf, rbuf,
+					_GdpChannel, 0);
+	EP_STAT_CHECK(estat, goto fail1);
+	if (gdp_buf_get_uint32(rbuf) != 1)
+	{
+		estat = GDP_STAT_PDU_CORRUPT;
+		goto fail1;
+	}
+	estat = repl_get_entry(rbuf, rl, &last, mbuf);
+	EP_STAT_CHECK(estat, goto fail1);
+
+	gmd = _gdp_gclmd_deserialize(mbuf);
+	physimpl = gcl_physimpl_select(gmd);
+	if (physimpl == NULL)
+	{
+		estat = GDP_STAT_NAK_BADREQ;
+		gdp_gclmd_free(gmd);
+		goto fail1;
+	}
+	gcl->x->physimpl = physimpl;
+	estat = physimpl->create(gcl, gmd);
+	if (!EP_STAT_ISOK(estat))
+	{
+		gdp_gclmd_free(gmd);
+		goto fail1;
+	}
+	if (gmd == NULL)
+		gmd = gdp_gclmd_new(0);
+	gcl->gclmd = gmd;
+	estat = gcl_load_metadata(gcl);
+	EP_STAT_CHECK(estat, goto fail1);
+
+	ep_log(EP_STAT_OK, "logd_repl: created replica of %s (%" PRIgdp_recno
+			" records to copy)", rl->pname, last);
+
+	// leave this in the cache (but don't advertise it)
+	_gdp_gcl_cache_add(gcl, gcl->iomode);
+	gcl->flags |= GCLF_DEFER_FREE;
+	gdp_buf_free(ibuf);
+	gdp_buf_free(rbuf);
+	gdp_buf_free(mbuf);
+	*pgcl = gcl;
+	return estat;
+
+fail1:
+	gdp_buf_free(ibuf);
+	gdp_buf_free(rbuf);
+	gdp_buf_free(mbuf);
+	_gdp_gcl_decref(&gcl);
+fail0:
+	return estat;
+}
+
+
+/*
+**  REPL_APPLY --- write a batch of records fetched from the leader
+**
+**		Records we already have are skipped (e.g., if an earlier
+**		reply was written but its status was lost).  The rest must
+**		start right after our last record and be contiguous.
+**		Only records the back end reports as written (which for
+**		appendv means flushed) advance nrecs or go to subscribers.
+*/
+
+static EP_STAT
+repl_apply(struct repl_log *rl, gdp_gcl_t *gcl, gdp_pdu_t *bpdu)
+{
+	EP_STAT estat = EP_STAT_OK;
+	gdp_pdu_t **pdus = NULL;
+	gdp_datum_t **datums = NULL;
+	gdp_pdu_t *pdu;
+	int npdus = 0;
+	int nalloc = 0;
+	int first;
+	int ndatums = 0;
+	int nwritten = 0;
+	int i;
+
+	while ((pdu = _gdp_pdu_unbatch(bpdu)) != NULL)
+	{
+		if (npdus >= nalloc)
+		{
+			nalloc = nalloc == 0 ? 64 : nalloc * 2;
+			pdus = ep_mem_realloc(pdus, nalloc * sizeof *pdus);
+			datums = ep_mem_realloc(datums, nalloc * sizeof *datums);
+		}
+		pdus[npdus++] = pdu;
+	}
+	if (npdus == 0)
+		return EP_STAT_OK;
+
+	ep_thr_mutex_lock(&gcl->x->append_mutex);
+	for (first = 0; first < npdus; first++)
+	{
+		if (pdus[first]->datum->recno > gcl->nrecs)
+			break;
+	}
+	for (i = first; i < npdus; i++)
+	{
+		gdp_datum_t *datum = pdus[i]->datum;
+
+		if (datum->recno != gcl->nrecs + 1 + (i - first))
+		{
+			ep_dbg_cprintf(Dbg, 1, "repl_apply(%s): recno %" PRIgdp_recno
+					", wanted %" PRIgdp_recno "\n",
+					rl->pname, datum->recno, gcl->nrecs + 1 + (i - first));
+			estat = GDP_STAT_RECNO_SEQ_ERROR;
+			break;
+		}
+		datums[ndatums++] = datum;
+	}
+
+	if (ndatums > 0 && gcl->x->physimpl->appendv != NULL)
+	{
+		EP_STAT xstat;
+
+		xstat = gcl->x->physimpl->appendv(gcl, datums, ndatums, &nwritten);
+		if (!EP_STAT_ISOK(xstat))
+			estat = xstat;
+	}
+	else
+	{
+		for (; nwritten < ndatums; nwritten++)
+		{
+			EP_STAT xstat;
+
+			xstat = gcl->x->physimpl->append(gcl, datums[nwritten]);
+			if (!EP_STAT_ISOK(xstat))
+			{
+				estat = xstat;
+				break;
+			}
+		}
+	}
+	if (nwritten > 0)
+	{
+		gcl->nrecs = datums[nwritten - 1]->recno;
+		ep_thr_cond_broadcast(&gcl->x->append_cond);
+	}
+	ep_thr_mutex_unlock(&gcl->x->append_mutex);
+
+	// tell local subscribers (outside the append lock)
+	for (i = 0; i < nwritten; i++)
+		sub_notify_datum(gcl, datums[i], GDP_ACK_CONTENT);
+
+	ep_dbg_cprintf(Dbg, 24, "repl_apply(%s): %d received, %d written\n",
+			rl->pname, npdus, nwritten);
+
+	for (i = 0; i < npdus; i++)
+		_gdp_pdu_free(pdus[i]);
+	ep_mem_free(pdus);
+	ep_mem_free(datums);
+	return estat;
+}
+
+
+
+/*
+**  Tell the leader where our copy of a log stands
+**
+**		This is the chain link of our last record (see
+**		disk_getchain), so the leader can tell if our copy has
+**		diverged from its own.  Zero means we have nothing to
+**		compare.
+*/
+
+static void
+repl_put_chain(gdp_buf_t *ibuf, gdp_gcl_t *gcl)
+{
+	uint8_t link[EP_CRYPTO_MD_MAXSIZE];
+	int alg = 0;
+
+	if (gcl->nrecs == 0 || gcl->x->physimpl->getchain == NULL ||
+			!EP_STAT_ISOK(gcl->x->physimpl->getchain(gcl, gcl->nrecs,
+										&alg, link)))
+		alg = 0;
+	gdp_buf_put_uint32(ibuf, alg);
+	if (alg != 0)
+		gdp_buf_write(ibuf, link, ep_crypto_md_len(alg));
+}
+
+
+/*
+**  Remember how the last fetch of a log went
+**
+**		A log that failed is left out of fetches for a while so a
+**		persistent error doesn't keep the leader answering at once.
+**		One the leader says has diverged from its copy is left out
+**		until we are restarted, since copying more records onto it
+**		would only hide the damage.
+*/
+
+static void
+repl_note_stat(struct repl_log *rl, EP_STAT estat)
+{
+	bool changed;
+
+	ep_thr_mutex_lock(&rl->mutex);
+	changed = !EP_STAT_IS_SAME(estat, rl->laststat);
+	rl->laststat = estat;
+	if (EP_STAT_IS_SAME(estat, GDP_STAT_NAK_CONFLICT))
+		rl->diverged = true;
+	if (!EP_STAT_ISOK(estat))
+	{
+		EP_TIME_SPEC delta;
+
+		ep_time_from_nsec(ReplRetry * INT64_C(1000000), &delta);
+		ep_time_deltanow(&delta, &rl->retry);
+	}
+	ep_thr_mutex_unlock(&rl->mutex);
+
+	// only log when the error changes so a dead leader isn't noisy
+	if (changed && !EP_STAT_ISOK(estat))
+		ep_log(estat, "logd_repl: cannot replicate %s", rl->pname);
+}
+
+
+/*
+**  REPL_FETCH --- get and apply the next batch of records for every
+**		log we copy from one leader
+**
+**		Logs that can't be opened (or created), that failed
+**		recently, or that have diverged are left out.  Errors for single logs are noted
+**		on the log; the return is the status of the request as a
+**		whole, or of the last log tried if none could be asked
+**		about.
+*/
+
+static EP_STAT
+repl_fetch(struct repl_leader *ld)
+{
+	EP_STAT estat = EP_STAT_OK;
+	gdp_gcl_t *gcl = NULL;
+	gdp_buf_t *ibuf;
+	gdp_buf_t *rbuf;
+	gdp_pdu_t *bpdu;
+	EP_TIME_SPEC sent;
+	uint32_t nlogs = 0;
+	int i;
+
+	ep_time_now(&sent);
+	for (i = 0; i < ld->nlogs; i++)
+	{
+		struct repl_log *rl = ld->logs[i];
+		EP_STAT xstat;
+		bool wait;
+
+		ld->gcls[i] = NULL;
+		ep_thr_mutex_lock(&rl->mutex);
+		wait = rl->diverged ||
+				(EP_TIME_ISVALID(&rl->retry) && ep_time_before(&sent, &rl->retry));
+		xstat = rl->laststat;
+		ep_thr_mutex_unlock(&rl->mutex);
+		if (!wait)
+		{
+			xstat = gcl_get_open(rl->name, GDP_MODE_AO, &ld->gcls[i]);
+			if (EP_STAT_IS_SAME(xstat, GDP_STAT_NAK_NOTFOUND))
+				xstat = repl_create(rl, ld, &ld->gcls[i]);
+			if (!EP_STAT_ISOK(xstat))
+			{
+				ld->gcls[i] = NULL;
+				repl_note_stat(rl, xstat);
+			}
+		}
+		if (ld->gcls[i] == NULL)
+			estat = xstat;
+		else if (gcl == NULL)
+			gcl = ld->gcls[i];		// the reply comes from the first one
+	}
+	if (gcl == NULL)
+		return EP_STAT_ISOK(estat) ? GDP_STAT_NAK_NOTFOUND : estat;
+
+	// anything the leader has as of now will be in the reply
+	ibuf = gdp_buf_new();
+	rbuf = gdp_buf_new();
+	bpdu = _gdp_pdu_new();
+	ep_time_now(&sent);
+	for (i = 0; i < ld->nlogs; i++)
+	{
+		struct repl_log *rl = ld->logs[i];
+		uint32_t stalems;
+
+		if (ld->gcls[i] == NULL)
+			continue;
+		ep_thr_mutex_lock(&rl->mutex);
+		stalems = repl_stalems(rl, &sent);
+		ep_thr_mutex_unlock(&rl->mutex);
+		gdp_buf_write(ibuf, rl->name, sizeof rl->name);
+		gdp_buf_put_uint64(ibuf, ld->gcls[i]->nrecs + 1);
+		gdp_buf_put_uint32(ibuf, ReplMaxRecs);
+		gdp_buf_put_uint32(ibuf, stalems);
+		repl_put_chain(ibuf, ld->gcls[i]);
+		nlogs++;
+	}
+	estat = _gdp_gcl_repl_fetch(gcl, ld->name, ReplWait, repl_load(),
+					nlogs, ibuf, rbuf, _GdpChannel, 0);
+	if (EP_STAT_ISOK(estat) && gdp_buf_get_uint32(rbuf) != nlogs)
+		estat = GDP_STAT_PDU_CORRUPT;
+
+	// entries come back in the order we asked
+	for (i = 0; i < ld->nlogs; i++)
+	{
+		struct repl_log *rl = ld->logs[i];
+		EP_STAT xstat = estat;
+		gdp_recno_t last = 0;
+
+		if (ld->gcls[i] == NULL)
+			continue;
+		if (EP_STAT_ISOK(estat))
+		{
+			gdp_buf_reset(bpdu->datum->dbuf);
+			xstat = repl_get_entry(rbuf, rl, &last, bpdu->datum->dbuf);
+			if (EP_STAT_IS_SAME(xstat, GDP_STAT_PDU_CORRUPT))
+				estat = xstat;
+			else if (EP_STAT_ISOK(xstat))
+				xstat = repl_apply(rl, ld->gcls[i], bpdu);
+		}
+
+		ep_thr_mutex_lock(&rl->mutex);
+		rl->local_recno = ld->gcls[i]->nrecs;
+		if (EP_STAT_ISOK(xstat))
+		{
+			rl->leader_recno = last;
+			if (rl->local_recno >= last)
+				rl->caughtup = sent;
+		}
+		ep_thr_mutex_unlock(&rl->mutex);
+		repl_note_stat(rl, xstat);
+		_gdp_gcl_decref(&ld->gcls[i]);
+	}
+
+	_gdp_pdu_free(bpdu);
+	gdp_buf_free(rbuf);
+	gdp_buf_free(ibuf);
+	return estat;
+}
+
+
+/*
+**  REPL_THREAD --- follow all the logs from one leader forever
+*/
+
+static void *
+repl_thread(void *arg)
+{
+	struct repl_leader *ld = arg;
+	EP_STAT estat;
+
+	ld->gcls = ep_mem_zalloc(ld->nlogs * sizeof *ld->gcls);
+	for (;;)
+	{
+		estat = repl_fetch(ld);
+		if (EP_STAT_ISOK(estat))
+			continue;
+
+		// the leader is down or has nothing we can use
+		ep_dbg_cprintf(Dbg, 10, "logd_repl: %s failed, waiting\n", ld->pname);
+		ep_time_nanosleep(ReplRetry * INT64_C(1000000));
+	}
+	return NULL;
+}
+
+
+/*
+**  Start replicating
+**
+**		Must be called after the connection to the router is up.
+*/
+
+EP_STAT
+logd_repl_start(void)
+{
+	struct repl_leader *ld;
+
+	for (ld = ReplLeaders; ld != NULL; ld = ld->next)
+	{
+		pthread_t thr;
+		int err;
+
+		err = pthread_create(&thr, NULL, repl_thread, ld);
+		if (err != 0)
+		{
+			EP_STAT estat = ep_stat_from_errno(err);
+
+			ep_log(estat, "logd_repl_start: cannot start thread for %s",
+					ld->pname);
+			return estat;
+		}
+		pthread_detach(thr);
+	}
+	return EP_STAT_OK;
+}
+
+
+/*
+**  Leader side: remember who is replicating our logs
+**
+**		Called for each fetch from a follower of a log we have.
+**		Only followers named in swarm.gdplogd.replicate.followers
+**		are remembered, since what they report steers client
+**		reads and the list would otherwise grow without bound.
+**		Followers that haven't been heard from for
+**		swarm.gdplogd.replicate.expire milliseconds are forgotten
+**		the next time the list is sent.
+*/
+
+void
+logd_repl_note_follower(gdp_name_t gcl_name,
+		gdp_name_t follower,
+		gdp_recno_t recno,
+		uint32_t stalems,
+		uint32_t load)
+{
+	struct repl_follower *head;
+	struct repl_follower *f;
+	int i;
+
+	// anyone can claim to be a fresh, idle replica: only believe some
+	for (i = 0; i < NFollowers; i++)
+	{
+		if (GDP_NAME_SAME(Followers[i], follower))
+			break;
+	}
+	if (i >= NFollowers)
+		return;
+
+	ep_thr_mutex_lock(&LeaderMutex);
+	head = ep_hash_search(LeaderHash, sizeof (gdp_name_t), gcl_name);
+	for (f = head; f != NULL; f = f->next)
+	{
+		if (GDP_NAME_SAME(f->name, follower))
+			break;
+	}
+	if (f == NULL)
+	{
+		f = ep_mem_zalloc(sizeof *f);
+		memcpy(f->name, follower, sizeof f->name);
+		f->next = head;
+		(void) ep_hash_insert(LeaderHash, sizeof (gdp_name_t), gcl_name, f);
+		if (ep_dbg_test(Dbg, 8))
+		{
+			gdp_pname_t lpname, fpname;
+
+			ep_dbg_printf("logd_repl_note_follower: %s replicated by %s\n",
+					gdp_printable_name(gcl_name, lpname),
+					gdp_printable_name(follower, fpname));
+		}
+	}
+	f->recno = recno;
+	f->stalems = stalems;
+	f->load = load;
+	ep_time_now(&f->seen);
+	ep_thr_mutex_unlock(&LeaderMutex);
+}
+
+
+/*
+**  Leader side: list the replicas of a log
+**
+**		Writes the number of replicas followed by, for each, its
+**		routing name, the last record it has, how stale it is in
+**		milliseconds (aged since it told us), and its load.
+*/
+
+void
+logd_repl_list_followers(gdp_name_t gcl_name, gdp_buf_t *obuf)
+{
+	struct repl_follower *head;
+	struct repl_follower **fp;
+	struct repl_follower *f;
+	EP_TIME_SPEC now;
+	uint32_t n = 0;
+
+	ep_time_now(&now);
+	ep_thr_mutex_lock(&LeaderMutex);
+	head = ep_hash_search(LeaderHash, sizeof (gdp_name_t), gcl_name);
+
+	// drop anyone we haven't heard from in a while
+	for (fp = &head; (f = *fp) != NULL; )
+	{
+		int64_t age = (now.tv_sec - f->seen.tv_sec) * INT64_C(1000) +
+					(now.tv_nsec - f->seen.tv_nsec) / 1000000;
+
+		if (age > ReplExpire)
+		{
+			*fp = f->next;
+			ep_mem_free(f);
+			continue;
+		}
+		n++;
+		fp = &f->next;
+	}
+	(void) ep_hash_insert(LeaderHash, sizeof (gdp_name_t), gcl_name, head);
+
+	gdp_buf_put_uint32(obuf, n);
+	for (f = head; f != NULL; f = f->next)
+	{
+		int64_t stalems = f->stalems;
+
+		if (f->stalems != UINT32_MAX)
+		{
+			stalems += (now.tv_sec - f->seen.tv_sec) * INT64_C(1000) +
+					(now.tv_nsec - f->seen.tv_nsec) / 1000000;
+			if (stalems >= UINT32_MAX)
+				stalems = UINT32_MAX;
+		}
+		gdp_buf_write(obuf, f->name, sizeof f->name);
+		gdp_buf_put_uint64(obuf, f->recno);
+		gdp_buf_put_uint32(obuf, stalems);
+		gdp_buf_put_uint32(obuf, f->load);
+	}
+	ep_thr_mutex_unlock(&LeaderMutex);
+}
+
+
+/*
+**  Leader side: answer fetches from followers
+**
+**		A fetch names any number of logs.  If any of them has
+**		records the follower doesn't (or metadata was asked for, or
+**		the follower won't wait) the reply is sent right away.
+**		Otherwise the request is parked: like a subscription it is
+**		hung on each of its logs (gcl->x->repl_waits) and the worker
+**		thread goes back to the pool.  The next append to any of
+**		those logs (see logd_repl_wake, called when subscribers are
+**		notified) or a timer, whichever comes first, sends the reply
+**		from a worker thread.
+**
+**		FetchMutex protects the wait lists and the state of every
+**		fetch on ReplFetches.  Whoever moves a fetch out of
+**		RF_PARKED owns it; a waiter is on the wait lists exactly
+**		when its fetch is parked.
+*/
+
+
+/*
+**  Take a parked fetch off its logs' wait lists
+**
+**		FetchMutex must be held.
+*/
+
+static void
+repl_fetch_unhook(struct repl_fetch *rf)
+{
+	uint32_t i;
+
+	for (i = 0; i < rf->nlogs; i++)
+	{
+		struct repl_wait **wp;
+
+		if (rf->logs[i].gcl == NULL)
+			continue;
+		for (wp = &rf->logs[i].gcl->x->repl_waits; *wp != NULL;
+				wp = &(*wp)->next)
+		{
+			if (*wp == &rf->logs[i])
+			{
+				*wp = rf->logs[i].next;
+				break;
+			}
+		}
+		rf->logs[i].next = NULL;
+	}
+}
+
+
+/*
+**  Release a fetch (but not its request)
+*/
+
+static void
+repl_fetch_free(struct repl_fetch *rf)
+{
+	uint32_t i;
+
+	// if the timer callback is running this waits for it to finish
+	if (rf->timer != NULL)
+		event_free(rf->timer);
+	for (i = 0; i < rf->nlogs; i++)
+	{
+		if (rf->logs[i].gcl != NULL)
+			_gdp_gcl_decref(&rf->logs[i].gcl);
+	}
+	ep_mem_free(rf->logs);
+	ep_mem_free(rf);
+}
+
+
+/*
+**  Build the reply to a fetch
+**
+**		The batch size is split among the logs that have records
+**		to send, so one busy log can't starve the others.  Each of
+**		them gets at least one record per reply.
+*/
+
+static void
+repl_fetch_build(struct repl_fetch *rf, gdp_buf_t *obuf)
+{
+	gdp_pdu_t *bpdu = _gdp_pdu_new();
+	gdp_datum_t *datum = gdp_datum_new();
+	size_t used = 0;
+	uint32_t nready = 0;
+	uint32_t i;
+
+	for (i = 0; i < rf->nlogs; i++)
+	{
+		struct repl_wait *w = &rf->logs[i];
+
+		if (w->gcl != NULL && w->first > 0 && w->first <= w->gcl->nrecs)
+			nready++;
+	}
+
+	gdp_buf_put_uint32(obuf, rf->nlogs);
+	for (i = 0; i < rf->nlogs; i++)
+	{
+		struct repl_wait *w = &rf->logs[i];
+		EP_STAT estat = w->estat;
+		gdp_recno_t recno = w->first;
+		gdp_recno_t last = 0;
+		uint32_t n = 0;
+
+		gdp_buf_reset(bpdu->datum->dbuf);
+		if (w->gcl == NULL)
+			goto done;
+		last = w->gcl->nrecs;
+
+		if (recno == 0)
+		{
+			// metadata only
+			if (w->gcl->x->md_wire == NULL)
+				estat = gcl_load_metadata(w->gcl);
+			if (EP_STAT_ISOK(estat))
+				gdp_buf_write(bpdu->datum->dbuf, w->gcl->x->md_wire,
+						w->gcl->x->md_wirelen);
+		}
+		else if (recno <= last)
+		{
+			size_t share = 0;
+
+			if (used < ReplBatchSize && nready > 0)
+				share = (ReplBatchSize - used) / nready;
+			if (share == 0)
+				share = 1;
+			if (nready > 0)
+				nready--;
+
+			for (n = 0; n < w->maxrecs && recno <= last &&
+					gdp_buf_getlength(bpdu->datum->dbuf) < share; n++)
+			{
+				datum->recno = recno++;
+				estat = w->gcl->x->physimpl->read(w->gcl, datum);
+				EP_STAT_CHECK(estat, break);
+				_gdp_pdu_batch_add(bpdu, datum);
+				gdp_buf_reset(datum->dbuf);
+			}
+
+			// a partial batch is still useful
+			if (n > 0)
+				estat = EP_STAT_OK;
+		}
+		if (!EP_STAT_ISOK(estat))
+			gdp_buf_reset(bpdu->datum->dbuf);
+		ep_dbg_cprintf(Dbg, 24, "repl_fetch_build(%s): %" PRIu32
+				" records, last %" PRIgdp_recno "\n",
+				w->gcl->pname, n, last);
+
+done:
+		used += gdp_buf_getlength(bpdu->datum->dbuf);
+		gdp_buf_write(obuf, w->name, sizeof w->name);
+		gdp_buf_put_uint32(obuf, EP_STAT_TO_INT(estat));
+		gdp_buf_put_uint64(obuf, last);
+		gdp_buf_put_uint32(obuf, gdp_buf_getlength(bpdu->datum->dbuf));
+		gdp_buf_copy(bpdu->datum->dbuf, obuf);
+	}
+
+	gdp_datum_free(datum);
+	_gdp_pdu_free(bpdu);
+}
+
+
+/*
+**  Send the reply to a parked fetch (in a worker thread)
+**
+**		The request is still locked by gdp_pdu_proc_cmd if the
+**		fetch was woken up right after it was parked, so we wait
+**		for it.  The reply is only sent while holding FetchMutex so
+**		that logd_repl_cancel knows we are done with the channel.
+*/
+
+static void
+repl_fetch_reply(void *rf_)
+{
+	struct repl_fetch *rf = rf_;
+	gdp_buf_t *obuf = gdp_buf_new();
+	struct repl_fetch **rfp;
+
+	// nothing else can find rf now; stop the timer
+	if (rf->timer != NULL)
+	{
+		event_free(rf->timer);
+		rf->timer = NULL;
+	}
+	repl_fetch_build(rf, obuf);
+
+	ep_thr_mutex_lock(&FetchMutex);
+	for (rfp = &ReplFetches; *rfp != NULL; rfp = &(*rfp)->next)
+	{
+		if (*rfp == rf)
+		{
+			*rfp = rf->next;
+			break;
+		}
+	}
+	if (rf->state != RF_CANCELLED)
+	{
+		gdp_req_t *req = rf->req;
+		EP_STAT estat;
+
+		(void) _gdp_req_lock(req);
+		gdp_buf_reset(req->pdu->datum->dbuf);
+		gdp_buf_copy(obuf, req->pdu->datum->dbuf);
+		req->pdu->cmd = GDP_ACK_CONTENT;
+		estat = _gdp_pdu_out(req->pdu, req->chan, NULL);
+		if (!EP_STAT_ISOK(estat))
+		{
+			ep_dbg_cprintf(Dbg, 1,
+					"repl_fetch_reply: couldn't write PDU!\n");
+		}
+		req->flags &= ~(GDP_REQ_PERSIST | GDP_REQ_DEFER_REPLY);
+		_gdp_req_free(&req);
+	}
+	ep_thr_mutex_unlock(&FetchMutex);
+
+	gdp_buf_free(obuf);
+	repl_fetch_free(rf);
+}
+
+
+/*
+**  Timer callback: a parked fetch has waited long enough
+*/
+
+static void
+repl_fetch_timeout(int fd, short what, void *rf_)
+{
+	struct repl_fetch *rf = rf_;
+	bool claimed = false;
+
+	ep_thr_mutex_lock(&FetchMutex);
+	if (rf->state == RF_PARKED)
+	{
+		repl_fetch_unhook(rf);
+		rf->state = RF_REPLYING;
+		claimed = true;
+	}
+	ep_thr_mutex_unlock(&FetchMutex);
+
+	// building the reply reads the disk: not in the I/O thread
+	if (claimed)
+		ep_thr_pool_run(&repl_fetch_reply, rf);
+}
+
+
+/*
+**  Something was appended to a log: answer the fetches waiting on it
+*/
+
+void
+logd_repl_wake(gdp_gcl_t *gcl)
+{
+	struct repl_wait *w;
+
+	ep_thr_mutex_lock(&FetchMutex);
+	for (w = gcl->x->repl_waits; w != NULL; )
+	{
+		if (w->first > gcl->nrecs)
+		{
+			w = w->next;
+			continue;
+		}
+
+		// this takes w (and maybe others) off the list; start over
+		repl_fetch_unhook(w->rf);
+		w->rf->state = RF_REPLYING;
+		ep_thr_pool_run(&repl_fetch_reply, w->rf);
+		w = gcl->x->repl_waits;
+	}
+	ep_thr_mutex_unlock(&FetchMutex);
+}
+
+
+/*
+**  A channel is closing: forget the fetches that came in on it
+**
+**		The requests themselves are freed by the caller.
+*/
+
+void
+logd_repl_cancel(gdp_chan_t *chan)
+{
+	struct repl_fetch **rfp;
+	struct repl_fetch *rf;
+	struct repl_fetch *dead = NULL;
+
+	ep_thr_mutex_lock(&FetchMutex);
+	for (rfp = &ReplFetches; (rf = *rfp) != NULL; )
+	{
+		if (rf->req->chan != chan)
+		{
+			rfp = &rf->next;
+			continue;
+		}
+		if (rf->state == RF_PARKED)
+		{
+			// nobody else has it: free it here
+			repl_fetch_unhook(rf);
+			*rfp = rf->next;
+			rf->next = dead;
+			dead = rf;
+		}
+		else
+		{
+			// repl_fetch_reply will free it
+			rfp = &rf->next;
+		}
+		rf->state = RF_CANCELLED;
+	}
+	ep_thr_mutex_unlock(&FetchMutex);
+
+	while ((rf = dead) != NULL)
+	{
+		dead = rf->next;
+		repl_fetch_free(rf);
+	}
+}
+
+
+/*
+**  Does a follower's copy of a log agree with ours?
+**
+**		The follower sends the chain link of its last record (see
+**		disk_getchain), which covers every record up to there.
+**		If either of us doesn't chain the log, or we use different
+**		digests, there is nothing to compare.
+*/
+
+static bool
+repl_chain_agrees(gdp_gcl_t *gcl, gdp_recno_t recno,
+		int alg, const uint8_t *link)
+{
+	uint8_t mylink[EP_CRYPTO_MD_MAXSIZE];
+	int myalg;
+
+	if (alg == 0 || recno == 0 || gcl->x->physimpl->getchain == NULL)
+		return true;
+	if (!EP_STAT_ISOK(gcl->x->physimpl->getchain(gcl, recno, &myalg, mylink))
+			|| myalg != alg)
+		return true;
+	return memcmp(link, mylink, ep_crypto_md_len(alg)) == 0;
+}
+
+
+/*
+**  Answer (or park) a fetch; called by cmd_repl_fetch
+**
+**		The request is waitms, load, and the number of logs,
+**		followed by an entry for each log (see _gdp_gcl_repl_fetch).
+**		The reply seems to come from the first log named.
+*/
+
+EP_STAT
+logd_repl_fetch(gdp_req_t *req)
+{
+	gdp_buf_t *dbuf = req->pdu->datum->dbuf;
+	struct repl_fetch *rf;
+	uint32_t waitms;
+	uint32_t load;
+	uint32_t nlogs;
+	uint32_t i;
+	bool parked = false;
+
+	if (gdp_buf_getlength(dbuf) < 3 * sizeof (uint32_t))
+		goto fail0;
+	waitms = gdp_buf_get_uint32(dbuf);
+	load = gdp_buf_get_uint32(dbuf);
+	nlogs = gdp_buf_get_uint32(dbuf);
+	if (nlogs == 0 || gdp_buf_getlength(dbuf) / REPL_FETCH_ENTLEN < nlogs)
+		goto fail0;
+
+	rf = ep_mem_zalloc(sizeof *rf);
+	rf->logs = ep_mem_zalloc(nlogs * sizeof *rf->logs);
+	rf->nlogs = nlogs;
+	rf->req = req;
+	for (i = 0; i < nlogs; i++)
+	{
+		struct repl_wait *w = &rf->logs[i];
+		uint8_t link[EP_CRYPTO_MD_MAXSIZE];
+		uint32_t stalems;
+		uint32_t alg;
+		size_t linklen = 0;
+
+		if (gdp_buf_getlength(dbuf) < REPL_FETCH_ENTLEN)
+			goto fail1;
+		gdp_buf_read(dbuf, w->name, sizeof w->name);
+		w->first = gdp_buf_get_uint64(dbuf);
+		w->maxrecs = gdp_buf_get_uint32(dbuf);
+		stalems = gdp_buf_get_uint32(dbuf);
+		alg = gdp_buf_get_uint32(dbuf);
+		if (alg != 0 && ((linklen = ep_crypto_md_len(alg)) == 0 ||
+					linklen > sizeof link ||
+					gdp_buf_read(dbuf, link, linklen) < linklen))
+			goto fail1;
+		w->rf = rf;
+		w->estat = gcl_get_open(w->name, GDP_MODE_RO, &w->gcl);
+		if (!EP_STAT_ISOK(w->estat))
+		{
+			w->gcl = NULL;
+			continue;
+		}
+		if (w->first == 0)
+			continue;
+
+		if (!repl_chain_agrees(w->gcl, w->first - 1, alg, link))
+		{
+			gdp_pname_t fpname;
+
+			w->estat = GDP_STAT_NAK_CONFLICT;
+			ep_log(w->estat, "logd_repl_fetch: %s's copy of %s"
+					" differs from ours at or before %" PRIgdp_recno,
+					gdp_printable_name(req->pdu->src, fpname),
+					w->gcl->pname, w->first - 1);
+			_gdp_gcl_decref(&w->gcl);
+			continue;
+		}
+		logd_repl_note_follower(w->name, req->pdu->src, w->first - 1,
+				stalems, load);
+	}
+	gdp_buf_reset(dbuf);
+
+	// the reply comes from the first log
+	memcpy(req->pdu->dst, rf->logs[0].name, sizeof req->pdu->dst);
+	req->pdu->cmd = GDP_ACK_CONTENT;
+
+	// if the follower has everything, park the request for a while
+	if (waitms > ReplMaxWait)
+		waitms = ReplMaxWait;
+	if (waitms > 0)
+	{
+		ep_thr_mutex_lock(&FetchMutex);
+		for (i = 0; i < nlogs; i++)
+		{
+			struct repl_wait *w = &rf->logs[i];
+
+			if (w->gcl == NULL || w->first == 0 || w->first <= w->gcl->nrecs)
+				break;
+		}
+		if (i >= nlogs)
+		{
+			struct timeval tv = { waitms / 1000, (waitms % 1000) * 1000 };
+
+			for (i = 0; i < nlogs; i++)
+			{
+				struct repl_wait *w = &rf->logs[i];
+
+				w->next = w->gcl->x->repl_waits;
+				w->gcl->x->repl_waits = w;
+			}
+			rf->state = RF_PARKED;
+			rf->next = ReplFetches;
+			ReplFetches = rf;
+			rf->timer = event_new(GdpIoEventBase, -1, 0,
+							&repl_fetch_timeout, rf);
+			event_add(rf->timer, &tv);
+			req->flags |= GDP_REQ_PERSIST | GDP_REQ_DEFER_REPLY;
+			parked = true;
+		}
+		ep_thr_mutex_unlock(&FetchMutex);
+	}
+
+	if (!parked)
+	{
+		repl_fetch_build(rf, dbuf);
+		repl_fetch_free(rf);
+	}
+	return EP_STAT_OK;
+
+fail1:
+	repl_fetch_free(rf);
+fail0:
+	gdp_buf_reset(dbuf);
+	ep_dbg_cprintf(Dbg, 1, "logd_repl_fetch: malformed request\n");
+	return GDP_STAT_NAK_BADREQ;
+}
+
+
+/*
+**  Print replication status (for debugging)
+*/
+
+void
+logd_repl_dump(FILE *fp)
+{
+	struct repl_log *rl;
+	EP_TIME_SPEC now;
+
+	if (ReplLogs == NULL)
+		return;
+	ep_time_now(&now);
+	fprintf(fp, "\n<<< Replicated logs >>>\n");
+	for (rl = ReplLogs; rl != NULL; rl = rl->next)
+	{
+		char ebuf[100];
+
+		ep_thr_mutex_lock(&rl->mutex);
+		fprintf(fp, "%s: %" PRIgdp_recno " of %" PRIgdp_recno,
+				rl->pname, rl->local_recno, rl->leader_recno);
+		if (EP_TIME_ISVALID(&rl->caughtup))
+			fprintf(fp, ", current as of %" PRIu64 "s ago",
+					(uint64_t) (now.tv_sec - rl->caughtup.tv_sec));
+		fprintf(fp, "\n    %s\n",
+				ep_stat_tostr(rl->laststat, ebuf, sizeof ebuf));
+		ep_thr_mutex_unlock(&rl->mutex);
+	}
+	fprintf(fp, "replica load %" PRIu32 " reads/sec\n", repl_load());
+}
@@ -0,0 +1,1060 @@
+/* vim: set ai sw=4 sts=4 ts=4 : */
+
+/*
+**	----- BEGIN LICENSE BLOCK -----
+**	GDPLOGD: Log Daemon for the Global Data Plane
+**	From the Ubiquitous Swarm Lab, 490 Cory Hall, U.C. Berkeley.
+**
+**	Copyright (c) 2015, Regents of the University of California.
+**	All rights reserved.
+**
+**	Permission is hereby granted, without written agreement and without
+**	license or royalty fees, to use, copy, modify, and distribute this
+**	software and its documentation for any purpose, provided that the above
+**	copyright notice and the following two paragraphs appear in all copies
+**	of this software.
+**
+**	IN NO EVENT SHALL REGENTS BE LIABLE TO ANY PARTY FOR DIRECT, INDIRECT,
+**	SPECIAL, INCIDENTAL, OR CONSEQUENTIAL DAMAGES, INCLUDING LOST
+**	PROFITS, ARISING OUT OF THE USE OF THIS SOFTWARE AND ITS DOCUMENTATION,
+**	EVEN IF REGENTS HAS BEEN ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+**
+**	REGENTS SPECIFICALLY DISCLAIMS ANY WARRANTIES, INCLUDING, BUT NOT
+**	LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+**	FOR A PARTICULAR PURPOSE. THE SOFTWARE AND ACCOMPANYING DOCUMENTATION,
+**	IF ANY, PROVIDED HEREUNDER IS PROVIDED "AS IS". REGENTS HAS NO
+**	OBLIGATION TO PROVIDE MAINTENANCE, SUPPORT, UPDATES, ENHANCEMENTS,
+**	OR MODIFICATIONS.
+**	----- END LICENSE BLOCK -----
+*/
+
+
+
+/*
+**  Implement logs packed into shared segment files.
+**
+**		Hosting very many small logs with one set of files each
+**		wastes inodes and file descriptors and turns every append
+**		into a random write.  Here all logs share a series of
+**		append-only segment files.  Where each record lives is kept
+**		in memory, rebuilt at startup from the index file that sits
+**		next to each segment.  See logd_seglog.h for the layout.
+**
+**		There is no compaction: segments are never rewritten.
+*/
+
+#include "logd.h"
+#include "logd_io.h"
+#include "logd_seglog.h"
+
+#include <gdp/gdp_buf.h>
+#include <gdp/gdp_gclmd.h>
+
+#include <ep/ep_crc32c.h>
+#include <ep/ep_hash.h>
+#include <ep/ep_log.h>
+#include <ep/ep_mem.h>
+#include <ep/ep_net.h>
+#include <ep/ep_thr.h>
+
+#include <sys/stat.h>
+#include <sys/uio.h>
+#include <dirent.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <inttypes.h>
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+
+static EP_DBG	Dbg = EP_DBG_INIT("gdplogd.seglog", "GDP Log Daemon Segment Log");
+
+#define SEG_PATH_MAX		200		// max length of pathname
+
+static const char	*SegDir;		// where segments live
+static off_t		SegMaxSize;		// start new segment after this
+static bool			SegSync;		// sync data before acknowledging
+
+struct segfile
+{
+	int					fd;				// segment file
+	int					xfd;			// index file
+	off_t				size;			// current size of segment
+};
+
+static struct segfile	*Segs;		// all segments, by number
+static uint32_t			NSegs;		// number of segments
+static uint32_t			SegsAlloc;	// slots allocated in Segs
+static EP_HASH			*SegLogs;	// all segment logs, by name
+static EP_THR_MUTEX		SegMutex	EP_THR_MUTEX_INITIALIZER;
+									// Segs, SegLogs, and all writes
+
+struct segloc
+{
+	uint32_t			segno;			// segment number
+	uint32_t			offset;			// offset of entry in segment
+};
+
+/*
+**  This is what gcl->x->physinfo points at for segment logs
+**  (the other implementations have their own definitions).
+*/
+
+struct physinfo
+{
+	gdp_name_t			name;			// name of this log
+	EP_THR_RWLOCK		lock;			// lock on everything below
+	struct segloc		mdloc;			// create entry (has metadata)
+	gdp_recno_t			max_recno;		// last record appended
+	EP_TIME_SPEC		mtime;			// time of last append
+	struct segloc		*locs;			// locs[recno - 1]
+	size_t				nalloc;			// slots allocated in locs
+};
+
+#define GETSEG(gcl)		((gcl)->x->physinfo)
+
+// a decoded entry header
+struct segent
+{
+	int					type;			// SEG_ENT_*
+	uint16_t			sigmeta;		// signature length & alg
+	uint32_t			dlen;			// length of payload (w/o sig)
+	uint32_t			crc;			// checksum
+	gdp_name_t			name;			// log name
+	gdp_recno_t			recno;			// record number
+	EP_TIME_SPEC		ts;				// timestamp
+};
+
+#define SEG_SIGLEN(e)	((e)->sigmeta & 0x0fff)
+
+
+/*
+**  Encoding helpers (network byte order)
+*/
+
+static void
+put16(uint8_t *p, uint16_t v)
+{
+	v = ep_net_hton16(v);
+	memcpy(p, &v, sizeof v);
+}
+
+static void
+put32(uint8_t *p, uint32_t v)
+{
+	v = ep_net_hton32(v);
+	memcpy(p, &v, sizeof v);
+}
+
+static void
+put64(uint8_t *p, uint64_t v)
+{
+	v = ep_net_hton64(v);
+	memcpy(p, &v, sizeof v);
+}
+
+static uint16_t
+get16(const uint8_t *p)
+{
+	uint16_t v;
+
+	memcpy(&v, p, sizeof v);
+	return ep_net_ntoh16(v);
+}
+
+static uint32_t
+get32(const uint8_t *p)
+{
+	uint32_t v;
+
+	memcpy(&v, p, sizeof v);
+	return ep_net_ntoh32(v);
+}
+
+static uint64_t
+get64(const uint8_t *p)
+{
+	uint64_t v;
+
+	memcpy(&v, p, sizeof v);
+	return ep_net_ntoh64(v);
+}
+
+
+/*
+**  SEGENT_ENCODE --- encode an entry header (with zero checksum)
+*/
+
+static void
+segent_encode(const struct segent *e, uint8_t *hbuf)
+{
+	uint32_t acc;
+
+	put32(&hbuf[0], SEG_ENT_MAGIC);
+	hbuf[4] = e->type;
+	hbuf[5] = 0;
+	put16(&hbuf[6], e->sigmeta);
+	put32(&hbuf[8], e->dlen);
+	put32(&hbuf[12], 0);
+	memcpy(&hbuf[16], e->name, sizeof e->name);
+	put64(&hbuf[48], e->recno);
+	put64(&hbuf[56], e->ts.tv_sec);
+	put32(&hbuf[64], e->ts.tv_nsec);
+	memcpy(&acc, &e->ts.tv_accuracy, sizeof acc);
+	put32(&hbuf[68], acc);
+}
+
+
+/*
+**  SEGENT_DECODE --- decode an entry header
+**
+**		The checksum field is zeroed in hbuf so that the caller
+**		can verify it.
+*/
+
+static EP_STAT
+segent_decode(uint8_t *hbuf, struct segent *e)
+{
+	uint32_t acc;
+
+	if (get32(&hbuf[0]) != SEG_ENT_MAGIC)
+		return GDP_STAT_CORRUPT_GCL;
+	e->type = hbuf[4];
+	e->sigmeta = get16(&hbuf[6]);
+	e->dlen = get32(&hbuf[8]);
+	e->crc = get32(&hbuf[12]);
+	put32(&hbuf[12], 0);
+	memcpy(e->name, &hbuf[16], sizeof e->name);
+	e->recno = get64(&hbuf[48]);
+	e->ts.tv_sec = get64(&hbuf[56]);
+	e->ts.tv_nsec = get32(&hbuf[64]);
+	acc = get32(&hbuf[68]);
+	memcpy(&e->ts.tv_accuracy, &acc, sizeof acc);
+	return EP_STAT_OK;
+}
+
+
+static void
+seg_path(uint32_t segno, const char *sfx, char *pbuf, size_t pbufsiz)
+{
+	snprintf(pbuf, pbufsiz, "%s/%08" PRIx32 "%s", SegDir, segno, sfx);
+}
+
+
+/*
+**  SEG_ADD --- add a segment file to Segs
+*/
+
+static void
+seg_add(uint32_t segno, int fd, int xfd, off_t size)
+{
+	if (segno >= SegsAlloc)
+	{
+		uint32_t n = SegsAlloc == 0 ? 64 : SegsAlloc * 2;
+
+		while (n <= segno)
+			n *= 2;
+		Segs = ep_mem_realloc(Segs, n * sizeof Segs[0]);
+		while (SegsAlloc < n)
+		{
+			Segs[SegsAlloc].fd = Segs[SegsAlloc].xfd = -1;
+			Segs[SegsAlloc++].size = 0;
+		}
+	}
+	Segs[segno].fd = fd;
+	Segs[segno].xfd = xfd;
+	Segs[segno].size = size;
+	if (segno >= NSegs)
+		NSegs = segno + 1;
+}
+
+
+/*
+**  SEG_NEW --- start a new segment (SegMutex must be held)
+*/
+
+static EP_STAT
+seg_new(void)
+{
+	EP_STAT estat;
+	uint32_t segno = NSegs;
+	uint8_t hbuf[SEG_HDR_SIZE];
+	char pbuf[SEG_PATH_MAX];
+	int fd, xfd;
+
+	seg_path(segno, SEG_SUFFIX, pbuf, sizeof pbuf);
+	ep_dbg_cprintf(Dbg, 10, "seg_new: creating %s\n", pbuf);
+	// not O_APPEND: entries are written at reserved offsets
+	fd = open(pbuf, O_RDWR | O_CREAT | O_EXCL, 0644);
+	if (fd < 0)
+		goto fail0;
+	put32(&hbuf[0], SEG_MAGIC);
+	put32(&hbuf[4], SEG_VERSION);
+	put32(&hbuf[8], segno);
+	put32(&hbuf[12], 0);
+	if (pwrite(fd, hbuf, sizeof hbuf, 0) != sizeof hbuf)
+		goto fail1;
+
+	seg_path(segno, SEG_INDEX_SUFFIX, pbuf, sizeof pbuf);
+	xfd = open(pbuf, O_RDWR | O_APPEND | O_CREAT | O_TRUNC, 0644);
+	if (xfd < 0)
+		goto fail1;
+
+	seg_add(segno, fd, xfd, sizeof hbuf);
+	return EP_STAT_OK;
+
+fail1:
+	(void) close(fd);
+fail0:
+	estat = ep_stat_from_errno(errno);
+	ep_log(estat, "seg_new: cannot create %s", pbuf);
+	return estat;
+}
+
+
+/*
+**  SEG_FD --- return the file descriptor for a segment
+*/
+
+static int
+seg_fd(uint32_t segno)
+{
+	int fd = -1;
+
+	ep_thr_mutex_lock(&SegMutex);
+	if (segno < NSegs)
+		fd = Segs[segno].fd;
+	ep_thr_mutex_unlock(&SegMutex);
+	return fd;
+}
+
+
+/*
+**  SEG_RESERVE --- allocate space for an entry in the current segment
+**
+**		Entries are written at the reserved offset, so once the
+**		space is allocated the write itself needs no lock and
+**		appends to different logs proceed in parallel.
+**		SegMutex must be held.
+*/
+
+static EP_STAT
+seg_reserve(size_t len, struct segloc *locp, struct segfile *segp)
+{
+	EP_STAT estat;
+	struct segfile *seg;
+
+	// start a new segment if this one is full (but never leave one empty)
+	if (NSegs == 0 ||
+			(Segs[NSegs - 1].size + len > SegMaxSize &&
+			 Segs[NSegs - 1].size > SEG_HDR_SIZE))
+	{
+		estat = seg_new();
+		EP_STAT_CHECK(estat, return estat);
+	}
+	seg = &Segs[NSegs - 1];
+	locp->segno = NSegs - 1;
+	locp->offset = seg->size;
+	seg->size += len;
+	*segp = *seg;
+	return EP_STAT_OK;
+}
+
+
+/*
+**  SEG_PUT --- write an entry into reserved space
+**
+**		The payload is in two pieces (data and signature).
+**		If the write fails the space is wasted; since the entry
+**		is never indexed, startup recovery ignores it.
+*/
+
+static EP_STAT
+seg_put(struct segent *e,
+		const void *p1, size_t l1,
+		const void *p2, size_t l2,
+		const struct segloc *locp,
+		const struct segfile *seg)
+{
+	EP_STAT estat;
+	uint8_t hbuf[SEG_ENT_HDRSIZE];
+	uint8_t xbuf[SEG_XENT_SIZE];
+	struct iovec iov[3];
+	size_t len = sizeof hbuf + l1 + l2;
+	uint32_t crc;
+
+	segent_encode(e, hbuf);
+	crc = ep_crc32c(0, hbuf, sizeof hbuf);
+	if (l1 > 0)
+		crc = ep_crc32c(crc, p1, l1);
+	if (l2 > 0)
+		crc = ep_crc32c(crc, p2, l2);
+	put32(&hbuf[12], crc);
+
+	iov[0].iov_base = hbuf;
+	iov[0].iov_len = sizeof hbuf;
+	iov[1].iov_base = (void *) p1;
+	iov[1].iov_len = l1;
+	iov[2].iov_base = (void *) p2;
+	iov[2].iov_len = l2;
+	if (logd_io_pwritev(seg->fd, iov, 3, locp->offset) != (ssize_t) len ||
+			(SegSync && logd_io_fsync(seg->fd, true) < 0))
+	{
+		estat = ep_stat_from_errno(errno);
+		ep_log(estat, "seg_put: write to segment %" PRIu32 " failed",
+				locp->segno);
+		return estat;
+	}
+
+	// now the index entry; if this fails startup will recover it
+	memcpy(&xbuf[0], e->name, sizeof e->name);
+	put64(&xbuf[32], e->recno);
+	put64(&xbuf[40], locp->offset);
+	put64(&xbuf[48], e->ts.tv_sec);
+	if (write(seg->xfd, xbuf, sizeof xbuf) != sizeof xbuf)
+		ep_log(ep_stat_from_errno(errno),
+				"seg_put: write to index %" PRIu32 " failed", locp->segno);
+
+	return EP_STAT_OK;
+}
+
+
+/*
+**  SEG_READ_ENTRY --- read and check an entry
+**
+**		On success *payloadp is allocated to hold the payload
+**		(including any signature); the caller must free it.
+*/
+
+static EP_STAT
+seg_read_entry(int fd, off_t off, struct segent *e, uint8_t **payloadp)
+{
+	uint8_t hbuf[SEG_ENT_HDRSIZE];
+	uint8_t *payload;
+	size_t plen;
+	EP_STAT estat;
+
+	if (fd < 0)
+		return GDP_STAT_CORRUPT_GCL;
+	if (logd_io_pread(fd, hbuf, sizeof hbuf, off) != sizeof hbuf)
+		return GDP_STAT_CORRUPT_GCL;
+	estat = segent_decode(hbuf, e);
+	EP_STAT_CHECK(estat, return estat);
+
+	plen = e->dlen + SEG_SIGLEN(e);
+	payload = ep_mem_malloc(plen + 1);
+	if (plen > 0 &&
+			logd_io_pread(fd, payload, plen, off + sizeof hbuf) !=
+					(ssize_t) plen)
+		goto fail1;
+	if (ep_crc32c(ep_crc32c(0, hbuf, sizeof hbuf), payload, plen) != e->crc)
+		goto fail1;
+
+	*payloadp = payload;
+	return EP_STAT_OK;
+
+fail1:
+	ep_mem_free(payload);
+	return GDP_STAT_CORRUPT_GCL;
+}
+
+
+/*
+**  SEGLOG_APPLY --- record the location of an entry in memory
+**
+**		Used both when writing and when recovering at startup.
+*/
+
+static void
+seglog_addloc(gcl_physinfo_t *sl, struct segloc loc)
+{
+	if (sl->max_recno >= sl->nalloc)
+	{
+		sl->nalloc = sl->nalloc == 0 ? 8 : sl->nalloc * 2;
+		sl->locs = ep_mem_realloc(sl->locs, sl->nalloc * sizeof sl->locs[0]);
+	}
+	sl->locs[sl->max_recno++] = loc;
+}
+
+static gcl_physinfo_t *
+seglog_new(const gdp_name_t name, struct segloc mdloc)
+{
+	gcl_physinfo_t *sl = ep_mem_zalloc(sizeof *sl);
+
+	memcpy(sl->name, name, sizeof sl->name);
+	ep_thr_rwlock_init(&sl->lock);
+	sl->mdloc = mdloc;
+	ep_hash_insert(SegLogs, sizeof sl->name, sl->name, sl);
+	return sl;
+}
+
+static void
+seglog_apply(const uint8_t *name,
+		gdp_recno_t recno,
+		struct segloc loc,
+		int64_t mtsec)
+{
+	gcl_physinfo_t *sl = ep_hash_search(SegLogs, sizeof (gdp_name_t), name);
+	gdp_pname_t pname;
+
+	if (recno == 0)
+	{
+		if (sl != NULL)
+		{
+			ep_log(GDP_STAT_CORRUPT_GCL, "seg_init: %s created twice",
+					gdp_printable_name(name, pname));
+			return;
+		}
+		sl = seglog_new(name, loc);
+	}
+	else if (sl == NULL || recno != sl->max_recno + 1)
+	{
+		ep_log(GDP_STAT_CORRUPT_GCL, "seg_init: %s: unexpected recno %"
+				PRIgdp_recno " (segment %" PRIu32 ", offset %" PRIu32 ")",
+				gdp_printable_name(name, pname), recno, loc.segno, loc.offset);
+		return;
+	}
+	else
+	{
+		seglog_addloc(sl, loc);
+	}
+	sl->mtime.tv_sec = mtsec;
+	sl->mtime.tv_nsec = 0;
+	sl->mtime.tv_accuracy = 1.0;
+}
+
+
+/*
+**  SEG_RECOVER --- load one segment at startup
+**
+**		Everything in the index file is loaded, then anything in
+**		the segment after the last indexed entry is scanned (and
+**		added to the index).  A partial entry at the end, left by
+**		a crash, is truncated away.
+*/
+
+static void
+seg_recover(uint32_t segno)
+{
+	char pbuf[SEG_PATH_MAX];
+	uint8_t xbuf[SEG_XENT_SIZE * 64];
+	struct stat st;
+	off_t end = SEG_HDR_SIZE;
+	off_t last = -1;				// offset of highest indexed entry
+	off_t xoff = 0;
+	ssize_t n;
+	int fd, xfd;
+
+	seg_path(segno, SEG_SUFFIX, pbuf, sizeof pbuf);
+	fd = open(pbuf, O_RDWR);
+	if (fd < 0 || fstat(fd, &st) < 0)
+	{
+		ep_log(ep_stat_from_errno(errno), "seg_init: cannot open %s", pbuf);
+		if (fd >= 0)
+			(void) close(fd);
+		return;
+	}
+	seg_path(segno, SEG_INDEX_SUFFIX, pbuf, sizeof pbuf);
+	xfd = open(pbuf, O_RDWR | O_APPEND | O_CREAT, 0644);
+	if (xfd < 0)
+	{
+		ep_log(ep_stat_from_errno(errno), "seg_init: cannot open %s", pbuf);
+		(void) close(fd);
+		return;
+	}
+
+	// load the index
+	while ((n = pread(xfd, xbuf, sizeof xbuf, xoff)) >= SEG_XENT_SIZE)
+	{
+		uint8_t *xp;
+
+		n -= n % SEG_XENT_SIZE;
+		for (xp = xbuf; xp < &xbuf[n]; xp += SEG_XENT_SIZE)
+		{
+			struct segloc loc;
+			uint64_t off = get64(&xp[40]);
+
+			if (off < SEG_HDR_SIZE || off >= (uint64_t) st.st_size)
+				break;
+			loc.segno = segno;
+			loc.offset = off;
+			seglog_apply(xp, get64(&xp[32]), loc, get64(&xp[48]));
+			if ((off_t) off > last)
+				last = off;
+		}
+		xoff += xp - xbuf;
+		if (xp < &xbuf[n])
+			break;
+	}
+	if (ftruncate(xfd, xoff) < 0)
+		ep_log(ep_stat_from_errno(errno), "seg_init: cannot truncate %s",
+				pbuf);
+
+	// scan forward from the end of the highest indexed entry
+	if (last >= 0)
+	{
+		struct segent e;
+		uint8_t hbuf[SEG_ENT_HDRSIZE];
+
+		end = last;
+		if (pread(fd, hbuf, sizeof hbuf, last) == sizeof hbuf &&
+				EP_STAT_ISOK(segent_decode(hbuf, &e)))
+			end += sizeof hbuf + e.dlen + SEG_SIGLEN(&e);
+	}
+	while (end < st.st_size)
+	{
+		struct segent e;
+		uint8_t *payload;
+		uint8_t xent[SEG_XENT_SIZE];
+		struct segloc loc;
+
+		if (!EP_STAT_ISOK(seg_read_entry(fd, end, &e, &payload)))
+		{
+			ep_log(GDP_STAT_CORRUPT_GCL,
+					"seg_init: segment %" PRIu32 ": truncating at %jd",
+					segno, (intmax_t) end);
+			if (ftruncate(fd, end) < 0)
+				ep_log(ep_stat_from_errno(errno),
+						"seg_init: cannot truncate segment %" PRIu32, segno);
+			st.st_size = end;
+			break;
+		}
+		ep_mem_free(payload);
+		loc.segno = segno;
+		loc.offset = end;
+		seglog_apply(e.name, e.recno, loc, e.ts.tv_sec);
+		memcpy(&xent[0], e.name, sizeof e.name);
+		put64(&xent[32], e.recno);
+		put64(&xent[40], end);
+		put64(&xent[48], e.ts.tv_sec);
+		if (write(xfd, xent, sizeof xent) != sizeof xent)
+			ep_log(ep_stat_from_errno(errno),
+					"seg_init: cannot update index %" PRIu32, segno);
+		end += SEG_ENT_HDRSIZE + e.dlen + SEG_SIGLEN(&e);
+	}
+
+	ep_dbg_cprintf(Dbg, 20, "seg_recover: segment %" PRIu32 ", size %jd\n",
+			segno, (intmax_t) st.st_size);
+	seg_add(segno, fd, xfd, st.st_size);
+}
+
+
+/*
+**  SEG_INIT --- initialize the segment implementation
+*/
+
+static EP_STAT
+seg_init(void)
+{
+	DIR *dir;
+	struct dirent *dent;
+	uint32_t segno;
+	uint32_t nsegs = 0;
+
+	SegDir = ep_adm_getstrparam("swarm.gdplogd.seg.dir", NULL);
+	if (SegDir == NULL)
+	{
+		static char dbuf[SEG_PATH_MAX];
+
+		snprintf(dbuf, sizeof dbuf, "%s/_segs",
+				ep_adm_getstrparam("swarm.gdplogd.gcl.dir",
+						"/var/swarm/gdp/gcls"));
+		SegDir = dbuf;
+	}
+	SegMaxSize = ep_adm_getlongparam("swarm.gdplogd.seg.maxsize",
+							256 * 1024 * 1024);
+	if (SegMaxSize > UINT32_MAX)
+		SegMaxSize = UINT32_MAX;
+	SegSync = ep_adm_getboolparam("swarm.gdplogd.seg.sync", false);
+	ep_dbg_cprintf(Dbg, 8, "seg_init: segment dir = %s, max size %jd\n",
+			SegDir, (intmax_t) SegMaxSize);
+
+	ep_thr_mutex_lock(&SegMutex);
+	if (SegLogs == NULL)
+		SegLogs = ep_hash_new("SegLogs", NULL, 0);
+
+	// find out how many segments there are
+	dir = opendir(SegDir);
+	if (dir == NULL)
+	{
+		// no segments yet; it will be created when needed
+		if (mkdir(SegDir, 0755) < 0 && errno != EEXIST)
+			ep_log(ep_stat_from_errno(errno),
+					"seg_init: cannot create %s", SegDir);
+	}
+	else
+	{
+		while ((dent = readdir(dir)) != NULL)
+		{
+			char *p;
+
+			p = strrchr(dent->d_name, '.');
+			if (p == NULL || strcmp(p, SEG_SUFFIX) != 0)
+				continue;
+			segno = strtoul(dent->d_name, &p, 16);
+			if (strcmp(p, SEG_SUFFIX) == 0 && segno + 1 > nsegs)
+				nsegs = segno + 1;
+		}
+		closedir(dir);
+	}
+
+	// load them in order (a log's records are in order across segments)
+	for (segno = 0; segno < nsegs; segno++)
+		seg_recover(segno);
+	ep_thr_mutex_unlock(&SegMutex);
+
+	ep_dbg_cprintf(Dbg, 8, "seg_init: %" PRIu32 " segments\n", nsegs);
+	return EP_STAT_OK;
+}
+
+
+/*
+**  SEG_CREATE --- create a new log in the segments
+*/
+
+static EP_STAT
+seg_create(gdp_gcl_t *gcl, gdp_gclmd_t *gmd)
+{
+	EP_STAT estat;
+	struct evbuffer *evb;
+	struct segent e;
+	struct segloc loc;
+	struct segfile seg;
+	size_t mdlen;
+
+	EP_ASSERT_POINTER_VALID(gcl);
+
+	// allocate a name
+	if (!gdp_name_is_valid(gcl->name))
+	{
+		_gdp_gcl_newname(gcl);
+	}
+
+	evb = evbuffer_new();
+	if (gmd != NULL)
+		_gdp_gclmd_serialize(gmd, evb);
+	mdlen = evbuffer_get_length(evb);
+
+	memset(&e, 0, sizeof e);
+	e.type = SEG_ENT_CREATE;
+	e.dlen = mdlen;
+	memcpy(e.name, gcl->name, sizeof e.name);
+	e.recno = 0;
+	ep_time_now(&e.ts);
+
+	// creates are rare, so just hold the lock throughout
+	ep_thr_mutex_lock(&SegMutex);
+	if (ep_hash_search(SegLogs, sizeof e.name, e.name) != NULL)
+	{
+		estat = GDP_STAT_NAK_CONFLICT;
+		goto fail0;
+	}
+	estat = seg_reserve(SEG_ENT_HDRSIZE + mdlen, &loc, &seg);
+	EP_STAT_CHECK(estat, goto fail0);
+	estat = seg_put(&e, evbuffer_pullup(evb, mdlen), mdlen, NULL, 0,
+					&loc, &seg);
+	EP_STAT_CHECK(estat, goto fail0);
+	gcl->x->physinfo = seglog_new(e.name, loc);
+	gcl->x->physinfo->mtime = e.ts;
+	ep_dbg_cprintf(Dbg, 10, "Created new segment GCL %s\n", gcl->pname);
+
+fail0:
+	ep_thr_mutex_unlock(&SegMutex);
+	evbuffer_free(evb);
+	return estat;
+}
+
+
+/*
+**  SEG_OPEN --- attach a handle to an existing log
+*/
+
+static EP_STAT
+seg_open(gdp_gcl_t *gcl)
+{
+	gcl_physinfo_t *sl;
+
+	EP_ASSERT_REQUIRE(gcl->x->physinfo == NULL);
+
+	ep_thr_mutex_lock(&SegMutex);
+	sl = ep_hash_search(SegLogs, sizeof (gdp_name_t), gcl->name);
+	ep_thr_mutex_unlock(&SegMutex);
+	if (sl == NULL)
+		return GDP_STAT_NAK_NOTFOUND;
+	gcl->x->physinfo = sl;
+
+	ep_thr_rwlock_rdlock(&sl->lock);
+	gcl->nrecs = sl->max_recno;
+	ep_thr_rwlock_unlock(&sl->lock);
+	return EP_STAT_OK;
+}
+
+
+/*
+**  SEG_CLOSE --- detach a handle (the index stays in memory)
+*/
+
+static EP_STAT
+seg_close(gdp_gcl_t *gcl)
+{
+	EP_ASSERT_POINTER_VALID(gcl);
+	EP_ASSERT_POINTER_VALID(gcl->x);
+
+	gcl->x->physinfo = NULL;
+	return EP_STAT_OK;
+}
+
+
+/*
+**  SEG_READ --- read a record
+*/
+
+static EP_STAT
+seg_read(gdp_gcl_t *gcl,
+		gdp_datum_t *datum)
+{
+	gcl_physinfo_t *sl = GETSEG(gcl);
+	EP_STAT estat;
+	struct segloc loc;
+	struct segent e;
+	uint8_t *payload;
+
+	ep_dbg_cprintf(Dbg, 14, "seg_read(%" PRIgdp_recno ")\n", datum->recno);
+
+	// locations never change once written, so take a copy
+	ep_thr_rwlock_rdlock(&sl->lock);
+	if (datum->recno < 1 || datum->recno > sl->max_recno)
+	{
+		ep_thr_rwlock_unlock(&sl->lock);
+		return GDP_STAT_NAK_NOTFOUND;
+	}
+	loc = sl->locs[datum->recno - 1];
+	ep_thr_rwlock_unlock(&sl->lock);
+
+	estat = seg_read_entry(seg_fd(loc.segno), loc.offset, &e, &payload);
+	if (EP_STAT_ISOK(estat) &&
+			(e.type != SEG_ENT_RECORD || e.recno != datum->recno ||
+			 memcmp(e.name, sl->name, sizeof e.name) != 0))
+	{
+		ep_mem_free(payload);
+		estat = GDP_STAT_CORRUPT_GCL;
+	}
+	if (!EP_STAT_ISOK(estat))
+	{
+		ep_log(estat, "seg_read: %s: bad entry for recno %" PRIgdp_recno
+				" (segment %" PRIu32 ", offset %" PRIu32 ")",
+				gcl->pname, datum->recno, loc.segno, loc.offset);
+		return estat;
+	}
+
+	datum->ts = e.ts;
+	datum->sigmdalg = (e.sigmeta >> 12) & 0x000f;
+	datum->siglen = SEG_SIGLEN(&e);
+	if (e.dlen > 0)
+		gdp_buf_write(datum->dbuf, payload, e.dlen);
+	if (datum->siglen > 0)
+	{
+		if (datum->sig == NULL)
+			datum->sig = gdp_buf_new();
+		else
+			gdp_buf_reset(datum->sig);
+		gdp_buf_write(datum->sig, &payload[e.dlen], datum->siglen);
+	}
+	ep_mem_free(payload);
+	return EP_STAT_OK;
+}
+
+
+/*
+**  SEG_GETTIMESTAMP --- return the timestamp of a record
+**
+**		Only the entry header is read, so the checksum (which
+**		covers the payload) can't be verified here.
+*/
+
+static EP_STAT
+seg_gettimestamp(gdp_gcl_t *gcl,
+		gdp_recno_t recno,
+		EP_TIME_SPEC *tsp)
+{
+	gcl_physinfo_t *sl = GETSEG(gcl);
+	EP_STAT estat;
+	struct segloc loc;
+	struct segent e;
+	uint8_t hbuf[SEG_ENT_HDRSIZE];
+	int fd;
+
+	ep_thr_rwlock_rdlock(&sl->lock);
+	if (recno < 1 || recno > sl->max_recno)
+	{
+		ep_thr_rwlock_unlock(&sl->lock);
+		return GDP_STAT_NAK_NOTFOUND;
+	}
+	loc = sl->locs[recno - 1];
+	ep_thr_rwlock_unlock(&sl->lock);
+
+	if ((fd = seg_fd(loc.segno)) < 0 ||
+			logd_io_pread(fd, hbuf, sizeof hbuf, loc.offset) != sizeof hbuf)
+		return GDP_STAT_CORRUPT_GCL;
+	estat = segent_decode(hbuf, &e);
+	EP_STAT_CHECK(estat, return estat);
+	if (e.type != SEG_ENT_RECORD || e.recno != recno)
+		return GDP_STAT_CORRUPT_GCL;
+	*tsp = e.ts;
+	return EP_STAT_OK;
+}
+
+
+/*
+**  SEG_APPEND --- append a record
+*/
+
+static EP_STAT
+seg_append(gdp_gcl_t *gcl,
+		gdp_datum_t *datum)
+{
+	gcl_physinfo_t *sl = GETSEG(gcl);
+	EP_STAT estat;
+	struct segent e;
+	struct segloc loc;
+	struct segfile seg;
+	uint8_t *dp = NULL;
+	uint8_t *sp = NULL;
+	size_t dlen, slen = 0;
+
+	if (ep_dbg_test(Dbg, 14))
+	{
+		ep_dbg_printf("seg_append ");
+		_gdp_datum_dump(datum, ep_dbg_getfile());
+	}
+
+	dlen = evbuffer_get_length(datum->dbuf);
+	if (dlen > 0)
+		dp = evbuffer_pullup(datum->dbuf, dlen);
+	if (datum->sig != NULL)
+	{
+		slen = evbuffer_get_length(datum->sig);
+		sp = evbuffer_pullup(datum->sig, slen);
+	}
+
+	memset(&e, 0, sizeof e);
+	e.type = SEG_ENT_RECORD;
+	e.sigmeta = (slen & 0x0fff) | ((datum->sigmdalg & 0x000f) << 12);
+	e.dlen = dlen;
+	memcpy(e.name, sl->name, sizeof e.name);
+	e.ts = datum->ts;
+
+	ep_thr_rwlock_wrlock(&sl->lock);
+	e.recno = sl->max_recno + 1;
+	ep_thr_mutex_lock(&SegMutex);
+	estat = seg_reserve(SEG_ENT_HDRSIZE + dlen + slen, &loc, &seg);
+	ep_thr_mutex_unlock(&SegMutex);
+	if (EP_STAT_ISOK(estat))
+		estat = seg_put(&e, dp, dlen, sp, slen, &loc, &seg);
+	if (EP_STAT_ISOK(estat))
+	{
+		seglog_addloc(sl, loc);
+		sl->mtime = datum->ts;
+	}
+	ep_thr_rwlock_unlock(&sl->lock);
+
+	return estat;
+}
+
+
+/*
+**  SEG_GETMETADATA --- read metadata from the create entry
+*/
+
+static EP_STAT
+seg_getmetadata(gdp_gcl_t *gcl,
+		gdp_gclmd_t **gmdp)
+{
+	gcl_physinfo_t *sl = GETSEG(gcl);
+	EP_STAT estat;
+	struct segent e;
+	uint8_t *payload;
+	struct evbuffer *evb;
+
+	estat = seg_read_entry(seg_fd(sl->mdloc.segno), sl->mdloc.offset,
+					&e, &payload);
+	EP_STAT_CHECK(estat, return estat);
+	if (e.type != SEG_ENT_CREATE)
+	{
+		ep_mem_free(payload);
+		return GDP_STAT_CORRUPT_GCL;
+	}
+
+	evb = evbuffer_new();
+	evbuffer_add(evb, payload, e.dlen);
+	*gmdp = _gdp_gclmd_deserialize(evb);
+	evbuffer_free(evb);
+	ep_mem_free(payload);
+	if (*gmdp == NULL)
+		*gmdp = gdp_gclmd_new(0);
+	return EP_STAT_OK;
+}
+
+
+/*
+**  SEG_FOREACH --- call function for each segment log
+*/
+
+static void
+foreach_helper(size_t klen, const void *key, void *val, va_list av)
+{
+	void (*func)(gdp_name_t, void *) = va_arg(av, void (*)(gdp_name_t, void *));
+	void *ctx = va_arg(av, void *);
+
+	if (val != NULL)
+		(*func)(((gcl_physinfo_t *) val)->name, ctx);
+}
+
+static void
+seg_foreach(void (*func)(gdp_name_t, void *), void *ctx)
+{
+	ep_thr_mutex_lock(&SegMutex);
+	if (SegLogs != NULL)
+		ep_hash_forall(SegLogs, foreach_helper, func, ctx);
+	ep_thr_mutex_unlock(&SegMutex);
+}
+
+
+/*
+**  SEG_GETMTIME --- return time of last append
+**
+**		Also serves as a cheap test of whether a segment log with
+**		this name exists.
+*/
+
+static EP_STAT
+seg_getmtime(gdp_name_t gname, EP_TIME_SPEC *mtime)
+{
+	gcl_physinfo_t *sl = NULL;
+
+	ep_thr_mutex_lock(&SegMutex);
+	if (SegLogs != NULL)
+		sl = ep_hash_search(SegLogs, sizeof (gdp_name_t), gname);
+	ep_thr_mutex_unlock(&SegMutex);
+	if (sl == NULL)
+		return GDP_STAT_NAK_NOTFOUND;
+	ep_thr_rwlock_rdlock(&sl->lock);
+	*mtime = sl->mtime;
+	ep_thr_rwlock_unlock(&sl->lock);
+	return EP_STAT_OK;
+}
+
+
+struct gcl_phys_impl	GdpSegImpl =
+{
+	.init =			seg_init,
+	.read =			seg_read,
+	.create =		seg_create,
+	.open =			seg_open,
+	.close =		seg_close,
+	.append =		seg_append,
+	.getmetadata =	seg_getmetadata,
+	.foreach =		seg_foreach,
+	.getmtime =		seg_getmtime,
+	.gettimestamp =	seg_gettimestamp,
+};
@@ -0,0 +1,99 @@
+/* vim: set ai sw=4 sts=4 ts=4 : */
+
+/*
+**	----- BEGIN LICENSE BLOCK -----
+**	GDPLOGD: Log Daemon for the Global Data Plane
+**	From the Ubiquitous Swarm Lab, 490 Cory Hall, U.C. Berkeley.
+**
+**	Copyright (c) 2015, Regents of the University of California.
+**	All rights reserved.
+**
+**	Permission is hereby granted, without written agreement and without
+**	license or royalty fees, to use, copy, modify, and distribute this
+**	software and its documentation for any purpose, provided that the above
+**	copyright notice and the following two paragraphs appear in all copies
+**	of this software.
+**
+**	IN NO EVENT SHALL REGENTS BE LIABLE TO ANY PARTY FOR DIRECT, INDIRECT,
+**	SPECIAL, INCIDENTAL, OR CONSEQUENTIAL DAMAGES, INCLUDING LOST
+**	PROFITS, ARISING OUT OF THE USE OF THIS SOFTWARE AND ITS DOCUMENTATION,
+**	EVEN IF REGENTS HAS BEEN ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+**
+**	REGENTS SPECIFICALLY DISCLAIMS ANY WARRANTIES, INCLUDING, BUT NOT
+**	LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+**	FOR A PARTICULAR PURPOSE. THE SOFTWARE AND ACCOMPANYING DOCUMENTATION,
+**	IF ANY, PROVIDED HEREUNDER IS PROVIDED "AS IS". REGENTS HAS NO
+**	OBLIGATION TO PROVIDE MAINTENANCE, SUPPORT, UPDATES, ENHANCEMENTS,
+**	OR MODIFICATIONS.
+**	----- END LICENSE BLOCK -----
+*/
+
+
+#ifndef _GDPLOGD_SEGLOG_H_
+#define _GDPLOGD_SEGLOG_H_		1
+
+#include "logd.h"
+
+/*
+**	Headers for the packed segment log implementation.
+**		This is how bytes are laid out on disk for logs that are
+**		kept in shared segment files rather than files of their own.
+**
+**		Segment files are append-only and are numbered from zero;
+**		when the current one reaches swarm.gdplogd.seg.maxsize a new
+**		one is started.  Each begins with a SEG_HDR_SIZE byte header
+**		(magic, version, segment number, reserved) followed by a
+**		series of entries from any number of logs, each of which is
+**		a SEG_ENT_HDRSIZE byte header followed by a payload:
+**
+**			 0	magic (SEG_ENT_MAGIC)			4 bytes
+**			 4	type (SEG_ENT_*)				1
+**			 5	flags (none defined yet)		1
+**			 6	sigmeta (as in disk logs)		2
+**			 8	payload length (dlen)			4
+**			12	CRC-32C							4
+**			16	log name						32
+**			48	record number (0 for create)	8
+**			56	timestamp seconds				8
+**			64	timestamp nanoseconds			4
+**			68	timestamp accuracy (float)		4
+**
+**		The payload is the serialized metadata for SEG_ENT_CREATE
+**		entries, or the data followed by the signature for
+**		SEG_ENT_RECORD entries.  dlen does not include the signature,
+**		whose length is in sigmeta.  The checksum covers the header
+**		(with the checksum field zero) and the entire payload.
+**		Everything is in network byte order.
+**
+**		Next to each segment is an index file with a
+**		SEG_XENT_SIZE entry for each entry in the segment:
+**
+**			 0	log name						32
+**			32	record number (0 for create)	8
+**			40	offset in segment				8
+**			48	modification time (seconds)		8
+**
+**		Space for an entry is reserved before it is written, so
+**		appends to different logs may complete out of order and
+**		index entries are not necessarily in offset order (but are
+**		in record order for any one log).  The index is written
+**		after the segment, so after a crash it may be missing
+**		entries; those past the highest indexed one are recovered
+**		by scanning the segment at startup.  Any others were never
+**		acknowledged and are ignored.
+*/
+
+#define SEG_MAGIC			UINT32_C(0x47445353)	// 'GDSS'
+#define SEG_VERSION			UINT32_C(20170101)		// on-disk version
+#define SEG_SUFFIX			".gdpseg"
+#define SEG_INDEX_SUFFIX	".gdpsdx"
+#define SEG_HDR_SIZE		16
+
+#define SEG_ENT_MAGIC		UINT32_C(0x47445345)	// 'GDSE'
+#define SEG_ENT_CREATE		1						// new log + metadata
+#define SEG_ENT_RECORD		2						// data record
+#define SEG_ENT_HDRSIZE		72
+
+#define SEG_XENT_SIZE		56
+
+#endif //_GDPLOGD_SEGLOG_H_
@@ -380,6 +380,59 @@ class GDP_GCL:
 
         return self.__multiread(start, numrecs, None, None)
 
+    def __multiread_sampled(self, start, numrecs, stride, bucket,
+                            cbfunc, cbarg):
+        """
+        similar to multiread_sampled in the GDP C API
+        """
+
+        # casting start, numrecs and stride to ctypes
+        __start = gdp_recno_t(start)
+        __numrecs = c_int32(numrecs)
+        __stride = c_int32(stride)
+
+        # if bucket is None, then we just skip this
+        if bucket == None:
+            __bucket = None
+        else:
+            __bucket = GDP_DATUM.EP_TIME_SPEC()
+            __bucket.tv_sec = c_int64(bucket['tv_sec'])
+            __bucket.tv_nsec = c_uint32(bucket['tv_nsec'])
+            __bucket.tv_accuracy = c_float(bucket.get('tv_accuracy', 0.0))
+
+        # casting the python function to the callback function
+        if cbfunc == None:
+            __cbfunc = None
+        else:
+            __cbfunc = self.gdp_gcl_sub_cbfunc_t(cbfunc)
+
+        __func = gdp.gdp_gcl_multiread_sampled
+        if cbfunc == None:
+            __func.argtypes = [POINTER(self.gdp_gcl_t), gdp_recno_t, c_int32,
+                               c_int32, POINTER(GDP_DATUM.EP_TIME_SPEC),
+                               c_void_p, c_void_p]
+        else:
+            __func.argtypes = [POINTER(self.gdp_gcl_t), gdp_recno_t, c_int32,
+                               c_int32, POINTER(GDP_DATUM.EP_TIME_SPEC),
+                               self.gdp_gcl_sub_cbfunc_t, c_void_p]
+        __func.restype = EP_STAT
+
+        estat = __func(self.ptr, __start, __numrecs, __stride, __bucket,
+                       __cbfunc, cbarg)
+        check_EP_STAT(estat)
+        return estat
+
+    def multiread_sampled(self, start, numrecs, stride=1, bucket=None):
+        """
+        Multiread returning only every stride'th record, or (if bucket
+            is given as a time dictionary) the last record in each
+            bucket-sized time interval. Refer to the C-API for details.
+            Events are generated, as for multiread.
+        """
+
+        return self.__multiread_sampled(start, numrecs, stride, bucket,
+                                        None, None)
+
     def print_to_file(self, fh, detail, indent):
         """
         Print this GDP object to a file. Could be sys.stdout
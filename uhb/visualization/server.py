@@ -63,6 +63,21 @@ class GDPcache:
         return ret
 
 
+    def __multiread_sampled(self, start, num, stride):
+        """ like __multiread, but the log server only returns every
+        stride'th record, so a long range costs a single request """
+        self.lh.multiread_sampled(start, num, stride)
+        ret = []
+        while True:
+            event = self.lh.get_next_event(None)
+            if event['type'] == gdp.GDP_EVENT_EOS: break
+            datum = event['datum']
+            recno = datum['recno']
+            self.cache[recno] = datum
+            ret.append(datum)
+        return ret
+
+
     def __findRecNo(self, t):
         """ find the most recent record num before t, i.e. a binary search"""
 
@@ -91,13 +106,9 @@ class GDPcache:
         if _endR+1-_startR<4*numPoints:
             return self.__multiread(_startR, (_endR+1)-_startR)
 
-        # if not, let's read one by one
-        ret = []
+        # if not, let the log server do the downsampling
         step = max((_endR+1-_startR)/numPoints,1)
-        for r in xrange(_startR, _endR+1, step):
-            ret.append(self.__read(r))
-
-        return ret
+        return self.__multiread_sampled(_startR, (_endR+1)-_startR, step)
 
     def mostRecent(self):
         return self.__read(-1)